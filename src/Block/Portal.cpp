@@ -1,11 +1,16 @@
 #include "Block/Portal.hpp"
 
+#include "Engine.hpp"
 #include "Render/Renderer.hpp"
 
 PortalBlock::PortalBlock()
 {
     m_unbreakable = true;
     m_solid = false;
+
+    if (Engine::get().is_headless())
+        return;
+
     m_mat = Material::create(Renderer::get().get_portal_shader(), MaterialFlagBits::NoNormal | MaterialFlagBits::NoUV | MaterialFlagBits::StencilMask, WGPUCullMode_Back, WGPUVertexFormat_Float32x2);
     m_mesh = Renderer::get().get_cube_mesh();
 }
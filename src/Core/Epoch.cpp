@@ -0,0 +1,173 @@
+#include "Core/Epoch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+struct alignas(64) Record
+{
+    /**
+     * Epoch pinned by the thread, 0 when not pinned.
+     */
+    std::atomic<uint64_t> epoch = 0;
+    std::atomic<bool> in_use = false;
+    Record *next = nullptr;
+
+    /**
+     * Number of live guards, only used by the owner thread.
+     */
+    uint32_t depth = 0;
+};
+
+struct Retired
+{
+    void *object;
+    void (*deleter)(void *);
+    uint64_t epoch;
+};
+
+struct RetiredList
+{
+    std::mutex mutex;
+    std::vector<Retired> objects;
+
+    /**
+     * Every thread is gone when static objects are destroyed.
+     */
+    ~RetiredList()
+    {
+        for (const Retired& retired : objects)
+            retired.deleter(retired.object);
+    }
+};
+
+constexpr size_t collect_threshold = 64;
+
+std::atomic<uint64_t> global_epoch = 1;
+
+/**
+ * Records are never freed, a record released by an exiting thread is reused by the next thread.
+ */
+std::atomic<Record *> records = nullptr;
+
+RetiredList retired_list;
+
+Record *acquire_record()
+{
+    for (Record *record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+    {
+        bool expected = false;
+        if (!record->in_use.load(std::memory_order_relaxed) && record->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return record;
+    }
+
+    Record *record = new Record();
+    record->in_use.store(true, std::memory_order_relaxed);
+
+    Record *head = records.load(std::memory_order_relaxed);
+    do
+    {
+        record->next = head;
+    } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+
+    return record;
+}
+
+struct ThreadRecord
+{
+    Record *record = acquire_record();
+
+    ~ThreadRecord()
+    {
+        record->epoch.store(0, std::memory_order_release);
+        record->in_use.store(false, std::memory_order_release);
+    }
+};
+
+Record& thread_record()
+{
+    static thread_local ThreadRecord thread_record;
+    return *thread_record.record;
+}
+
+/**
+ * Oldest epoch pinned by a reader, or the maximum value if no reader is pinned.
+ */
+uint64_t oldest_pinned_epoch()
+{
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (Record *record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+    {
+        const uint64_t epoch = record->epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0)
+            oldest = std::min(oldest, epoch);
+    }
+    return oldest;
+}
+
+} // namespace
+
+Epoch::Guard::Guard()
+{
+    Record& record = thread_record();
+    if (record.depth++ == 0)
+    {
+        // Sequentially consistent so the pin is visible to writers before any shared pointer is read.
+        record.epoch.store(global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+}
+
+Epoch::Guard::~Guard()
+{
+    Record& record = thread_record();
+    if (--record.depth == 0)
+        record.epoch.store(0, std::memory_order_release);
+}
+
+void Epoch::retire(void *object, void (*deleter)(void *))
+{
+    // Readers that pin from now on get a later epoch and can not see the object.
+    const uint64_t epoch = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    bool should_collect;
+    {
+        std::lock_guard<std::mutex> lock(retired_list.mutex);
+        retired_list.objects.push_back(Retired{object, deleter, epoch});
+        should_collect = retired_list.objects.size() >= collect_threshold;
+    }
+
+    if (should_collect)
+        collect();
+}
+
+void Epoch::collect()
+{
+    std::vector<Retired> to_delete;
+
+    {
+        std::lock_guard<std::mutex> lock(retired_list.mutex);
+
+        // A reader pinned at epoch `e` may see objects retired at epoch `e` or later.
+        const uint64_t oldest = oldest_pinned_epoch();
+        auto iter = std::partition(retired_list.objects.begin(), retired_list.objects.end(), [oldest](const Retired& retired)
+                                   { return retired.epoch >= oldest; });
+
+        to_delete.assign(iter, retired_list.objects.end());
+        retired_list.objects.erase(iter, retired_list.objects.end());
+    }
+
+    for (const Retired& retired : to_delete)
+        retired.deleter(retired.object);
+}
+
+size_t Epoch::pending()
+{
+    std::lock_guard<std::mutex> lock(retired_list.mutex);
+    return retired_list.objects.size();
+}
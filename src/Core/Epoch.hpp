@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Epoch-based reclamation for lock-free readers.
+ *
+ * A reader pins the current epoch while it follows pointers to shared objects. A writer that unlinks an object
+ * retires it instead of deleting it, the object is deleted once every reader that may still see it has unpinned.
+ * Pinning is a store to a cache line owned by the thread, readers never write shared memory.
+ */
+class Epoch
+{
+public:
+    /**
+     * Keeps the thread pinned while alive. Guards can be nested.
+     */
+    class Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    /**
+     * Delete `object` once no reader can see it anymore. The object must already be unreachable for new readers.
+     */
+    template <typename T>
+    static void retire(T *object)
+    {
+        retire(object, [](void *ptr)
+               { delete static_cast<T *>(ptr); });
+    }
+
+    static void retire(void *object, void (*deleter)(void *));
+
+    /**
+     * Delete the retired objects that are no longer visible. Called by `retire` when enough objects are waiting.
+     */
+    static void collect();
+
+    /**
+     * Number of retired objects not deleted yet.
+     */
+    static size_t pending();
+};
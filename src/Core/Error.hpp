@@ -29,6 +29,11 @@ enum class ErrorKind : uint16_t
     WriteFailure = 0x4,
     EndOfFile = 0x5,
 
+    /**
+     * @brief Data read from a file or the network is malformed.
+     */
+    InvalidData = 0x6,
+
     /**
      * @brief A generic error to indicate something went wrong while talking to the GPU.
      */
@@ -84,6 +89,9 @@ static inline const char *error_name(const ErrorKind& kind)
     case ErrorKind::EndOfFile:
         msg = "End of file";
         break;
+    case ErrorKind::InvalidData:
+        msg = "Invalid data";
+        break;
     case ErrorKind::BadDriver:
         msg = "Bad driver";
         break;
@@ -143,6 +151,8 @@ public:
 
     void print(FILE *fp = stderr);
 
+    ErrorKind kind() const { return m_kind; }
+
     bool is_other() const
     {
         return (uint32_t)m_kind < 0x1000;
@@ -1,8 +1,10 @@
 #include "Core/Filesystem.hpp"
 #include "Core/Result.hpp"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <filesystem>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -73,7 +75,10 @@ Result<File> Filesystem::open_file(std::string_view path, bool rw)
 
 Result<void> Filesystem::make_dirs(std::string_view path)
 {
-    std::filesystem::create_directories(path.data());
+    std::error_code error;
+    std::filesystem::create_directories(path.data(), error);
+    if (error)
+        return Error(ErrorKind::WriteFailure);
     return Result<void>();
 }
 
@@ -83,6 +88,75 @@ void File::close()
     m_fd = -1;
 }
 
+Result<size_t> File::read_at(void *buf, size_t size, size_t offset) const
+{
+    ssize_t r = ::pread(m_fd, buf, size, (off_t)offset);
+    if (r == -1)
+        return Error(ErrorKind::ReadFailure);
+    return (size_t)r;
+}
+
+Result<size_t> File::write_at(const void *buf, size_t size, size_t offset) const
+{
+    ssize_t r = ::pwrite(m_fd, buf, size, (off_t)offset);
+    if (r == -1 || (size_t)r != size)
+        return Error(ErrorKind::WriteFailure);
+    return (size_t)r;
+}
+
+Result<void> File::sync() const
+{
+    if (::fsync(m_fd) == -1)
+        return Error(ErrorKind::WriteFailure);
+    return Result<void>();
+}
+
+Result<std::shared_ptr<FileMapping>> File::map(size_t size) const
+{
+    // An empty mapping is not allowed, but there is nothing to read in it anyway.
+    if (size == 0)
+        return std::shared_ptr<FileMapping>(new FileMapping(nullptr, 0));
+
+    void *data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED)
+        return Error(ErrorKind::ReadFailure);
+
+    return std::shared_ptr<FileMapping>(new FileMapping((const uint8_t *)data, size));
+}
+
+FileMapping::~FileMapping()
+{
+    if (m_data != nullptr)
+        ::munmap((void *)m_data, m_size);
+}
+
+void FileMapping::advise(size_t offset, size_t size, Advice advice) const
+{
+    if (m_data == nullptr || offset >= m_size)
+        return;
+
+    // `madvise` wants an address aligned on a page.
+    static const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = offset - offset % page_size;
+    const size_t end = std::min(offset + size, m_size);
+
+    int flag = MADV_NORMAL;
+    switch (advice)
+    {
+    case Advice::Normal:
+        flag = MADV_NORMAL;
+        break;
+    case Advice::Sequential:
+        flag = MADV_SEQUENTIAL;
+        break;
+    case Advice::WillNeed:
+        flag = MADV_WILLNEED;
+        break;
+    }
+
+    ::madvise((void *)(m_data + start), end - start, flag);
+}
+
 Result<size_t> FileReader::read_raw(void *buffer, size_t size)
 {
     ssize_t r = ::read(m_fp->m_fd, buffer, size);
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <span>
 
 #include "Core/IO.hpp"
 #include "Core/Result.hpp"
 
 class File;
+class FileMapping;
 
 class FileReader : public Reader
 {
@@ -47,6 +50,30 @@ public:
     File();
     void close();
 
+    bool is_open() const { return m_fd != -1; }
+    size_t size() const { return m_size; }
+
+    /**
+     * Read at a specific offset without moving the file cursor. Can be called from multiple threads.
+     */
+    Result<size_t> read_at(void *buf, size_t size, size_t offset) const;
+
+    /**
+     * Write at a specific offset without moving the file cursor. Can be called from multiple threads.
+     */
+    Result<size_t> write_at(const void *buf, size_t size, size_t offset) const;
+
+    /**
+     * Flush the written data to the disk.
+     */
+    Result<void> sync() const;
+
+    /**
+     * Map the first `size` bytes of the file in memory, read-only. Later writes to the file are visible through the
+     * mapping, up to `size`.
+     */
+    Result<std::shared_ptr<FileMapping>> map(size_t size) const;
+
     FileReader reader() const { return FileReader(this); }
     FileWriter writer() const { return FileWriter(m_fd); }
 
@@ -57,6 +84,49 @@ private:
     int m_fd;
 };
 
+class FileMapping
+{
+public:
+    enum class Advice
+    {
+        Normal,
+
+        /**
+         * The range is read in order, the kernel reads ahead more and drops the pages already read first.
+         */
+        Sequential,
+
+        /**
+         * The range will be read soon, the kernel starts reading it in the background.
+         */
+        WillNeed,
+    };
+
+    ~FileMapping();
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    std::span<const uint8_t> data() const { return std::span(m_data, m_size); }
+    size_t size() const { return m_size; }
+
+    /**
+     * Hint how a range of the mapping is going to be read. Only a hint, ignored where not supported.
+     */
+    void advise(size_t offset, size_t size, Advice advice) const;
+
+private:
+    friend class File;
+
+    const uint8_t *m_data;
+    size_t m_size;
+
+    FileMapping(const uint8_t *data, size_t size)
+        : m_data(data), m_size(size)
+    {
+    }
+};
+
 class Filesystem
 {
 public:
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Histogram of frame times with 1 ms buckets, the last bucket counts every frame longer than that.
+ */
+class FrameHistogram
+{
+public:
+    static constexpr size_t bucket_count = 50;
+
+    /**
+     * Frames longer than this are counted as hitches, one frame at 60 FPS.
+     */
+    static constexpr uint64_t hitch_us = 16667;
+
+    void record(std::chrono::microseconds duration)
+    {
+        const uint64_t us = uint64_t(std::max<int64_t>(duration.count(), 0));
+
+        m_buckets[std::min<size_t>(us / 1000, bucket_count - 1)]++;
+        m_count++;
+        m_max_us = std::max(m_max_us, us);
+        if (us > hitch_us)
+            m_hitches++;
+    }
+
+    /**
+     * Upper bound in milliseconds of the bucket containing the percentile.
+     */
+    uint64_t percentile_ms(uint64_t permille) const
+    {
+        const uint64_t rank = (m_count * permille + 999) / 1000;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            seen += m_buckets[i];
+            if (seen >= rank && seen > 0)
+                return i + 1;
+        }
+        return 0;
+    }
+
+    void print(std::string_view name) const
+    {
+        if (m_count == 0)
+            return;
+
+        info("{}: {} frames, p50 < {} ms, p90 < {} ms, p99 < {} ms, max {:.1f} ms, {} hitches", name, m_count, percentile_ms(500), percentile_ms(900), percentile_ms(990), double(m_max_us) / 1000.0, m_hitches);
+
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            if (m_buckets[i] == 0)
+                continue;
+
+            if (i == bucket_count - 1)
+                info("  >= {:2} ms: {}", i, m_buckets[i]);
+            else
+                info("  {:2}-{:2} ms: {}", i, i + 1, m_buckets[i]);
+        }
+    }
+
+private:
+    std::array<uint64_t, bucket_count> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_max_us = 0;
+    uint64_t m_hitches = 0;
+};
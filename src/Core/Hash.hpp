@@ -19,3 +19,17 @@ constexpr uint32_t hash_fnv32(std::string_view s)
 
     return h;
 }
+
+constexpr uint64_t hash_fnv64(std::string_view s)
+{
+    const uint64_t fnv_64_prime = 0x100000001b3;
+    uint64_t h = 0xcbf29ce484222325;
+
+    for (char c : s)
+    {
+        h ^= uint8_t(c);
+        h *= fnv_64_prime;
+    }
+
+    return h;
+}
@@ -3,6 +3,7 @@
 #include "Core/Result.hpp"
 #include "Variant.hpp"
 
+#include <algorithm>
 #include <cstddef>
 
 class Reader
@@ -34,6 +35,11 @@ public:
     virtual size_t size() override;
     virtual bool eof() override;
 
+    /**
+     * Bytes read so far, the rest of the buffer starts there.
+     */
+    size_t position() const { return std::min(m_cursor, m_size); }
+
 private:
     const uint8_t *m_buffer;
     size_t m_size;
@@ -50,6 +56,16 @@ public:
 
     std::span<const uint8_t> buffer() const { return m_buffer; }
 
+    /**
+     * Move the content out of the writer, leaving it empty.
+     */
+    std::vector<uint8_t> release() { return std::move(m_buffer); }
+
+    /**
+     * Empty the writer but keep its capacity, to reuse it without allocating.
+     */
+    void clear() { m_buffer.clear(); }
+
 private:
     std::vector<uint8_t> m_buffer;
 };
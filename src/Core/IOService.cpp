@@ -0,0 +1,564 @@
+#include "Core/IOService.hpp"
+#include "Core/Logger.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <future>
+#include <span>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __platform_linux
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * A read, write or sync of a batch. `result` is the number of bytes transferred, or `-errno`.
+ */
+struct IOOperation
+{
+    enum class Kind : uint8_t
+    {
+        Read,
+        Write,
+        Sync,
+    };
+
+    Kind kind;
+    int fd;
+    uint8_t *buffer;
+    size_t size;
+    size_t offset;
+    int64_t result;
+};
+
+class IOBackend
+{
+public:
+    virtual ~IOBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    /**
+     * Run every operation and set their result, in no particular order.
+     */
+    virtual void run(std::span<IOOperation> operations) = 0;
+};
+
+/**
+ * Portable fallback, the I/O thread makes the syscalls itself.
+ */
+class SyscallBackend : public IOBackend
+{
+public:
+    const char *name() const override { return "syscalls"; }
+
+    void run(std::span<IOOperation> operations) override
+    {
+        for (IOOperation& op : operations)
+        {
+            ssize_t r = 0;
+            switch (op.kind)
+            {
+            case IOOperation::Kind::Read:
+                r = ::pread(op.fd, op.buffer, op.size, (off_t)op.offset);
+                break;
+            case IOOperation::Kind::Write:
+                r = ::pwrite(op.fd, op.buffer, op.size, (off_t)op.offset);
+                break;
+            case IOOperation::Kind::Sync:
+                r = ::fsync(op.fd);
+                break;
+            }
+            op.result = r == -1 ? -errno : r;
+        }
+    }
+};
+
+#ifdef __platform_linux
+
+/**
+ * Submits a whole batch with a single `io_uring_enter` and waits for its completions. Uses the raw syscalls, the rings
+ * are only touched by the I/O thread.
+ */
+class UringBackend : public IOBackend
+{
+public:
+    /**
+     * Returns nothing when the kernel does not support `io_uring` or forbids it, ex: in some containers.
+     */
+    static std::unique_ptr<UringBackend> create(uint32_t entries)
+    {
+        io_uring_params params{};
+        const int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+            return nullptr;
+
+        std::unique_ptr<UringBackend> backend(new UringBackend());
+        backend->m_fd = fd;
+
+        // `IORING_OP_READ` and `IORING_OP_WRITE` need Linux 5.6, which also added this feature.
+        if (!(params.features & IORING_FEAT_RW_CUR_POS))
+            return nullptr;
+
+        backend->m_entries = params.sq_entries;
+        backend->m_sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        backend->m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        backend->m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            backend->m_sq_size = backend->m_cq_size = std::max(backend->m_sq_size, backend->m_cq_size);
+
+        backend->m_sq = map(fd, backend->m_sq_size, IORING_OFF_SQ_RING);
+        if (backend->m_sq == nullptr)
+            return nullptr;
+
+        backend->m_cq = single_mmap ? backend->m_sq : map(fd, backend->m_cq_size, IORING_OFF_CQ_RING);
+        backend->m_sqes = (io_uring_sqe *)map(fd, backend->m_sqes_size, IORING_OFF_SQES);
+        if (backend->m_cq == nullptr || backend->m_sqes == nullptr)
+            return nullptr;
+
+        backend->m_sq_tail = (uint32_t *)(backend->m_sq + params.sq_off.tail);
+        backend->m_sq_mask = *(uint32_t *)(backend->m_sq + params.sq_off.ring_mask);
+        backend->m_sq_array = (uint32_t *)(backend->m_sq + params.sq_off.array);
+        backend->m_cq_head = (uint32_t *)(backend->m_cq + params.cq_off.head);
+        backend->m_cq_tail = (uint32_t *)(backend->m_cq + params.cq_off.tail);
+        backend->m_cq_mask = *(uint32_t *)(backend->m_cq + params.cq_off.ring_mask);
+        backend->m_cqes = (io_uring_cqe *)(backend->m_cq + params.cq_off.cqes);
+
+        return backend;
+    }
+
+    ~UringBackend()
+    {
+        if (m_sqes != nullptr)
+            munmap(m_sqes, m_sqes_size);
+        if (m_cq != nullptr && m_cq != m_sq)
+            munmap(m_cq, m_cq_size);
+        if (m_sq != nullptr)
+            munmap(m_sq, m_sq_size);
+        if (m_fd != -1)
+            close(m_fd);
+    }
+
+    const char *name() const override { return "io_uring"; }
+
+    void run(std::span<IOOperation> operations) override
+    {
+        for (size_t first = 0; first < operations.size(); first += m_entries)
+            run_ring(operations.subspan(first, std::min<size_t>(m_entries, operations.size() - first)));
+    }
+
+private:
+    int m_fd = -1;
+    uint32_t m_entries = 0;
+
+    uint8_t *m_sq = nullptr;
+    uint8_t *m_cq = nullptr;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sq_size = 0;
+    size_t m_cq_size = 0;
+    size_t m_sqes_size = 0;
+
+    uint32_t *m_sq_tail = nullptr;
+    uint32_t m_sq_mask = 0;
+    uint32_t *m_sq_array = nullptr;
+    uint32_t *m_cq_head = nullptr;
+    uint32_t *m_cq_tail = nullptr;
+    uint32_t m_cq_mask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+
+    UringBackend() = default;
+
+    static uint8_t *map(int fd, size_t size, off_t offset)
+    {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return ptr == MAP_FAILED ? nullptr : (uint8_t *)ptr;
+    }
+
+    /**
+     * Run at most `m_entries` operations.
+     */
+    void run_ring(std::span<IOOperation> operations)
+    {
+        // Only this thread writes the submission tail, the kernel only reads it.
+        uint32_t tail = *m_sq_tail;
+        for (size_t i = 0; i < operations.size(); i++)
+        {
+            const IOOperation& op = operations[i];
+            const uint32_t index = tail & m_sq_mask;
+
+            io_uring_sqe& sqe = m_sqes[index];
+            std::memset(&sqe, 0, sizeof(io_uring_sqe));
+            sqe.fd = op.fd;
+            sqe.user_data = i;
+
+            switch (op.kind)
+            {
+            case IOOperation::Kind::Read:
+                sqe.opcode = IORING_OP_READ;
+                break;
+            case IOOperation::Kind::Write:
+                sqe.opcode = IORING_OP_WRITE;
+                break;
+            case IOOperation::Kind::Sync:
+                sqe.opcode = IORING_OP_FSYNC;
+                break;
+            }
+
+            if (op.kind != IOOperation::Kind::Sync)
+            {
+                // Larger transfers are completed by the next round of the batch, like a short write.
+                sqe.addr = (uint64_t)op.buffer;
+                sqe.len = (uint32_t)std::min<size_t>(op.size, 1 << 30);
+                sqe.off = op.offset;
+            }
+
+            m_sq_array[index] = index;
+            tail++;
+        }
+        std::atomic_ref<uint32_t>(*m_sq_tail).store(tail, std::memory_order_release);
+
+        size_t submitted = 0;
+        size_t completed = 0;
+        while (completed < operations.size())
+        {
+            const int r = (int)syscall(__NR_io_uring_enter, m_fd, uint32_t(operations.size() - submitted), 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    continue;
+
+                // Submitted operations would complete in a later batch and be mistaken for its own.
+                error("io_uring_enter failed: {}", std::strerror(errno));
+                std::abort();
+            }
+            submitted += (size_t)r;
+
+            uint32_t head = *m_cq_head;
+            const uint32_t cq_tail = std::atomic_ref<uint32_t>(*m_cq_tail).load(std::memory_order_acquire);
+            for (; head != cq_tail; head++)
+            {
+                const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+                operations[cqe.user_data].result = cqe.res;
+                completed++;
+            }
+            std::atomic_ref<uint32_t>(*m_cq_head).store(head, std::memory_order_release);
+        }
+    }
+};
+
+#endif
+
+/**
+ * Build the error of a failed request, `Error` reads `errno`.
+ */
+static Error io_error(int code, ErrorKind kind)
+{
+    errno = code;
+    return Error(kind);
+}
+
+IOService::IOService(bool allow_io_uring)
+{
+#ifdef __platform_linux
+    if (allow_io_uring)
+        m_backend = UringBackend::create(max_batch);
+#else
+    (void)allow_io_uring;
+#endif
+
+    if (m_backend == nullptr)
+        m_backend = std::make_unique<SyscallBackend>();
+
+    m_thread = std::thread(&IOService::thread_worker, this);
+}
+
+IOService::~IOService()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void IOService::write_file(std::string path, std::vector<uint8_t> data, WriteCallback callback)
+{
+    push(Request{.write = true, .path = std::move(path), .data = std::move(data), .on_read = nullptr, .on_write = std::move(callback), .job = nullptr});
+}
+
+void IOService::read_file(std::string path, ReadCallback callback)
+{
+    push(Request{.write = false, .path = std::move(path), .data = {}, .on_read = std::move(callback), .on_write = nullptr, .job = nullptr});
+}
+
+Result<std::vector<uint8_t>> IOService::read_file_wait(std::string path)
+{
+    std::promise<Result<std::vector<uint8_t>>> promise;
+    std::future<Result<std::vector<uint8_t>>> future = promise.get_future();
+
+    read_file(std::move(path), [&promise](Result<std::vector<uint8_t>> result)
+              { promise.set_value(std::move(result)); });
+
+    return future.get();
+}
+
+void IOService::run(std::function<void()> job)
+{
+    push(Request{.write = false, .path = {}, .data = {}, .on_read = nullptr, .on_write = nullptr, .job = std::move(job)});
+}
+
+void IOService::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this]
+                   { return m_in_flight == 0; });
+}
+
+const char *IOService::backend_name() const
+{
+    return m_backend->name();
+}
+
+IOService::Stats IOService::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void IOService::push(Request request)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back(std::move(request));
+        m_in_flight++;
+    }
+
+    m_cv.notify_one();
+}
+
+void IOService::thread_worker()
+{
+    TracySetThreadName("io");
+
+    std::vector<Request> batch;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]
+                      { return !m_requests.empty() || m_stop; });
+
+            // Stopping only once every request is done.
+            if (m_requests.empty())
+                return;
+
+            // A file is only touched once per batch, a later request for it waits for the next batch to see the result
+            // of the previous one.
+            while (!m_requests.empty() && batch.size() < max_batch)
+            {
+                // A job may touch any file, it runs alone once the requests before it are done.
+                if (m_requests.front().job && !batch.empty())
+                    break;
+                if (!batch.empty() && batch.front().job)
+                    break;
+
+                const std::string& path = m_requests.front().path;
+                if (std::any_of(batch.begin(), batch.end(), [&path](const Request& request)
+                                { return request.path == path; }))
+                    break;
+
+                batch.push_back(std::move(m_requests.front()));
+                m_requests.pop_front();
+            }
+        }
+
+        if (batch.front().job)
+            batch.front().job();
+        else
+            run_batch(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_in_flight -= batch.size();
+        }
+
+        m_done_cv.notify_all();
+        batch.clear();
+    }
+}
+
+void IOService::run_batch(std::vector<Request>& batch)
+{
+    ZoneScoped;
+
+    struct FileState
+    {
+        int fd = -1;
+        size_t done = 0;
+
+        /**
+         * `errno` of the first failure.
+         */
+        int error = 0;
+    };
+
+    std::vector<FileState> files(batch.size());
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        Request& request = batch[i];
+        FileState& file = files[i];
+
+        if (request.write)
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::path(request.path).parent_path(), ec);
+
+            file.fd = ::open((request.path + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        }
+        else
+        {
+            file.fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+            struct stat st{};
+            if (file.fd != -1 && fstat(file.fd, &st) == 0)
+                request.data.resize((size_t)st.st_size);
+        }
+
+        if (file.fd == -1)
+            file.error = errno;
+    }
+
+    // Transfers are repeated until complete, a round only contains the files with data left after a short transfer.
+    std::vector<IOOperation> operations;
+    std::vector<size_t> owners;
+    while (true)
+    {
+        operations.clear();
+        owners.clear();
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            FileState& file = files[i];
+            if (file.error != 0 || file.done >= batch[i].data.size())
+                continue;
+
+            operations.push_back(IOOperation{
+                .kind = batch[i].write ? IOOperation::Kind::Write : IOOperation::Kind::Read,
+                .fd = file.fd,
+                .buffer = batch[i].data.data() + file.done,
+                .size = batch[i].data.size() - file.done,
+                .offset = file.done,
+                .result = 0,
+            });
+            owners.push_back(i);
+        }
+
+        if (operations.empty())
+            break;
+
+        m_backend->run(operations);
+
+        for (size_t k = 0; k < operations.size(); k++)
+        {
+            const size_t i = owners[k];
+            const int64_t result = operations[k].result;
+
+            if (result < 0)
+                files[i].error = int(-result);
+            else if (result == 0 && batch[i].write)
+                files[i].error = EIO;
+            else if (result == 0)
+                batch[i].data.resize(files[i].done); // The file shrank since `fstat`.
+            else
+                files[i].done += (size_t)result;
+        }
+    }
+
+    // Every written file is synced at once.
+    operations.clear();
+    owners.clear();
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (!batch[i].write || files[i].error != 0)
+            continue;
+
+        operations.push_back(IOOperation{.kind = IOOperation::Kind::Sync, .fd = files[i].fd, .buffer = nullptr, .size = 0, .offset = 0, .result = 0});
+        owners.push_back(i);
+    }
+
+    m_backend->run(operations);
+    for (size_t k = 0; k < operations.size(); k++)
+    {
+        if (operations[k].result < 0)
+            files[owners[k]].error = int(-operations[k].result);
+    }
+
+    Stats stats;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        Request& request = batch[i];
+        FileState& file = files[i];
+
+        if (file.fd != -1)
+            ::close(file.fd);
+
+        if (request.write)
+        {
+            const std::string temp_path = request.path + ".tmp";
+            if (file.error == 0 && ::rename(temp_path.c_str(), request.path.c_str()) == -1)
+                file.error = errno;
+            if (file.error != 0 && file.fd != -1)
+                ::unlink(temp_path.c_str());
+
+            stats.writes++;
+            stats.bytes_written += file.done;
+        }
+        else
+        {
+            stats.reads++;
+            stats.bytes_read += file.done;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.reads += stats.reads;
+        m_stats.writes += stats.writes;
+        m_stats.bytes_read += stats.bytes_read;
+        m_stats.bytes_written += stats.bytes_written;
+        m_stats.batches++;
+    }
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        Request& request = batch[i];
+        const int code = files[i].error;
+
+        if (request.write)
+        {
+            if (request.on_write)
+                request.on_write(code == 0 ? Result<void>() : Result<void>(io_error(code, ErrorKind::WriteFailure)));
+        }
+        else if (request.on_read)
+        {
+            if (code == 0)
+                request.on_read(std::move(request.data));
+            else
+                request.on_read(io_error(code, code == ENOENT ? ErrorKind::FileNotFound : ErrorKind::ReadFailure));
+        }
+    }
+}
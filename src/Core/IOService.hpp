@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Core/Result.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class IOBackend;
+
+/**
+ * Whole-file reads and writes executed on a dedicated I/O thread.
+ *
+ * Requests are taken in batches: every file of a batch is read or written at once, then the written files are synced
+ * together before being renamed over their destination. On Linux the batch goes through `io_uring` when the kernel
+ * allows it, otherwise the I/O thread makes the syscalls itself.
+ *
+ * Callbacks run on the I/O thread, keep them short or hand the result to the thread pool or the integration queue.
+ */
+class IOService
+{
+public:
+    using ReadCallback = std::function<void(Result<std::vector<uint8_t>>)>;
+    using WriteCallback = std::function<void(Result<void>)>;
+
+    /**
+     * Maximum number of requests in a batch.
+     */
+    static constexpr size_t max_batch = 64;
+
+    struct Stats
+    {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+        uint64_t batches = 0;
+    };
+
+    IOService(bool allow_io_uring = true);
+
+    /**
+     * Wait for every request.
+     */
+    ~IOService();
+
+    /**
+     * Replace the content of `path` with `data`, parent directories are created. A crash leaves either the previous
+     * or the new content.
+     */
+    void write_file(std::string path, std::vector<uint8_t> data, WriteCallback callback = nullptr);
+
+    void read_file(std::string path, ReadCallback callback);
+
+    /**
+     * Read `path` and wait for the result, for the few places that can not continue without the data.
+     */
+    Result<std::vector<uint8_t>> read_file_wait(std::string path);
+
+    /**
+     * Run `job` on the I/O thread, after the requests submitted before it. For files accessed with many small reads and
+     * writes instead of whole.
+     */
+    void run(std::function<void()> job);
+
+    /**
+     * Wait until every request submitted before is done.
+     */
+    void flush();
+
+    const char *backend_name() const;
+    Stats stats();
+
+private:
+    struct Request
+    {
+        bool write;
+        std::string path;
+        std::vector<uint8_t> data;
+        ReadCallback on_read;
+        WriteCallback on_write;
+
+        /**
+         * Set for the requests of `run`, which are alone in their batch.
+         */
+        std::function<void()> job;
+    };
+
+    std::unique_ptr<IOBackend> m_backend;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_done_cv;
+    std::deque<Request> m_requests;
+    size_t m_in_flight = 0;
+    bool m_stop = false;
+    Stats m_stats;
+
+    std::thread m_thread;
+
+    void push(Request request);
+    void thread_worker();
+    void run_batch(std::vector<Request>& batch);
+};
@@ -0,0 +1,54 @@
+#include "Core/IntegrationQueue.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+
+void IntegrationQueue::push(std::function<void()> work, uint32_t estimated_cost_us)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_items.push_back(Item{.work = std::move(work), .estimated_cost_us = estimated_cost_us});
+}
+
+void IntegrationQueue::drain(uint32_t budget_us)
+{
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t spent_us = 0;
+    bool first = true;
+
+    while (true)
+    {
+        Item item;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.empty())
+                break;
+
+            // Stop before an item that would not fit in what is left of the budget.
+            if (!first && budget_us != 0 && spent_us + m_items.front().estimated_cost_us > budget_us)
+            {
+                m_stats.deferred_ticks++;
+                break;
+            }
+
+            item = std::move(m_items.front());
+            m_items.pop_front();
+        }
+
+        item.work();
+        first = false;
+
+        spent_us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        m_stats.items++;
+        m_stats.estimated_us += item.estimated_cost_us;
+    }
+
+    m_stats.time_us += spent_us;
+}
+
+size_t IntegrationQueue::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_items.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/**
+ * Work that must run on the main thread, drained a bit every tick instead of all at once.
+ *
+ * Each item declares an estimate of its cost. `drain` runs items in order until the budget is spent, the remaining
+ * items are kept for the next tick. Bursts of work, like many chunks finishing at the same time, are spread over
+ * several ticks instead of causing a hitch.
+ */
+class IntegrationQueue
+{
+public:
+    struct Stats
+    {
+        uint64_t items = 0;
+        uint64_t time_us = 0;
+        uint64_t estimated_us = 0;
+
+        /**
+         * Ticks that did not run every item.
+         */
+        uint64_t deferred_ticks = 0;
+    };
+
+    /**
+     * Can be called from any thread.
+     */
+    void push(std::function<void()> work, uint32_t estimated_cost_us);
+
+    /**
+     * Run items until `budget_us` is spent, or every item if `budget_us` is 0. The first item always runs, so an
+     * item more expensive than the budget does not block the queue.
+     */
+    void drain(uint32_t budget_us);
+
+    size_t size();
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Item
+    {
+        std::function<void()> work;
+        uint32_t estimated_cost_us;
+    };
+
+    std::mutex m_mutex;
+    std::deque<Item> m_items;
+
+    Stats m_stats;
+};
@@ -10,10 +10,10 @@ SimplexNoise::SimplexNoise(uint64_t seed)
     for (size_t i = 0; i < 256; i++)
         m_perms[i] = i;
 
-    std::mt19937 prng{std::random_device{}()};
-    prng.seed(seed);
-
-    std::shuffle(std::begin(m_perms), std::end(m_perms), prng);
+    // `std::shuffle` is implementation defined, a seed must give the same terrain with every standard library.
+    std::mt19937 prng(seed);
+    for (size_t i = 255; i > 0; i--)
+        std::swap(m_perms[i], m_perms[prng() % (i + 1)]);
 }
 
 float SimplexNoise::sample(glm::vec2 coords) const
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "Core/Epoch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+/**
+ * Hash map where lookups never take a lock, for data read by many threads and rarely modified.
+ *
+ * The table is open-addressed and stores pointers to immutable entries. Modifying a key publishes a new entry and
+ * growing publishes a new table, the old ones are retired through `Epoch` so readers that still see them stay valid.
+ * Lookups copy the value out, `V` should be cheap to copy, like a `std::shared_ptr`.
+ *
+ * Writers must be serialized by the caller.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ReadMostlyMap
+{
+public:
+    ReadMostlyMap()
+        : m_table(new Table(min_capacity))
+    {
+    }
+
+    ~ReadMostlyMap()
+    {
+        Table *table = m_table.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            Entry *entry = table->slots[i].load(std::memory_order_relaxed);
+            if (entry != nullptr && entry != tombstone())
+                delete entry;
+        }
+        delete table;
+    }
+
+    ReadMostlyMap(const ReadMostlyMap&) = delete;
+    ReadMostlyMap& operator=(const ReadMostlyMap&) = delete;
+
+    /**
+     * Lock-free, can be called from any thread.
+     */
+    std::optional<V> find(const K& key) const
+    {
+        Epoch::Guard guard;
+
+        const Table *table = m_table.load(std::memory_order_seq_cst);
+        const Entry *entry = table->find(key, Hash{}(key));
+        if (entry == nullptr)
+            return std::nullopt;
+        return entry->value;
+    }
+
+    bool contains(const K& key) const
+    {
+        Epoch::Guard guard;
+
+        const Table *table = m_table.load(std::memory_order_seq_cst);
+        return table->find(key, Hash{}(key)) != nullptr;
+    }
+
+    /**
+     * Insert `value` or replace the value of `key`.
+     */
+    void insert(const K& key, V value)
+    {
+        Table *table = m_table.load(std::memory_order_relaxed);
+        const size_t hash = Hash{}(key);
+
+        Entry *entry = new Entry{key, std::move(value)};
+
+        std::atomic<Entry *> *free_slot = nullptr;
+        for (size_t i = hash & table->mask();; i = (i + 1) & table->mask())
+        {
+            Entry *current = table->slots[i].load(std::memory_order_relaxed);
+            if (current == nullptr)
+            {
+                if (free_slot == nullptr)
+                    free_slot = &table->slots[i];
+                break;
+            }
+
+            if (current == tombstone())
+            {
+                if (free_slot == nullptr)
+                    free_slot = &table->slots[i];
+                continue;
+            }
+
+            if (current->key == key)
+            {
+                table->slots[i].store(entry, std::memory_order_seq_cst);
+                Epoch::retire(current);
+                return;
+            }
+        }
+
+        if (free_slot->load(std::memory_order_relaxed) == nullptr)
+            m_used++;
+        free_slot->store(entry, std::memory_order_seq_cst);
+        m_size++;
+
+        // Keep at least half of the slots empty so probe sequences stay short and always end.
+        if (m_used * 2 > table->capacity)
+            rehash(std::bit_ceil(std::max(min_capacity, m_size * 4)));
+    }
+
+    /**
+     * Returns false if the key is not in the map.
+     */
+    bool erase(const K& key)
+    {
+        Table *table = m_table.load(std::memory_order_relaxed);
+        const size_t hash = Hash{}(key);
+
+        for (size_t i = hash & table->mask();; i = (i + 1) & table->mask())
+        {
+            Entry *current = table->slots[i].load(std::memory_order_relaxed);
+            if (current == nullptr)
+                return false;
+
+            if (current != tombstone() && current->key == key)
+            {
+                // A tombstone instead of an empty slot, the keys after it in the probe sequence must still be found.
+                table->slots[i].store(tombstone(), std::memory_order_seq_cst);
+                Epoch::retire(current);
+                m_size--;
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Only exact when called by the writer.
+     */
+    size_t size() const { return m_size; }
+
+    /**
+     * Call `function(key, value)` for every entry, only called by the writer.
+     */
+    template <typename F>
+    void for_each(F&& function) const
+    {
+        const Table *table = m_table.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            const Entry *entry = table->slots[i].load(std::memory_order_relaxed);
+            if (entry != nullptr && entry != tombstone())
+                function(entry->key, entry->value);
+        }
+    }
+
+private:
+    static constexpr size_t min_capacity = 64;
+
+    struct Entry
+    {
+        const K key;
+        const V value;
+    };
+
+    struct Table
+    {
+        size_t capacity;
+        std::unique_ptr<std::atomic<Entry *>[]> slots;
+
+        Table(size_t capacity)
+            : capacity(capacity), slots(std::make_unique<std::atomic<Entry *>[]>(capacity))
+        {
+        }
+
+        size_t mask() const { return capacity - 1; }
+
+        const Entry *find(const K& key, size_t hash) const
+        {
+            for (size_t i = hash & mask();; i = (i + 1) & mask())
+            {
+                const Entry *entry = slots[i].load(std::memory_order_seq_cst);
+                if (entry == nullptr)
+                    return nullptr;
+                if (entry != tombstone() && entry->key == key)
+                    return entry;
+            }
+        }
+    };
+
+    std::atomic<Table *> m_table;
+
+    /**
+     * Live entries and slots that are not empty, tombstones included.
+     */
+    size_t m_size = 0;
+    size_t m_used = 0;
+
+    static Entry *tombstone()
+    {
+        static constinit char marker = 0;
+        return reinterpret_cast<Entry *>(&marker);
+    }
+
+    /**
+     * Copy the live entries in a new table without tombstones. Entries are shared by both tables.
+     */
+    void rehash(size_t capacity)
+    {
+        Table *old_table = m_table.load(std::memory_order_relaxed);
+        Table *new_table = new Table(capacity);
+
+        for (size_t i = 0; i < old_table->capacity; i++)
+        {
+            Entry *entry = old_table->slots[i].load(std::memory_order_relaxed);
+            if (entry == nullptr || entry == tombstone())
+                continue;
+
+            size_t j = Hash{}(entry->key) & new_table->mask();
+            while (new_table->slots[j].load(std::memory_order_relaxed) != nullptr)
+                j = (j + 1) & new_table->mask();
+            new_table->slots[j].store(entry, std::memory_order_relaxed);
+        }
+
+        m_table.store(new_table, std::memory_order_seq_cst);
+        m_used = m_size;
+        Epoch::retire(old_table);
+    }
+};
@@ -3,6 +3,7 @@
 #include "Core/Error.hpp"
 
 #include <optional>
+#include <utility>
 
 // TODO: lots of space could be saved by not using Option here.
 
@@ -15,6 +16,11 @@ public:
     {
     }
 
+    Result(T&& value)
+        : m_value(std::move(value))
+    {
+    }
+
     Result(const E& error)
         : m_error(error)
     {
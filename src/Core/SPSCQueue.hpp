@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Core/Assert.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * Each side keeps a cached copy of the other side's index and only reloads it when the queue looks full or empty,
+ * so in the common case a push or a pop touches a single shared cache line.
+ */
+template <typename T>
+class SPSCQueue
+{
+public:
+    /**
+     * `capacity` must be a power of two.
+     */
+    SPSCQueue(size_t capacity)
+        : m_mask(capacity - 1), m_items(std::make_unique<T[]>(capacity))
+    {
+        ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    /**
+     * Only called by the producer. Returns false and leaves `item` untouched if the queue is full.
+     */
+    bool try_push(T&& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head > m_mask)
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head > m_mask)
+                return false;
+        }
+
+        m_items[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Only called by the consumer. Returns false if the queue is empty.
+     */
+    bool try_pop(T& item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail)
+                return false;
+        }
+
+        item = std::move(m_items[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Approximate when called concurrently with a push or a pop.
+     */
+    size_t size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    /**
+     * Written by the consumer.
+     */
+    alignas(64) std::atomic<size_t> m_head = 0;
+    size_t m_cached_tail = 0;
+
+    /**
+     * Written by the producer.
+     */
+    alignas(64) std::atomic<size_t> m_tail = 0;
+    size_t m_cached_head = 0;
+
+    alignas(64) size_t m_mask;
+    std::unique_ptr<T[]> m_items;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Move-only `void()` callable stored inline, creating a task never allocates.
+ *
+ * Callables larger than `inline_size` do not compile. Capture a pointer or a `std::shared_ptr` to large data instead.
+ */
+class Task
+{
+public:
+    static constexpr size_t inline_size = 64;
+
+    Task() = default;
+
+    template <typename F>
+        requires(!std::is_same_v<std::decay_t<F>, Task> && std::is_invocable_v<std::decay_t<F>&>)
+    Task(F&& function)
+    {
+        using T = std::decay_t<F>;
+        static_assert(sizeof(T) <= inline_size, "task captures are larger than Task::inline_size");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "task captures are over-aligned");
+        static_assert(std::is_nothrow_move_constructible_v<T>, "task captures must be nothrow movable");
+
+        new (m_storage) T(std::forward<F>(function));
+        m_ops = &ops_for<T>;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task(Task&& other) noexcept
+    {
+        move_from(other);
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    void reset()
+    {
+        if (m_ops != nullptr)
+        {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *storage);
+
+        /**
+         * Move construct into `to` and destroy `from`.
+         */
+        void (*relocate)(void *to, void *from);
+        void (*destroy)(void *storage);
+    };
+
+    template <typename T>
+    static constexpr Ops ops_for{
+        .invoke = [](void *storage)
+        { (*static_cast<T *>(storage))(); },
+        .relocate = [](void *to, void *from)
+        {
+            new (to) T(std::move(*static_cast<T *>(from)));
+            static_cast<T *>(from)->~T();
+        },
+        .destroy = [](void *storage)
+        { static_cast<T *>(storage)->~T(); },
+    };
+
+    alignas(std::max_align_t) std::byte m_storage[inline_size];
+    const Ops *m_ops = nullptr;
+
+    void move_from(Task& other)
+    {
+        if (other.m_ops == nullptr)
+            return;
+
+        other.m_ops->relocate(m_storage, other.m_storage);
+        m_ops = other.m_ops;
+        other.m_ops = nullptr;
+    }
+};
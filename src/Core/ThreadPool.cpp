@@ -1,55 +1,430 @@
 #include "Core/ThreadPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <bit>
 #include <mutex>
 
+/**
+ * Pool and index of the worker running on this thread, so tasks started from a worker go to its own deque.
+ */
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+/**
+ * Number of times an idle worker looks for work before parking, tasks often come in bursts.
+ */
+static constexpr size_t spin_count = 64;
+
+/**
+ * Jobs kept by a worker, the excess goes back to the shared list for the threads starting tasks.
+ */
+static constexpr size_t max_free_jobs = 256;
+
+/**
+ * Reading the clock costs as much as running a small task, so the latency is only measured for one task out of
+ * `latency_sample_interval` started by each thread.
+ */
+static constexpr uint32_t latency_sample_interval = 16;
+static thread_local uint32_t latency_sample_counter = 0;
+
+static constexpr std::array<const char *, task_priority_count> priority_names{
+    "interactive",
+    "near generation",
+    "background generation",
+    "io",
+    "housekeeping",
+};
+
+const char *task_priority_name(TaskPriority priority)
+{
+    return priority_names[(size_t)priority];
+}
+
+bool ThreadPool::compare_jobs(const Job *a, const Job *b)
+{
+    // `std::push_heap` builds a max heap, so the job with the lowest key must compare greater.
+    if (a->key != b->key)
+        return a->key > b->key;
+    return a->sequence > b->sequence;
+}
+
 ThreadPool::ThreadPool(size_t num_threads)
 {
+    // Every worker must exist before any thread starts stealing.
+    for (size_t i = 0; i < num_threads; i++)
+        m_workers.push_back(std::make_unique<Worker>());
+
     for (size_t i = 0; i < num_threads; i++)
-        m_threads.emplace_back(&ThreadPool::thread_worker, this);
+        m_workers[i]->thread = std::thread(&ThreadPool::thread_worker, this, i);
 }
 
 ThreadPool::~ThreadPool()
+{
+    m_stop.store(true);
+
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        for (size_t index : m_idle)
+        {
+            Worker& worker = *m_workers[index];
+            std::lock_guard<std::mutex> park_lock(worker.park_mutex);
+            worker.notified = true;
+            worker.park_cv.notify_one();
+        }
+        m_idle.clear();
+        m_idle_count.store(0);
+    }
+
+    for (auto& worker : m_workers)
+        worker->thread.join();
+
+    // Only left when there is no worker.
+    for (std::vector<Job *>& jobs : m_inject)
+        for (Job *job : jobs)
+            delete job;
+
+    for (auto& worker : m_workers)
+        for (Job *job : worker->free_jobs)
+            delete job;
+    for (Job *job : m_free_jobs)
+        delete job;
+}
+
+bool TaskStateBase::cancel()
+{
+    m_cancel_requested.store(true);
+
+    Status expected = Status::Pending;
+    if (!m_status.compare_exchange_strong(expected, Status::Cancelled))
+        return false;
+
+    notify_done();
+    return true;
+}
+
+void TaskStateBase::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]
+              { return is_done(); });
+}
+
+bool TaskStateBase::start()
+{
+    Status expected = Status::Pending;
+    return m_status.compare_exchange_strong(expected, Status::Running);
+}
+
+void TaskStateBase::finish()
+{
+    m_status.store(Status::Done);
+    notify_done();
+}
+
+void TaskStateBase::on_done(std::function<void()> function)
 {
     {
-        std::unique_lock<std::mutex> lock(m_queue_mutex);
-        m_stop = true;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!is_done())
+        {
+            m_continuations.push_back(std::move(function));
+            return;
+        }
+    }
+
+    function();
+}
+
+void TaskStateBase::notify_done()
+{
+    std::vector<std::function<void()>> continuations;
+    {
+        // The status is set before taking the lock, so `wait` and `on_done` can not miss it.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        continuations = std::move(m_continuations);
     }
 
     m_cv.notify_all();
 
-    for (auto& thread : m_threads)
+    for (std::function<void()>& continuation : continuations)
+        continuation();
+}
+
+void ThreadPool::run(Task task, TaskPriority priority, std::optional<int64_t> key)
+{
+    const bool from_worker = current_pool == this;
+    const size_t index = (size_t)priority;
+
+    std::unique_lock<std::mutex> lock(m_inject_mutex, std::defer_lock);
+    if (!from_worker || key.has_value())
+        lock.lock();
+
+    Job *job = allocate_job(from_worker ? m_workers[current_worker]->free_jobs : m_free_jobs);
+    job->task = std::move(task);
+    job->priority = priority;
+    job->key = key.value_or(0);
+    job->sequence = 0;
+    job->queued_at = {};
+
+    if (latency_sample_counter++ % latency_sample_interval == 0)
+        job->queued_at = std::chrono::steady_clock::now();
+
+    if (!lock.owns_lock())
+    {
+        m_workers[current_worker]->deques[index].push(job);
+    }
+    else
     {
-        thread.join();
+        job->sequence = m_next_sequence++;
+        m_inject[index].push_back(job);
+        std::push_heap(m_inject[index].begin(), m_inject[index].end(), compare_jobs);
+        m_inject_sizes[index].fetch_add(1);
+        lock.unlock();
     }
+
+    wake_one();
 }
 
-void ThreadPool::async(std::function<void()> task)
+ThreadPool::Job *ThreadPool::allocate_job(std::vector<Job *>& free_jobs)
 {
+    if (free_jobs.empty())
+        return new Job();
+
+    Job *job = free_jobs.back();
+    free_jobs.pop_back();
+    return job;
+}
+
+void ThreadPool::free_job(size_t index, Job *job)
+{
+    // Release the captures now rather than when the job is reused.
+    job->task.reset();
+
+    std::vector<Job *>& free_jobs = m_workers[index]->free_jobs;
+    free_jobs.push_back(job);
+    if (free_jobs.size() <= max_free_jobs)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_inject_mutex);
+    m_free_jobs.insert(m_free_jobs.end(), free_jobs.begin() + max_free_jobs / 2, free_jobs.end());
+    free_jobs.resize(max_free_jobs / 2);
+}
+
+TaskLatency ThreadPool::latency(TaskPriority priority) const
+{
+    const auto& buckets = m_latencies[(size_t)priority];
+
+    std::array<uint64_t, latency_buckets> counts;
+    TaskLatency result;
+    for (size_t i = 0; i < latency_buckets; i++)
     {
-        std::unique_lock<std::mutex> lock(m_queue_mutex);
-        m_tasks.push_back(task);
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += counts[i];
     }
 
-    m_cv.notify_one();
+    // Percentiles are rounded up to the upper bound of their bucket.
+    const auto percentile = [&](uint64_t permille)
+    {
+        const uint64_t rank = (result.count * permille + 999) / 1000;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < latency_buckets; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank && seen > 0)
+                return uint64_t(1) << i;
+        }
+        return uint64_t(0);
+    };
+
+    result.p50_us = percentile(500);
+    result.p90_us = percentile(900);
+    result.p99_us = percentile(990);
+    return result;
 }
 
-void ThreadPool::thread_worker()
+void ThreadPool::record_latency(const Job& job)
 {
+    if (job.queued_at == std::chrono::steady_clock::time_point())
+        return;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.queued_at);
+    const uint64_t us = uint64_t(std::max<int64_t>(elapsed.count(), 0));
+
+    const size_t bucket = std::min<size_t>(std::bit_width(us), latency_buckets - 1);
+    m_latencies[(size_t)job.priority][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::thread_worker(size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
     while (true)
     {
-        std::function<void()> task;
-
+        Job *job = find_job(index);
+        for (size_t i = 0; i < spin_count && job == nullptr; i++)
         {
-            std::unique_lock<std::mutex> lock(m_queue_mutex);
-            m_cv.wait(lock, [this]
-                      { return !m_tasks.empty() || m_stop; });
+            std::this_thread::yield();
+            job = find_job(index);
+        }
 
-            if (m_stop && m_tasks.empty())
+        if (job == nullptr)
+        {
+            if (m_stop.load())
                 return;
 
-            task = m_tasks[m_tasks.size() - 1];
-            m_tasks.pop_back();
+            park(index);
+            continue;
+        }
+
+        record_latency(*job);
+        job->task();
+        free_job(index, job);
+    }
+}
+
+ThreadPool::Job *ThreadPool::find_job(size_t index)
+{
+    Worker& worker = *m_workers[index];
+
+    // Only the jobs found are counted, so the interval is measured in jobs run whatever the number of empty polls.
+    const uint32_t pick = worker.picks + 1;
+    size_t first = 0;
+    if (pick % starvation_interval == 0)
+        first = 1 + (pick / starvation_interval) % (task_priority_count - 1);
+
+    for (size_t i = 0; i < task_priority_count; i++)
+    {
+        Job *job = find_job_in(index, (first + i) % task_priority_count);
+        if (job != nullptr)
+        {
+            worker.picks = pick;
+            return job;
         }
+    }
+
+    return nullptr;
+}
 
-        task();
+ThreadPool::Job *ThreadPool::find_job_in(size_t index, size_t priority)
+{
+    // `pop` is more expensive than checking, most deques are empty.
+    Job *job;
+    WorkStealingDeque<Job *>& deque = m_workers[index]->deques[priority];
+    if (!deque.empty() && deque.pop(job))
+        return job;
+
+    job = pop_injected(priority);
+    if (job != nullptr)
+        return job;
+
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        WorkStealingDeque<Job *>& victim = m_workers[(index + i) % m_workers.size()]->deques[priority];
+        if (!victim.empty() && victim.steal(job))
+        {
+            // The victim has more work than it can run, let another worker help.
+            if (!victim.empty())
+                wake_one();
+            return job;
+        }
     }
+
+    return nullptr;
+}
+
+ThreadPool::Job *ThreadPool::pop_injected(size_t priority)
+{
+    if (m_inject_sizes[priority].load(std::memory_order_relaxed) == 0)
+        return nullptr;
+
+    Job *job;
+    bool more;
+    {
+        std::lock_guard<std::mutex> lock(m_inject_mutex);
+        std::vector<Job *>& jobs = m_inject[priority];
+        if (jobs.empty())
+            return nullptr;
+
+        std::pop_heap(jobs.begin(), jobs.end(), compare_jobs);
+        job = jobs.back();
+        jobs.pop_back();
+        more = m_inject_sizes[priority].fetch_sub(1) > 1;
+    }
+
+    if (more)
+        wake_one();
+    return job;
+}
+
+bool ThreadPool::has_work() const
+{
+    for (const std::atomic<size_t>& size : m_inject_sizes)
+        if (size.load() > 0)
+            return true;
+
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+        for (const WorkStealingDeque<Job *>& deque : worker->deques)
+            if (!deque.empty())
+                return true;
+
+    return false;
+}
+
+void ThreadPool::wake_one()
+{
+    // The task was published with a sequentially consistent store, so either this load sees the worker registered in
+    // `park`, or the worker sees the new task when checking again.
+    if (m_idle_count.load() == 0)
+        return;
+
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        if (m_idle.empty())
+            return;
+
+        index = m_idle.back();
+        m_idle.pop_back();
+        m_idle_count.fetch_sub(1);
+    }
+
+    Worker& worker = *m_workers[index];
+    std::lock_guard<std::mutex> lock(worker.park_mutex);
+    worker.notified = true;
+    worker.park_cv.notify_one();
+}
+
+void ThreadPool::park(size_t index)
+{
+    ZoneScoped;
+
+    Worker& worker = *m_workers[index];
+
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        m_idle.push_back(index);
+        m_idle_count.fetch_add(1);
+    }
+
+    // A task started before the worker was registered did not wake anyone.
+    if (has_work() || m_stop.load())
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        auto iter = std::find(m_idle.begin(), m_idle.end(), index);
+        if (iter != m_idle.end())
+        {
+            m_idle.erase(iter);
+            m_idle_count.fetch_sub(1);
+            return;
+        }
+
+        // Already woken up, `notified` is set or about to be set.
+    }
+
+    std::unique_lock<std::mutex> lock(worker.park_mutex);
+    worker.park_cv.wait(lock, [&worker]
+                        { return worker.notified; });
+    worker.notified = false;
 }
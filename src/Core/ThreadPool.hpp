@@ -1,31 +1,385 @@
 #pragma once
 
+#include "Core/Task.hpp"
+#include "Core/WorkStealingDeque.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+/**
+ * Classes of tasks, from the most important to the least important.
+ */
+enum class TaskPriority : uint8_t
+{
+    /**
+     * Direct consequences of player actions, ex: remeshing an edited chunk.
+     */
+    Interactive,
+    NearGeneration,
+    BackgroundGeneration,
+    IO,
+    Housekeeping,
+};
+
+static constexpr size_t task_priority_count = 5;
+
+const char *task_priority_name(TaskPriority priority);
+
+/**
+ * Time spent by tasks of a class between `async` and the start of the task.
+ */
+struct TaskLatency
+{
+    uint64_t count = 0;
+    uint64_t p50_us = 0;
+    uint64_t p90_us = 0;
+    uint64_t p99_us = 0;
+};
+
+class ThreadPool;
+
+/**
+ * State shared between a task and its handles.
+ */
+class TaskStateBase
+{
+public:
+    enum class Status : uint8_t
+    {
+        Pending,
+        Running,
+        Done,
+        /**
+         * Cancelled before it started, the task never runs.
+         */
+        Cancelled,
+    };
+
+    TaskStateBase(TaskPriority priority)
+        : m_priority(priority)
+    {
+    }
+
+    TaskPriority priority() const { return m_priority; }
+    Status status() const { return m_status.load(); }
+    bool is_done() const { return status() == Status::Done || status() == Status::Cancelled; }
+    bool is_cancel_requested() const { return m_cancel_requested.load(std::memory_order_relaxed); }
+
+    bool cancel();
+    void wait();
+
+    /**
+     * Called by the worker, returns false if the task was cancelled.
+     */
+    bool start();
+    void finish();
+
+    /**
+     * Run `function` once the task is done or cancelled, immediately if it already is.
+     */
+    void on_done(std::function<void()> function);
+
+private:
+    TaskPriority m_priority;
+    std::atomic<Status> m_status = Status::Pending;
+    std::atomic<bool> m_cancel_requested = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::function<void()>> m_continuations;
+
+    void notify_done();
+};
+
+template <typename T>
+class TaskState : public TaskStateBase
+{
+public:
+    using TaskStateBase::TaskStateBase;
+
+    std::optional<T> value;
+};
+
+template <>
+class TaskState<void> : public TaskStateBase
+{
+public:
+    using TaskStateBase::TaskStateBase;
+};
+
+/**
+ * Passed to tasks that accept it, so long tasks can stop at safe points once their handle is cancelled.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+    CancellationToken(const TaskStateBase *state)
+        : m_state(state)
+    {
+    }
+
+    bool is_cancelled() const { return m_state != nullptr && m_state->is_cancel_requested(); }
+
+private:
+    const TaskStateBase *m_state = nullptr;
+};
+
+template <typename T, typename F>
+struct ContinuationResult
+{
+    using type = std::invoke_result_t<F&, T&>;
+};
+
+template <typename F>
+struct ContinuationResult<void, F>
+{
+    using type = std::invoke_result_t<F&>;
+};
+
+/**
+ * Handle to a task started with `ThreadPool::async`. Dropping the handle does not cancel the task.
+ */
+template <typename T>
+class TaskHandle
+{
+public:
+    TaskHandle() = default;
+    TaskHandle(std::shared_ptr<TaskState<T>> state, ThreadPool *pool)
+        : m_state(std::move(state)), m_pool(pool)
+    {
+    }
+
+    bool is_valid() const { return m_state != nullptr; }
+
+    /**
+     * Request the task to stop. Returns true if the task had not started yet, it will never run. Otherwise the task
+     * may check its `CancellationToken`.
+     */
+    bool cancel() { return m_state != nullptr && m_state->cancel(); }
+
+    bool is_pending() const { return m_state != nullptr && m_state->status() == TaskStateBase::Status::Pending; }
+    bool is_done() const { return m_state == nullptr || m_state->is_done(); }
+    bool is_cancelled() const { return m_state != nullptr && m_state->is_cancel_requested(); }
+
+    void wait() const
+    {
+        if (m_state != nullptr)
+            m_state->wait();
+    }
+
+    /**
+     * Wait for the task and returns its result, or nothing if it was cancelled before it started.
+     */
+    std::optional<T> get() const
+        requires(!std::is_void_v<T>)
+    {
+        wait();
+        return m_state != nullptr ? m_state->value : std::nullopt;
+    }
+
+    /**
+     * Start `function` with the result of this task once it is done, with the same priority. The continuation is
+     * cancelled if this task is cancelled before it starts.
+     */
+    template <typename F>
+    auto then(F&& function);
+
+private:
+    std::shared_ptr<TaskState<T>> m_state;
+    ThreadPool *m_pool = nullptr;
+};
+
+/**
+ * Work-stealing thread pool.
+ *
+ * Each worker owns a deque per priority: tasks started from a worker go to the bottom of its deque and are run LIFO by
+ * that worker, idle workers steal from the top of other deques. Tasks started from other threads, or with a key, go to
+ * a shared queue per priority ordered by key. Idle workers park on their own condition variable and a new task wakes
+ * at most one of them.
+ *
+ * Workers take tasks from the most important class first. To guarantee that less important classes still progress,
+ * one pick out of `starvation_interval` starts from another class, in turn.
+ */
 class ThreadPool
 {
 public:
+    static constexpr uint32_t starvation_interval = 8;
+
     ThreadPool(size_t num_threads = std::thread::hardware_concurrency() - 1);
     ~ThreadPool();
 
     /**
-     * Starts an asynchronous task.
-     * TODO: Should returns a future that can be canceled.
+     * Starts an asynchronous task. Among tasks of the same priority, those with the lowest `key` start first, ex: the
+     * squared distance to the player. Tasks without a key are started in no particular order.
+     *
+     * `function` is called without arguments or with a `const CancellationToken&`.
      */
-    void async(std::function<void()> task);
+    template <typename F>
+    auto async(F&& function, TaskPriority priority = TaskPriority::BackgroundGeneration, std::optional<int64_t> key = std::nullopt)
+    {
+        using R = decltype(call(function, std::declval<const CancellationToken&>()));
+
+        std::shared_ptr<TaskState<R>> state = std::make_shared<TaskState<R>>(priority);
+        start(state, std::forward<F>(function), key);
+        return TaskHandle<R>(state, this);
+    }
+
+    /**
+     * Starts a task without a handle. Unlike `async`, this does not allocate: the task is stored inline in a recycled
+     * job.
+     */
+    void run(Task task, TaskPriority priority = TaskPriority::BackgroundGeneration, std::optional<int64_t> key = std::nullopt);
+
+    size_t thread_count() const { return m_workers.size(); }
+
+    TaskLatency latency(TaskPriority priority) const;
 
 private:
-    std::vector<std::thread> m_threads;
+    template <typename T>
+    friend class TaskHandle;
 
-    std::mutex m_queue_mutex;
-    std::vector<std::function<void()>> m_tasks;
+    template <typename F>
+    static decltype(auto) call(F& function, const CancellationToken& token)
+    {
+        if constexpr (std::is_invocable_v<F&, const CancellationToken&>)
+            return function(token);
+        else
+            return function();
+    }
 
-    std::condition_variable m_cv;
-    bool m_stop = false;
+    template <typename R, typename F>
+    void start(std::shared_ptr<TaskState<R>> state, F&& function, std::optional<int64_t> key)
+    {
+        const TaskPriority priority = state->priority();
+        run([state = std::move(state), function = std::forward<F>(function)]() mutable
+            {
+                if (!state->start())
+                    return;
+
+                const CancellationToken token(state.get());
+                if constexpr (std::is_void_v<R>)
+                    call(function, token);
+                else
+                    state->value = call(function, token);
+                state->finish(); },
+            priority, key);
+    }
+
+    /**
+     * Jobs are recycled instead of deleted, the deques only hold pointers because their slots must be trivially
+     * copyable.
+     */
+    struct Job
+    {
+        Task task;
+        TaskPriority priority;
+        int64_t key;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    struct Worker
+    {
+        std::array<WorkStealingDeque<Job *>, task_priority_count> deques;
+        std::thread thread;
+        uint32_t picks = 0;
+
+        std::mutex park_mutex;
+        std::condition_variable park_cv;
+        bool notified = false;
+
+        /**
+         * Jobs freed by this worker, only used by its thread.
+         */
+        std::vector<Job *> free_jobs;
+    };
 
-    void thread_worker();
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    /**
+     * Binary heaps ordered by key then sequence, the sequence keeps tasks with the same key in FIFO order.
+     */
+    std::mutex m_inject_mutex;
+    std::array<std::vector<Job *>, task_priority_count> m_inject;
+    std::array<std::atomic<size_t>, task_priority_count> m_inject_sizes{};
+    uint64_t m_next_sequence = 0;
+
+    /**
+     * Jobs for tasks started from other threads, also protected by `m_inject_mutex`. Workers give back their excess
+     * jobs here.
+     */
+    std::vector<Job *> m_free_jobs;
+
+    /**
+     * Parked workers, `m_idle_count` lets `wake_one` skip the lock when no worker is parked.
+     */
+    std::mutex m_idle_mutex;
+    std::vector<size_t> m_idle;
+    std::atomic<size_t> m_idle_count = 0;
+
+    std::atomic<bool> m_stop = false;
+
+    /**
+     * Log2 histograms of the latency in microseconds, bucket `i` counts latencies below `2^i` us.
+     */
+    static constexpr size_t latency_buckets = 32;
+    std::array<std::array<std::atomic<uint64_t>, latency_buckets>, task_priority_count> m_latencies{};
+
+    static bool compare_jobs(const Job *a, const Job *b);
+
+    void thread_worker(size_t index);
+
+    Job *find_job(size_t index);
+    Job *find_job_in(size_t index, size_t priority);
+    Job *pop_injected(size_t priority);
+    bool has_work() const;
+
+    void record_latency(const Job& job);
+
+    Job *allocate_job(std::vector<Job *>& free_jobs);
+    void free_job(size_t index, Job *job);
+
+    void wake_one();
+
+    /**
+     * Park the worker until a task is started or the pool stops.
+     */
+    void park(size_t index);
 };
+
+template <typename T>
+template <typename F>
+auto TaskHandle<T>::then(F&& function)
+{
+    using R = typename ContinuationResult<T, F>::type;
+
+    std::shared_ptr<TaskState<R>> next = std::make_shared<TaskState<R>>(m_state->priority());
+    ThreadPool *pool = m_pool;
+
+    m_state->on_done([pool, previous = m_state, next, function = std::forward<F>(function)]() mutable
+                     {
+                         if (previous->status() == TaskStateBase::Status::Cancelled)
+                         {
+                             next->cancel();
+                             return;
+                         }
+
+                         if constexpr (std::is_void_v<T>)
+                             pool->start(next, std::move(function), std::nullopt);
+                         else
+                             pool->start(next, [function = std::move(function), previous]() mutable
+                                         { return function(*previous->value); },
+                                         std::nullopt); });
+
+    return TaskHandle<R>(next, pool);
+}
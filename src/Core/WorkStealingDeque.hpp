@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Chase-Lev work-stealing deque (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+ *
+ * The owner thread pushes and pops at the bottom, any other thread can steal from the top. Items must be trivially
+ * copyable, usually pointers. Indices use sequentially consistent operations instead of the fences of the paper, which
+ * costs the same on x86 and is understood by ThreadSanitizer.
+ */
+template <typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    /**
+     * `capacity` must be a power of two, the deque grows when full.
+     */
+    WorkStealingDeque(int64_t capacity = 256)
+    {
+        m_buffers.push_back(std::make_unique<Buffer>(capacity));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /**
+     * Only called by the owner.
+     */
+    void push(T item)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_top.load(std::memory_order_acquire);
+        Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+
+        if (bottom - top > buffer->capacity - 1)
+            buffer = grow(buffer, top, bottom);
+
+        buffer->put(bottom, item);
+        m_bottom.store(bottom + 1, std::memory_order_seq_cst);
+    }
+
+    /**
+     * Only called by the owner. Returns false if the deque is empty or the last item was stolen.
+     */
+    bool pop(T& item)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_seq_cst);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = buffer->get(bottom);
+        if (top == bottom)
+        {
+            // Last item, race against thieves.
+            const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /**
+     * Called by any thread. Returns false if the deque is empty or another thread took the item first.
+     */
+    bool steal(T& item)
+    {
+        int64_t top = m_top.load(std::memory_order_seq_cst);
+        const int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+
+        if (top >= bottom)
+            return false;
+
+        Buffer *buffer = m_buffer.load(std::memory_order_acquire);
+        item = buffer->get(top);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    /**
+     * Approximate when called concurrently with other operations.
+     */
+    bool empty() const
+    {
+        return m_top.load(std::memory_order_seq_cst) >= m_bottom.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct Buffer
+    {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> items;
+
+        Buffer(int64_t capacity)
+            : capacity(capacity), items(std::make_unique<std::atomic<T>[]>(capacity))
+        {
+        }
+
+        T get(int64_t index) const { return items[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t index, T item) { items[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+    std::atomic<Buffer *> m_buffer;
+
+    /**
+     * Thieves may still read a buffer after it was replaced, so old buffers are only freed with the deque.
+     */
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+
+    Buffer *grow(Buffer *buffer, int64_t top, int64_t bottom)
+    {
+        m_buffers.push_back(std::make_unique<Buffer>(buffer->capacity * 2));
+        Buffer *new_buffer = m_buffers.back().get();
+
+        for (int64_t i = top; i < bottom; i++)
+            new_buffer->put(i, buffer->get(i));
+
+        m_buffer.store(new_buffer, std::memory_order_release);
+        return new_buffer;
+    }
+};
@@ -2,87 +2,153 @@
 
 #include <zlib.h>
 
-#define DEFLATE_BUFFER_SIZE (4 * 1024)
-#define INFLATE_BUFFER_SIZE (4 * 1024)
+#include <algorithm>
+#include <array>
 
-Result<void> ZLib::deflate(std::span<const std::byte> data, std::vector<uint8_t>& compressed_data)
+/**
+ * Smallest output buffer of `inflate` when the caller gives no hint.
+ */
+#define INFLATE_MIN_BUFFER_SIZE (4 * 1024)
+
+struct DeflateStream
 {
-    uint8_t tmp[DEFLATE_BUFFER_SIZE];
-
-    z_stream strm;
-    strm.zalloc = 0;
-    strm.zfree = 0;
-    strm.next_in = (uint8_t *)data.data();
-    strm.avail_in = data.size_bytes();
-    strm.next_out = tmp;
-    strm.avail_out = DEFLATE_BUFFER_SIZE;
-    deflateInit(&strm, Z_BEST_COMPRESSION);
-
-    while (strm.avail_in != 0)
+    z_stream strm{};
+    bool initialized = false;
+
+    ~DeflateStream()
     {
-        int res = ::deflate(&strm, Z_NO_FLUSH);
+        if (initialized)
+            deflateEnd(&strm);
+    }
+};
 
-        if (res != Z_OK)
-            return Error(ErrorKind::ReadFailure);
+struct InflateStream
+{
+    z_stream strm{};
+    bool initialized = false;
 
-        if (strm.avail_out == 0)
-        {
-            compressed_data.insert(compressed_data.end(), tmp, tmp + DEFLATE_BUFFER_SIZE);
-            strm.next_out = tmp;
-            strm.avail_out = DEFLATE_BUFFER_SIZE;
-        }
+    ~InflateStream()
+    {
+        if (initialized)
+            inflateEnd(&strm);
     }
+};
+
+/**
+ * Stream of the thread for `level`, reset to compress new data.
+ */
+static z_stream *deflate_stream(int level)
+{
+    // The level is chosen when the stream is created, one stream per level.
+    static thread_local std::array<DeflateStream, 10> streams;
+
+    // Same level as `Z_DEFAULT_COMPRESSION`.
+    if (level < 0 || level > 9)
+        level = 6;
+    DeflateStream& stream = streams[level];
 
-    int deflate_res = Z_OK;
-    while (deflate_res == Z_OK)
+    if (!stream.initialized)
     {
-        if (strm.avail_out == 0)
-        {
-            compressed_data.insert(compressed_data.end(), tmp, tmp + DEFLATE_BUFFER_SIZE);
-            strm.next_out = tmp;
-            strm.avail_out = DEFLATE_BUFFER_SIZE;
-        }
-        deflate_res = ::deflate(&strm, Z_FINISH);
+        if (deflateInit(&stream.strm, level) != Z_OK)
+            return nullptr;
+        stream.initialized = true;
+    }
+    else if (deflateReset(&stream.strm) != Z_OK)
+    {
+        return nullptr;
+    }
+
+    return &stream.strm;
+}
+
+static z_stream *inflate_stream()
+{
+    static thread_local InflateStream stream;
+
+    if (!stream.initialized)
+    {
+        if (inflateInit(&stream.strm) != Z_OK)
+            return nullptr;
+        stream.initialized = true;
     }
+    else if (inflateReset(&stream.strm) != Z_OK)
+    {
+        return nullptr;
+    }
+
+    return &stream.strm;
+}
+
+Result<void> ZLib::deflate(std::span<const std::byte> data, std::vector<uint8_t>& compressed_data, int level)
+{
+    z_stream *strm = deflate_stream(level);
+    if (strm == nullptr)
+        return Error(ErrorKind::Unknown);
 
-    if (deflate_res != Z_STREAM_END)
-        return Error(ErrorKind::ReadFailure);
+    // Compressed in one call into a buffer large enough for the worst case, instead of copying through a temporary
+    // buffer.
+    const size_t offset = compressed_data.size();
+    compressed_data.resize(offset + deflateBound(strm, data.size_bytes()));
 
-    compressed_data.insert(compressed_data.end(), tmp, tmp + DEFLATE_BUFFER_SIZE - strm.avail_out);
-    deflateEnd(&strm);
+    strm->next_in = (Bytef *)data.data();
+    strm->avail_in = data.size_bytes();
+    strm->next_out = compressed_data.data() + offset;
+    strm->avail_out = compressed_data.size() - offset;
 
+    if (::deflate(strm, Z_FINISH) != Z_STREAM_END)
+    {
+        compressed_data.resize(offset);
+        return Error(ErrorKind::Unknown);
+    }
+
+    compressed_data.resize(offset + strm->total_out);
     return Result<void>();
 }
 
-Result<void> ZLib::inflate(std::span<const std::byte> data, std::vector<uint8_t>& uncompressed_data)
+Result<void> ZLib::inflate(std::span<const std::byte> data, std::vector<uint8_t>& uncompressed_data, size_t size_hint, size_t max_size)
 {
-    uint8_t tmp[INFLATE_BUFFER_SIZE];
-
-    z_stream strm;
-    strm.zalloc = 0;
-    strm.zfree = 0;
-    strm.next_in = (uint8_t *)data.data();
-    strm.avail_in = data.size_bytes();
-    strm.next_out = tmp;
-    strm.avail_out = INFLATE_BUFFER_SIZE;
-    inflateInit(&strm);
-
-    while (strm.avail_in != 0)
+    z_stream *strm = inflate_stream();
+    if (strm == nullptr)
+        return Error(ErrorKind::Unknown);
+
+    // Without a hint, the output starts with the capacity left by the previous uses of the vector.
+    const size_t offset = uncompressed_data.size();
+    size_t size = size_hint > 0 ? size_hint : std::max<size_t>(uncompressed_data.capacity() - offset, INFLATE_MIN_BUFFER_SIZE);
+    size = std::min(size, max_size);
+    uncompressed_data.resize(offset + size);
+
+    strm->next_in = (Bytef *)data.data();
+    strm->avail_in = data.size_bytes();
+
+    while (true)
     {
-        int res = ::inflate(&strm, Z_NO_FLUSH);
-        if (res < 0)
-            return Error(ErrorKind::ReadFailure);
+        strm->next_out = uncompressed_data.data() + offset + strm->total_out;
+        strm->avail_out = size - strm->total_out;
+
+        const int res = ::inflate(strm, Z_NO_FLUSH);
+        if (res == Z_STREAM_END)
+            break;
 
-        if (strm.avail_out == 0)
+        if ((res != Z_OK && res != Z_BUF_ERROR) || (strm->avail_out > 0 && strm->avail_in == 0))
         {
-            uncompressed_data.insert(uncompressed_data.end(), tmp, tmp + INFLATE_BUFFER_SIZE);
-            strm.next_out = tmp;
-            strm.avail_out = INFLATE_BUFFER_SIZE;
+            // Corrupted or truncated data.
+            uncompressed_data.resize(offset);
+            return Error(ErrorKind::InvalidData);
         }
-    }
 
-    uncompressed_data.insert(uncompressed_data.end(), tmp, tmp + INFLATE_BUFFER_SIZE - strm.avail_out);
-    inflateEnd(&strm);
+        if (strm->avail_out == 0)
+        {
+            if (size == max_size)
+            {
+                uncompressed_data.resize(offset);
+                return Error(ErrorKind::InvalidData);
+            }
+
+            size = std::min(std::max<size_t>(size * 2, INFLATE_MIN_BUFFER_SIZE), max_size);
+            uncompressed_data.resize(offset + size);
+        }
+    }
 
+    uncompressed_data.resize(offset + strm->total_out);
     return Result<void>();
 }
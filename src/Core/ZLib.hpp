@@ -7,9 +7,21 @@
 #include <span>
 #include <vector>
 
+/**
+ * Each thread keeps its streams between calls and resets them, so compressing does not allocate once the output
+ * vectors are large enough.
+ */
 class ZLib
 {
 public:
-    static Result<void> deflate(std::span<const std::byte> data, std::vector<uint8_t>& compressed_data);
-    static Result<void> inflate(std::span<const std::byte> data, std::vector<uint8_t>& uncompressed_data);
+    /**
+     * Append the compressed `data` to `compressed_data`. `level` goes from 1 (fastest) to 9 (smallest).
+     */
+    static Result<void> deflate(std::span<const std::byte> data, std::vector<uint8_t>& compressed_data, int level = 9);
+
+    /**
+     * Append the uncompressed `data` to `uncompressed_data`. `size_hint` is the uncompressed size when the caller
+     * knows it, the output grows past it if needed. Fails if the uncompressed data is larger than `max_size`.
+     */
+    static Result<void> inflate(std::span<const std::byte> data, std::vector<uint8_t>& uncompressed_data, size_t size_hint = 0, size_t max_size = SIZE_MAX);
 };
@@ -6,6 +6,7 @@
 #include "Core/Types.hpp"
 #include "Entity/Cow.hpp"
 #include "Entity/Entity.hpp"
+#include "Entity/Item.hpp"
 #include "Entity/Player.hpp"
 #include "Entity/Zombie.hpp"
 #include "Input.hpp"
@@ -20,6 +21,7 @@
 #include <cstdlib>
 #include <imgui.h>
 
+#include <chrono>
 #include <cstddef>
 #include <ctime>
 #include <format>
@@ -33,10 +35,22 @@ constexpr int two_d_to_1d(int x, int y)
 #define WINDOW_INIT_WIDTH 1920
 #define WINDOW_INIT_HEIGHT 1080
 
-Engine::Engine(bool disable_save)
-    : m_disable_save(disable_save)
+Engine::Engine(bool disable_save, bool headless)
+    : m_disable_save(disable_save), m_headless(headless)
 {
     singleton = this;
+
+    if (m_headless)
+    {
+        register_entities();
+        register_recipes();
+
+        // Without a renderer there is no texture to create, only block runtime ids are needed to generate worlds.
+        m_registry.register_all();
+        m_registry.assign_runtime_ids();
+        return;
+    }
+
     m_window = std::make_shared<Window>("ft_minecraft", WINDOW_INIT_WIDTH, WINDOW_INIT_HEIGHT);
 
     Input::init(*m_window);
@@ -55,8 +69,46 @@ Engine::Engine(bool disable_save)
 
 Engine::~Engine()
 {
+    // The I/O service is destroyed before the world.
+    if (m_world != nullptr)
+        m_world->close();
+
+    if (m_print_frame_stats)
+    {
+        m_tick_times.print("tick time");
+
+        if (m_world != nullptr)
+        {
+            const IntegrationQueue::Stats& stats = m_world->integration_queue().stats();
+            info("integration queue: {} items, {} us spent, {} us estimated, {} ticks deferred work", stats.items, stats.time_us, stats.estimated_us, stats.deferred_ticks);
+
+            const ChunkSaver::Stats save_stats = m_world->save_stats();
+            info("chunk saver: {} queued, {} saves, {} bytes written, {} bytes/s", save_stats.dirty + save_stats.in_flight, save_stats.saves, save_stats.bytes_written, save_stats.bytes_per_second);
+
+            const PlayerSaver::Stats player_stats = m_world->player_saver().stats();
+            info("player saver: {} saves, {} skipped", player_stats.saves, player_stats.skipped);
+
+            if (m_world->block_log() != nullptr)
+            {
+                const BlockLog::Stats log_stats = m_world->block_log()->stats();
+                info("block log: {} edits, {} bytes written", log_stats.records, log_stats.bytes_written);
+            }
+        }
+
+        const IOService::Stats io_stats = m_io.stats();
+        info("io ({}): {} writes, {} bytes written, {} reads, {} bytes read, {} batches", m_io.backend_name(), io_stats.writes, io_stats.bytes_written, io_stats.reads, io_stats.bytes_read, io_stats.batches);
+
+        if (m_connection.state() != ConnectionState::Idle)
+        {
+            const NetworkConnection::Stats net_stats = m_connection.stats();
+            info("network: {} packets sent, {} received, {} invalid, {} send stalls, {} receive stalls, max depth {} out / {} in", net_stats.packets_sent, net_stats.packets_received, net_stats.invalid_packets, net_stats.send_stalls, net_stats.receive_stalls, net_stats.max_outgoing_depth, net_stats.max_incoming_depth);
+        }
+    }
+
     m_connection.close();
-    Font::deinit_library();
+
+    if (!m_headless)
+        Font::deinit_library();
 }
 
 void Engine::register_entities()
@@ -67,6 +119,7 @@ void Engine::register_entities()
     m_entity_registry.register_entity<Player>();
     m_entity_registry.register_entity<Cow>();
     m_entity_registry.register_entity<Zombie>();
+    m_entity_registry.register_entity<ItemEntity>();
 }
 
 // TODO: Create a helper for creating recipe maybe ?
@@ -95,6 +148,8 @@ void Engine::tick(float delta)
 {
     ZoneScoped;
 
+    const auto start_time = std::chrono::steady_clock::now();
+
     std::optional<SDL_Event> event_opt;
 
     {
@@ -188,6 +243,8 @@ void Engine::tick(float delta)
         if (m_ticks_since_start_of_day > ticks_per_day)
             m_ticks_since_start_of_day = 0;
     }
+
+    m_tick_times.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time));
 }
 
 void Engine::draw(float delta)
@@ -289,7 +346,7 @@ void Engine::create_world_and_start()
     m_connection.set_packet_handler(&Engine::receive_server, this);
 
     uint64_t seed = std::stoull(m_world_seed_buf);
-    std::string name = "unamed";
+    const std::string& name = m_world_name;
 
     m_ticks_since_start_of_day = ticks_per_day / 2;
 
@@ -311,24 +368,21 @@ void Engine::create_world_and_start()
     m_player->set_username(username);
     m_world->add_entity(World::overworld, m_player);
 
-    if (m_world->is_player_saved(username))
-    {
-        m_world->load_player(username, m_player);
-    }
-    else
+    // Mobs are saved with their chunks, the zombie is only spawned the first time the player joins the world.
+    if (!m_world->load_player(username, m_player))
     {
         m_player->get_transform().position() = m_world->get_spawn_position();
-    }
 
-    // m_world->force_load_chunk_for(m_player->get_position());
+        // m_world->force_load_chunk_for(m_player->get_position());
 
-    // std::shared_ptr<Entity> cow = EXPECT(std::make_shared<Cow>());
-    // cow->get_transform().position() = m_player->get_position();
-    // m_world->add_entity(World::overworld, cow);
+        // std::shared_ptr<Entity> cow = EXPECT(std::make_shared<Cow>());
+        // cow->get_transform().position() = m_player->get_position();
+        // m_world->add_entity(World::overworld, cow);
 
-    std::shared_ptr<Entity> zombie = std::make_shared<Zombie>();
-    zombie->get_transform().position() = m_player->get_position();
-    m_world->add_entity(World::overworld, zombie);
+        std::shared_ptr<Entity> zombie = std::make_shared<Zombie>();
+        zombie->get_transform().position() = m_player->get_position();
+        m_world->add_entity(World::overworld, zombie);
+    }
 
     m_scene = GameScene::World;
     m_authority = RpcTarget::Server;
@@ -345,23 +399,16 @@ void Engine::connect_to_remote_world()
     EXPECT(m_connection.connect_to(m_connect_ip, m_connect_port));
 }
 
-void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *packet, const Client& client)
+void Engine::receive_client(void *user, NetworkConnection& conn, AnyPacket& packet, const Client& client)
 {
     Engine *self = (Engine *)user;
     (void)client;
 
-    const void *data = packet->data;
-    const size_t data_size = packet->dataLength;
-
-    DataBuffer buffer((char *)data, data_size);
-    PacketType type = buffer.read<PacketType>();
-
-    switch (type)
+    switch (packet_type(packet))
     {
     case PacketType::Refused:
     {
-        RefusedPacket p;
-        EXPECT(deserialize(buffer, p));
+        RefusedPacket& p = std::get<RefusedPacket>(packet);
 
         info("Connection error: {}", p.message);
 
@@ -372,8 +419,7 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::Init:
     {
-        InitPacket p;
-        EXPECT(deserialize(buffer, p));
+        InitPacket& p = std::get<InitPacket>(packet);
 
         self->m_world = EXPECT(World::create_proxy(p.seed));
         self->m_scene = GameScene::World;
@@ -389,8 +435,7 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::AddEntity:
     {
-        AddEntityPacket p;
-        EXPECT(deserialize(buffer, p));
+        AddEntityPacket& p = std::get<AddEntityPacket>(packet);
 
         debug("new entity (class_id = {}, id = {})", p.class_id.value, (uint32_t)p.id);
 
@@ -407,8 +452,7 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::RemoveEntity:
     {
-        RemoveEntityPacket p;
-        EXPECT(deserialize(buffer, p));
+        RemoveEntityPacket& p = std::get<RemoveEntityPacket>(packet);
 
         debug("remove entity (id = {})", (uint32_t)p.id);
         self->m_world->remove_entity(World::overworld, p.id);
@@ -416,8 +460,7 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::UpdateEntity:
     {
-        UpdateEntityPacket p;
-        EXPECT(deserialize(buffer, p));
+        UpdateEntityPacket& p = std::get<UpdateEntityPacket>(packet);
 
         std::shared_ptr<Entity> entity = self->m_world->get_entity(p.id);
         if (entity == nullptr)
@@ -431,8 +474,7 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::RpcCall:
     {
-        RpcCallPacket p;
-        EXPECT(deserialize(buffer, p));
+        RpcCallPacket& p = std::get<RpcCallPacket>(packet);
 
         debug("call `{}` with {} args on entity {}", p.name, p.args.size(), (uint32_t)p.id);
 
@@ -458,10 +500,9 @@ void Engine::receive_client(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::ChunkData:
     {
-        ChunkDataPacket p;
-        EXPECT(deserialize(buffer, p));
+        ChunkDataPacket& p = std::get<ChunkDataPacket>(packet);
 
-        self->m_world->queue_receive_chunk(p);
+        self->m_world->queue_receive_chunk(std::move(p));
     }
     break;
     default:
@@ -476,7 +517,7 @@ void Engine::connect_client(void *user, NetworkConnection& conn, const Client& c
 
     BonjourPacket p;
     p.username = self->m_username;
-    conn.send(conn.create_packet(p));
+    conn.send(p);
 }
 
 void Engine::disconnect_client(void *user, NetworkConnection& conn, const Client& client)
@@ -491,28 +532,21 @@ void Engine::disconnect_client(void *user, NetworkConnection& conn, const Client
     info("Disconnected from the server");
 }
 
-void Engine::receive_server(void *user, NetworkConnection& conn, ENetPacket *packet, const Client& client)
+void Engine::receive_server(void *user, NetworkConnection& conn, AnyPacket& packet, const Client& client)
 {
     Engine *self = (Engine *)user;
 
-    const void *data = packet->data;
-    const size_t data_size = packet->dataLength;
-
-    DataBuffer buffer((char *)data, data_size);
-    PacketType type = buffer.read<PacketType>();
-
-    switch (type)
+    switch (packet_type(packet))
     {
     case PacketType::Bonjour:
     {
-        BonjourPacket p;
-        EXPECT(deserialize(buffer, p));
+        BonjourPacket& p = std::get<BonjourPacket>(packet);
 
         if (self->has_player_with_name(p.username))
         {
             RefusedPacket p2;
             p2.message = std::format("`{}` is already connected", p.username);
-            conn.send(client.peer(), conn.create_packet(p2));
+            conn.send(client.peer(), p2);
             break;
         }
 
@@ -525,32 +559,28 @@ void Engine::receive_server(void *user, NetworkConnection& conn, ENetPacket *pac
         player->set_username(p.username);
 
         // TODO: Send inventory content, maybe with a separate packet.
-        if (self->m_world->is_player_saved(p.username))
-        {
-            self->m_world->load_player(p.username, player);
-        }
+        self->m_world->load_player(p.username, player);
 
         InitPacket init_p(self->m_world->seed(), id, player->get_transform().position());
-        conn.send(client.peer(), conn.create_packet(init_p));
+        conn.send(client.peer(), init_p);
 
         for (std::shared_ptr<Entity> entity : self->m_world->get_dimension(0).get_entities())
         {
             Transform3D transform = entity->get_transform();
             AddEntityPacket p2(transform.position(), transform.rotation(), entity->id(), entity->get_class_hash_code());
-            conn.send(client.peer(), conn.create_packet(p2));
+            conn.send(client.peer(), p2);
         }
 
         self->m_world->add_entity(0, player);
         self->m_players[client.peer()] = player;
 
         AddEntityPacket p2(player->get_transform().position(), player->get_transform().rotation(), id, player->get_class_hash_code());
-        conn.broadcast(conn.create_packet(p2), client.peer());
+        conn.broadcast(p2, client.peer());
     };
     break;
     case PacketType::SendPlayerTransform:
     {
-        SendPlayerTransformPacket p;
-        EXPECT(deserialize(buffer, p));
+        SendPlayerTransformPacket& p = std::get<SendPlayerTransformPacket>(packet);
 
         std::shared_ptr<Entity> entity = self->m_world->get_entity(p.id);
         if (entity == nullptr)
@@ -562,8 +592,7 @@ void Engine::receive_server(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::RequestChunk:
     {
-        RequestChunkPacket p{};
-        EXPECT(deserialize(buffer, p));
+        RequestChunkPacket& p = std::get<RequestChunkPacket>(packet);
 
         // TODO: handle different dimension here.
         self->m_world->request_chunk(client.peer(), 0, p.x, p.z);
@@ -571,8 +600,7 @@ void Engine::receive_server(void *user, NetworkConnection& conn, ENetPacket *pac
     break;
     case PacketType::RpcCall:
     {
-        RpcCallPacket p;
-        EXPECT(deserialize(buffer, p));
+        RpcCallPacket& p = std::get<RpcCallPacket>(packet);
 
         std::shared_ptr<Entity> entity = self->m_world->get_entity(p.id);
         debug("received RPC call on {}", (uint32_t)p.id);
@@ -587,7 +615,7 @@ void Engine::receive_server(void *user, NetworkConnection& conn, ENetPacket *pac
             entity->call(p.name, p.args);
 
         if (rpc == RpcTarget::Both || rpc == RpcTarget::Client)
-            conn.broadcast(conn.create_packet(p), client.peer());
+            conn.broadcast(p, client.peer());
     };
     break;
     default:
@@ -609,9 +637,10 @@ void Engine::disconnect_server(void *user, NetworkConnection& conn, const Client
     Engine *self = (Engine *)user;
 
     std::shared_ptr<Player> player = std::dynamic_pointer_cast<Player>(self->m_players.at(client.peer()));
+    EXPECT(self->m_world->save_player(player));
 
     RemoveEntityPacket p(player->id());
-    conn.broadcast(conn.create_packet(p), client.peer());
+    conn.broadcast(p, client.peer());
 
     self->m_world->remove_entity(World::overworld, player);
     self->m_players.erase(client.peer());
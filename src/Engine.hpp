@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Core/FrameHistogram.hpp"
+#include "Core/IOService.hpp"
 #include "Core/ThreadPool.hpp"
 #include "Entity/Entity.hpp"
 #include "Entity/Player.hpp"
@@ -29,7 +31,11 @@ constexpr int64_t ticks_sunset = ticks_noon + ticks_per_day / 4;
 class Engine
 {
 public:
-    Engine(bool disable_save);
+    /**
+     * @param headless Do not create a window nor initialize the renderer. Only the registry and the world code can be
+     *                 used, for example to pregenerate a world.
+     */
+    Engine(bool disable_save, bool headless = false);
     ~Engine();
 
     bool is_running() const { return m_window->is_running(); }
@@ -58,6 +64,11 @@ public:
         return m_thread_pool;
     }
 
+    /**
+     * File I/O of the world, the main thread never reads or writes files itself.
+     */
+    IOService& io() { return m_io; }
+
     bool is_online() const { return m_connection.state() != ConnectionState::Idle; }
 
     GameRegistry& registry() { return m_registry; }
@@ -73,6 +84,23 @@ public:
     ALWAYS_INLINE int64_t get_tps() const { return m_tps; }
 
     bool is_save_disabled() const { return m_disable_save; }
+    bool is_headless() const { return m_headless; }
+
+    /**
+     * Name of the world created or loaded when pressing "Play".
+     */
+    void set_world_name(std::string_view name) { m_world_name = name; }
+
+    /**
+     * Time spent each tick on the world integration queue, 0 for no limit.
+     */
+    uint32_t integration_budget_us() const { return m_integration_budget_us; }
+    void set_integration_budget_us(uint32_t budget) { m_integration_budget_us = budget; }
+
+    /**
+     * Print the histogram of tick times when the engine is destroyed.
+     */
+    void set_print_frame_stats(bool print) { m_print_frame_stats = print; }
 
     /**
      * Time of day in ticks since the start of the day.
@@ -90,6 +118,8 @@ private:
     GameRegistry m_registry;
     EntityRegistry m_entity_registry;
     bool m_disable_save;
+    bool m_headless;
+    std::string m_world_name = "unamed";
 
     RpcTarget m_authority = RpcTarget::Server;
     NetworkConnection m_connection;
@@ -101,6 +131,10 @@ private:
     std::shared_ptr<Player> m_player;
     std::shared_ptr<Font> m_font;
 
+    /**
+     * Declared before the thread pool so it outlives the tasks still waiting for a read when the pool is destroyed.
+     */
+    IOService m_io;
     ThreadPool m_thread_pool;
 
     bool m_time_pass = true;
@@ -115,6 +149,10 @@ private:
     float m_last_second_frame_time = 0.0;
     size_t m_current_memory_usage = 0;
 
+    uint32_t m_integration_budget_us = 2000;
+    bool m_print_frame_stats = false;
+    FrameHistogram m_tick_times;
+
     // main menu stuff
     int m_main_menu_world_type = 1;
     char m_world_seed_buf[32] = "0";
@@ -147,11 +185,11 @@ private:
     void create_world_and_start();
     void connect_to_remote_world();
 
-    static void receive_client(void *, NetworkConnection& conn, ENetPacket *packet, const Client& client);
+    static void receive_client(void *, NetworkConnection& conn, AnyPacket& packet, const Client& client);
     static void connect_client(void *, NetworkConnection& conn, const Client& client);
     static void disconnect_client(void *, NetworkConnection& conn, const Client& client);
 
-    static void receive_server(void *, NetworkConnection& conn, ENetPacket *packet, const Client& client);
+    static void receive_server(void *, NetworkConnection& conn, AnyPacket& packet, const Client& client);
     static void connect_server(void *, NetworkConnection& conn, const Client& client);
     static void disconnect_server(void *, NetworkConnection& conn, const Client& client);
 };
@@ -45,8 +45,10 @@ void ArrowEntity::tick(float delta)
 
         if (auto mob = std::dynamic_pointer_cast<Mob>(e))
         {
-            println("Arrow hit {}", e->get_class_name());
-            mob->damage(1, id());
+            m_world->defer([mob, id = id()]()
+                           {
+                               println("Arrow hit {}", mob->get_class_name());
+                               mob->damage(1, id); });
             m_velocity = glm::vec3(0.0f);
             break;
         }
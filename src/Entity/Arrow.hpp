@@ -14,6 +14,7 @@ public:
     ArrowEntity(Id<Item> item);
 
     virtual void tick(float delta) override;
+    bool ticks_in_parallel() const override { return true; }
     virtual void draw(const RenderPass& pass) override;
     void on_ready() override;
     inline void set_velocity(const glm::vec3 velocity) { m_velocity = velocity; }
@@ -51,8 +51,8 @@ void Cow::tick(float delta)
 void Cow::on_ready()
 {
     m_model = EXPECT(Model::load("assets/models/cow.json"));
-    m_id = World::next_id();
     m_pathfinding = std::make_unique<Pathfinding>(m_world);
+    m_random.seed(m_world->seed() + m_id);
 }
 
 void Cow::die()
@@ -64,7 +64,9 @@ void Cow::die()
 void Cow::on_damage(int damage, EntityId damage_source)
 {
     (void)damage;
-    m_threat_entity = m_world->get_entity(damage_source);
+    m_threat_entity = m_world->get_dimension(m_dimension).get_entity(damage_source);
+    if (m_threat_entity)
+        m_threat_position = m_threat_entity->get_global_transform().position();
     flee_from(20);
 }
 
@@ -74,7 +76,7 @@ void Cow::flee_from(int radius)
         return;
 
     glm::ivec3 cow_grid = glm::ivec3(glm::round(m_transform.position()));
-    glm::ivec3 threat_grid = glm::ivec3(glm::round(m_threat_entity->get_global_transform().position()));
+    glm::ivec3 threat_grid = glm::ivec3(glm::round(m_threat_position));
 
     glm::vec3 flee_dir = safe_normalize(glm::vec3(cow_grid - threat_grid));
     glm::ivec3 flee_position = find_random_walkable_position(radius, flee_dir);
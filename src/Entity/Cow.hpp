@@ -5,6 +5,8 @@
 
 class Cow : public Mob
 {
+    CLASS(Cow, Mob);
+
 public:
     Cow()
         : Mob(3)
@@ -23,4 +25,9 @@ protected:
     void flee_from(int radius);
 
     std::shared_ptr<Entity> m_threat_entity;
+
+    /**
+     * Position of the threat when it dealt damage, the threat may be ticked at the same time as the cow.
+     */
+    glm::dvec3 m_threat_position = glm::dvec3();
 };
@@ -1,6 +1,5 @@
 #include "Entity/Entity.hpp"
 
-#include "Core/Filesystem.hpp"
 #include "Core/Result.hpp"
 #include "Engine.hpp"
 #include "Network/Network.hpp"
@@ -10,26 +9,19 @@
 
 #include <string>
 
-Result<void> EntitySerializer::save(std::string_view path) const
+Result<void> EntitySerializer::save(Writer& writer) const
 {
-    File file = TRY(Filesystem::open_file(path, true));
-    FileWriter writer = file.writer();
-
     for (auto& [name, value] : m_variants)
     {
         TRY(writer.write_variant(Variant(name)));
         TRY(writer.write_variant(value));
     }
 
-    file.close();
     return Result<void>();
 }
 
-Result<void> EntitySerializer::load(std::string_view path)
+Result<void> EntitySerializer::load(Reader& reader)
 {
-    File file = TRY(Filesystem::open_file(path));
-    FileReader reader = file.reader();
-
     while (!reader.eof())
     {
         std::optional<Variant> vname_opt = TRY(reader.read_variant());
@@ -37,14 +29,16 @@ Result<void> EntitySerializer::load(std::string_view path)
             break;
 
         Variant vname = vname_opt.value();
-        ASSERT_V(vname.has(VariantType::String), "");
+        if (!vname.has(VariantType::String))
+            return Error(ErrorKind::InvalidData);
         std::string s = vname.get_unchecked<std::string>();
 
-        Variant value = TRY(reader.read_variant()).value();
-        m_variants[s] = value;
+        std::optional<Variant> value = TRY(reader.read_variant());
+        if (!value.has_value())
+            return Error(ErrorKind::InvalidData);
+        m_variants[s] = value.value();
     }
 
-    file.close();
     return Result<void>();
 }
 
@@ -74,7 +68,10 @@ void Entity::tick(float delta)
     if (Engine::get().registry().from_runtime_id(state.id) == Blocks::portal && !m_inside_portal)
     {
         m_inside_portal = true;
-        m_world->change_dimension(m_id, (m_dimension + 1) % 2);
+        // Moving to another dimension touches both dimensions, it waits for the sync point.
+        m_world->defer([world = m_world, id = m_id, from = m_dimension, to = (m_dimension + 1) % 2]()
+                       { world->hand_off(from, [world, id, to]()
+                                         { world->change_dimension(id, to); }); });
     }
     else if (Engine::get().registry().from_runtime_id(state.id) != Blocks::portal)
     {
@@ -152,9 +149,9 @@ void Entity::call_rpci(std::string_view name, std::span<const Variant> args)
             p.args.push_back(v);
 
         if (Engine::singleton->is_server())
-            Engine::singleton->connection().broadcast(Engine::singleton->connection().create_packet(p));
+            Engine::singleton->connection().broadcast(std::move(p));
         else
-            Engine::singleton->connection().send(Engine::singleton->connection().create_packet(p));
+            Engine::singleton->connection().send(std::move(p));
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include "AABB.hpp"
 #include "Core/Class.hpp"
+#include "Core/IO.hpp"
 #include "Core/Result.hpp"
 #include "Core/Types.hpp"
 #include "Event.hpp"
@@ -104,8 +105,8 @@ public:
         return std::nullopt;
     }
 
-    Result<void> save(std::string_view path) const;
-    Result<void> load(std::string_view path);
+    Result<void> save(Writer& writer) const;
+    Result<void> load(Reader& reader);
 
 private:
     stdext::string_map<Variant> m_variants;
@@ -129,6 +130,12 @@ public:
 
     virtual void tick(float delta);
 
+    /**
+     * Entities ticked in parallel must only write to themselves in `tick`. Every other side effect goes through
+     * `World::defer`, and other entities are only found with `Dimension::cast_box`.
+     */
+    virtual bool ticks_in_parallel() const { return false; }
+
     virtual void draw(const RenderPass& pass)
     {
         (void)pass;
@@ -164,6 +171,11 @@ public:
         (void)deser;
     }
 
+    /**
+     * Saved with the chunk it is in, and unloaded with it. Players are saved on their own.
+     */
+    virtual bool is_saved_with_chunk() const { return false; }
+
     const Transform3D& get_transform() const { return m_transform; }
     Transform3D& get_transform() { return m_transform; }
 
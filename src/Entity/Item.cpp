@@ -10,12 +10,21 @@ struct GPU_ATTRIBUTE ItemBlockModel
     glm::uvec3 textures;
 };
 
+ItemEntity::ItemEntity()
+    : ItemEntity(Id<Item>())
+{
+}
+
 ItemEntity::ItemEntity(Id<Item> item)
     : m_item(item), m_time(0)
 {
     m_aabb = AABBd(-glm::vec3(0.2, 0.2, 0.2), glm::vec3(0.2, 0.2, 0.2));
     get_transform().scale() = glm::dvec3(0.2, 0.2, 0.2);
+}
 
+void ItemEntity::on_ready()
+{
+    // Created here rather than in the constructor, the item of a restored entity is only known once it is loaded.
     m_model_buffer = EXPECT(Buffer::create(sizeof(ItemBlockModel), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform));
 
     m_bg = BindGroup::create(Renderer::get().get_fw_item_block_shader()); // FIXME
@@ -25,10 +34,25 @@ ItemEntity::ItemEntity(Id<Item> item)
     m_bg->set_param("images", EXPECT(Engine::get().registry().get_texture_array()->get_view(WGPUTextureViewDimension_2DArray)));
     m_bg->set_param("shadowmap", EXPECT(Renderer::get().get_fw_shadowmap()->get_view(WGPUTextureViewDimension_2D)));
 
-    std::shared_ptr<Block> block = Engine::get().registry().block_from_item(item);
+    std::shared_ptr<Block> block = Engine::get().registry().block_from_item(m_item);
     m_textures = glm::uvec3(block->get_texture_ids()[0] | (block->get_texture_ids()[1] << 16), block->get_texture_ids()[2] | (block->get_texture_ids()[3] << 16), block->get_texture_ids()[4] | (block->get_texture_ids()[5] << 16));
 }
 
+void ItemEntity::save(EntitySerializer& ser) const
+{
+    if (m_item.valid())
+        ser.set("item", std::string(m_item.str));
+}
+
+void ItemEntity::load(const EntitySerializer& deser)
+{
+    m_item = Engine::get().registry().item_from_name(deser.get<std::string>("item").value_or(""));
+
+    // Items removed since the save are dropped with their entity.
+    if (!m_item.valid() || Engine::get().registry().block_from_item(m_item) == nullptr)
+        m_active = false;
+}
+
 void ItemEntity::tick(float delta)
 {
     m_velocity.y -= m_gravity_value * delta;
@@ -9,10 +9,20 @@ class ItemEntity : public Entity
     CLASS(ItemEntity, Entity);
 
 public:
+    /**
+     * Item entity restored from a save, its item is read by `load`.
+     */
+    ItemEntity();
     ItemEntity(Id<Item> item);
 
     virtual void tick(float delta) override;
+    bool ticks_in_parallel() const override { return true; }
+    bool is_saved_with_chunk() const override { return true; }
     virtual void draw(const RenderPass& pass) override;
+    virtual void on_ready() override;
+
+    virtual void save(EntitySerializer& ser) const override;
+    virtual void load(const EntitySerializer& deser) override;
 
     Id<Item> item() const { return m_item; }
 
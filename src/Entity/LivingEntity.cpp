@@ -1,5 +1,17 @@
 #include "Entity/LivingEntity.hpp"
 
+#include <algorithm>
+
+void LivingEntity::save(EntitySerializer& ser) const
+{
+    ser.set("health", (int64_t)m_health);
+}
+
+void LivingEntity::load(const EntitySerializer& deser)
+{
+    m_health = (int)std::clamp<int64_t>(deser.get<int64_t>("health").value_or(m_max_health), 1, m_max_health);
+}
+
 void LivingEntity::damage(int value, EntityId damage_source)
 {
 
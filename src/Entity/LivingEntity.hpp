@@ -17,6 +17,9 @@ public:
     {
     }
 
+    virtual void save(EntitySerializer& ser) const override;
+    virtual void load(const EntitySerializer& deser) override;
+
     void damage(int value, EntityId damage_source);
 
     virtual void on_damage(int value, EntityId damage_source)
@@ -10,7 +10,7 @@ void Mob::draw(const RenderPass& pass)
 
 void Mob::die()
 {
-    m_world->remove_entity(World::overworld, id());
+    m_world->remove_entity(m_dimension, id());
 }
 
 void Mob::follow_path(float delta_time)
@@ -194,16 +194,16 @@ glm::ivec3 Mob::find_random_walkable_position(int radius, const glm::vec3& prefe
 
     for (size_t i = 0; i < attempts; i++)
     {
-        int dx = rand() % (radius * 2 + 1) - radius;
-        int dz = rand() % (radius * 2 + 1) - radius;
-        int dy = rand() % 5 - 2;
+        int dx = int(m_random() % uint32_t(radius * 2 + 1)) - radius;
+        int dz = int(m_random() % uint32_t(radius * 2 + 1)) - radius;
+        int dy = int(m_random() % 5) - 2;
 
         glm::vec3 dir = safe_normalize(glm::vec3(dx, 0.0f, dz));
 
         if (glm::length2(preferred_dir) > 0.0f)
             dir = safe_normalize(dir + preferred_dir);
 
-        int dist = rand() % radius + 1;
+        int dist = int(m_random() % uint32_t(radius)) + 1;
 
         glm::ivec3 horizontal = glm::ivec3(glm::round(dir * (float)dist));
         glm::ivec3 pos = start + glm::ivec3(horizontal.x, dy, horizontal.z);
@@ -4,6 +4,8 @@
 #include "Entity/Pathfinding/Path.hpp"
 #include "Entity/Pathfinding/Pathfinding.hpp"
 
+#include <random>
+
 /**
  * @brief An entity controlled by AI.
  */
@@ -19,6 +21,8 @@ public:
 
     virtual void draw(const RenderPass& pass) override;
     virtual void die() override;
+    bool ticks_in_parallel() const override { return true; }
+    bool is_saved_with_chunk() const override { return true; }
 
     void follow_path(float delta_time);
     void flee_to(const glm::ivec3& to);
@@ -36,4 +40,9 @@ protected:
 
     float m_speed = 1.0f;
     float m_jump_force = 0.24f;
+
+    /**
+     * Seeded from the world seed and the id, mobs are ticked in parallel and `rand` would depend on the order.
+     */
+    std::minstd_rand m_random;
 };
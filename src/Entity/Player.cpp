@@ -588,7 +588,7 @@ void Player::tick(float delta)
         p.id = m_id;
         p.position = get_global_transform().position();
         p.rotation = get_global_transform().rotation();
-        Engine::get().connection().send(Engine::get().connection().create_packet(p));
+        Engine::get().connection().send(p);
     }
 }
 
@@ -116,8 +116,8 @@ void Zombie::tick(float delta)
 void Zombie::on_ready()
 {
     m_model = EXPECT(Model::load("assets/models/zombie.json"));
-    m_id = World::next_id();
     m_pathfinding = std::make_unique<Pathfinding>(m_world);
+    m_random.seed(m_world->seed() + m_id);
 }
 
 void Zombie::attack()
@@ -129,6 +129,7 @@ void Zombie::attack()
     if (!mob)
         return;
 
-    mob->damage(1, id());
+    m_world->defer([mob, id = id()]()
+                   { mob->damage(1, id); });
     m_attack_timer = m_attack_cooldown;
 }
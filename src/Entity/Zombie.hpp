@@ -5,6 +5,8 @@
 
 class Zombie : public Mob
 {
+    CLASS(Zombie, Mob);
+
 public:
     Zombie() : Mob(3)
     {
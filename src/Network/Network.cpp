@@ -6,11 +6,32 @@
 
 #include <enet/enet.h>
 
+#include <algorithm>
+#include <chrono>
+
+/**
+ * Longest time the network thread waits for the socket before checking the outgoing queue again.
+ */
+static constexpr uint32_t service_timeout_ms = 1;
+
+static void update_max(std::atomic<size_t>& max, size_t value)
+{
+    size_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
 NetworkConnection::NetworkConnection()
 {
     ASSERT(enet_initialize() == 0, "failed to initialize ENet");
 }
 
+NetworkConnection::~NetworkConnection()
+{
+    close();
+}
+
 Result<void> NetworkConnection::connect_to(std::string_view ip, uint16_t port)
 {
     m_address.port = port;
@@ -34,6 +55,7 @@ Result<void> NetworkConnection::connect_to(std::string_view ip, uint16_t port)
 
     m_state = ConnectionState::Connection;
     m_is_server = false;
+    start_thread();
     return Result<void>();
 }
 
@@ -54,124 +76,83 @@ Result<void> NetworkConnection::host(uint16_t port, std::string_view ip)
 
     m_state = ConnectionState::Host;
     m_is_server = true;
+    start_thread();
     return Result<void>();
 }
 
-void NetworkConnection::send(ENetPeer *peer, ENetPacket *packet)
-{
-    enet_peer_send(peer, 0, packet);
-}
-
-void NetworkConnection::send(ENetPacket *packet)
-{
-    send(m_peer, packet);
-}
-
-void NetworkConnection::broadcast(ENetPacket *packet, ENetPeer *peer)
-{
-    for (const auto& [key, value] : m_clients)
-    {
-        if (peer == value.peer())
-            continue;
-        enet_peer_send(value.peer(), 0, packet);
-    }
-}
-
-void NetworkConnection::tick()
+void NetworkConnection::push_outgoing(Outgoing outgoing)
 {
     if (m_state == ConnectionState::Idle)
         return;
 
-    if (m_is_server)
+    // Back-pressure: the game thread waits for the network thread instead of dropping packets.
+    while (!m_outgoing.try_push(std::move(outgoing)))
     {
-        tick_server();
+        m_send_stalls.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
     }
-    else
-    {
-        tick_client();
-    }
-}
 
-void NetworkConnection::tick_client()
-{
-    ENetEvent event;
-    while (enet_host_service(m_host, &event, 0) > 0)
-    {
-        switch (event.type)
-        {
-        case ENET_EVENT_TYPE_CONNECT:
-        {
-            m_state = ConnectionState::Connected;
-            Client client("", 0, event.peer);
-            m_connect_handler(m_connect_handler_user, *this, client);
-            info("Connected to server");
-        }
-        break;
-        case ENET_EVENT_TYPE_DISCONNECT:
-        {
-            Client client("", 0, event.peer);
-            m_disconnect_handler(m_disconnect_handler_user, *this, client);
-            close();
-        };
-        break;
-        case ENET_EVENT_TYPE_RECEIVE:
-        {
-            Client client("", 0, event.peer);
-            m_packet_handler(m_packet_handler_user, *this, event.packet, client);
-            enet_packet_destroy(event.packet);
-        }
-        break;
-        default:
-            break;
-        }
-    }
+    update_max(m_max_outgoing_depth, m_outgoing.size());
 }
 
-void NetworkConnection::tick_server()
+void NetworkConnection::tick()
 {
-    ENetEvent event;
-    while (enet_host_service(m_host, &event, 0) > 0)
+    Event event;
+    while (m_state != ConnectionState::Idle && m_incoming.try_pop(event))
     {
         switch (event.type)
         {
-        case ENET_EVENT_TYPE_CONNECT:
+        case EventType::Connect:
         {
-            char address_buf[32];
-            enet_address_get_host_ip(&event.peer->address, address_buf, sizeof(address_buf));
-
-            Client client(address_buf, event.peer->address.port, event.peer);
-            m_clients[event.peer] = client;
-
-            m_connect_handler(m_disconnect_handler_user, *this, client);
+            if (m_is_server)
+            {
+                m_clients[event.client.peer()] = event.client;
+                info("Client connected from {}:{}", event.client.ip(), event.client.port());
+            }
+            else
+            {
+                m_state = ConnectionState::Connected;
+                info("Connected to server");
+            }
 
-            info("Client connected from {}:{}", client.ip(), client.port());
+            m_connect_handler(m_connect_handler_user, *this, event.client);
         }
         break;
-        case ENET_EVENT_TYPE_DISCONNECT:
+        case EventType::Disconnect:
         {
-            m_disconnect_handler(m_disconnect_handler_user, *this, m_clients[event.peer]);
+            if (m_is_server)
+            {
+                const Client& client = m_clients[event.client.peer()];
+                m_disconnect_handler(m_disconnect_handler_user, *this, client);
 
-            const Client& client = m_clients[event.peer];
-            info("Client disconnected from {}:{}", client.ip(), client.port());
-
-            m_clients.erase(event.peer);
-        };
+                info("Client disconnected from {}:{}", client.ip(), client.port());
+                m_clients.erase(event.client.peer());
+            }
+            else
+            {
+                m_disconnect_handler(m_disconnect_handler_user, *this, event.client);
+                close();
+            }
+        }
         break;
-        case ENET_EVENT_TYPE_RECEIVE:
+        case EventType::Receive:
         {
-            const Client& client = m_clients[event.peer];
+            const Client& client = m_is_server ? m_clients[event.client.peer()] : event.client;
             m_packet_handler(m_packet_handler_user, *this, event.packet, client);
-            enet_packet_destroy(event.packet);
         }
         break;
-        default:
-            break;
         }
     }
 }
 
 void NetworkConnection::close()
 {
+    if (m_thread.joinable())
+    {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
     switch (m_state)
     {
     case ConnectionState::Host:
@@ -181,7 +162,10 @@ void NetworkConnection::close()
     case ConnectionState::Connection:
     {
         if (m_state == ConnectionState::Connected)
+        {
             enet_peer_disconnect(m_peer, 0);
+            enet_host_flush(m_host);
+        }
         enet_host_destroy(m_host);
     }
     break;
@@ -189,6 +173,167 @@ void NetworkConnection::close()
         break;
     }
 
+    // Drop what was not sent or handled, the next connection starts with empty queues.
+    Outgoing outgoing;
+    while (m_outgoing.try_pop(outgoing))
+    {
+    }
+    Event event;
+    while (m_incoming.try_pop(event))
+    {
+    }
+
+    m_clients.clear();
+    m_host = nullptr;
+    m_peer = nullptr;
+
     // Reset the state connection state to idle.
     m_state = ConnectionState::Idle;
 }
+
+NetworkConnection::Stats NetworkConnection::stats() const
+{
+    Stats stats;
+    stats.packets_sent = m_packets_sent.load(std::memory_order_relaxed);
+    stats.packets_received = m_packets_received.load(std::memory_order_relaxed);
+    stats.invalid_packets = m_invalid_packets.load(std::memory_order_relaxed);
+    stats.send_stalls = m_send_stalls.load(std::memory_order_relaxed);
+    stats.receive_stalls = m_receive_stalls.load(std::memory_order_relaxed);
+    stats.max_outgoing_depth = m_max_outgoing_depth.load(std::memory_order_relaxed);
+    stats.max_incoming_depth = m_max_incoming_depth.load(std::memory_order_relaxed);
+    return stats;
+}
+
+DataBuffer& NetworkConnection::packet_buffer()
+{
+    static thread_local DataBuffer buffer;
+    return buffer;
+}
+
+void NetworkConnection::start_thread()
+{
+    m_stop.store(false, std::memory_order_relaxed);
+    m_thread = std::thread(&NetworkConnection::thread_worker, this);
+}
+
+void NetworkConnection::thread_worker()
+{
+    Event pending;
+    bool has_pending = false;
+
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+        Outgoing outgoing;
+        while (m_outgoing.try_pop(outgoing))
+            send_outgoing(outgoing);
+
+        if (has_pending)
+        {
+            if (!m_incoming.try_push(std::move(pending)))
+            {
+                // The game thread is behind, stop reading the socket so ENet slows the peers down.
+                m_receive_stalls.fetch_add(1, std::memory_order_relaxed);
+                enet_host_flush(m_host);
+                std::this_thread::sleep_for(std::chrono::milliseconds(service_timeout_ms));
+                continue;
+            }
+            has_pending = false;
+        }
+
+        ENetEvent enet_event;
+        int result = enet_host_service(m_host, &enet_event, service_timeout_ms);
+        while (result > 0)
+        {
+            if (make_event(enet_event, pending) && !m_incoming.try_push(std::move(pending)))
+            {
+                has_pending = true;
+                break;
+            }
+
+            result = enet_host_check_events(m_host, &enet_event);
+        }
+
+        update_max(m_max_incoming_depth, m_incoming.size());
+    }
+}
+
+void NetworkConnection::send_outgoing(Outgoing& outgoing)
+{
+    DataBuffer& buffer = packet_buffer();
+    buffer.clear();
+    outgoing.serialize();
+    outgoing.serialize.reset();
+
+    ENetPacket *packet = enet_packet_create(buffer.data().data(), buffer.data().size(), 0);
+
+    if (!outgoing.broadcast)
+    {
+        if (outgoing.peer != nullptr)
+        {
+            enet_peer_send(outgoing.peer, 0, packet);
+            m_packets_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < m_host->peerCount; i++)
+        {
+            ENetPeer *peer = &m_host->peers[i];
+            if (peer->state != ENET_PEER_STATE_CONNECTED || peer == outgoing.ignored_peer)
+                continue;
+
+            enet_peer_send(peer, 0, packet);
+            m_packets_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // ENet takes ownership once the packet is queued on a peer.
+    if (packet->referenceCount == 0)
+        enet_packet_destroy(packet);
+}
+
+bool NetworkConnection::make_event(const ENetEvent& enet_event, Event& event)
+{
+    switch (enet_event.type)
+    {
+    case ENET_EVENT_TYPE_CONNECT:
+    {
+        if (m_is_server)
+        {
+            char address_buf[32];
+            enet_address_get_host_ip(&enet_event.peer->address, address_buf, sizeof(address_buf));
+            event.client = Client(address_buf, enet_event.peer->address.port, enet_event.peer);
+        }
+        else
+        {
+            event.client = Client("", 0, enet_event.peer);
+        }
+
+        event.type = EventType::Connect;
+        return true;
+    }
+    case ENET_EVENT_TYPE_DISCONNECT:
+        event.type = EventType::Disconnect;
+        event.client = Client("", 0, enet_event.peer);
+        return true;
+    case ENET_EVENT_TYPE_RECEIVE:
+    {
+        Result<AnyPacket> packet = decode_packet(std::span((const uint8_t *)enet_event.packet->data, enet_event.packet->dataLength));
+        enet_packet_destroy(enet_event.packet);
+        m_packets_received.fetch_add(1, std::memory_order_relaxed);
+
+        if (packet.has_error())
+        {
+            m_invalid_packets.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        event.type = EventType::Receive;
+        event.client = Client("", 0, enet_event.peer);
+        event.packet = std::move(packet.value());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "Core/SPSCQueue.hpp"
+#include "Core/Task.hpp"
 #include "Network/Packet.hpp"
 
 #include <enet/enet.h>
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>
 
 enum class ConnectionState
 {
@@ -37,16 +42,53 @@ private:
     ENetPeer *m_peer = nullptr;
 };
 
+/**
+ * ENet host serviced by a dedicated network thread.
+ *
+ * The network thread decodes received packets and serializes outgoing ones, the game thread only exchanges packet
+ * values with it through two bounded single-producer single-consumer queues. Sending, `tick` and `close` must be called
+ * from the game thread.
+ */
 class NetworkConnection
 {
 public:
     using ConnectHandler = std::function<void(void *, NetworkConnection& conn, const Client& client)>;
     using DisconnectHandler = std::function<void(void *, NetworkConnection& conn, const Client& client)>;
-    using PacketHandler = std::function<void(void *, NetworkConnection& conn, ENetPacket *packet, const Client& client)>;
+    using PacketHandler = std::function<void(void *, NetworkConnection& conn, AnyPacket& packet, const Client& client)>;
 
     static constexpr uint16_t default_port = 25566;
 
+    /**
+     * Capacity of each queue between the game thread and the network thread.
+     */
+    static constexpr size_t queue_capacity = 1024;
+
+    struct Stats
+    {
+        uint64_t packets_sent = 0;
+        uint64_t packets_received = 0;
+
+        /**
+         * Received packets that could not be decoded.
+         */
+        uint64_t invalid_packets = 0;
+
+        /**
+         * Times the game thread waited because the outgoing queue was full.
+         */
+        uint64_t send_stalls = 0;
+
+        /**
+         * Times the network thread stopped reading the socket because the incoming queue was full.
+         */
+        uint64_t receive_stalls = 0;
+
+        size_t max_outgoing_depth = 0;
+        size_t max_incoming_depth = 0;
+    };
+
     NetworkConnection();
+    ~NetworkConnection();
 
     Result<void> connect_to(std::string_view ip, uint16_t port = default_port);
     Result<void> host(uint16_t port, std::string_view ip = "0.0.0.0");
@@ -54,12 +96,30 @@ public:
     /**
      * Send a packet to a connected peer.
      */
-    void send(ENetPeer *peer, ENetPacket *packet);
+    template <typename T>
+    void send(ENetPeer *peer, T packet)
+    {
+        push_outgoing(Outgoing{peer, nullptr, false, serializer(std::move(packet))});
+    }
 
-    void send(ENetPacket *packet);
+    /**
+     * Send a packet to the server.
+     */
+    template <typename T>
+    void send(T packet)
+    {
+        send(m_peer, std::move(packet));
+    }
 
-    void broadcast(ENetPacket *packet, ENetPeer *ignored_peer = nullptr);
+    template <typename T>
+    void broadcast(T packet, ENetPeer *ignored_peer = nullptr)
+    {
+        push_outgoing(Outgoing{nullptr, ignored_peer, true, serializer(std::move(packet))});
+    }
 
+    /**
+     * Call the handlers for the events received by the network thread.
+     */
     void tick();
 
     /**
@@ -67,15 +127,6 @@ public:
      */
     void close();
 
-    template <typename T>
-    ENetPacket *create_packet(const T& p)
-    {
-        DataBuffer buffer;
-        buffer.write(T::type);
-        EXPECT(serialize(buffer, p));
-        return enet_packet_create(buffer.data().data(), buffer.data().size(), 0);
-    }
-
     void set_packet_handler(PacketHandler handler, void *user)
     {
         m_packet_handler = handler;
@@ -96,7 +147,37 @@ public:
 
     ConnectionState state() const { return m_state; }
 
+    size_t outgoing_depth() const { return m_outgoing.size(); }
+    size_t incoming_depth() const { return m_incoming.size(); }
+    Stats stats() const;
+
 private:
+    struct Outgoing
+    {
+        ENetPeer *peer = nullptr;
+        ENetPeer *ignored_peer = nullptr;
+        bool broadcast = false;
+
+        /**
+         * Writes the packet into `packet_buffer()`, run by the network thread.
+         */
+        Task serialize;
+    };
+
+    enum class EventType
+    {
+        Connect,
+        Disconnect,
+        Receive,
+    };
+
+    struct Event
+    {
+        EventType type = EventType::Receive;
+        Client client;
+        AnyPacket packet;
+    };
+
     ConnectionState m_state = ConnectionState::Idle;
     std::map<ENetPeer *, Client> m_clients;
 
@@ -115,6 +196,55 @@ private:
     DisconnectHandler m_disconnect_handler;
     void *m_disconnect_handler_user = nullptr;
 
-    void tick_client();
-    void tick_server();
+    SPSCQueue<Outgoing> m_outgoing{queue_capacity};
+    SPSCQueue<Event> m_incoming{queue_capacity};
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop = false;
+
+    std::atomic<uint64_t> m_packets_sent = 0;
+    std::atomic<uint64_t> m_packets_received = 0;
+    std::atomic<uint64_t> m_invalid_packets = 0;
+    std::atomic<uint64_t> m_send_stalls = 0;
+    std::atomic<uint64_t> m_receive_stalls = 0;
+    std::atomic<size_t> m_max_outgoing_depth = 0;
+    std::atomic<size_t> m_max_incoming_depth = 0;
+
+    /**
+     * Buffer the packets are serialized into, only used by the network thread.
+     */
+    static DataBuffer& packet_buffer();
+
+    template <typename T>
+    static Task serializer(T packet)
+    {
+        // Packets too large to be stored inline in the task, ex: chunk data, are moved to the heap.
+        if constexpr (sizeof(T) > Task::inline_size)
+        {
+            return Task([p = std::make_unique<T>(std::move(packet))]()
+                        {
+                            DataBuffer& buffer = packet_buffer();
+                            buffer.write(T::type);
+                            EXPECT(serialize(buffer, *p)); });
+        }
+        else
+        {
+            return Task([p = std::move(packet)]()
+                        {
+                            DataBuffer& buffer = packet_buffer();
+                            buffer.write(T::type);
+                            EXPECT(serialize(buffer, p)); });
+        }
+    }
+
+    void push_outgoing(Outgoing outgoing);
+    void start_thread();
+
+    void thread_worker();
+    void send_outgoing(Outgoing& outgoing);
+
+    /**
+     * Convert an ENet event, returns false if there is nothing to give to the game thread.
+     */
+    bool make_event(const ENetEvent& enet_event, Event& event);
 };
@@ -1 +1,44 @@
-#include "Network/Packet.hpp"
\ No newline at end of file
+#include "Network/Packet.hpp"
+
+template <typename T>
+static Result<AnyPacket> decode_as(DataBuffer& buffer)
+{
+    T p{};
+    TRY(deserialize(buffer, p));
+    return AnyPacket(std::move(p));
+}
+
+Result<AnyPacket> decode_packet(std::span<const uint8_t> data)
+{
+    if (data.size() < sizeof(PacketType))
+        return Error(ErrorKind::InvalidData);
+
+    DataBuffer buffer((char *)data.data(), data.size());
+    PacketType type = buffer.read<PacketType>();
+
+    switch (type)
+    {
+    case PacketType::Bonjour:
+        return decode_as<BonjourPacket>(buffer);
+    case PacketType::Refused:
+        return decode_as<RefusedPacket>(buffer);
+    case PacketType::Init:
+        return decode_as<InitPacket>(buffer);
+    case PacketType::SendPlayerTransform:
+        return decode_as<SendPlayerTransformPacket>(buffer);
+    case PacketType::AddEntity:
+        return decode_as<AddEntityPacket>(buffer);
+    case PacketType::RemoveEntity:
+        return decode_as<RemoveEntityPacket>(buffer);
+    case PacketType::UpdateEntity:
+        return decode_as<UpdateEntityPacket>(buffer);
+    case PacketType::RpcCall:
+        return decode_as<RpcCallPacket>(buffer);
+    case PacketType::RequestChunk:
+        return decode_as<RequestChunkPacket>(buffer);
+    case PacketType::ChunkData:
+        return decode_as<ChunkDataPacket>(buffer);
+    }
+
+    return Error(ErrorKind::InvalidData);
+}
@@ -2,11 +2,14 @@
 
 #include "Core/IO.hpp"
 #include "Entity/Entity.hpp"
+#include "World/ChunkCodec.hpp"
 
 #include <nlohmann/json.hpp>
 
 #include <cstdint>
 #include <cstring>
+#include <span>
+#include <variant>
 
 enum class PacketType : uint32_t
 {
@@ -106,6 +109,8 @@ public:
 
     std::span<const char> data() const { return m_data; }
 
+    void clear() { m_data.clear(); }
+
 private:
     std::vector<char> m_data;
     char *m_ro_data = nullptr;
@@ -361,6 +366,11 @@ struct ChunkDataPacket
 {
     int64_t x;
     int64_t z;
+
+    /**
+     * Codec of both `blocks` and `tags`.
+     */
+    ChunkCompression compression = ChunkCompression::Zlib;
     std::vector<uint8_t> blocks;
     std::vector<uint8_t> tags;
 
@@ -370,6 +380,7 @@ inline Result<void> serialize(DataBuffer& buffer, const ChunkDataPacket& p)
 {
     buffer.write(p.x);
     buffer.write(p.z);
+    buffer.write((uint8_t)p.compression);
 
     uint32_t size = p.blocks.size();
     buffer.write(size);
@@ -386,6 +397,7 @@ inline Result<void> deserialize(DataBuffer& buffer, ChunkDataPacket& p)
 {
     p.x = buffer.read<int64_t>();
     p.z = buffer.read<int64_t>();
+    p.compression = ChunkCompression(buffer.read<uint8_t>());
 
     uint32_t size = buffer.read<uint32_t>();
     p.blocks = buffer.read_array<uint8_t>(size);
@@ -394,3 +406,17 @@ inline Result<void> deserialize(DataBuffer& buffer, ChunkDataPacket& p)
     p.tags = buffer.read_array<uint8_t>(size);
     return Result<void>();
 }
+
+using AnyPacket = std::variant<BonjourPacket, RefusedPacket, InitPacket, SendPlayerTransformPacket, AddEntityPacket, RemoveEntityPacket, UpdateEntityPacket, RpcCallPacket, RequestChunkPacket, ChunkDataPacket>;
+
+inline PacketType packet_type(const AnyPacket& packet)
+{
+    return std::visit([](const auto& p)
+                      { return std::decay_t<decltype(p)>::type; },
+                      packet);
+}
+
+/**
+ * Deserialize a packet received from the network, including its type.
+ */
+Result<AnyPacket> decode_packet(std::span<const uint8_t> data);
@@ -0,0 +1,317 @@
+#include "World/BlockLog.hpp"
+
+#include "Core/Hash.hpp"
+#include "Core/Logger.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <string_view>
+
+// A segment is a sequence of blocks, each one a `BlockPrefix` followed by `record_count` records:
+//   uint8_t kind, uint8_t dimension, int64_t x, int32_t y, int64_t z
+//   Block:     uint16_t old state, uint16_t new state
+//   SetTag:    uint16_t name size, name, variant
+//   RemoveTag: uint16_t name size, name
+static constexpr uint32_t block_magic = 0x474f4c42; // "BLOG"
+
+struct BlockPrefix
+{
+    uint32_t magic;
+    uint32_t size;
+
+    /**
+     * FNV-1a of the records.
+     */
+    uint32_t checksum;
+    uint32_t record_count;
+};
+
+template <typename T>
+static void write_value(BufferWriter& writer, T value)
+{
+    EXPECT(writer.write_raw(&value, sizeof(T)));
+}
+
+template <typename T>
+static Result<T> read_value(Reader& reader)
+{
+    T value;
+    const size_t read = TRY(reader.read_raw(&value, sizeof(T)));
+    if (read != sizeof(T))
+        return Error(ErrorKind::InvalidData);
+    return value;
+}
+
+static Result<std::string> read_string(Reader& reader)
+{
+    const uint16_t size = TRY(read_value<uint16_t>(reader));
+    std::string str(size, '\0');
+    if (size > 0 && TRY(reader.read_raw(str.data(), size)) != size)
+        return Error(ErrorKind::InvalidData);
+    return str;
+}
+
+static Result<BlockLog::Record> read_record(Reader& reader)
+{
+    BlockLog::Record record;
+    record.kind = BlockLog::RecordKind(TRY(read_value<uint8_t>(reader)));
+    record.dimension = TRY(read_value<uint8_t>(reader));
+    record.pos.x = TRY(read_value<int64_t>(reader));
+    record.pos.y = TRY(read_value<int32_t>(reader));
+    record.pos.z = TRY(read_value<int64_t>(reader));
+
+    switch (record.kind)
+    {
+    case BlockLog::RecordKind::Block:
+        record.old_state.id.value = TRY(read_value<uint16_t>(reader));
+        record.new_state.id.value = TRY(read_value<uint16_t>(reader));
+        break;
+    case BlockLog::RecordKind::SetTag:
+    {
+        record.tag = TRY(read_string(reader));
+        std::optional<Variant> value = TRY(reader.read_variant());
+        if (!value.has_value())
+            return Error(ErrorKind::InvalidData);
+        record.value = value.value();
+    }
+    break;
+    case BlockLog::RecordKind::RemoveTag:
+        record.tag = TRY(read_string(reader));
+        break;
+    default:
+        return Error(ErrorKind::InvalidData);
+    }
+
+    return record;
+}
+
+BlockLog::BlockLog(IOService& io, std::string directory)
+    : m_io(io), m_directory(std::move(directory))
+{
+    const std::vector<uint64_t> segments = list_segments();
+    m_segment = segments.empty() ? 0 : segments.back() + 1;
+}
+
+BlockLog::~BlockLog()
+{
+    if (m_file.is_open())
+        m_file.close();
+}
+
+void BlockLog::write_header(RecordKind kind, int dimension, glm::i64vec3 pos)
+{
+    write_value(m_buffer, (uint8_t)kind);
+    write_value(m_buffer, (uint8_t)dimension);
+    write_value(m_buffer, (int64_t)pos.x);
+    write_value(m_buffer, (int32_t)pos.y);
+    write_value(m_buffer, (int64_t)pos.z);
+    m_buffered_records++;
+}
+
+void BlockLog::write_string(std::string_view str)
+{
+    const uint16_t size = (uint16_t)std::min<size_t>(str.size(), UINT16_MAX);
+    write_value(m_buffer, size);
+    EXPECT(m_buffer.write_raw(str.data(), size));
+}
+
+void BlockLog::set_block(int dimension, glm::i64vec3 pos, BlockState old_state, BlockState new_state)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write_header(RecordKind::Block, dimension, pos);
+    write_value(m_buffer, old_state.id.value);
+    write_value(m_buffer, new_state.id.value);
+}
+
+void BlockLog::set_tag(int dimension, glm::i64vec3 pos, std::string_view name, const Variant& value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write_header(RecordKind::SetTag, dimension, pos);
+    write_string(name);
+    EXPECT(m_buffer.write_variant(value));
+}
+
+void BlockLog::remove_tag(int dimension, glm::i64vec3 pos, std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write_header(RecordKind::RemoveTag, dimension, pos);
+    write_string(name);
+}
+
+void BlockLog::flush(bool sync)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_buffered_records == 0 && !(sync && m_unsynced))
+        return;
+
+    std::vector<uint8_t> block;
+    if (m_buffered_records > 0)
+    {
+        const std::span<const uint8_t> records = m_buffer.buffer();
+        const BlockPrefix prefix{
+            .magic = block_magic,
+            .size = (uint32_t)records.size(),
+            .checksum = hash_fnv32(std::string_view((const char *)records.data(), records.size())),
+            .record_count = m_buffered_records,
+        };
+
+        block.resize(sizeof(prefix) + records.size());
+        std::memcpy(block.data(), &prefix, sizeof(prefix));
+        std::memcpy(block.data() + sizeof(prefix), records.data(), records.size());
+
+        m_stats.records += m_buffered_records;
+        m_stats.bytes_written += block.size();
+        m_buffer.clear();
+        m_buffered_records = 0;
+    }
+
+    m_unsynced = !sync;
+    m_io.run([log = shared_from_this(), segment = m_segment, block = std::move(block), sync]()
+             { log->append(segment, block, sync); });
+}
+
+uint64_t BlockLog::rotate()
+{
+    flush(true);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return ++m_segment;
+}
+
+void BlockLog::truncate(uint64_t segment)
+{
+    m_io.run([log = shared_from_this(), segment]()
+             {
+                 if (log->m_file.is_open() && log->m_file_segment < segment)
+                     log->m_file.close();
+
+                 for (uint64_t old_segment : log->list_segments())
+                 {
+                     if (old_segment >= segment)
+                         break;
+
+                     std::error_code ec;
+                     std::filesystem::remove(log->segment_path(old_segment), ec);
+                 } });
+}
+
+void BlockLog::append(uint64_t segment, const std::vector<uint8_t>& block, bool sync)
+{
+    ZoneScoped;
+
+    if (!block.empty() && (!m_file.is_open() || m_file_segment != segment))
+    {
+        if (m_file.is_open())
+            m_file.close();
+
+        // Segments are only created when something is written in them.
+        EXPECT(Filesystem::make_dirs(m_directory));
+        Result<File> file = Filesystem::open_file(segment_path(segment), true);
+        if (file.has_error())
+        {
+            error("failed to open block log `{}`", segment_path(segment));
+            return;
+        }
+
+        m_file = file.value();
+        m_file_segment = segment;
+        m_file_offset = m_file.size();
+    }
+
+    if (!m_file.is_open())
+        return;
+
+    if (!block.empty())
+    {
+        Result<size_t> result = m_file.write_at(block.data(), block.size(), m_file_offset);
+        if (result.has_error())
+        {
+            error("failed to append to block log `{}`", segment_path(m_file_segment));
+            return;
+        }
+        m_file_offset += block.size();
+    }
+
+    if (sync)
+        EXPECT(m_file.sync());
+}
+
+Result<std::vector<BlockLog::Record>> BlockLog::read_all() const
+{
+    std::vector<Record> records;
+
+    for (uint64_t segment : list_segments())
+    {
+        const std::string path = segment_path(segment);
+        File file = TRY(Filesystem::open_file(path));
+
+        std::vector<uint8_t> data(file.size());
+        const size_t read = data.empty() ? 0 : TRY(file.read_at(data.data(), data.size(), 0));
+        file.close();
+        data.resize(read);
+
+        size_t offset = 0;
+        while (offset + sizeof(BlockPrefix) <= data.size())
+        {
+            BlockPrefix prefix;
+            std::memcpy(&prefix, data.data() + offset, sizeof(prefix));
+
+            const std::string_view payload((const char *)data.data() + offset + sizeof(prefix), std::min<size_t>(prefix.size, data.size() - offset - sizeof(prefix)));
+            if (prefix.magic != block_magic || payload.size() != prefix.size || hash_fnv32(payload) != prefix.checksum)
+            {
+                warn("block log `{}` is torn or corrupted after {} bytes", path, offset);
+                break;
+            }
+
+            BufferReader reader((const uint8_t *)payload.data(), payload.size());
+            for (uint32_t i = 0; i < prefix.record_count; i++)
+                records.push_back(TRY(read_record(reader)));
+
+            offset += sizeof(prefix) + prefix.size;
+        }
+    }
+
+    return records;
+}
+
+uint64_t BlockLog::segment() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segment;
+}
+
+BlockLog::Stats BlockLog::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::string BlockLog::segment_path(uint64_t segment) const
+{
+    return std::format("{}blocks.{}.log", m_directory, segment);
+}
+
+std::vector<uint64_t> BlockLog::list_segments() const
+{
+    namespace fs = std::filesystem;
+
+    std::vector<uint64_t> segments;
+
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(m_directory, ec))
+    {
+        uint64_t segment;
+        char end;
+        if (std::sscanf(entry.path().filename().string().c_str(), "blocks.%" SCNu64 ".lo%c", &segment, &end) == 2 && end == 'g')
+            segments.push_back(segment);
+    }
+
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
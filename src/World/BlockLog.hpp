@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Block/Block.hpp"
+#include "Core/Filesystem.hpp"
+#include "Core/IOService.hpp"
+#include "Core/Result.hpp"
+#include "Variant.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only log of the block and tag edits of a world, a crash loses no edit even though chunks are saved rarely.
+ *
+ * Edits are buffered and handed to the I/O thread as blocks of records, each one with a checksum. The log is split in
+ * segments: a checkpoint starts a new segment, and the older ones are deleted once every chunk modified before the
+ * checkpoint is saved. The segments left by a crash are replayed over the saved chunks on the next load.
+ */
+class BlockLog : public std::enable_shared_from_this<BlockLog>
+{
+public:
+    enum class RecordKind : uint8_t
+    {
+        Block = 0,
+        SetTag = 1,
+        RemoveTag = 2,
+    };
+
+    struct Record
+    {
+        RecordKind kind = RecordKind::Block;
+        uint8_t dimension = 0;
+        glm::i64vec3 pos;
+
+        BlockState old_state;
+        BlockState new_state;
+
+        std::string tag;
+
+        /**
+         * Only for `SetTag`.
+         */
+        Variant value;
+    };
+
+    struct Stats
+    {
+        uint64_t records = 0;
+        uint64_t bytes_written = 0;
+    };
+
+    /**
+     * Segments are stored in `directory`, new edits go to a segment after the ones already there.
+     */
+    BlockLog(IOService& io, std::string directory);
+    ~BlockLog();
+
+    BlockLog(const BlockLog&) = delete;
+    BlockLog& operator=(const BlockLog&) = delete;
+
+    /**
+     * Can be called by the threads ticking the dimensions at the same time.
+     */
+    void set_block(int dimension, glm::i64vec3 pos, BlockState old_state, BlockState new_state);
+    void set_tag(int dimension, glm::i64vec3 pos, std::string_view name, const Variant& value);
+    void remove_tag(int dimension, glm::i64vec3 pos, std::string_view name);
+
+    /**
+     * Hand the buffered edits to the I/O thread. With `sync`, they reach the disk before the I/O queued after, ex: the
+     * save of a chunk containing them.
+     */
+    void flush(bool sync);
+
+    /**
+     * Flush the edits to the current segment and start a new one. Returns the new segment.
+     */
+    uint64_t rotate();
+
+    /**
+     * Delete the segments before `segment`, after the I/O queued before.
+     */
+    void truncate(uint64_t segment);
+
+    /**
+     * Read the records of the segments left by a previous run, in order. A torn or corrupted block ends its segment,
+     * the edits after it are lost. Must be called before any edit is logged.
+     */
+    Result<std::vector<Record>> read_all() const;
+
+    uint64_t segment() const;
+    Stats stats() const;
+
+private:
+    IOService& m_io;
+    std::string m_directory;
+
+    mutable std::mutex m_mutex;
+    BufferWriter m_buffer;
+    uint32_t m_buffered_records = 0;
+    uint64_t m_segment = 0;
+
+    /**
+     * Edits handed to the I/O thread but maybe not on the disk yet.
+     */
+    bool m_unsynced = false;
+
+    Stats m_stats;
+
+    /**
+     * Only used on the I/O thread.
+     */
+    File m_file;
+    uint64_t m_file_segment = 0;
+    size_t m_file_offset = 0;
+
+    void write_header(RecordKind kind, int dimension, glm::i64vec3 pos);
+    void write_string(std::string_view str);
+
+    /**
+     * Runs on the I/O thread.
+     */
+    void append(uint64_t segment, const std::vector<uint8_t>& block, bool sync);
+
+    std::string segment_path(uint64_t segment) const;
+    std::vector<uint64_t> list_segments() const;
+};
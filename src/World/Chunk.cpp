@@ -1,19 +1,27 @@
 #include "World/Chunk.hpp"
 
 #include "Block/Block.hpp"
+#include "Core/Epoch.hpp"
 #include "Engine.hpp"
 #include "Render/Renderer.hpp"
 #include "World/Registry.hpp"
 
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 
 Chunk::Chunk(Dimension *dim, int64_t x, int64_t z)
     : m_dim(dim), m_x(x), m_z(z)
 {
-    m_blocks = new BlockState[block_count];
+    m_block_data = std::shared_ptr<BlockState[]>(new BlockState[block_count]);
+    m_blocks = m_block_data.get();
     m_biomes = new Biome[16 * 16];
     m_slices = new Slice[slice_count];
 
+    // Chunks generated without a renderer are never drawn.
+    if (Engine::get().is_headless())
+        return;
+
     m_uniform_buffer = EXPECT(Buffer::create(sizeof(FwChunkUniforms) * slice_count, WGPUBufferUsage_Uniform | WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst));
 
     for (size_t i = 0; i < slice_count; i++)
@@ -37,7 +45,6 @@ Chunk::Chunk(Dimension *dim, int64_t x, int64_t z)
 
 Chunk::~Chunk()
 {
-    delete[] m_blocks;
     delete[] m_biomes;
     delete[] m_slices;
 }
@@ -55,19 +62,21 @@ void Chunk::set_block(int64_t x, int64_t y, int64_t z, BlockState state)
     if (y < 0 || y > Chunk::height)
         return;
 
+    unshare_blocks();
     m_blocks[linearize(x, y, z)] = state;
     m_modified = true;
 
-    m_dim->queue_rebuild(ChunkPos(m_x, m_z));
+    // The player sees the block change, the mesh is more important than generation.
+    m_dim->queue_rebuild(ChunkPos(m_x, m_z), 0, Chunk::slice_count, TaskPriority::Interactive);
 
     if (x == 0)
-        m_dim->queue_rebuild(ChunkPos(m_x - 1, m_z));
+        m_dim->queue_rebuild(ChunkPos(m_x - 1, m_z), 0, Chunk::slice_count, TaskPriority::Interactive);
     else if (x == 15)
-        m_dim->queue_rebuild(ChunkPos(m_x + 1, m_z));
+        m_dim->queue_rebuild(ChunkPos(m_x + 1, m_z), 0, Chunk::slice_count, TaskPriority::Interactive);
     else if (z == 0)
-        m_dim->queue_rebuild(ChunkPos(m_x, m_z - 1));
+        m_dim->queue_rebuild(ChunkPos(m_x, m_z - 1), 0, Chunk::slice_count, TaskPriority::Interactive);
     else if (z == 15)
-        m_dim->queue_rebuild(ChunkPos(m_x, m_z + 1));
+        m_dim->queue_rebuild(ChunkPos(m_x, m_z + 1), 0, Chunk::slice_count, TaskPriority::Interactive);
 
     std::shared_ptr<Block> block = Engine::get().registry().get_block(state.id);
     if (block != nullptr && !block->is_conventional())
@@ -379,6 +388,25 @@ Result<void> Chunk::build_water_mesh(size_t slice_index, const std::map<ChunkPos
     return Result<void>();
 }
 
+void Chunk::unshare_blocks()
+{
+    if (m_block_data.use_count() == 1)
+    {
+        // Pairs with the release of the last other owner, its reads are done before the blocks are written.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return;
+    }
+
+    std::shared_ptr<BlockState[]> copy(new BlockState[block_count]);
+    std::memcpy((void *)copy.get(), m_blocks, sizeof(BlockState) * block_count);
+
+    // Mesh builders may still read the previous blocks, they are deleted once no thread is pinned.
+    Epoch::retire(new std::shared_ptr<BlockState[]>(std::move(m_block_data)));
+
+    m_block_data = std::move(copy);
+    m_blocks = m_block_data.get();
+}
+
 void Chunk::set_tag(glm::i64vec3 pos, std::string_view name, Variant v)
 {
     uint16_t key = linearize(pos.x, pos.y, pos.z);
@@ -395,7 +423,9 @@ void Chunk::remove_tag(glm::i64vec3 pos, std::string_view name)
     if (tags != m_tags.end())
     {
         BlockTags& block_tags = tags->second;
-        block_tags.tags.erase(block_tags.tags.find(name));
+        auto tag = block_tags.tags.find(name);
+        if (tag != block_tags.tags.end())
+            block_tags.tags.erase(tag);
 
         if (tags->second.tags.size() == 0)
         {
@@ -8,7 +8,9 @@
 #include "stdext.hpp"
 
 #include <cstdint>
+#include <functional>
 #include <set>
+#include <vector>
 
 class World;
 class Dimension;
@@ -30,6 +32,25 @@ struct ChunkPos
     {
         return std::tie(x, z) < std::tie(other.x, other.z);
     }
+
+    bool operator==(ChunkPos other) const
+    {
+        return x == other.x && z == other.z;
+    }
+};
+
+template <>
+struct std::hash<ChunkPos>
+{
+    size_t operator()(ChunkPos pos) const
+    {
+        // Hash tables mask the low bits, both coordinates are mixed into them.
+        uint64_t h = (uint64_t)pos.x * 0x9e3779b97f4a7c15 + (uint64_t)pos.z;
+        h ^= h >> 32;
+        h *= 0xd6e8feb86659fd93;
+        h ^= h >> 32;
+        return (size_t)h;
+    }
 };
 
 struct BlockPos
@@ -88,8 +109,18 @@ public:
     void set_block(int64_t x, int64_t y, int64_t z, BlockState state);
 
     ALWAYS_INLINE const BlockState *get_blocks() const { return m_blocks; }
+
+    /**
+     * Writing through the pointer bypasses the copy-on-write of `share_blocks`, only for chunks not shared yet.
+     */
     ALWAYS_INLINE BlockState *get_blocks() { return m_blocks; }
 
+    /**
+     * Share the blocks with another thread without copying them, ex: to save the chunk in the background. The next
+     * `set_block` copies the blocks instead of modifying the shared ones.
+     */
+    std::shared_ptr<const BlockState[]> share_blocks() const { return m_block_data; }
+
     ALWAYS_INLINE const Biome *get_biomes() const { return m_biomes; }
     ALWAYS_INLINE Biome *get_biomes() { return m_biomes; }
 
@@ -109,6 +140,13 @@ public:
     bool is_modified() const { return m_modified; }
     void clear_modified() { m_modified = false; }
 
+    /**
+     * Generated again in place of a corrupted saved chunk. It is never saved, so the original stays on the disk for
+     * the maintenance tool.
+     */
+    bool replaces_corrupted() const { return m_replaces_corrupted; }
+    void set_replaces_corrupted() { m_replaces_corrupted = true; }
+
     void set_tag(glm::i64vec3 pos, std::string_view name, Variant v);
     void remove_tag(glm::i64vec3 pos, std::string_view name);
     std::optional<Variant> get_tag(glm::i64vec3 pos, std::string_view name) const;
@@ -120,6 +158,10 @@ public:
     static ALWAYS_INLINE size_t linearize(int64_t x, int64_t y, int64_t z) { return z * width * height + y * width + x; }
 
 private:
+    /**
+     * `m_blocks` is owned by `m_block_data`, kept separately for faster accesses.
+     */
+    std::shared_ptr<BlockState[]> m_block_data;
     BlockState *m_blocks;
     Biome *m_biomes;
     Slice *m_slices;
@@ -129,10 +171,22 @@ private:
     std::map<int64_t, BlockTags> m_tags;
     std::set<BlockPos> m_non_conventional_blocks;
 
+    /**
+     * Entities section of a saved chunk, written by `EntityCodec`. Kept until the chunk is added to its dimension,
+     * where the entities are created.
+     */
+    std::vector<uint8_t> m_entity_data;
+
     std::shared_ptr<Buffer> m_uniform_buffer;
 
     int64_t m_x;
     int64_t m_z;
 
     bool m_modified : 1 = false;
+    bool m_replaces_corrupted : 1 = false;
+
+    /**
+     * Copy the blocks if they are shared.
+     */
+    void unshare_blocks();
 };
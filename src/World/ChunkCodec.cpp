@@ -0,0 +1,214 @@
+#include "World/ChunkCodec.hpp"
+#include "Core/ZLib.hpp"
+
+#include <lz4.h>
+#include <zstd.h>
+
+#include <cstring>
+#include <limits>
+
+/**
+ * Sizes stored by the codecs are little-endian 32 bits integers, like the rest of the saves.
+ */
+static void append_size(std::vector<uint8_t>& out, uint32_t size)
+{
+    const size_t offset = out.size();
+    out.resize(offset + sizeof(uint32_t));
+    std::memcpy(out.data() + offset, &size, sizeof(uint32_t));
+}
+
+static Result<uint32_t> read_size(std::span<const uint8_t> data)
+{
+    if (data.size() < sizeof(uint32_t))
+        return Error(ErrorKind::InvalidData);
+
+    uint32_t size;
+    std::memcpy(&size, data.data(), sizeof(uint32_t));
+    if (size > ChunkCodec::max_decoded_size)
+        return Error(ErrorKind::InvalidData);
+    return size;
+}
+
+const ChunkCodec *ChunkCodec::get(ChunkCompression id)
+{
+    static const RawCodec raw;
+    static const RleCodec rle;
+    static const ZlibCodec zlib;
+    static const Lz4Codec lz4;
+    static const ZstdCodec zstd;
+
+    switch (id)
+    {
+    case ChunkCompression::None:
+        return &raw;
+    case ChunkCompression::Zlib:
+        return &zlib;
+    case ChunkCompression::Rle:
+        return &rle;
+    case ChunkCompression::Lz4:
+        return &lz4;
+    case ChunkCompression::Zstd:
+        return &zstd;
+    }
+
+    return nullptr;
+}
+
+Result<void> RawCodec::encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const
+{
+    encoded.insert(encoded.end(), data.begin(), data.end());
+    return Result<void>();
+}
+
+Result<void> RawCodec::decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const
+{
+    if (data.size() > max_decoded_size)
+        return Error(ErrorKind::InvalidData);
+
+    decoded.insert(decoded.end(), data.begin(), data.end());
+    return Result<void>();
+}
+
+// Layout: decoded size, then runs of `{uint16_t count, uint16_t word}`. An odd last byte is stored as is after the runs.
+Result<void> RleCodec::encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const
+{
+    if (data.size() > max_decoded_size)
+        return Error(ErrorKind::InvalidData);
+
+    append_size(encoded, (uint32_t)data.size());
+
+    const size_t words = data.size() / sizeof(uint16_t);
+    size_t i = 0;
+    while (i < words)
+    {
+        uint16_t word;
+        std::memcpy(&word, data.data() + i * sizeof(uint16_t), sizeof(uint16_t));
+
+        uint16_t count = 1;
+        while (i + count < words && count < std::numeric_limits<uint16_t>::max() && std::memcmp(data.data() + (i + count) * sizeof(uint16_t), &word, sizeof(uint16_t)) == 0)
+            count++;
+
+        const uint16_t run[2] = {count, word};
+        const uint8_t *bytes = (const uint8_t *)run;
+        encoded.insert(encoded.end(), bytes, bytes + sizeof(run));
+        i += count;
+    }
+
+    if (data.size() % sizeof(uint16_t) != 0)
+        encoded.push_back(data.back());
+
+    return Result<void>();
+}
+
+Result<void> RleCodec::decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const
+{
+    const uint32_t size = TRY(read_size(data));
+    data = data.subspan(sizeof(uint32_t));
+
+    const size_t offset = decoded.size();
+    decoded.resize(offset + size);
+    uint8_t *out = decoded.data() + offset;
+
+    const size_t words = size / sizeof(uint16_t);
+    size_t i = 0;
+    while (i < words)
+    {
+        uint16_t run[2];
+        if (data.size() < sizeof(run))
+            return Error(ErrorKind::InvalidData);
+        std::memcpy(run, data.data(), sizeof(run));
+        data = data.subspan(sizeof(run));
+
+        if (run[0] == 0 || i + run[0] > words)
+            return Error(ErrorKind::InvalidData);
+
+        for (size_t j = 0; j < run[0]; j++)
+            std::memcpy(out + (i + j) * sizeof(uint16_t), &run[1], sizeof(uint16_t));
+        i += run[0];
+    }
+
+    if (size % sizeof(uint16_t) != 0)
+    {
+        if (data.empty())
+            return Error(ErrorKind::InvalidData);
+        out[size - 1] = data[0];
+        data = data.subspan(1);
+    }
+
+    if (!data.empty())
+        return Error(ErrorKind::InvalidData);
+    return Result<void>();
+}
+
+Result<void> ZlibCodec::encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const
+{
+    return ZLib::deflate(std::as_bytes(data), encoded, m_level);
+}
+
+Result<void> ZlibCodec::decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const
+{
+    // The zlib format does not store the decoded size, the free capacity of `decoded` is used first.
+    return ZLib::inflate(std::as_bytes(data), decoded, 0, max_decoded_size);
+}
+
+// Layout: decoded size, then an LZ4 block. The block format does not store the size, the decoder needs it.
+Result<void> Lz4Codec::encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const
+{
+    if (data.size() > max_decoded_size)
+        return Error(ErrorKind::InvalidData);
+
+    append_size(encoded, (uint32_t)data.size());
+
+    const size_t offset = encoded.size();
+    encoded.resize(offset + (size_t)LZ4_compressBound((int)data.size()));
+
+    const int size = LZ4_compress_default((const char *)data.data(), (char *)encoded.data() + offset, (int)data.size(), int(encoded.size() - offset));
+    if (size <= 0)
+        return Error(ErrorKind::Unknown);
+
+    encoded.resize(offset + (size_t)size);
+    return Result<void>();
+}
+
+Result<void> Lz4Codec::decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const
+{
+    const uint32_t size = TRY(read_size(data));
+    data = data.subspan(sizeof(uint32_t));
+
+    const size_t offset = decoded.size();
+    decoded.resize(offset + size);
+
+    const int r = LZ4_decompress_safe((const char *)data.data(), (char *)decoded.data() + offset, (int)data.size(), (int)size);
+    if (r != (int)size)
+        return Error(ErrorKind::InvalidData);
+    return Result<void>();
+}
+
+// A zstd frame stores the decoded size itself.
+Result<void> ZstdCodec::encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const
+{
+    const size_t offset = encoded.size();
+    encoded.resize(offset + ZSTD_compressBound(data.size()));
+
+    const size_t size = ZSTD_compress(encoded.data() + offset, encoded.size() - offset, data.data(), data.size(), m_level);
+    if (ZSTD_isError(size))
+        return Error(ErrorKind::Unknown);
+
+    encoded.resize(offset + size);
+    return Result<void>();
+}
+
+Result<void> ZstdCodec::decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const
+{
+    const unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size > max_decoded_size)
+        return Error(ErrorKind::InvalidData);
+
+    const size_t offset = decoded.size();
+    decoded.resize(offset + (size_t)size);
+
+    const size_t r = ZSTD_decompress(decoded.data() + offset, (size_t)size, data.data(), data.size());
+    if (ZSTD_isError(r) || r != size)
+        return Error(ErrorKind::InvalidData);
+    return Result<void>();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Core/Result.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Identifier of a codec, stored next to the encoded data. Values must never change, older saves and packets use them.
+ */
+enum class ChunkCompression : uint8_t
+{
+    None = 0,
+    Zlib = 1,
+    Rle = 2,
+    Lz4 = 3,
+    Zstd = 4,
+};
+
+/**
+ * Compression of the saved or sent data of a chunk: its blocks followed by its tags.
+ */
+class ChunkCodec
+{
+public:
+    /**
+     * Largest decoded data accepted, protects against corrupted or malicious sizes.
+     */
+    static constexpr size_t max_decoded_size = 16 * 1024 * 1024;
+
+    virtual ~ChunkCodec() = default;
+
+    virtual ChunkCompression id() const = 0;
+    virtual const char *name() const = 0;
+
+    /**
+     * Append the encoded `data` to `encoded`.
+     */
+    virtual Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const = 0;
+
+    /**
+     * Append the decoded `data` to `decoded`.
+     */
+    virtual Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const = 0;
+
+    /**
+     * Codec of `id` with its default settings, `nullptr` if `id` is unknown.
+     */
+    static const ChunkCodec *get(ChunkCompression id);
+};
+
+/**
+ * Chunks saved on the disk, the ratio matters more than the speed.
+ */
+static constexpr ChunkCompression save_compression = ChunkCompression::Zstd;
+
+/**
+ * Chunks sent over the network, the server encodes every chunk a client loads.
+ */
+static constexpr ChunkCompression network_compression = ChunkCompression::Lz4;
+
+class RawCodec : public ChunkCodec
+{
+public:
+    ChunkCompression id() const override { return ChunkCompression::None; }
+    const char *name() const override { return "raw"; }
+
+    Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const override;
+    Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const override;
+};
+
+/**
+ * Run-length encoding of 16 bits words, the size of a `BlockState`. Fast on the long runs of air, stone and water of
+ * generated chunks but bad on anything else.
+ */
+class RleCodec : public ChunkCodec
+{
+public:
+    ChunkCompression id() const override { return ChunkCompression::Rle; }
+    const char *name() const override { return "rle"; }
+
+    Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const override;
+    Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const override;
+};
+
+class ZlibCodec : public ChunkCodec
+{
+public:
+    /**
+     * `level` goes from 1 (fastest) to 9 (smallest).
+     */
+    ZlibCodec(int level = 6)
+        : m_level(level)
+    {
+    }
+
+    ChunkCompression id() const override { return ChunkCompression::Zlib; }
+    const char *name() const override { return "zlib"; }
+
+    Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const override;
+    Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const override;
+
+private:
+    int m_level;
+};
+
+class Lz4Codec : public ChunkCodec
+{
+public:
+    ChunkCompression id() const override { return ChunkCompression::Lz4; }
+    const char *name() const override { return "lz4"; }
+
+    Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const override;
+    Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const override;
+};
+
+class ZstdCodec : public ChunkCodec
+{
+public:
+    /**
+     * `level` goes from 1 (fastest) to 19 (smallest), negative levels trade more ratio for speed.
+     */
+    ZstdCodec(int level = 3)
+        : m_level(level)
+    {
+    }
+
+    ChunkCompression id() const override { return ChunkCompression::Zstd; }
+    const char *name() const override { return "zstd"; }
+
+    Result<void> encode(std::span<const uint8_t> data, std::vector<uint8_t>& encoded) const override;
+    Result<void> decode(std::span<const uint8_t> data, std::vector<uint8_t>& decoded) const override;
+
+private:
+    int m_level;
+};
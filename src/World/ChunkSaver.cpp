@@ -0,0 +1,165 @@
+#include "World/ChunkSaver.hpp"
+#include "Engine.hpp"
+#include "Profiler.hpp"
+#include "World/Dimension.hpp"
+
+ChunkSaver::ChunkSaver()
+{
+}
+
+ChunkSaver::~ChunkSaver()
+{
+    for (auto& [pos, entry] : m_entries)
+        entry.task.wait();
+}
+
+void ChunkSaver::mark_dirty(const std::shared_ptr<Chunk>& chunk)
+{
+    if (chunk->replaces_corrupted())
+        return;
+
+    Entry& entry = m_entries[chunk->pos()];
+    entry.chunk = chunk;
+    if (!entry.dirty)
+        m_dirty_count++;
+    entry.dirty = true;
+}
+
+void ChunkSaver::update()
+{
+    ZoneScoped;
+
+    const Clock::time_point now = Clock::now();
+    if (now - m_rate_start >= std::chrono::seconds(1))
+    {
+        const uint64_t bytes = m_bytes_written.load(std::memory_order_relaxed);
+        const std::chrono::duration<double> elapsed = now - m_rate_start;
+        m_bytes_per_second = uint64_t(double(bytes - m_rate_bytes) / elapsed.count());
+        m_rate_bytes = bytes;
+        m_rate_start = now;
+    }
+
+    for (auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        Entry& entry = iter->second;
+        const bool interval_over = now - entry.last_save >= m_interval;
+
+        if (entry.dirty && interval_over)
+            save(entry, now);
+        else if (!entry.dirty && interval_over && entry.task.is_done())
+        {
+            iter = m_entries.erase(iter);
+            continue;
+        }
+
+        ++iter;
+    }
+}
+
+void ChunkSaver::save_now(ChunkPos pos)
+{
+    auto iter = m_entries.find(pos);
+    if (iter != m_entries.end() && iter->second.dirty)
+        save(iter->second, Clock::now());
+}
+
+std::vector<TaskHandle<void>> ChunkSaver::save_all()
+{
+    const Clock::time_point now = Clock::now();
+    std::vector<TaskHandle<void>> tasks;
+    for (auto& [pos, entry] : m_entries)
+    {
+        if (entry.dirty)
+            save(entry, now);
+        if (!entry.task.is_done())
+            tasks.push_back(entry.task);
+    }
+    return tasks;
+}
+
+void ChunkSaver::flush()
+{
+    ZoneScoped;
+
+    for (const TaskHandle<void>& task : save_all())
+        task.wait();
+}
+
+std::shared_ptr<const ChunkSnapshot> ChunkSaver::find_unsaved(ChunkPos pos) const
+{
+    std::lock_guard<std::mutex> lock(m_unsaved_mutex);
+
+    auto iter = m_unsaved.find(pos);
+    return iter != m_unsaved.end() ? iter->second : nullptr;
+}
+
+ChunkSaver::Stats ChunkSaver::stats() const
+{
+    return Stats{
+        .dirty = m_dirty_count,
+        .in_flight = m_in_flight.load(std::memory_order_relaxed),
+        .saves = m_saves.load(std::memory_order_relaxed),
+        .bytes_written = m_bytes_written.load(std::memory_order_relaxed),
+        .bytes_per_second = m_bytes_per_second,
+    };
+}
+
+void ChunkSaver::save(Entry& entry, Clock::time_point now)
+{
+    entry.dirty = false;
+    entry.last_save = now;
+    m_dirty_count--;
+
+    if (m_store == nullptr)
+        return;
+
+    if (m_before_save)
+        m_before_save();
+
+    // Only the snapshot is taken here, the chunk can be modified again as soon as it returns. The chunk itself is not
+    // needed anymore until its next modification, it may be unloaded.
+    ChunkSnapshot chunk_snapshot = Dimension::snapshot_chunk(entry.chunk);
+    entry.chunk = nullptr;
+
+    // A chunk whose saved entities were not created yet keeps them.
+    if (m_snapshot_entities && chunk_snapshot.entities.empty())
+        chunk_snapshot.entities = m_snapshot_entities(chunk_snapshot.pos);
+
+    std::shared_ptr<const ChunkSnapshot> snapshot = std::make_shared<ChunkSnapshot>(std::move(chunk_snapshot));
+
+    {
+        std::lock_guard<std::mutex> lock(m_unsaved_mutex);
+        m_unsaved[snapshot->pos] = snapshot;
+    }
+    m_in_flight.fetch_add(1, std::memory_order_relaxed);
+
+    auto job = [this, store = m_store, snapshot]()
+    {
+        Result<RegionChunk> saved = Dimension::encode_chunk(*snapshot);
+        if (saved.has_value())
+        {
+            m_saves.fetch_add(1, std::memory_order_relaxed);
+            m_bytes_written.fetch_add(saved.value().data.size(), std::memory_order_relaxed);
+            store->write(snapshot->pos, std::move(saved.value()));
+        }
+        else
+        {
+            error("failed to compress chunk {} {}", snapshot->pos.x, snapshot->pos.z);
+        }
+
+        {
+            // A newer snapshot may have replaced this one.
+            std::lock_guard<std::mutex> lock(m_unsaved_mutex);
+            auto iter = m_unsaved.find(snapshot->pos);
+            if (iter != m_unsaved.end() && iter->second == snapshot)
+                m_unsaved.erase(iter);
+        }
+
+        m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+    };
+
+    if (entry.task.is_done())
+        entry.task = Engine::get().get_thread_pool().async(std::move(job), TaskPriority::IO);
+    else
+        entry.task = entry.task.then(std::move(job));
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Core/ThreadPool.hpp"
+#include "World/Chunk.hpp"
+#include "World/Region.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Content of a chunk at some point, readable from any thread while the chunk keeps changing.
+ */
+struct ChunkSnapshot
+{
+    ChunkPos pos;
+
+    /**
+     * Shared copy-on-write with the chunk.
+     */
+    std::shared_ptr<const BlockState[]> blocks;
+
+    /**
+     * Tags serialized by `Dimension::write_tags`.
+     */
+    std::vector<uint8_t> tags;
+
+    /**
+     * Entities serialized by `EntityCodec`, empty if the chunk has none.
+     */
+    std::vector<uint8_t> entities;
+};
+
+/**
+ * Saves the modified chunks of a dimension in the background, each chunk at most once per interval.
+ *
+ * Only the thread ticking the dimension calls it. Saving a chunk takes a snapshot on that thread, the compression runs
+ * on the thread pool and the write on the I/O thread.
+ */
+class ChunkSaver
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds default_interval{5000};
+
+    struct Stats
+    {
+        /**
+         * Chunks waiting for the end of their interval.
+         */
+        size_t dirty = 0;
+
+        /**
+         * Snapshots being compressed.
+         */
+        size_t in_flight = 0;
+
+        uint64_t saves = 0;
+        uint64_t bytes_written = 0;
+
+        /**
+         * Compressed bytes handed to the store during the last second.
+         */
+        uint64_t bytes_per_second = 0;
+    };
+
+    ChunkSaver();
+
+    /**
+     * Wait for the snapshots being compressed, the dirty chunks must have been flushed before.
+     */
+    ~ChunkSaver();
+
+    ChunkSaver(const ChunkSaver&) = delete;
+    ChunkSaver& operator=(const ChunkSaver&) = delete;
+
+    /**
+     * Nothing is saved without a store.
+     */
+    void set_store(std::shared_ptr<RegionStore> store) { m_store = std::move(store); }
+
+    void set_interval(std::chrono::milliseconds interval) { m_interval = interval; }
+
+    /**
+     * Called before a chunk is snapshotted, ex: to make the logged edits it contains durable before it is written.
+     */
+    void set_before_save(std::function<void()> callback) { m_before_save = std::move(callback); }
+
+    /**
+     * Called when a chunk is snapshotted to serialize the entities in it, on the same thread.
+     */
+    void set_snapshot_entities(std::function<std::vector<uint8_t>(ChunkPos)> callback) { m_snapshot_entities = std::move(callback); }
+
+    void mark_dirty(const std::shared_ptr<Chunk>& chunk);
+
+    /**
+     * Save the dirty chunks whose interval is over, and forget the chunks that stayed clean for a whole interval.
+     */
+    void update();
+
+    /**
+     * Save a chunk now if it is dirty, ex: before unloading it.
+     */
+    void save_now(ChunkPos pos);
+
+    /**
+     * Save every dirty chunk now, whatever their interval. Returns the saves in progress, once they are all done the
+     * data of every chunk modified before is handed to the I/O thread.
+     */
+    std::vector<TaskHandle<void>> save_all();
+
+    /**
+     * Save every dirty chunk and wait until their data is handed to the I/O thread.
+     */
+    void flush();
+
+    /**
+     * Latest snapshot of a chunk that is not in the store yet, `nullptr` if there is none. Can be called from any
+     * thread, a chunk loaded again while its save is being compressed is read from here.
+     */
+    std::shared_ptr<const ChunkSnapshot> find_unsaved(ChunkPos pos) const;
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<Chunk> chunk;
+        bool dirty = false;
+        Clock::time_point last_save;
+
+        /**
+         * Last save of the chunk, the next one starts after it so an older snapshot is never written last.
+         */
+        TaskHandle<void> task;
+    };
+
+    std::shared_ptr<RegionStore> m_store;
+    std::chrono::milliseconds m_interval = default_interval;
+    std::function<void()> m_before_save;
+    std::function<std::vector<uint8_t>(ChunkPos)> m_snapshot_entities;
+
+    /**
+     * Chunks modified or saved less than an interval ago.
+     */
+    std::map<ChunkPos, Entry> m_entries;
+    size_t m_dirty_count = 0;
+
+    mutable std::mutex m_unsaved_mutex;
+    std::map<ChunkPos, std::shared_ptr<const ChunkSnapshot>> m_unsaved;
+
+    std::atomic<size_t> m_in_flight = 0;
+    std::atomic<uint64_t> m_saves = 0;
+    std::atomic<uint64_t> m_bytes_written = 0;
+
+    Clock::time_point m_rate_start = Clock::now();
+    uint64_t m_rate_bytes = 0;
+    uint64_t m_bytes_per_second = 0;
+
+    void save(Entry& entry, Clock::time_point now);
+};
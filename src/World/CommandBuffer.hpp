@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Core/Task.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/**
+ * Side effects recorded by entities ticked in parallel: block edits, spawns, despawns, damage, RPCs...
+ *
+ * Each batch of entities records into its own buffer. The buffers are applied by the thread ticking the dimension, in
+ * the order of the batches, so the result does not depend on which thread ticked which batch.
+ */
+class CommandBuffer
+{
+public:
+    void push(Task command) { m_commands.push_back(std::move(command)); }
+
+    void apply()
+    {
+        for (Task& command : m_commands)
+            command();
+        m_commands.clear();
+    }
+
+    /**
+     * Apply the buffers returned by `tick_in_batches`, in the order of the batches.
+     */
+    static void apply_all(std::vector<CommandBuffer>& buffers)
+    {
+        for (CommandBuffer& buffer : buffers)
+            buffer.apply();
+    }
+
+    size_t size() const { return m_commands.size(); }
+
+private:
+    std::vector<Task> m_commands;
+};
+
+/**
+ * Call `tick_batch(begin, end, commands)` for every batch of `batch_size` items out of `count`. The calling thread ticks
+ * batches too, helped by the workers of `pool` if it is not null. Helpers that did not start before the calling thread
+ * ran out of batches are cancelled, so a busy pool never delays the tick.
+ *
+ * Returns one buffer per batch, applying them with `CommandBuffer::apply_all` gives the same result as ticking every
+ * item on one thread.
+ */
+template <typename F>
+std::vector<CommandBuffer> tick_in_batches(size_t count, size_t batch_size, ThreadPool *pool, F&& tick_batch)
+{
+    const size_t batch_count = (count + batch_size - 1) / batch_size;
+    std::vector<CommandBuffer> commands(batch_count);
+    std::atomic<size_t> next_batch = 0;
+
+    const auto tick_batches = [&]()
+    {
+        ZoneScopedN("tick_batches");
+
+        size_t batch;
+        while ((batch = next_batch.fetch_add(1)) < batch_count)
+            tick_batch(batch * batch_size, std::min(count, (batch + 1) * batch_size), commands[batch]);
+    };
+
+    std::vector<TaskHandle<void>> helpers;
+    if (pool != nullptr)
+    {
+        for (size_t i = 1; i < std::min(batch_count, pool->thread_count() + 1); i++)
+            helpers.push_back(pool->async([&tick_batches]()
+                                          { tick_batches(); },
+                                          TaskPriority::Interactive));
+    }
+
+    tick_batches();
+
+    for (TaskHandle<void>& helper : helpers)
+    {
+        if (!helper.cancel())
+            helper.wait();
+    }
+
+    return commands;
+}
@@ -0,0 +1,827 @@
+#include "World/Density.hpp"
+
+#include "Core/Hash.hpp"
+#include "Core/Logger.hpp"
+#include "Profiler.hpp"
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <set>
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t d = a / b;
+    if (a % b != 0 && (a < 0) != (b < 0))
+        d--;
+    return d;
+}
+
+static tk::spline make_spline(const DensityNode& node)
+{
+    return tk::spline(node.spline_x, node.spline_y, node.spline_linear ? tk::spline::linear : tk::spline::cspline);
+}
+
+namespace
+{
+
+struct GraphParser
+{
+    DensityGraph& graph;
+    YAML::Node declarations;
+
+    /**
+     * Named nodes being parsed, to detect cycles.
+     */
+    std::set<std::string> parsing{};
+
+    uint32_t push(DensityNode node)
+    {
+        graph.nodes.push_back(std::move(node));
+        return uint32_t(graph.nodes.size() - 1);
+    }
+
+    Result<uint32_t> parse_named(const std::string& name)
+    {
+        auto iter = graph.names.find(name);
+        if (iter != graph.names.end())
+            return iter->second;
+
+        if (name == "x" || name == "y" || name == "z")
+        {
+            const DensityOp op = name == "x" ? DensityOp::X : (name == "y" ? DensityOp::Y : DensityOp::Z);
+            const uint32_t index = push(DensityNode{.op = op});
+            graph.names[name] = index;
+            return index;
+        }
+
+        const YAML::Node declaration = declarations[name];
+        if (!declaration)
+        {
+            error("density graph: unknown node `{}`", name);
+            return Error(ErrorKind::InvalidData);
+        }
+
+        if (parsing.contains(name))
+        {
+            error("density graph: node `{}` depends on itself", name);
+            return Error(ErrorKind::InvalidData);
+        }
+
+        parsing.insert(name);
+        const uint32_t index = TRY(parse_input(declaration));
+        parsing.erase(name);
+
+        graph.names[name] = index;
+        return index;
+    }
+
+    Result<uint32_t> parse_input(const YAML::Node& node)
+    {
+        if (node.IsMap())
+            return parse_node(node);
+
+        if (!node.IsScalar())
+        {
+            error("density graph: expected a number, a name or a node");
+            return Error(ErrorKind::InvalidData);
+        }
+
+        float value;
+        if (YAML::convert<float>::decode(node, value))
+            return push(DensityNode{.op = DensityOp::Constant, .value = value});
+
+        return parse_named(node.as<std::string>());
+    }
+
+    Result<uint32_t> parse_node(const YAML::Node& node)
+    {
+        const std::string type = node["type"].as<std::string>("");
+        DensityNode result;
+
+        if (type == "constant")
+        {
+            result.op = DensityOp::Constant;
+            result.value = node["value"].as<float>();
+        }
+        else if (type == "noise")
+        {
+            result.op = DensityOp::Noise;
+            result.noise.scale = node["scale"].as<float>(1.0f);
+            result.noise.octaves = node["octaves"].as<int32_t>(1);
+            result.noise.lacunarity = node["lacunarity"].as<float>(2.0f);
+            result.noise.persistence = node["persistence"].as<float>(0.5f);
+            result.noise.seed = node["seed"].as<uint64_t>(0);
+            result.noise.is_3d = node["3d"].as<bool>(false);
+
+            if (result.noise.scale <= 0.0f || result.noise.octaves < 1)
+            {
+                error("density graph: noise scale and octaves must be positive");
+                return Error(ErrorKind::InvalidData);
+            }
+        }
+        else if (type == "spline")
+        {
+            result.op = DensityOp::Spline;
+            result.inputs.push_back(TRY(parse_input(node["input"])));
+            result.spline_linear = node["interpolation"].as<std::string>("cubic") == "linear";
+
+            for (const YAML::Node& point : node["points"])
+            {
+                result.spline_x.push_back(point[0].as<double>());
+                result.spline_y.push_back(point[1].as<double>());
+            }
+
+            if (result.spline_x.size() < 3 || !std::is_sorted(result.spline_x.begin(), result.spline_x.end(), std::less_equal<double>()))
+            {
+                error("density graph: splines need at least 3 points with increasing x");
+                return Error(ErrorKind::InvalidData);
+            }
+        }
+        else if (type == "add" || type == "mul" || type == "min" || type == "max")
+        {
+            if (type == "add")
+                result.op = DensityOp::Add;
+            else if (type == "mul")
+                result.op = DensityOp::Mul;
+            else
+                result.op = type == "min" ? DensityOp::Min : DensityOp::Max;
+
+            for (const YAML::Node& arg : node["args"])
+                result.inputs.push_back(TRY(parse_input(arg)));
+
+            if (result.inputs.empty())
+            {
+                error("density graph: `{}` needs at least one argument", type);
+                return Error(ErrorKind::InvalidData);
+            }
+        }
+        else if (type == "clamp")
+        {
+            result.op = DensityOp::Clamp;
+            result.inputs.push_back(TRY(parse_input(node["input"])));
+            result.min = node["min"].as<float>();
+            result.max = node["max"].as<float>();
+
+            if (result.min > result.max)
+            {
+                error("density graph: clamp min is greater than max");
+                return Error(ErrorKind::InvalidData);
+            }
+        }
+        else if (type == "cache2d")
+        {
+            result.op = DensityOp::Cache2D;
+            result.inputs.push_back(TRY(parse_input(node["input"])));
+        }
+        else if (type == "interpolate")
+        {
+            result.op = DensityOp::Interpolate;
+            result.inputs.push_back(TRY(parse_input(node["input"])));
+            result.cell_width = node["width"].as<int32_t>(1);
+            result.cell_height = node["height"].as<int32_t>(1);
+
+            if (result.cell_width < 1 || result.cell_height < 1 || 16 % result.cell_width != 0)
+            {
+                error("density graph: interpolate width must divide 16 and height must be positive");
+                return Error(ErrorKind::InvalidData);
+            }
+        }
+        else
+        {
+            error("density graph: unknown node type `{}`", type);
+            return Error(ErrorKind::InvalidData);
+        }
+
+        return push(std::move(result));
+    }
+};
+
+} // namespace
+
+static Result<std::shared_ptr<DensityGraph>> parse_graph(const YAML::Node& root)
+{
+    std::shared_ptr<DensityGraph> graph = std::make_shared<DensityGraph>();
+    GraphParser parser{.graph = *graph, .declarations = root["nodes"]};
+
+    if (!parser.declarations.IsMap())
+    {
+        error("density graph: missing `nodes`");
+        return Error(ErrorKind::InvalidData);
+    }
+
+    // Inputs are always parsed before the node using them, so nodes only refer to nodes with a lower index.
+    for (const auto& declaration : parser.declarations)
+        TRY(parser.parse_named(declaration.first.as<std::string>()));
+
+    return graph;
+}
+
+Result<std::shared_ptr<DensityGraph>> DensityGraph::load(std::string_view path)
+{
+    try
+    {
+        return parse_graph(YAML::LoadFile(std::string(path)));
+    }
+    catch (const YAML::Exception& ex)
+    {
+        error("density graph `{}`: {}", path, ex.what());
+        return Error(ErrorKind::InvalidData);
+    }
+}
+
+Result<std::shared_ptr<DensityGraph>> DensityGraph::parse(std::string_view source)
+{
+    try
+    {
+        return parse_graph(YAML::Load(std::string(source)));
+    }
+    catch (const YAML::Exception& ex)
+    {
+        error("density graph: {}", ex.what());
+        return Error(ErrorKind::InvalidData);
+    }
+}
+
+namespace
+{
+
+struct Compiler
+{
+    std::vector<DensityNode>& nodes;
+    std::vector<bool>& is_2d;
+    std::map<DensityNode, uint32_t> instructions{};
+
+    bool is_constant(uint32_t index) const { return nodes[index].op == DensityOp::Constant; }
+
+    uint32_t constant(float value)
+    {
+        return emit(DensityNode{.op = DensityOp::Constant, .value = value});
+    }
+
+    /**
+     * Add an instruction, or returns an identical instruction already emitted.
+     */
+    uint32_t emit(DensityNode node)
+    {
+        auto iter = instructions.find(node);
+        if (iter != instructions.end())
+            return iter->second;
+
+        bool flat;
+        switch (node.op)
+        {
+        case DensityOp::Y:
+            flat = false;
+            break;
+        case DensityOp::Noise:
+            flat = !node.noise.is_3d;
+            break;
+        case DensityOp::Cache2D:
+            flat = true;
+            break;
+        default:
+            flat = std::all_of(node.inputs.begin(), node.inputs.end(), [this](uint32_t i)
+                               { return is_2d[i]; });
+            break;
+        }
+
+        nodes.push_back(node);
+        is_2d.push_back(flat);
+
+        const uint32_t index = uint32_t(nodes.size() - 1);
+        instructions[std::move(node)] = index;
+        return index;
+    }
+
+    /**
+     * Fold constants and remove operations that do nothing, `node.inputs` must be compiled instructions.
+     */
+    uint32_t simplify(DensityNode node)
+    {
+        switch (node.op)
+        {
+        case DensityOp::Add:
+        case DensityOp::Mul:
+        {
+            const bool is_add = node.op == DensityOp::Add;
+            float folded = is_add ? 0.0f : 1.0f;
+            std::vector<uint32_t> inputs;
+
+            for (uint32_t input : node.inputs)
+            {
+                if (!is_constant(input))
+                    inputs.push_back(input);
+                else if (is_add)
+                    folded += nodes[input].value;
+                else
+                    folded *= nodes[input].value;
+            }
+
+            if (inputs.empty() || (!is_add && folded == 0.0f))
+                return constant(folded);
+            if (folded != (is_add ? 0.0f : 1.0f))
+                inputs.push_back(constant(folded));
+            if (inputs.size() == 1)
+                return inputs[0];
+
+            // Both operations are commutative, sorting inputs lets `emit` merge `a + b` and `b + a`.
+            std::sort(inputs.begin(), inputs.end());
+            node.inputs = std::move(inputs);
+        }
+        break;
+        case DensityOp::Min:
+        case DensityOp::Max:
+        {
+            const bool is_min = node.op == DensityOp::Min;
+            std::optional<float> folded;
+            std::vector<uint32_t> inputs;
+
+            for (uint32_t input : node.inputs)
+            {
+                if (!is_constant(input))
+                    inputs.push_back(input);
+                else if (!folded.has_value())
+                    folded = nodes[input].value;
+                else
+                    folded = is_min ? std::min(*folded, nodes[input].value) : std::max(*folded, nodes[input].value);
+            }
+
+            if (inputs.empty())
+                return constant(*folded);
+            if (folded.has_value())
+                inputs.push_back(constant(*folded));
+
+            // Duplicated inputs do not change the result.
+            std::sort(inputs.begin(), inputs.end());
+            inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+            if (inputs.size() == 1)
+                return inputs[0];
+
+            node.inputs = std::move(inputs);
+        }
+        break;
+        case DensityOp::Clamp:
+            if (is_constant(node.inputs[0]))
+                return constant(std::clamp(nodes[node.inputs[0]].value, node.min, node.max));
+            break;
+        case DensityOp::Spline:
+            if (is_constant(node.inputs[0]))
+                return constant(float(make_spline(node)(nodes[node.inputs[0]].value)));
+            break;
+        case DensityOp::Cache2D:
+            if (is_2d[node.inputs[0]])
+                return node.inputs[0];
+            break;
+        case DensityOp::Interpolate:
+            if (is_constant(node.inputs[0]) || (node.cell_width == 1 && (node.cell_height == 1 || is_2d[node.inputs[0]])))
+                return node.inputs[0];
+            break;
+        default:
+            break;
+        }
+
+        return emit(std::move(node));
+    }
+};
+
+} // namespace
+
+Result<std::shared_ptr<DensityProgram>> DensityProgram::compile(const DensityGraph& graph, uint64_t seed, std::span<const std::string_view> outputs)
+{
+    ZoneScoped;
+
+    std::shared_ptr<DensityProgram> program = std::make_shared<DensityProgram>();
+
+    std::vector<uint32_t> output_nodes;
+    for (std::string_view name : outputs)
+    {
+        auto iter = graph.names.find(name);
+        if (iter == graph.names.end())
+        {
+            error("density graph: missing output `{}`", name);
+            return Error(ErrorKind::InvalidData);
+        }
+        output_nodes.push_back(iter->second);
+    }
+
+    // Only compile nodes used by the outputs. Inputs have a lower index than the node using them.
+    std::vector<bool> used(graph.nodes.size(), false);
+    for (uint32_t index : output_nodes)
+        used[index] = true;
+    for (size_t i = graph.nodes.size(); i-- > 0;)
+        if (used[i])
+            for (uint32_t input : graph.nodes[i].inputs)
+                used[input] = true;
+
+    std::vector<DensityNode> nodes;
+    std::vector<bool> is_2d;
+    Compiler compiler{.nodes = nodes, .is_2d = is_2d};
+
+    std::vector<uint32_t> compiled(graph.nodes.size(), 0);
+    for (size_t i = 0; i < graph.nodes.size(); i++)
+    {
+        if (!used[i])
+            continue;
+
+        DensityNode node = graph.nodes[i];
+        for (uint32_t& input : node.inputs)
+            input = compiled[input];
+        compiled[i] = compiler.simplify(std::move(node));
+    }
+
+    std::map<uint64_t, uint32_t> noises;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        Instruction instruction{.node = nodes[i], .is_2d = is_2d[i]};
+
+        if (instruction.node.op == DensityOp::Noise)
+        {
+            auto [iter, inserted] = noises.try_emplace(instruction.node.noise.seed, uint32_t(program->m_noises.size()));
+            if (inserted)
+                program->m_noises.push_back(SimplexNoise(seed + instruction.node.noise.seed));
+            instruction.noise_index = iter->second;
+        }
+        else if (instruction.node.op == DensityOp::Spline)
+        {
+            instruction.spline_index = uint32_t(program->m_splines.size());
+            program->m_splines.push_back(make_spline(instruction.node));
+        }
+
+        program->m_instructions.push_back(std::move(instruction));
+    }
+
+    // Flatten the graph into steps. An instruction is evaluated once per level it is used at.
+    std::map<Level, uint32_t> levels;
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> steps;
+
+    const auto add_level = [&](Level level)
+    {
+        auto [iter, inserted] = levels.try_emplace(level, uint32_t(program->m_levels.size()));
+        if (inserted)
+            program->m_levels.push_back(level);
+        return iter->second;
+    };
+
+    const auto schedule = [&](auto& self, uint32_t instruction, uint32_t level) -> uint32_t
+    {
+        const Instruction& ins = program->m_instructions[instruction];
+
+        // Values that do not depend on `y` are the same on a level and its flat version.
+        if (ins.is_2d && program->m_levels[level].kind != Level::Kind::Flat)
+            level = add_level(Level{.kind = Level::Kind::Flat, .parent = level});
+
+        auto iter = steps.find({instruction, level});
+        if (iter != steps.end())
+            return iter->second;
+
+        uint32_t input_level = level;
+        // `Cache2D` is evaluated on a flat level already, so its input is too.
+        if (ins.node.op == DensityOp::Interpolate)
+            input_level = add_level(Level{.kind = Level::Kind::Coarse, .parent = level, .cell_width = ins.node.cell_width, .cell_height = ins.node.cell_height});
+
+        std::vector<uint32_t> inputs;
+        for (uint32_t input : ins.node.inputs)
+            inputs.push_back(self(self, input, input_level));
+
+        const uint32_t step = uint32_t(program->m_steps.size());
+        program->m_steps.push_back(Step{.instruction = instruction, .level = level, .inputs_offset = uint32_t(program->m_step_inputs.size())});
+        program->m_step_inputs.insert(program->m_step_inputs.end(), inputs.begin(), inputs.end());
+
+        steps[{instruction, level}] = step;
+        return step;
+    };
+
+    add_level(Level{});
+    for (uint32_t index : output_nodes)
+        program->m_output_steps.push_back(schedule(schedule, compiled[index], 0));
+
+    // The fingerprint covers everything `evaluate` depends on.
+    std::string bytes;
+    const auto append = [&bytes](const auto& value)
+    {
+        bytes.append((const char *)&value, sizeof(value));
+    };
+
+    append(seed);
+    for (const Step& step : program->m_steps)
+    {
+        const DensityNode& node = program->m_instructions[step.instruction].node;
+        const Level& level = program->m_levels[step.level];
+
+        append(node.op);
+        append(node.value);
+        append(node.min);
+        append(node.max);
+        append(node.noise.scale);
+        append(node.noise.octaves);
+        append(node.noise.lacunarity);
+        append(node.noise.persistence);
+        append(node.noise.seed);
+        append(node.noise.is_3d);
+        append(node.spline_linear);
+        for (size_t i = 0; i < node.spline_x.size(); i++)
+        {
+            append(node.spline_x[i]);
+            append(node.spline_y[i]);
+        }
+        append(node.cell_width);
+        append(node.cell_height);
+
+        append(level.kind);
+        append(level.parent);
+        append(level.cell_width);
+        append(level.cell_height);
+        for (size_t i = 0; i < node.inputs.size(); i++)
+            append(program->m_step_inputs[step.inputs_offset + i]);
+    }
+    for (uint32_t step : program->m_output_steps)
+        append(step);
+
+    program->m_fingerprint = hash_fnv64(bytes);
+
+    return program;
+}
+
+/**
+ * Returns the coarse axis covering `[origin, origin + (size - 1) * step]` with a step of `cell`.
+ */
+static void coarse_axis(int64_t origin, int32_t step, int32_t size, int32_t cell, int64_t& coarse_origin, int32_t& coarse_size)
+{
+    const int64_t end = origin + int64_t(size - 1) * step;
+    coarse_origin = floor_div(origin, cell) * cell;
+    coarse_size = int32_t(floor_div(end - coarse_origin + cell - 1, cell) + 1);
+}
+
+void DensityProgram::evaluate(const DensityGrid& grid, DensityContext& context) const
+{
+    ZoneScoped;
+
+    context.m_grids.resize(m_levels.size());
+    context.m_slots.resize(m_steps.size());
+    context.m_outputs = m_output_steps;
+
+    // Parents are always created before their children.
+    for (size_t i = 0; i < m_levels.size(); i++)
+    {
+        const Level& level = m_levels[i];
+        DensityGrid& g = context.m_grids[i];
+
+        switch (level.kind)
+        {
+        case Level::Kind::Root:
+            g = grid;
+            break;
+        case Level::Kind::Flat:
+            g = context.m_grids[level.parent];
+            g.y = 0;
+            g.step_y = 1;
+            g.size_y = 1;
+            break;
+        case Level::Kind::Coarse:
+            g = context.m_grids[level.parent];
+
+            if (g.step_xz < level.cell_width)
+            {
+                int64_t x, z;
+                int32_t size_x, size_z;
+                coarse_axis(g.x, g.step_xz, g.size_xz, level.cell_width, x, size_x);
+                coarse_axis(g.z, g.step_xz, g.size_xz, level.cell_width, z, size_z);
+
+                g.x = x;
+                g.z = z;
+                g.step_xz = level.cell_width;
+                g.size_xz = std::max(size_x, size_z);
+            }
+
+            if (g.size_y > 1 && g.step_y < level.cell_height)
+            {
+                coarse_axis(g.y, g.step_y, g.size_y, level.cell_height, g.y, g.size_y);
+                g.step_y = level.cell_height;
+            }
+            break;
+        }
+    }
+
+    for (const Step& step : m_steps)
+        run_step(step, context);
+}
+
+namespace
+{
+
+/**
+ * Position of each sample of a fine axis on a coarse axis, as the lower coarse sample and the weight of the upper one.
+ */
+struct AxisWeights
+{
+    std::vector<int32_t> index;
+    std::vector<float> t;
+
+    void compute(int64_t origin, int32_t step, int32_t size, int64_t coarse_origin, int32_t coarse_step, int32_t coarse_size)
+    {
+        index.resize(size);
+        t.resize(size);
+
+        for (int32_t i = 0; i < size; i++)
+        {
+            const int64_t offset = origin + int64_t(i) * step - coarse_origin;
+            const int32_t cell = std::clamp(int32_t(floor_div(offset, coarse_step)), 0, std::max(coarse_size - 2, 0));
+            index[i] = cell;
+            t[i] = coarse_size > 1 ? float(offset - int64_t(cell) * coarse_step) / float(coarse_step) : 0.0f;
+        }
+    }
+
+    int32_t next(int32_t i, int32_t coarse_size) const { return std::min(index[i] + 1, coarse_size - 1); }
+};
+
+} // namespace
+
+void DensityProgram::run_step(const Step& step, DensityContext& context) const
+{
+    const Instruction& ins = m_instructions[step.instruction];
+    const DensityNode& node = ins.node;
+    const DensityGrid& grid = context.m_grids[step.level];
+
+    const size_t plane = size_t(grid.size_xz) * size_t(grid.size_xz);
+    const size_t count = ins.is_2d ? plane : plane * size_t(grid.size_y);
+
+    std::vector<float>& out = context.m_slots[&step - m_steps.data()];
+    out.resize(count);
+
+    const auto input = [&](size_t i) -> const std::vector<float>&
+    {
+        return context.m_slots[m_step_inputs[step.inputs_offset + i]];
+    };
+
+    // Inputs that do not depend on `y` only have one plane of values.
+    const auto at = [plane](const std::vector<float>& values, size_t i)
+    {
+        return values.size() == plane ? values[i % plane] : values[i];
+    };
+
+    const auto coord_x = [&](size_t i)
+    { return grid.x + int64_t(i % grid.size_xz) * grid.step_xz; };
+    const auto coord_y = [&](size_t i)
+    { return grid.y + int64_t(i / plane) * grid.step_y; };
+    const auto coord_z = [&](size_t i)
+    { return grid.z + int64_t((i / grid.size_xz) % grid.size_xz) * grid.step_xz; };
+
+    switch (node.op)
+    {
+    case DensityOp::Constant:
+        std::fill(out.begin(), out.end(), node.value);
+        break;
+    case DensityOp::X:
+        for (size_t i = 0; i < count; i++)
+            out[i] = float(coord_x(i));
+        break;
+    case DensityOp::Y:
+        for (size_t i = 0; i < count; i++)
+            out[i] = float(coord_y(i));
+        break;
+    case DensityOp::Z:
+        for (size_t i = 0; i < count; i++)
+            out[i] = float(coord_z(i));
+        break;
+    case DensityOp::Noise:
+    {
+        const SimplexNoise& noise = m_noises[ins.noise_index];
+        const DensityNoiseParams& params = node.noise;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            float sum = 0.0f;
+            float norm = 0.0f;
+            float amplitude = 1.0f;
+            float scale = params.scale;
+
+            for (int32_t octave = 0; octave < params.octaves; octave++)
+            {
+                if (params.is_3d)
+                    sum += amplitude * noise.sample(glm::vec3(float(coord_x(i)), float(coord_y(i)), float(coord_z(i))) / scale);
+                else
+                    sum += amplitude * noise.sample(glm::vec2(float(coord_x(i)), float(coord_z(i))) / scale);
+
+                norm += amplitude;
+                scale /= params.lacunarity;
+                amplitude *= params.persistence;
+            }
+
+            out[i] = sum / norm;
+        }
+    }
+    break;
+    case DensityOp::Spline:
+    {
+        const tk::spline& spline = m_splines[ins.spline_index];
+        const std::vector<float>& in = input(0);
+        for (size_t i = 0; i < count; i++)
+            out[i] = float(spline(at(in, i)));
+    }
+    break;
+    case DensityOp::Add:
+    case DensityOp::Mul:
+    {
+        const std::vector<float>& first = input(0);
+        for (size_t i = 0; i < count; i++)
+            out[i] = at(first, i);
+
+        for (size_t k = 1; k < node.inputs.size(); k++)
+        {
+            const std::vector<float>& in = input(k);
+            if (node.op == DensityOp::Add)
+                for (size_t i = 0; i < count; i++)
+                    out[i] += at(in, i);
+            else
+                for (size_t i = 0; i < count; i++)
+                    out[i] *= at(in, i);
+        }
+    }
+    break;
+    case DensityOp::Min:
+    case DensityOp::Max:
+    {
+        const std::vector<float>& first = input(0);
+        for (size_t i = 0; i < count; i++)
+            out[i] = at(first, i);
+
+        for (size_t k = 1; k < node.inputs.size(); k++)
+        {
+            const std::vector<float>& in = input(k);
+            if (node.op == DensityOp::Min)
+                for (size_t i = 0; i < count; i++)
+                    out[i] = std::min(out[i], at(in, i));
+            else
+                for (size_t i = 0; i < count; i++)
+                    out[i] = std::max(out[i], at(in, i));
+        }
+    }
+    break;
+    case DensityOp::Clamp:
+    {
+        const std::vector<float>& in = input(0);
+        for (size_t i = 0; i < count; i++)
+            out[i] = std::clamp(at(in, i), node.min, node.max);
+    }
+    break;
+    case DensityOp::Cache2D:
+    {
+        const std::vector<float>& in = input(0);
+        std::copy(in.begin(), in.begin() + count, out.begin());
+    }
+    break;
+    case DensityOp::Interpolate:
+    {
+        const std::vector<float>& in = input(0);
+        const DensityGrid& coarse = context.m_grids[m_steps[m_step_inputs[step.inputs_offset]].level];
+        const size_t coarse_plane = size_t(coarse.size_xz) * size_t(coarse.size_xz);
+        const bool input_3d = in.size() != coarse_plane;
+
+        thread_local AxisWeights wx, wy, wz;
+        wx.compute(grid.x, grid.step_xz, grid.size_xz, coarse.x, coarse.step_xz, coarse.size_xz);
+        wz.compute(grid.z, grid.step_xz, grid.size_xz, coarse.z, coarse.step_xz, coarse.size_xz);
+        wy.compute(grid.y, grid.step_y, ins.is_2d ? 1 : grid.size_y, coarse.y, coarse.step_y, input_3d ? coarse.size_y : 1);
+
+        const int32_t size_y = ins.is_2d ? 1 : grid.size_y;
+        const int32_t coarse_size_y = input_3d ? coarse.size_y : 1;
+
+        const auto sample = [&](int32_t x, int32_t y, int32_t z)
+        {
+            return in[size_t(x) + size_t(z) * coarse.size_xz + size_t(y) * coarse_plane];
+        };
+
+        size_t i = 0;
+        for (int32_t y = 0; y < size_y; y++)
+        {
+            const int32_t y0 = wy.index[y];
+            const int32_t y1 = wy.next(y, coarse_size_y);
+            const float ty = wy.t[y];
+
+            for (int32_t z = 0; z < grid.size_xz; z++)
+            {
+                const int32_t z0 = wz.index[z];
+                const int32_t z1 = wz.next(z, coarse.size_xz);
+                const float tz = wz.t[z];
+
+                for (int32_t x = 0; x < grid.size_xz; x++, i++)
+                {
+                    const int32_t x0 = wx.index[x];
+                    const int32_t x1 = wx.next(x, coarse.size_xz);
+                    const float tx = wx.t[x];
+
+                    const float v00 = std::lerp(sample(x0, y0, z0), sample(x1, y0, z0), tx);
+                    const float v01 = std::lerp(sample(x0, y0, z1), sample(x1, y0, z1), tx);
+                    const float v10 = std::lerp(sample(x0, y1, z0), sample(x1, y1, z0), tx);
+                    const float v11 = std::lerp(sample(x0, y1, z1), sample(x1, y1, z1), tx);
+
+                    out[i] = std::lerp(std::lerp(v00, v01, tz), std::lerp(v10, v11, tz), ty);
+                }
+            }
+        }
+    }
+    break;
+    }
+}
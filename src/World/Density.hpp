@@ -0,0 +1,242 @@
+#pragma once
+
+#include "Core/Noise/Simplex.hpp"
+#include "Core/Result.hpp"
+#include "spline.hpp"
+
+#include <compare>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class DensityOp : uint8_t
+{
+    Constant,
+    /**
+     * Block coordinates of the sample.
+     */
+    X,
+    Y,
+    Z,
+    /**
+     * Fractal simplex noise, 2D by default.
+     */
+    Noise,
+    /**
+     * Cubic or linear spline of its input.
+     */
+    Spline,
+    Add,
+    Mul,
+    Min,
+    Max,
+    Clamp,
+    /**
+     * Evaluate the input once per column, at `y = 0`.
+     */
+    Cache2D,
+    /**
+     * Evaluate the input on a grid of `cell_width x cell_height x cell_width` cells and interpolate inside cells.
+     */
+    Interpolate,
+};
+
+struct DensityNoiseParams
+{
+    float scale = 1.0f;
+    int32_t octaves = 1;
+    float lacunarity = 2.0f;
+    float persistence = 0.5f;
+
+    /**
+     * Added to the world seed, so unrelated noises can be decorrelated.
+     */
+    uint64_t seed = 0;
+    bool is_3d = false;
+
+    auto operator<=>(const DensityNoiseParams&) const = default;
+};
+
+struct DensityNode
+{
+    DensityOp op = DensityOp::Constant;
+
+    /**
+     * Indices of the input nodes, in `DensityGraph::nodes` or in the compiled instructions.
+     */
+    std::vector<uint32_t> inputs{};
+
+    /// `Constant` value, or `Clamp` bounds.
+    float value = 0.0f;
+    float min = 0.0f;
+    float max = 0.0f;
+
+    DensityNoiseParams noise{};
+
+    std::vector<double> spline_x{};
+    std::vector<double> spline_y{};
+    bool spline_linear = false;
+
+    int32_t cell_width = 1;
+    int32_t cell_height = 1;
+
+    auto operator<=>(const DensityNode&) const = default;
+};
+
+/**
+ * Terrain described as a graph of density nodes, loaded from `assets/worldgen/`.
+ *
+ * Nodes are declared by name under `nodes:`. An input is either a number, the name of another node, one of the
+ * coordinates `x`, `y`, `z` or an inline node:
+ *
+ *     nodes:
+ *       continent: {type: noise, scale: 4000}
+ *       height: {type: add, args: [64, {type: mul, args: [continent, 20]}]}
+ */
+class DensityGraph
+{
+public:
+    static Result<std::shared_ptr<DensityGraph>> load(std::string_view path);
+    static Result<std::shared_ptr<DensityGraph>> parse(std::string_view source);
+
+    std::vector<DensityNode> nodes;
+    std::map<std::string, uint32_t, std::less<>> names;
+};
+
+/**
+ * Region of the world a program is evaluated on. Values are laid out as `x + z * size_xz + y * size_xz * size_xz`.
+ */
+struct DensityGrid
+{
+    int64_t x = 0;
+    int64_t y = 0;
+    int64_t z = 0;
+
+    int32_t step_xz = 1;
+    int32_t step_y = 1;
+
+    int32_t size_xz = 16;
+    int32_t size_y = 1;
+
+    /**
+     * Grid of the 16x16 columns of a chunk.
+     */
+    static DensityGrid columns(int64_t cx, int64_t cz)
+    {
+        return DensityGrid{.x = cx * 16, .z = cz * 16};
+    }
+
+    bool operator==(const DensityGrid&) const = default;
+};
+
+/**
+ * Buffers used to evaluate a program. A context must not be shared between threads but can be reused for any number
+ * of evaluations.
+ */
+class DensityContext
+{
+public:
+    /**
+     * Values of the output at `index` after `DensityProgram::evaluate`. Outputs that do not depend on `y` only have
+     * `size_xz * size_xz` values.
+     */
+    std::span<const float> output(size_t index) const { return m_slots[m_outputs[index]]; }
+
+private:
+    friend class DensityProgram;
+
+    std::vector<std::vector<float>> m_slots;
+    std::vector<DensityGrid> m_grids;
+    std::span<const uint32_t> m_outputs;
+};
+
+/**
+ * A density graph compiled for a seed and a set of outputs.
+ *
+ * Compilation folds constants, simplifies trivial operations and merges identical subexpressions, then flattens the
+ * graph into a list of steps in dependency order. Each step fills a buffer covering the whole grid, so a node shared by
+ * several outputs is computed once per column, and nodes that do not depend on `y` are only computed once per column
+ * for 3D grids.
+ */
+class DensityProgram
+{
+public:
+    static Result<std::shared_ptr<DensityProgram>> compile(const DensityGraph& graph, uint64_t seed, std::span<const std::string_view> outputs);
+
+    void evaluate(const DensityGrid& grid, DensityContext& context) const;
+
+    bool is_2d(size_t output) const { return m_instructions[m_steps[m_output_steps[output]].instruction].is_2d; }
+
+    /**
+     * Hash of the compiled program and its seed. Changes when anything that affects the evaluation changes.
+     */
+    uint64_t fingerprint() const { return m_fingerprint; }
+
+    size_t instruction_count() const { return m_instructions.size(); }
+    size_t step_count() const { return m_steps.size(); }
+
+private:
+    struct Instruction
+    {
+        DensityNode node;
+        bool is_2d = true;
+
+        /**
+         * Index in `m_noises` for `Noise`.
+         */
+        uint32_t noise_index = 0;
+
+        /**
+         * Index in `m_splines` for `Spline`.
+         */
+        uint32_t spline_index = 0;
+    };
+
+    /**
+     * Grid on which a step is evaluated, derived from the grid passed to `evaluate`. `Interpolate` evaluates its input
+     * on a coarser grid and `Cache2D` on a flat one.
+     */
+    struct Level
+    {
+        enum class Kind : uint8_t
+        {
+            Root,
+            Coarse,
+            Flat,
+        };
+
+        Kind kind = Kind::Root;
+        uint32_t parent = 0;
+        int32_t cell_width = 1;
+        int32_t cell_height = 1;
+
+        auto operator<=>(const Level&) const = default;
+    };
+
+    struct Step
+    {
+        uint32_t instruction;
+        uint32_t level;
+        uint32_t inputs_offset;
+    };
+
+    std::vector<Instruction> m_instructions;
+    std::vector<SimplexNoise> m_noises;
+    std::vector<tk::spline> m_splines;
+
+    std::vector<Level> m_levels;
+    std::vector<Step> m_steps;
+
+    /**
+     * Input steps of each step, the output buffer of a step has the same index as the step.
+     */
+    std::vector<uint32_t> m_step_inputs;
+    std::vector<uint32_t> m_output_steps;
+
+    uint64_t m_fingerprint = 0;
+
+    void run_step(const Step& step, DensityContext& context) const;
+};
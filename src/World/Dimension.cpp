@@ -2,228 +2,26 @@
 
 #include "AABB.hpp"
 #include "Block/Block.hpp"
+#include "Core/Epoch.hpp"
 #include "Core/Filesystem.hpp"
-#include "Core/ZLib.hpp"
 #include "Engine.hpp"
 #include "Profiler.hpp"
 #include "World/Chunk.hpp"
+#include "World/EntityCodec.hpp"
 #include "World/Gen.hpp"
+#include "World/TagCodec.hpp"
 #include "World/World.hpp"
 
 #include <mutex>
 
-void GenScheduler::terrain_pass(ChunkPos middle)
-{
-    std::set<ChunkPos> chunks;
-
-    for (int64_t x = -(m_chunk_distance + m_gen_distance); x <= m_chunk_distance + m_gen_distance; x++)
-        for (int64_t z = -(m_chunk_distance + m_gen_distance); z <= m_chunk_distance + m_gen_distance; z++)
-        {
-            const ChunkPos pos(x + middle.x, z + middle.z);
-
-            {
-                std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-                if (m_dimension.has_pregen_chunk(x + middle.x, z + middle.z))
-                    continue;
-            }
-
-            {
-                std::lock_guard<std::mutex> lock(m_pregen_queue_mutex);
-                if (m_pregen_queue.contains(pos))
-                    continue;
-                m_pregen_queue.insert(pos);
-            }
-
-            chunks.insert(pos);
-        }
-
-    m_pregen_count.fetch_add(chunks.size());
-
-    for (const ChunkPos& pos : chunks)
-    {
-        Engine::get().get_thread_pool().async([this, pos]()
-                                              { terrain_and_struct_chunk(pos); });
-    }
-
-    std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-    for (auto iter : m_dimension.m_preloaded_chunks)
-    {
-        const ChunkPos pos = iter.first;
-        if (std::abs(pos.x - middle.x) > m_chunk_distance + m_gen_distance || std::abs(pos.z - middle.z) > m_chunk_distance + m_gen_distance)
-            m_pregen_unload_queue.push_back(pos);
-    }
-    for (const ChunkPos& pos : m_pregen_unload_queue)
-    {
-        m_dimension.m_preloaded_chunks.erase(pos);
-    }
-}
-
-// static ChunkPos pop_near(std::vector<ChunkLoadWithDistance>& elements)
-// {
-//     float min_distance = elements[0].distance;
-//     size_t min_index = 0;
-//     for (size_t i = 1; i < elements.size(); i++)
-//     {
-//         if (elements[i].distance > min_distance)
-//         {
-//             min_distance = elements[i].distance;
-//             min_index = i;
-//         }
-//     }
-//     ChunkPos pos = elements[min_index].pos;
-//     elements.erase(elements.begin() + (ssize_t)min_index);
-//     return pos;
-// }
-
-void GenScheduler::chunk_pass(ChunkPos middle)
-{
-    if (m_pregen_count.load() > 0)
-    {
-        return;
-    }
-
-    std::set<ChunkPos> chunks;
-
-    for (int64_t x = -m_chunk_distance; x <= m_chunk_distance; x++)
-        for (int64_t z = -m_chunk_distance; z <= m_chunk_distance; z++)
-        {
-            const ChunkPos pos(x + middle.x, z + middle.z);
-
-            {
-                std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-                if (!m_dimension.has_pregen_chunk(x + middle.x, z + middle.z))
-                    continue;
-            }
-
-            {
-                std::lock_guard<std::mutex> lock(m_dimension.m_chunk_loading_mutex);
-                if (m_dimension.m_chunk_loading_queue.contains(pos))
-                    continue;
-                m_dimension.m_chunk_loading_queue.insert(pos);
-            }
-
-            {
-                std::lock_guard<std::mutex> lock(m_dimension.m_chunk_mutex);
-                if (m_dimension.m_chunks_to_flush.contains(pos))
-                    continue;
-                m_pregen_queue.insert(pos);
-            }
-
-            chunks.insert(pos);
-        }
-
-    for (const ChunkPos& pos : chunks)
-    {
-        Engine::get().get_thread_pool().async([this, pos]()
-                                              { realize_chunk(pos); });
-    }
-
-    // Unload chunks too far from the camera.
-    std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-    for (auto iter : m_dimension.m_preloaded_chunks)
-    {
-        const ChunkPos pos = iter.first;
-        if (std::abs(pos.x - middle.x) > m_chunk_distance + m_gen_distance || std::abs(pos.z - middle.z) > m_chunk_distance + m_gen_distance)
-            m_pregen_unload_queue.push_back(pos);
-    }
-    for (const ChunkPos& pos : m_pregen_unload_queue)
-    {
-        m_dimension.m_preloaded_chunks.erase(pos);
-    }
-}
-
-void GenScheduler::terrain_and_struct_chunk(ChunkPos pos)
-{
-    std::shared_ptr<PreLoadedChunk> chunk = std::make_shared<PreLoadedChunk>();
-    m_dimension.m_gen->preload(pos.x, pos.z, chunk);
-    m_dimension.m_gen->structure_pass(pos.x, pos.z, chunk, m_dimension);
-
-    m_pregen_count.fetch_sub(1);
-
-    std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-    m_dimension.m_preloaded_chunks[pos] = chunk;
-}
-
-void GenScheduler::realize_chunk(ChunkPos pos)
-{
-    std::string path = std::format("{}saves/{}/DIM0/{}${}/blocks.dat", Filesystem::get_data_directory(), m_dimension.m_world->get_name(), pos.x, pos.z);
-    if (!Engine::get().is_save_disabled() && Filesystem::exists(path))
-    {
-        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(&m_dimension, pos.x, pos.z);
-
-        std::vector<char> data;
-        // TODO: how to handle errors from loading chunks ?
-        File file = EXPECT(Filesystem::open_file(path));
-        EXPECT(file.reader().read_to_buffer(data));
-        file.close();
-
-        std::vector<uint8_t> blocks_data;
-        EXPECT(ZLib::inflate(std::as_bytes(std::span(data)), blocks_data));
-
-        assert(blocks_data.size() == sizeof(BlockState) * Chunk::block_count);
-        memcpy(chunk->get_blocks(), blocks_data.data(), blocks_data.size());
-
-        std::string path = std::format("{}saves/{}/DIM0/{}${}/tags.dat", Filesystem::get_data_directory(), m_dimension.m_world->get_name(), pos.x, pos.z);
-        if (Filesystem::exists(path))
-        {
-            File file = EXPECT(Filesystem::open_file(path));
-            std::vector<char> tags_compressed_data;
-            EXPECT(file.reader().read_to_buffer(tags_compressed_data));
-            file.close();
-
-            std::vector<uint8_t> tags_data;
-            EXPECT(ZLib::inflate(std::as_bytes(std::span(tags_compressed_data)), tags_data));
-
-            BufferReader reader(tags_data.data(), tags_data.size());
-            Dimension::read_tags(reader, chunk);
-        }
-
-        std::lock_guard<std::mutex> lock(m_dimension.m_chunk_mutex);
-        m_dimension.m_chunks_to_flush[pos] = chunk;
-    }
-    else
-    {
-        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(&m_dimension, pos.x, pos.z);
-        memset((void *)chunk->get_blocks(), 0, sizeof(BlockState) * Chunk::block_count);
-
-        for (int i = 0; i < 16 * 16; i++)
-            chunk->get_biomes()[i] = Biome::Plain;
-
-        std::shared_ptr<PreLoadedChunk> preloaded_chunk;
-        {
-            std::lock_guard<std::mutex> lock(m_dimension.m_preload_mutex);
-            auto iter = m_dimension.m_preloaded_chunks.find(pos);
-            if (iter == m_dimension.m_preloaded_chunks.end())
-                return; // TODO: ERROR
-            preloaded_chunk = iter->second;
-        }
-
-        m_dimension.m_gen->generate_chunk(chunk, preloaded_chunk, m_dimension);
-
-        // Save the initial version of the chunk.
-        EXPECT(m_dimension.m_world->save_chunk(chunk, m_dimension.m_id));
-
-        std::lock_guard<std::mutex> lock(m_dimension.m_chunk_mutex);
-        m_dimension.m_chunks_to_flush[pos] = chunk;
-    }
-}
-
 std::optional<std::shared_ptr<Chunk>> Dimension::get_chunk(int64_t x, int64_t z) const
 {
-    auto iter = m_chunks.find(ChunkPos(x, z));
-    if (iter != m_chunks.end())
-        return iter->second;
-    return std::nullopt;
+    return m_chunk_lookup.find(ChunkPos(x, z));
 }
 
 bool Dimension::has_chunk(int64_t x, int64_t z) const
 {
-    return m_chunks.contains(ChunkPos(x, z));
-}
-
-bool Dimension::has_pregen_chunk(int64_t x, int64_t z) const
-{
-    return m_preloaded_chunks.contains(ChunkPos(x, z));
+    return m_chunk_lookup.contains(ChunkPos(x, z));
 }
 
 void Dimension::add_chunk(const std::shared_ptr<Chunk>& chunk)
@@ -266,14 +64,18 @@ std::shared_ptr<Entity> Dimension::get_entity(EntityId id) const
 
 void Dimension::load(int64_t x, int64_t y, int64_t z, int64_t distance)
 {
+    (void)y;
     (void)distance;
-    const glm::i64vec3 player_pos(x, y, z);
-    const int64_t player_cx = int64_t(player_pos.x / 16);
-    const int64_t player_cz = int64_t(player_pos.z / 16);
-    const ChunkPos player_cpos(player_cx, player_cz);
 
-    m_scheduler.terrain_pass(player_cpos);
-    m_scheduler.chunk_pass(player_cpos);
+    m_scheduler.update(ChunkPos(chunk_index(x), chunk_index(z)));
+}
+
+size_t Dimension::discard_flushed_chunks()
+{
+    std::lock_guard<std::mutex> lock(m_chunk_mutex);
+    const size_t count = m_chunks_to_flush.size();
+    m_chunks_to_flush.clear();
+    return count;
 }
 
 std::vector<AABBd> Dimension::get_boxes_that_may_collide(const AABBd& box) const
@@ -309,6 +111,16 @@ std::vector<std::shared_ptr<Entity>> Dimension::cast_box(const AABBd& box) const
 {
     std::vector<std::shared_ptr<Entity>> entities;
 
+    if (m_use_entity_boxes)
+    {
+        for (const auto& [entity_box, entity] : m_entity_boxes)
+        {
+            if (entity_box.intersect(box))
+                entities.push_back(entity);
+        }
+        return entities;
+    }
+
     for (const std::shared_ptr<Entity>& entity : m_entities)
     {
         if (entity->get_aabb().translate(entity->get_position()).intersect(box))
@@ -318,6 +130,20 @@ std::vector<std::shared_ptr<Entity>> Dimension::cast_box(const AABBd& box) const
     return entities;
 }
 
+void Dimension::snapshot_entity_boxes()
+{
+    m_entity_boxes.clear();
+    for (const std::shared_ptr<Entity>& entity : m_entities)
+        m_entity_boxes.emplace_back(entity->get_aabb().translate(entity->get_position()), entity);
+    m_use_entity_boxes = true;
+}
+
+void Dimension::release_entity_boxes()
+{
+    m_use_entity_boxes = false;
+    m_entity_boxes.clear();
+}
+
 BlockState Dimension::get_block(int64_t x, int64_t y, int64_t z) const
 {
     if (y < 0 || y >= Chunk::height)
@@ -356,6 +182,9 @@ void Dimension::set_block(int64_t x, int64_t y, int64_t z, BlockState state)
     int64_t local_x = local_coords(x);
     int64_t local_z = local_coords(z);
 
+    if (m_block_log != nullptr)
+        m_block_log->set_block(m_id, {x, y, z}, chunk->get_block(local_x, y, local_z), state);
+
     chunk->set_block(local_x, y, local_z, state);
 }
 
@@ -378,6 +207,9 @@ void Dimension::set_tag(glm::i64vec3 pos, std::string_view name, Variant v)
     int64_t local_x = local_coords(pos.x);
     int64_t local_z = local_coords(pos.z);
 
+    if (m_block_log != nullptr)
+        m_block_log->set_tag(m_id, pos, name, v);
+
     chunk->set_tag({local_x, pos.y, local_z}, name, v);
 }
 
@@ -400,6 +232,9 @@ void Dimension::remove_tag(glm::i64vec3 pos, std::string_view name)
     int64_t local_x = local_coords(pos.x);
     int64_t local_z = local_coords(pos.z);
 
+    if (m_block_log != nullptr)
+        m_block_log->remove_tag(m_id, pos, name);
+
     chunk->remove_tag({local_x, pos.y, local_z}, name);
 }
 
@@ -442,165 +277,113 @@ Result<std::shared_ptr<Chunk>> Dimension::generate_chunk(int64_t cx, int64_t cz)
     for (int i = 0; i < 16 * 16; i++)
         chunk->get_biomes()[i] = Biome::Plain;
 
-    std::shared_ptr<PreLoadedChunk> preloaded_chunk;
-    {
-        std::lock_guard<std::mutex> lock(m_preload_mutex);
-        auto iter = m_preloaded_chunks.find(ChunkPos(cx, cz));
-        if (iter == m_preloaded_chunks.end())
-            return Error(ErrorKind::Unknown);
-        preloaded_chunk = iter->second;
-    }
+    std::shared_ptr<PreLoadedChunk> preloaded_chunk = m_preload_cache.get(ChunkPos(cx, cz));
+    if (preloaded_chunk == nullptr)
+        return Error(ErrorKind::Unknown);
 
     m_gen->generate_chunk(chunk, preloaded_chunk, *this);
     return chunk;
 }
 
-void Dimension::rebuild(ChunkPos pos, size_t slice_index, size_t slice_count)
+void Dimension::rebuild(ChunkPos pos, size_t slice_index, size_t slice_count, const CancellationToken& token)
 {
     std::shared_ptr<Chunk> chunk;
     std::map<ChunkPos, std::shared_ptr<Chunk>> nchunks;
 
+    // Lookups do not lock, the neighbours are the chunks loaded when the rebuild starts.
+    std::optional<std::shared_ptr<Chunk>> chunk_opt = get_chunk(pos.x, pos.z);
+    if (!chunk_opt.has_value())
     {
-        std::lock_guard<std::mutex> lock(m_chunk_mutex);
-
-        std::optional<std::shared_ptr<Chunk>> chunk_opt = get_chunk(pos.x, pos.z);
-        if (!chunk_opt.has_value())
-        {
-            return;
-        }
+        return;
+    }
 
-        chunk = chunk_opt.value();
+    chunk = chunk_opt.value();
 
-        const std::array<ChunkPos, 4> positions{
-            ChunkPos(pos.x + 1, pos.z),
-            ChunkPos(pos.x - 1, pos.z),
-            ChunkPos(pos.x, pos.z + 1),
-            ChunkPos(pos.x, pos.z - 1),
-        };
-        for (ChunkPos p : positions)
+    const std::array<ChunkPos, 4> positions{
+        ChunkPos(pos.x + 1, pos.z),
+        ChunkPos(pos.x - 1, pos.z),
+        ChunkPos(pos.x, pos.z + 1),
+        ChunkPos(pos.x, pos.z - 1),
+    };
+    for (ChunkPos p : positions)
+    {
+        chunk_opt = get_chunk(p.x, p.z);
+        if (!chunk_opt.has_value())
         {
-            chunk_opt = get_chunk(p.x, p.z);
-            if (!chunk_opt.has_value())
-            {
-                continue;
-            }
-            nchunks[p] = chunk_opt.value();
+            continue;
         }
+        nchunks[p] = chunk_opt.value();
     }
 
+    // Keeps the blocks replaced by a copy-on-write alive while they are read.
+    Epoch::Guard guard;
+
     for (size_t i = slice_index; i < slice_count; i++)
     {
+        if (token.is_cancelled())
+            return;
+
         EXPECT(chunk->build_simple_mesh(i, nchunks));
         EXPECT(chunk->build_water_mesh(i, nchunks));
     }
 }
 
-void Dimension::queue_rebuild(ChunkPos pos, size_t slice_index, size_t slice_count)
+void Dimension::queue_rebuild(ChunkPos pos, size_t slice_index, size_t slice_count, TaskPriority priority)
 {
     std::lock_guard<std::mutex> lock(m_chunk_rebuild_mutex);
-    if (m_chunk_rebuild_queue.contains(pos))
-    {
+
+    // A rebuild that did not start yet will see the latest blocks.
+    TaskHandle<void>& task = m_chunk_rebuild_tasks[pos];
+    if (task.is_pending())
         return;
-    }
-    m_chunk_rebuild_queue.insert(pos);
 
-    Engine::get().get_thread_pool().async([this, pos, slice_index, slice_count]
-                                          {
-                                            rebuild(pos, slice_index, slice_count);
-                                            std::lock_guard<std::mutex> lock(m_chunk_rebuild_mutex);
-                                            m_chunk_rebuild_queue.erase(pos); });
+    task = Engine::get().get_thread_pool().async([this, pos, slice_index, slice_count](const CancellationToken& token)
+                                                 { rebuild(pos, slice_index, slice_count, token); },
+                                                 priority);
 }
 
-void Dimension::preload_chunk(ChunkPos pos)
+void Dimension::cancel_chunk_tasks(ChunkPos pos)
 {
-    std::shared_ptr<PreLoadedChunk> chunk = std::make_shared<PreLoadedChunk>();
-    m_gen->preload(pos.x, pos.z, chunk);
-    m_gen->structure_pass(pos.x, pos.z, chunk, *this);
-
-    std::lock_guard<std::mutex> lock(m_preload_mutex);
-    m_preloaded_chunks[pos] = chunk;
-}
+    std::lock_guard<std::mutex> lock(m_chunk_rebuild_mutex);
 
-void Dimension::queue_preload_chunk(ChunkPos pos)
-{
-    Engine::get().get_thread_pool().async([this, pos]
-                                          { preload_chunk(pos); });
-}
+    auto iter = m_chunk_rebuild_tasks.find(pos);
+    if (iter == m_chunk_rebuild_tasks.end())
+        return;
 
-void Dimension::remove_preload(ChunkPos pos)
-{
-    m_preloaded_chunks.erase(pos);
+    iter->second.cancel();
+    m_chunk_rebuild_tasks.erase(iter);
 }
 
-void Dimension::load_chunk(ChunkPos pos)
+Result<std::shared_ptr<Chunk>> Dimension::load_saved_chunk(ChunkPos pos)
 {
-    std::shared_ptr<Chunk> chunk;
-
-    std::string path = std::format("{}saves/{}/DIM0/{}${}/blocks.dat", Filesystem::get_data_directory(), m_world->get_name(), pos.x, pos.z);
-    if (!Engine::get().is_save_disabled() && Filesystem::exists(path))
-    {
-        chunk = std::make_shared<Chunk>(this, pos.x, pos.z);
-
-        std::vector<char> data;
-        // TODO: how to handle errors from loading chunks ?
-        File file = EXPECT(Filesystem::open_file(path));
-        EXPECT(file.reader().read_to_buffer(data));
-        file.close();
-
-        std::vector<uint8_t> blocks_data;
-        EXPECT(ZLib::inflate(std::as_bytes(std::span(data)), blocks_data));
-
-        assert(blocks_data.size() == sizeof(BlockState) * Chunk::block_count);
-        memcpy(chunk->get_blocks(), blocks_data.data(), blocks_data.size());
-
-        std::string path = std::format("{}saves/{}/DIM0/{}${}/tags.dat", Filesystem::get_data_directory(), m_world->get_name(), pos.x, pos.z);
-        if (Filesystem::exists(path))
-        {
-            File file = EXPECT(Filesystem::open_file(path));
-            std::vector<char> tags_compressed_data;
-            EXPECT(file.reader().read_to_buffer(tags_compressed_data));
-            file.close();
+    if (m_region_store == nullptr)
+        return std::shared_ptr<Chunk>();
 
-            std::vector<uint8_t> tags_data;
-            EXPECT(ZLib::inflate(std::as_bytes(std::span(tags_compressed_data)), tags_data));
+    // A chunk unloaded and loaded again quickly may still be compressed by the saver.
+    if (std::shared_ptr<const ChunkSnapshot> snapshot = m_saver.find_unsaved(pos))
+        return restore_chunk(*snapshot);
 
-            BufferReader reader(tags_data.data(), tags_data.size());
-            read_tags(reader, chunk);
-        }
-    }
-    else
+    // Going through the I/O thread orders the reads after the writes of a chunk saved just before being unloaded. The
+    // data is decoded here, straight from the mapping of the region file.
+    Result<std::optional<RegionChunkView>> saved = m_region_store->view_wait(pos);
+    if (saved.has_error())
     {
-        Result<std::shared_ptr<Chunk>> result = generate_chunk(pos.x, pos.z);
-        if (result.has_error())
-            return;
-        chunk = result.value();
-
-        EXPECT(m_world->save_chunk(chunk, m_id));
+        error("failed to read chunk {} {} of DIM{}", pos.x, pos.z, m_id);
+        saved.error().print();
+        return saved.error();
     }
 
-    add_chunk(chunk);
+    if (!saved.value().has_value())
+        return std::shared_ptr<Chunk>();
 
+    Result<std::shared_ptr<Chunk>> chunk = decode_chunk(pos, saved.value()->compression, saved.value()->data);
+    if (chunk.has_error())
     {
-        std::lock_guard<std::mutex> lock(m_chunk_loading_mutex);
-        m_chunk_loading_queue.erase(pos);
+        error("corrupted chunk {} {} in DIM{}", pos.x, pos.z, m_id);
+        return Error(ErrorKind::InvalidData);
     }
-}
-
-void Dimension::queue_load_chunk(ChunkPos pos)
-{
-    Engine::get().get_thread_pool().async([this, pos]
-                                          { load_chunk(pos); });
-}
-
-void Dimension::unload_chunk(ChunkPos pos)
-{
-    remove_chunk(pos.x, pos.z);
-}
 
-void Dimension::queue_unload_chunk(ChunkPos pos)
-{
-    Engine::get().get_thread_pool().async([this, pos]
-                                          { unload_chunk(pos); });
+    return chunk.value();
 }
 
 void Dimension::update_sun(glm::mat4 matrix)
@@ -608,7 +391,7 @@ void Dimension::update_sun(glm::mat4 matrix)
     m_sun_frustum = Frustum(matrix);
 }
 
-void Dimension::place_structure(glm::i64vec3 pos, BlockState *blocks, int64_t w, int64_t h, int64_t l)
+void Dimension::place_structure(glm::i64vec3 pos, std::shared_ptr<BlockState[]> blocks, int64_t w, int64_t h, int64_t l)
 {
     std::lock_guard<std::mutex> lock(m_structures_mutex);
     m_structures_queue.push_back(StructureGen(pos, blocks, w, h, l));
@@ -631,31 +414,120 @@ void Dimension::get_structures_overlap(ChunkPos pos, std::vector<StructureGen>&
     }
 }
 
+void Dimension::prune_structures(ChunkPos min, ChunkPos max)
+{
+    std::lock_guard<std::mutex> lock(m_structures_mutex);
+
+    const AABBi area_box(glm::i64vec3(min.x * 16, 0, min.z * 16),
+                         glm::i64vec3(max.x * 16 + 16, 256, max.z * 16 + 16));
+
+    std::erase_if(m_structures_queue, [&](const StructureGen& structure)
+                  {
+                    const AABBi box(structure.pos,
+                                    structure.pos + glm::i64vec3(structure.w, structure.h, structure.l));
+                    return !box.intersect(area_box); });
+}
+
 void Dimension::write_tags(Writer& writer, const std::shared_ptr<Chunk>& chunk)
 {
-    std::map<int64_t, std::map<std::string, Variant>> tags;
-    for (const auto& [key, value] : chunk->m_tags)
-    {
-        std::map<std::string, Variant> tags2;
-        for (const auto& [key2, value2] : value.tags)
-            tags2[key2] = value2;
-        tags[key] = tags2;
-    }
-    EXPECT(writer.write_variant(Variant(tags)));
+    TagCodec::encode(writer, chunk->m_tags);
+}
+
+Result<void> Dimension::read_tags(Reader& reader, std::shared_ptr<Chunk>& chunk)
+{
+    return TagCodec::decode(reader, chunk->m_tags);
 }
 
-void Dimension::read_tags(Reader& reader, std::shared_ptr<Chunk>& chunk)
+ChunkSnapshot Dimension::snapshot_chunk(const std::shared_ptr<Chunk>& chunk)
 {
-    std::optional<Variant> variant = EXPECT(reader.read_variant());
-    if (variant.has_value())
+    BufferWriter writer;
+    write_tags(writer, chunk);
+
+    // Entities of a loaded chunk that were not created yet, ex: when the block log is replayed.
+    return ChunkSnapshot{.pos = chunk->pos(), .blocks = chunk->share_blocks(), .tags = writer.release(), .entities = chunk->m_entity_data};
+}
+
+std::optional<ChunkPos> Dimension::saved_chunk_of(const Entity& entity)
+{
+    if (!entity.is_saved_with_chunk() || !entity.is_active())
+        return std::nullopt;
+    return ChunkPos(chunk_index(int64_t(entity.get_position().x)), chunk_index(int64_t(entity.get_position().z)));
+}
+
+std::vector<uint8_t> Dimension::snapshot_entities(ChunkPos pos) const
+{
+    std::vector<std::shared_ptr<Entity>> entities;
+    for (const std::shared_ptr<Entity>& entity : m_entities)
     {
-        std::map<int64_t, std::map<std::string, Variant>> tags = variant.value().to_map<int64_t, std::map<std::string, Variant>>();
-        for (const auto& [key, value] : tags)
-        {
-            BlockTags btags;
-            for (const auto& [key2, value2] : value)
-                btags.tags[key2] = value2;
-            chunk->m_tags[key] = btags;
-        }
+        auto iter = m_entity_chunks.find(entity->id());
+        if (iter != m_entity_chunks.end() && iter->second == pos && entity->is_active())
+            entities.push_back(entity);
     }
+
+    if (entities.empty())
+        return {};
+
+    BufferWriter writer;
+    if (EntityCodec::encode(writer, entities).has_error())
+    {
+        error("failed to serialize the entities of chunk {} {} in DIM{}", pos.x, pos.z, m_id);
+        return {};
+    }
+    return writer.release();
+}
+
+Result<RegionChunk> Dimension::encode_chunk(const ChunkSnapshot& snapshot)
+{
+    const size_t blocks_size = sizeof(BlockState) * Chunk::block_count;
+
+    std::vector<uint8_t> data(blocks_size + snapshot.tags.size() + snapshot.entities.size());
+    memcpy(data.data(), snapshot.blocks.get(), blocks_size);
+    if (!snapshot.tags.empty())
+        memcpy(data.data() + blocks_size, snapshot.tags.data(), snapshot.tags.size());
+    if (!snapshot.entities.empty())
+        memcpy(data.data() + blocks_size + snapshot.tags.size(), snapshot.entities.data(), snapshot.entities.size());
+
+    RegionChunk saved;
+    saved.compression = save_compression;
+    TRY(ChunkCodec::get(save_compression)->encode(data, saved.data));
+    return saved;
+}
+
+Result<std::shared_ptr<Chunk>> Dimension::decode_chunk(ChunkPos pos, ChunkCompression compression, std::span<const uint8_t> saved)
+{
+    const ChunkCodec *codec = ChunkCodec::get(compression);
+    if (codec == nullptr)
+        return Error(ErrorKind::InvalidData);
+
+    // Reused by the loads of a thread, so decoding a chunk does not allocate once the buffer is large enough.
+    static thread_local std::vector<uint8_t> data;
+    data.clear();
+    TRY(codec->decode(saved, data));
+
+    const size_t blocks_size = sizeof(BlockState) * Chunk::block_count;
+    if (data.size() < blocks_size)
+        return Error(ErrorKind::InvalidData);
+
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(this, pos.x, pos.z);
+    memcpy(chunk->get_blocks(), data.data(), blocks_size);
+
+    BufferReader reader(data.data() + blocks_size, data.size() - blocks_size);
+    TRY(read_tags(reader, chunk));
+
+    // The entities are created when the chunk is added to the dimension, only their section is kept until then.
+    chunk->m_entity_data.assign(data.begin() + ssize_t(blocks_size + reader.position()), data.end());
+
+    return chunk;
+}
+
+std::shared_ptr<Chunk> Dimension::restore_chunk(const ChunkSnapshot& snapshot)
+{
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(this, snapshot.pos.x, snapshot.pos.z);
+    memcpy(chunk->get_blocks(), snapshot.blocks.get(), sizeof(BlockState) * Chunk::block_count);
+
+    BufferReader reader(snapshot.tags.data(), snapshot.tags.size());
+    EXPECT(read_tags(reader, chunk));
+    chunk->m_entity_data = snapshot.entities;
+
+    return chunk;
 }
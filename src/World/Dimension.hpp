@@ -2,10 +2,17 @@
 
 #include "AABB.hpp"
 #include "Core/IO.hpp"
+#include "Core/ReadMostlyMap.hpp"
+#include "Core/ThreadPool.hpp"
 #include "Entity/Entity.hpp"
 #include "Frustum.hpp"
+#include "World/BlockLog.hpp"
 #include "World/Chunk.hpp"
+#include "World/ChunkSaver.hpp"
 #include "World/Gen.hpp"
+#include "World/GenScheduler.hpp"
+#include "World/PreloadCache.hpp"
+#include "World/Region.hpp"
 
 #include <mutex>
 #include <set>
@@ -27,52 +34,6 @@ struct ChunkLoadWithDistance
     bool operator<(const ChunkLoadWithDistance& other) const { return distance < other.distance; }
 };
 
-struct PreLoadedChunk
-{
-    Biome *biomes;
-    int64_t *heights;
-
-    PreLoadedChunk()
-        : biomes(new Biome[16 * 16](Biome::Plain)), heights(new int64_t[16 * 16](0))
-    {
-    }
-
-    ~PreLoadedChunk()
-    {
-        delete[] biomes;
-        delete[] heights;
-    }
-};
-
-/// When generating chunks on multiple threads, we need to guarantee that each pass are generated one after the other, otherwise we will cut structures that overlap
-/// multiple chunks.
-class GenScheduler
-{
-public:
-    GenScheduler(Dimension& dimension)
-        : m_dimension(dimension)
-    {
-    }
-
-    void terrain_pass(ChunkPos middle);
-    void chunk_pass(ChunkPos middle);
-
-private:
-    Dimension& m_dimension;
-
-    int64_t m_chunk_distance = 16;
-    int64_t m_gen_distance = 15;
-
-    std::mutex m_pregen_queue_mutex;
-    std::atomic_size_t m_pregen_count = 0;
-    std::set<ChunkPos> m_pregen_queue;
-
-    std::vector<ChunkPos> m_pregen_unload_queue;
-
-    void terrain_and_struct_chunk(ChunkPos pos);
-    void realize_chunk(ChunkPos pos);
-};
-
 class Dimension
 {
     friend class World;
@@ -85,10 +46,12 @@ public:
     {
     }
 
+    /**
+     * Lock-free, can be called from any thread.
+     */
     std::optional<std::shared_ptr<Chunk>> get_chunk(int64_t x, int64_t z) const;
 
     bool has_chunk(int64_t x, int64_t z) const;
-    bool has_pregen_chunk(int64_t x, int64_t z) const;
 
     void add_chunk(const std::shared_ptr<Chunk>& chunk);
     void remove_chunk(int64_t x, int64_t z);
@@ -98,6 +61,9 @@ public:
     void remove_entity(std::shared_ptr<Entity> entity);
     void remove_entity(EntityId id);
 
+    /**
+     * Only used by the thread ticking the dimension, or while the dimension is not ticked.
+     */
     const std::map<ChunkPos, std::shared_ptr<Chunk>>& get_chunks() const { return m_chunks; }
     std::span<const RenderableChunk> get_visible_chunks() const { return m_visible_chunks; }
     std::span<const RenderableChunk> get_sun_visible_chunks() const { return m_sun_visible_chunks; }
@@ -105,6 +71,14 @@ public:
     /// Load and world generation logic.
     void load(int64_t x, int64_t y, int64_t z, int64_t distance);
 
+    GenScheduler& get_scheduler() { return m_scheduler; }
+
+    /**
+     * Drop chunks waiting to be flushed instead of inserting them in the dimension. Used when generating chunks
+     * without playing, since they are already saved. Returns the number of chunks dropped.
+     */
+    size_t discard_flushed_chunks();
+
     /// TODO: remove this, put rendering outside this class.
     void update_sun(glm::mat4 matrix);
 
@@ -125,29 +99,62 @@ public:
     Result<std::shared_ptr<Chunk>> generate_chunk(int64_t cx, int64_t cz);
     BlockState generate_block(int64_t x, int64_t y, int64_t z, std::shared_ptr<Chunk>& chunk);
 
-    void rebuild(ChunkPos pos, size_t slice_index = 0, size_t slice_count = Chunk::slice_count);
-    void queue_rebuild(ChunkPos pos, size_t slice_index = 0, size_t slice_count = Chunk::slice_count);
+    void rebuild(ChunkPos pos, size_t slice_index = 0, size_t slice_count = Chunk::slice_count, const CancellationToken& token = {});
+    void queue_rebuild(ChunkPos pos, size_t slice_index = 0, size_t slice_count = Chunk::slice_count, TaskPriority priority = TaskPriority::NearGeneration);
 
-    void preload_chunk(ChunkPos pos);
-    void queue_preload_chunk(ChunkPos pos);
+    /**
+     * Cancel the work queued for a chunk that is being unloaded.
+     */
+    void cancel_chunk_tasks(ChunkPos pos);
 
-    void remove_preload(ChunkPos pos);
+    /**
+     * Read a chunk saved on the disk. Returns `nullptr` if the chunk was never saved, fails with
+     * `ErrorKind::InvalidData` if the saved chunk is corrupted, or with the error of the read.
+     */
+    Result<std::shared_ptr<Chunk>> load_saved_chunk(ChunkPos pos);
 
-    void load_chunk(ChunkPos pos);
-    void queue_load_chunk(ChunkPos pos);
+    /**
+     * Called by the thread ticking the dimension, the chunk keeps changing while its snapshot is saved.
+     */
+    static ChunkSnapshot snapshot_chunk(const std::shared_ptr<Chunk>& chunk);
 
-    void unload_chunk(ChunkPos pos);
-    void queue_unload_chunk(ChunkPos pos);
+    /**
+     * Saved form of a chunk: its blocks followed by its tags and its entities, compressed together.
+     */
+    static Result<RegionChunk> encode_chunk(const ChunkSnapshot& snapshot);
 
-    void place_structure(glm::i64vec3 pos, BlockState *blocks, int64_t w, int64_t h, int64_t l);
+    /**
+     * Serialize the entities saved with the chunk at `pos`, empty if there are none. Called by the thread ticking the
+     * dimension.
+     */
+    std::vector<uint8_t> snapshot_entities(ChunkPos pos) const;
+
+    ChunkSaver& saver() { return m_saver; }
+    const ChunkSaver& saver() const { return m_saver; }
+
+    void place_structure(glm::i64vec3 pos, std::shared_ptr<BlockState[]> blocks, int64_t w, int64_t h, int64_t l);
     void get_structures_overlap(ChunkPos pos, std::vector<StructureGen>& structures);
 
+    /**
+     * Remove structures that do not overlap the chunks between `min` and `max` (inclusive).
+     */
+    void prune_structures(ChunkPos min, ChunkPos max);
+
 private:
     World *m_world = nullptr;
     int m_id;
 
+    /**
+     * Serializes the writers of the chunk maps.
+     */
     std::mutex m_chunk_mutex;
+
+    /**
+     * Same chunks in both maps, `m_chunk_lookup` for lookups from any thread and `m_chunks` for ordered iteration by
+     * the thread ticking the dimension.
+     */
     std::map<ChunkPos, std::shared_ptr<Chunk>> m_chunks;
+    ReadMostlyMap<ChunkPos, std::shared_ptr<Chunk>> m_chunk_lookup;
     std::vector<RenderableChunk> m_visible_chunks;
 
     GenScheduler m_scheduler;
@@ -160,25 +167,72 @@ private:
     std::vector<std::shared_ptr<Entity>> m_entities_to_add;
     std::vector<std::shared_ptr<Entity>> m_entities_to_remove;
 
+    /**
+     * Loaded chunk each entity is saved with, as of the last tick. A chunk is saved again when an entity enters or
+     * leaves it, otherwise the entity could be restored twice or not at all. An entity outside of the loaded chunks
+     * stays with the last loaded chunk it was in, and is unloaded with it.
+     */
+    std::map<EntityId, ChunkPos> m_entity_chunks;
+
+    /**
+     * Boxes of the entities while they are ticked in parallel, `cast_box` reads them instead of the moving entities.
+     */
+    std::vector<std::pair<AABBd, std::shared_ptr<Entity>>> m_entity_boxes;
+    bool m_use_entity_boxes = false;
+
     std::vector<ChunkLoadWithDistance> m_load_buffer;
 
     std::mutex m_chunk_loading_mutex;
     std::set<ChunkPos> m_chunk_loading_queue;
 
+    /**
+     * Last mesh rebuild queued for each chunk, a new rebuild is only queued when the previous one started.
+     */
     std::mutex m_chunk_rebuild_mutex;
-    std::set<ChunkPos> m_chunk_rebuild_queue;
+    std::map<ChunkPos, TaskHandle<void>> m_chunk_rebuild_tasks;
 
     std::map<ChunkPos, std::shared_ptr<Chunk>> m_chunks_to_flush;
     std::vector<ChunkPos> m_chunks_to_remove;
 
+    /**
+     * Chunks with an item in the world integration queue. Only used on the main thread.
+     */
+    std::set<ChunkPos> m_chunks_queued_for_flush;
+
     std::shared_ptr<Gen> m_gen;
 
-    std::mutex m_preload_mutex;
-    std::map<ChunkPos, std::shared_ptr<PreLoadedChunk>> m_preloaded_chunks;
+    PreloadCache m_preload_cache;
+
+    /**
+     * Saved chunks, `nullptr` when saving is disabled.
+     */
+    std::shared_ptr<RegionStore> m_region_store;
+
+    ChunkSaver m_saver;
+
+    /**
+     * Edits of the loaded chunks, `nullptr` if the world is not saved.
+     */
+    std::shared_ptr<BlockLog> m_block_log;
 
     std::mutex m_structures_mutex;
     std::vector<StructureGen> m_structures_queue;
 
+    void snapshot_entity_boxes();
+    void release_entity_boxes();
+
+    /**
+     * Chunk the entity is in if it is saved with its chunk, nothing for players and dead entities.
+     */
+    static std::optional<ChunkPos> saved_chunk_of(const Entity& entity);
+
     static void write_tags(Writer& writer, const std::shared_ptr<Chunk>& chunk);
-    static void read_tags(Reader& reader, std::shared_ptr<Chunk>& chunk);
+    static Result<void> read_tags(Reader& reader, std::shared_ptr<Chunk>& chunk);
+
+    Result<std::shared_ptr<Chunk>> decode_chunk(ChunkPos pos, ChunkCompression compression, std::span<const uint8_t> saved);
+
+    /**
+     * Fill a new chunk with the blocks and the tags of a snapshot.
+     */
+    std::shared_ptr<Chunk> restore_chunk(const ChunkSnapshot& snapshot);
 };
@@ -0,0 +1,100 @@
+#include "World/EntityCodec.hpp"
+
+#include <string_view>
+
+// All integers little-endian:
+//   uint32_t magic, uint32_t version, uint32_t entity count
+//   for each entity: uint16_t size, class name
+//                    uint32_t id
+//                    uint32_t size, fields written by `EntitySerializer::save`
+static constexpr uint32_t entities_magic = 0x53544e45; // "ENTS"
+
+template <typename T>
+static Result<void> write_value(Writer& writer, T value)
+{
+    TRY(writer.write_raw(&value, sizeof(T)));
+    return Result<void>();
+}
+
+template <typename T>
+static Result<T> read_value(Reader& reader)
+{
+    T value;
+    if (TRY(reader.read_raw(&value, sizeof(T))) != sizeof(T))
+        return Error(ErrorKind::InvalidData);
+    return value;
+}
+
+Result<void> EntityCodec::encode(Writer& writer, std::span<const std::shared_ptr<Entity>> entities)
+{
+    TRY(write_value<uint32_t>(writer, entities_magic));
+    TRY(write_value<uint32_t>(writer, version));
+    TRY(write_value<uint32_t>(writer, (uint32_t)entities.size()));
+
+    // The fields are serialized first to know their size, in a buffer reused by the saves of the thread.
+    static thread_local BufferWriter fields;
+
+    for (const std::shared_ptr<Entity>& entity : entities)
+    {
+        EntitySerializer serializer;
+        serializer.set("position", entity->get_position());
+        serializer.set("rotation", entity->get_rotation());
+        entity->save(serializer);
+
+        fields.clear();
+        TRY(serializer.save(fields));
+
+        const std::string_view class_name = entity->get_class_name();
+        TRY(write_value<uint16_t>(writer, (uint16_t)class_name.size()));
+        TRY(writer.write_raw(class_name.data(), class_name.size()));
+        TRY(write_value<uint32_t>(writer, entity->id().value()));
+        TRY(write_value<uint32_t>(writer, (uint32_t)fields.buffer().size()));
+        TRY(writer.write_raw(fields.buffer().data(), fields.buffer().size()));
+    }
+
+    return Result<void>();
+}
+
+Result<void> EntityCodec::decode(Reader& reader, std::vector<SavedEntity>& entities)
+{
+    uint32_t magic;
+    const size_t read = TRY(reader.read_raw(&magic, sizeof(uint32_t)));
+    if (read == 0)
+        return Result<void>();
+    if (read != sizeof(uint32_t) || magic != entities_magic)
+        return Error(ErrorKind::InvalidData);
+
+    if (TRY(read_value<uint32_t>(reader)) > version)
+        return Error(ErrorKind::InvalidData);
+
+    // Every entity takes more than a byte, a larger count can only come from corrupted data.
+    const uint32_t count = TRY(read_value<uint32_t>(reader));
+    if (count > reader.size())
+        return Error(ErrorKind::InvalidData);
+
+    std::vector<uint8_t> fields;
+    entities.reserve(entities.size() + count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        SavedEntity& entity = entities.emplace_back();
+
+        const uint16_t name_size = TRY(read_value<uint16_t>(reader));
+        entity.class_name.resize(name_size);
+        if (name_size > 0 && TRY(reader.read_raw(entity.class_name.data(), name_size)) != name_size)
+            return Error(ErrorKind::InvalidData);
+
+        entity.id = EntityId(TRY(read_value<uint32_t>(reader)));
+
+        const uint32_t fields_size = TRY(read_value<uint32_t>(reader));
+        if (fields_size > reader.size())
+            return Error(ErrorKind::InvalidData);
+        fields.resize(fields_size);
+        if (fields_size > 0 && TRY(reader.read_raw(fields.data(), fields_size)) != fields_size)
+            return Error(ErrorKind::InvalidData);
+
+        BufferReader fields_reader(fields.data(), fields.size());
+        TRY(entity.data.load(fields_reader));
+    }
+
+    return Result<void>();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Core/IO.hpp"
+#include "Core/Result.hpp"
+#include "Entity/Entity.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Entity read from a saved chunk. It is only created once the chunk is added to its dimension, on the main thread.
+ */
+struct SavedEntity
+{
+    std::string class_name;
+    EntityId id;
+
+    /**
+     * Position and rotation of the entity, then the fields written by `Entity::save`.
+     */
+    EntitySerializer data;
+};
+
+/**
+ * Serialized form of the entities of a chunk, saved after its tags. Chunks saved without entities have no section.
+ *
+ * Entities are identified by the name of their class, created with `EntityRegistry::create_entity`.
+ */
+class EntityCodec
+{
+public:
+    /**
+     * Written after the magic, bumped on each change of the format. Older versions must stay readable.
+     */
+    static constexpr uint32_t version = 1;
+
+    static Result<void> encode(Writer& writer, std::span<const std::shared_ptr<Entity>> entities);
+
+    /**
+     * Read the entities written by `encode`, nothing if the section is empty.
+     */
+    static Result<void> decode(Reader& reader, std::vector<SavedEntity>& entities);
+};
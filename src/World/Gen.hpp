@@ -1,10 +1,9 @@
 #pragma once
 
-#include "Core/Noise/Simplex.hpp"
 #include "World/Chunk.hpp"
+#include "World/Density.hpp"
 #include "World/Settings.hpp"
 #include "World/Structure.hpp"
-#include "spline.hpp"
 
 #include <memory>
 #include <random>
@@ -15,9 +14,9 @@ struct StructureGen
     int64_t w;
     int64_t h;
     int64_t l;
-    BlockState *blocks;
+    std::shared_ptr<BlockState[]> blocks;
 
-    StructureGen(glm::i64vec3 pos, BlockState *blocks, int64_t w, int64_t h, int64_t l)
+    StructureGen(glm::i64vec3 pos, std::shared_ptr<BlockState[]> blocks, int64_t w, int64_t h, int64_t l)
         : pos(pos), w(w), h(h), l(l), blocks(blocks)
     {
     }
@@ -47,7 +46,7 @@ class Gen
 {
 public:
     Gen(WorldSettings settings)
-        : m_settings(settings), m_noise(settings.seed)
+        : m_settings(settings)
     {
     }
 
@@ -62,9 +61,15 @@ public:
             pass->place(ChunkPos(cx, cz), chunk, dim);
     }
 
+    /**
+     * Identifies the terrain produced by this generator, preloaded chunks computed with another fingerprint are not
+     * reused.
+     */
+    uint64_t fingerprint() const { return m_terrain->fingerprint(); }
+
 protected:
     WorldSettings m_settings;
-    SimplexNoise m_noise;
+    std::shared_ptr<DensityProgram> m_terrain;
 
     std::vector<std::shared_ptr<StructurePass>> m_structure_passes;
 };
@@ -78,8 +83,18 @@ public:
     virtual void generate_chunk(std::shared_ptr<Chunk> chunk, std::shared_ptr<PreLoadedChunk> preloaded_chunk, Dimension& dim) override;
 
 private:
-    tk::spline m_continent_spline;
     std::shared_ptr<Structure> m_tree;
+
+    /**
+     * 3D `surface_offset` and `caves` fields, evaluated on the corners of cells.
+     */
+    std::shared_ptr<DensityProgram> m_carver;
+
+    /**
+     * Fill the solid blocks of the chunk with stone. Density is sampled on the corners of `cell_width x cell_height x
+     * cell_width` cells, cells entirely solid or empty are filled without looking at individual blocks.
+     */
+    void carve(Chunk& chunk, const PreLoadedChunk& preloaded_chunk) const;
 };
 
 class UnderworldGen : public Gen
@@ -0,0 +1,397 @@
+#include "World/GenScheduler.hpp"
+
+#include "Engine.hpp"
+#include "Profiler.hpp"
+#include "World/Dimension.hpp"
+#include "World/Gen.hpp"
+#include "World/World.hpp"
+
+#include <chrono>
+
+static constexpr std::array<ChunkPos, 4> direct_neighbours{
+    ChunkPos(1, 0),
+    ChunkPos(-1, 0),
+    ChunkPos(0, 1),
+    ChunkPos(0, -1),
+};
+
+void GenScheduler::update(ChunkPos center)
+{
+    ZoneScoped;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_has_center && center == m_center)
+        return;
+
+    // A jump, ex: joining the world, a teleport or a pregeneration, realizes a whole area at once. Its saved chunks are
+    // read ahead in the order of the region files instead of one by one.
+    const bool jumped = !m_has_center || std::max(std::abs(center.x - m_center.x), std::abs(center.z - m_center.z)) > 1;
+    if (jumped && m_dimension.m_region_store != nullptr)
+        m_dimension.m_region_store->prefetch(ChunkPos(center.x - m_chunk_distance, center.z - m_chunk_distance), ChunkPos(center.x + m_chunk_distance, center.z + m_chunk_distance));
+
+    m_center = center;
+    m_has_center = true;
+
+    // Drop chunks that are too far and unload realized chunks outside the realized area. One more ring is kept to not
+    // unload and reload chunks when walking back and forth on the border.
+    for (auto iter = m_nodes.begin(); iter != m_nodes.end();)
+    {
+        const ChunkPos pos = iter->first;
+        Node& node = iter->second;
+        const int64_t distance = std::max(std::abs(pos.x - center.x), std::abs(pos.z - center.z));
+
+        if (node.stage >= GenStage::Realized && distance > m_chunk_distance + 1)
+        {
+            {
+                // The chunk may not be flushed yet.
+                std::lock_guard<std::mutex> chunk_lock(m_dimension.m_chunk_mutex);
+                m_dimension.m_chunks_to_flush.erase(pos);
+                m_dimension.m_chunks_to_remove.push_back(pos);
+            }
+
+            node.stage = GenStage::Structures;
+        }
+        else if (node.running && node.stage == GenStage::Structures && !in_realize_area(pos))
+        {
+            // The chunk is being realized but is no longer needed.
+            invalidate(node);
+        }
+
+        if (!in_preload_area(pos))
+        {
+            // Kept in the cache in case the player comes back.
+            m_dimension.m_preload_cache.release(pos);
+            cancel_task(node);
+
+            iter = m_nodes.erase(iter);
+            continue;
+        }
+
+        iter++;
+    }
+
+    const int64_t preload_distance = m_chunk_distance + m_gen_distance;
+
+    // Structures of chunks outside the preload area can not be used anymore. Chunks coming back run their structure
+    // pass again.
+    m_dimension.prune_structures(ChunkPos(center.x - preload_distance, center.z - preload_distance),
+                                 ChunkPos(center.x + preload_distance, center.z + preload_distance));
+
+    for (int64_t x = -preload_distance; x <= preload_distance; x++)
+        for (int64_t z = -preload_distance; z <= preload_distance; z++)
+        {
+            const ChunkPos pos(center.x + x, center.z + z);
+
+            auto [iter, inserted] = m_nodes.try_emplace(pos);
+            Node& node = iter->second;
+
+            if (inserted)
+            {
+                node.generation = m_next_generation++;
+                push_job(pos, node, JobKind::Preload);
+            }
+            else if (node.stage == GenStage::Structures)
+            {
+                // Chunks that were on the border of the realized area, or unloaded.
+                try_push_realize(pos);
+            }
+        }
+
+    // Distances of queued jobs changed, so the heap needs to be rebuilt.
+    std::erase_if(m_ready, [this](const Job& job)
+                  {
+                    auto iter = m_nodes.find(job.pos);
+                    return iter == m_nodes.end() || iter->second.generation != job.generation; });
+    for (Job& job : m_ready)
+        job.distance = distance_to_center(job.pos);
+    std::make_heap(m_ready.begin(), m_ready.end());
+
+    dispatch();
+}
+
+void GenScheduler::chunk_flushed(ChunkPos pos, std::set<ChunkPos>& rebuild)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto iter = m_nodes.find(pos);
+    if (iter == m_nodes.end() || iter->second.stage != GenStage::Realized)
+    {
+        // Chunks not generated by the scheduler (ex: received from the server), rebuild everything around.
+        rebuild.insert(pos);
+        for (ChunkPos offset : direct_neighbours)
+            rebuild.insert(ChunkPos(pos.x + offset.x, pos.z + offset.z));
+        return;
+    }
+
+    iter->second.stage = GenStage::Flushed;
+
+    std::array<ChunkPos, 5> positions{pos};
+    for (size_t i = 0; i < direct_neighbours.size(); i++)
+        positions[i + 1] = ChunkPos(pos.x + direct_neighbours[i].x, pos.z + direct_neighbours[i].z);
+
+    for (ChunkPos p : positions)
+    {
+        auto node_iter = m_nodes.find(p);
+        if (node_iter == m_nodes.end())
+            continue;
+
+        Node& node = node_iter->second;
+
+        if (node.stage == GenStage::Flushed && can_mesh(p))
+        {
+            node.stage = GenStage::Meshed;
+            rebuild.insert(p);
+        }
+        else if (node.stage == GenStage::Meshed)
+        {
+            // The mesh of a neighbour was built without this chunk, faces on the border are wrong.
+            rebuild.insert(p);
+        }
+    }
+}
+
+void GenScheduler::stop()
+{
+    std::vector<TaskHandle<void>> running;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        m_ready.clear();
+
+        for (auto& [pos, node] : m_nodes)
+        {
+            if (!node.task.is_valid())
+                continue;
+
+            // Jobs already started still complete, they lock `m_mutex` so they are waited for outside of it.
+            TaskHandle<void> task = node.task;
+            cancel_task(node);
+            if (!task.is_done())
+                running.push_back(std::move(task));
+        }
+    }
+
+    for (const TaskHandle<void>& task : running)
+        task.wait();
+}
+
+int64_t GenScheduler::distance_to_center(ChunkPos pos) const
+{
+    const int64_t dx = pos.x - m_center.x;
+    const int64_t dz = pos.z - m_center.z;
+    return dx * dx + dz * dz;
+}
+
+bool GenScheduler::in_realize_area(ChunkPos pos) const
+{
+    return std::abs(pos.x - m_center.x) <= m_chunk_distance && std::abs(pos.z - m_center.z) <= m_chunk_distance;
+}
+
+bool GenScheduler::in_preload_area(ChunkPos pos) const
+{
+    const int64_t preload_distance = m_chunk_distance + m_gen_distance;
+    return std::abs(pos.x - m_center.x) <= preload_distance && std::abs(pos.z - m_center.z) <= preload_distance;
+}
+
+void GenScheduler::push_job(ChunkPos pos, Node& node, JobKind kind)
+{
+    node.queued = true;
+
+    m_ready.push_back(Job{.pos = pos, .kind = kind, .generation = node.generation, .distance = distance_to_center(pos)});
+    std::push_heap(m_ready.begin(), m_ready.end());
+}
+
+void GenScheduler::try_push_realize(ChunkPos pos)
+{
+    auto iter = m_nodes.find(pos);
+    if (iter == m_nodes.end())
+        return;
+
+    Node& node = iter->second;
+    if (node.stage != GenStage::Structures || node.queued || node.running || !in_realize_area(pos))
+        return;
+
+    for (int64_t x = -1; x <= 1; x++)
+        for (int64_t z = -1; z <= 1; z++)
+        {
+            auto neighbour = m_nodes.find(ChunkPos(pos.x + x, pos.z + z));
+            if (neighbour == m_nodes.end() || neighbour->second.stage < GenStage::Structures)
+                return;
+        }
+
+    push_job(pos, node, JobKind::Realize);
+}
+
+bool GenScheduler::can_mesh(ChunkPos pos) const
+{
+    for (ChunkPos offset : direct_neighbours)
+    {
+        const ChunkPos p(pos.x + offset.x, pos.z + offset.z);
+        if (!in_realize_area(p))
+            continue;
+
+        auto iter = m_nodes.find(p);
+        if (iter == m_nodes.end() || iter->second.stage < GenStage::Flushed)
+            return false;
+    }
+
+    return true;
+}
+
+void GenScheduler::invalidate(Node& node)
+{
+    cancel_task(node);
+
+    node.generation = m_next_generation++;
+    node.queued = false;
+    node.running = false;
+}
+
+void GenScheduler::cancel_task(Node& node)
+{
+    if (node.running && node.task.cancel())
+        m_running--;
+
+    node.task = TaskHandle<void>();
+}
+
+void GenScheduler::dispatch()
+{
+    while (!m_stopped && m_running < m_max_running && !m_ready.empty())
+    {
+        std::pop_heap(m_ready.begin(), m_ready.end());
+        const Job job = m_ready.back();
+        m_ready.pop_back();
+
+        auto iter = m_nodes.find(job.pos);
+        if (iter == m_nodes.end() || iter->second.generation != job.generation || !iter->second.queued)
+            continue;
+
+        iter->second.queued = false;
+        iter->second.running = true;
+        m_running++;
+
+        // Chunks that will be visible go first, the pool orders tasks of the same class by distance.
+        const TaskPriority priority = in_realize_area(job.pos) ? TaskPriority::NearGeneration : TaskPriority::BackgroundGeneration;
+        iter->second.task = Engine::get().get_thread_pool().async([this, job](const CancellationToken& token)
+                                                                  { run_job(job, token); },
+                                                                  priority, job.distance);
+    }
+}
+
+GenScheduler::Node *GenScheduler::complete_job(const Job& job)
+{
+    m_running--;
+
+    auto iter = m_nodes.find(job.pos);
+    if (iter == m_nodes.end() || iter->second.generation != job.generation)
+        return nullptr;
+
+    iter->second.running = false;
+    iter->second.task = TaskHandle<void>();
+    return &iter->second;
+}
+
+void GenScheduler::run_job(const Job& job, const CancellationToken& token)
+{
+    ZoneScoped;
+
+    const ChunkPos pos = job.pos;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    const auto record_stats = [this, start_time](GenStage stage)
+    {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+        m_stats.jobs[(size_t)stage].fetch_add(1, std::memory_order_relaxed);
+        m_stats.time_us[(size_t)stage].fetch_add(elapsed.count(), std::memory_order_relaxed);
+    };
+
+    switch (job.kind)
+    {
+    case JobKind::Preload:
+    {
+        // Terrain noise is only computed for columns never preloaded before.
+        std::shared_ptr<PreLoadedChunk> chunk = m_dimension.m_preload_cache.load(pos);
+        if (chunk != nullptr)
+        {
+            m_stats.preload_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (!token.is_cancelled())
+        {
+            chunk = std::make_shared<PreLoadedChunk>();
+            m_dimension.m_gen->preload(pos.x, pos.z, chunk);
+            m_dimension.m_preload_cache.store(pos, *chunk);
+        }
+        record_stats(GenStage::Preloaded);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (Node *node = complete_job(job); node != nullptr && chunk != nullptr)
+        {
+            m_dimension.m_preload_cache.insert(pos, chunk);
+
+            node->stage = GenStage::Preloaded;
+            push_job(pos, *node, JobKind::Structures);
+        }
+        dispatch();
+    }
+    break;
+    case JobKind::Structures:
+    {
+        std::shared_ptr<PreLoadedChunk> chunk = m_dimension.m_preload_cache.get(pos);
+
+        if (chunk != nullptr && !token.is_cancelled())
+            m_dimension.m_gen->structure_pass(pos.x, pos.z, chunk, m_dimension);
+        record_stats(GenStage::Structures);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (Node *node = complete_job(job))
+        {
+            node->stage = GenStage::Structures;
+
+            // This chunk may be the last dependency of one of its neighbours.
+            for (int64_t x = -1; x <= 1; x++)
+                for (int64_t z = -1; z <= 1; z++)
+                    try_push_realize(ChunkPos(pos.x + x, pos.z + z));
+        }
+        dispatch();
+    }
+    break;
+    case JobKind::Realize:
+    {
+        Result<std::shared_ptr<Chunk>> saved = m_dimension.load_saved_chunk(pos);
+        const bool corrupted = saved.has_error() && saved.error().kind() == ErrorKind::InvalidData;
+
+        // A chunk that could not be read is not generated over its save, it is realized again once the center moves.
+        std::shared_ptr<Chunk> chunk = saved.has_value() ? saved.value() : nullptr;
+        if (chunk == nullptr && (saved.has_value() || corrupted) && !token.is_cancelled())
+        {
+            Result<std::shared_ptr<Chunk>> result = m_dimension.generate_chunk(pos.x, pos.z);
+            if (result.has_value() && !token.is_cancelled())
+            {
+                chunk = result.value();
+
+                // Save the initial version of the chunk, a corrupted save is kept instead.
+                if (corrupted)
+                    chunk->set_replaces_corrupted();
+                else
+                    EXPECT(m_dimension.m_world->save_chunk(chunk, m_dimension.m_id, true));
+            }
+        }
+        record_stats(GenStage::Realized);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (Node *node = complete_job(job))
+        {
+            if (chunk != nullptr)
+            {
+                node->stage = GenStage::Realized;
+                m_dimension.add_chunk(chunk);
+            }
+        }
+        dispatch();
+    }
+    break;
+    }
+}
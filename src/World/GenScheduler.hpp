@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Core/ThreadPool.hpp"
+#include "World/Chunk.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+class Dimension;
+
+/**
+ * Counters of the generation jobs, indexed by the stage completed by the job (`GenStage::Preloaded`,
+ * `GenStage::Structures` and `GenStage::Realized`).
+ */
+struct GenStats
+{
+    std::array<std::atomic_uint64_t, 4> jobs{};
+    std::array<std::atomic_uint64_t, 4> time_us{};
+
+    /**
+     * Preload jobs that found the chunk in the preload cache instead of computing the terrain noise.
+     */
+    std::atomic_uint64_t preload_cache_hits = 0;
+};
+
+/**
+ * Stages a chunk goes through before being visible. Each value means the stage has been completed.
+ */
+enum class GenStage : uint8_t
+{
+    None,
+    /**
+     * Heights and biomes are computed.
+     */
+    Preloaded,
+    /**
+     * Structures of the chunk have been placed in the dimension structure queue.
+     */
+    Structures,
+    /**
+     * Blocks are generated (or loaded from the disk) and the chunk is waiting to be flushed.
+     */
+    Realized,
+    /**
+     * The chunk is inside `Dimension::m_chunks`.
+     */
+    Flushed,
+    /**
+     * The mesh of the chunk has been queued.
+     */
+    Meshed,
+};
+
+/**
+ * Schedules the generation pipeline of a dimension: `preload -> structures -> realize -> mesh`.
+ *
+ * Every chunk job depends only on the neighbour stages it needs:
+ * - `preload` and `structures` only depend on the chunk itself.
+ * - `realize` depends on the `structures` stage of the 3x3 chunks around it, because a structure can overlap its neighbours.
+ * - `mesh` depends on the 4 direct neighbours being flushed (or outside of the realized area).
+ *
+ * Jobs are pushed in a ready queue when their dependencies complete and are dispatched to the thread pool ordered by their
+ * distance to the loading center. Nothing is done when the center does not move and no job completes.
+ */
+class GenScheduler
+{
+public:
+    GenScheduler(Dimension& dimension)
+        : m_dimension(dimension)
+    {
+    }
+
+    /**
+     * Move the loading center. This is a no-op if the center did not change chunk since the last call.
+     */
+    void update(ChunkPos center);
+
+    /**
+     * Called on the main thread when a realized chunk has been inserted into the dimension. Positions that need to be
+     * remeshed are inserted in `rebuild`.
+     */
+    void chunk_flushed(ChunkPos pos, std::set<ChunkPos>& rebuild);
+
+    /**
+     * Change the distance in chunks around the center inside which chunks are realized. Takes effect on the next
+     * center change.
+     */
+    void set_chunk_distance(int64_t distance)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_chunk_distance = distance;
+        m_has_center = false;
+    }
+
+    /**
+     * Returns true when there is no job running nor waiting for the current center.
+     */
+    bool is_idle()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_running == 0 && m_ready.empty();
+    }
+
+    /**
+     * Cancel the queued jobs and wait for the running ones, no job is dispatched afterwards. Called before the world is
+     * closed, jobs read and write the region files.
+     */
+    void stop();
+
+    const GenStats& stats() const { return m_stats; }
+
+private:
+    enum class JobKind : uint8_t
+    {
+        Preload,
+        Structures,
+        Realize,
+    };
+
+    struct Node
+    {
+        /**
+         * Changed every time the node is invalidated, so results of jobs started before are discarded.
+         */
+        uint64_t generation = 0;
+        GenStage stage = GenStage::None;
+        bool queued = false;
+        bool running = false;
+
+        /**
+         * Job dispatched to the thread pool, cancelled when the node is invalidated or dropped.
+         */
+        TaskHandle<void> task;
+    };
+
+    struct Job
+    {
+        ChunkPos pos;
+        JobKind kind;
+        uint64_t generation;
+        int64_t distance;
+
+        /// `std::push_heap` builds a max-heap, so the "greatest" job is the nearest one. At equal distance, later stages
+        /// are completed first.
+        bool operator<(const Job& other) const
+        {
+            if (distance != other.distance)
+                return distance > other.distance;
+            return kind < other.kind;
+        }
+    };
+
+    Dimension& m_dimension;
+
+    /**
+     * Chunks inside this distance are realized.
+     */
+    int64_t m_chunk_distance = 16;
+
+    /**
+     * Number of rings of chunks preloaded around the realized area. Realizing a chunk requires its neighbours to be
+     * preloaded so this must be at least 1.
+     */
+    int64_t m_gen_distance = 2;
+
+    size_t m_max_running = std::max(std::thread::hardware_concurrency(), 1u) * 2;
+
+    std::mutex m_mutex;
+    ChunkPos m_center;
+    bool m_has_center = false;
+    bool m_stopped = false;
+    size_t m_running = 0;
+    uint64_t m_next_generation = 1;
+
+    std::map<ChunkPos, Node> m_nodes;
+    std::vector<Job> m_ready;
+
+    GenStats m_stats;
+
+    int64_t distance_to_center(ChunkPos pos) const;
+    bool in_realize_area(ChunkPos pos) const;
+    bool in_preload_area(ChunkPos pos) const;
+
+    void push_job(ChunkPos pos, Node& node, JobKind kind);
+    void try_push_realize(ChunkPos pos);
+    bool can_mesh(ChunkPos pos) const;
+
+    /**
+     * Dispatch ready jobs to the thread pool until `m_max_running` jobs are running. `m_mutex` must be locked.
+     */
+    void dispatch();
+
+    void run_job(const Job& job, const CancellationToken& token);
+
+    /**
+     * Mark the job as completed and returns the node if its result must be kept. `m_mutex` must be locked.
+     */
+    Node *complete_job(const Job& job);
+
+    void invalidate(Node& node);
+
+    /**
+     * Cancel the job of the node. Jobs cancelled before they start never run, so they are not counted as running anymore.
+     */
+    void cancel_task(Node& node);
+};
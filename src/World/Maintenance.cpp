@@ -0,0 +1,349 @@
+#include "World/Maintenance.hpp"
+
+#include "Core/Filesystem.hpp"
+#include "Core/Logger.hpp"
+#include "Engine.hpp"
+#include "World/EntityCodec.hpp"
+#include "World/Region.hpp"
+#include "World/TagCodec.hpp"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct RegionReport
+{
+    size_t chunks = 0;
+    size_t generated = 0;
+    size_t corrupted = 0;
+    size_t pruned = 0;
+
+    /**
+     * Encoded size of the chunks.
+     */
+    size_t stored_bytes = 0;
+    size_t file_bytes = 0;
+    size_t compacted_file_bytes = 0;
+
+    std::map<ChunkCompression, size_t> compressions;
+
+    /**
+     * The header of the file is corrupted, none of its chunks could be read.
+     */
+    bool unreadable = false;
+};
+
+struct DimensionReport : RegionReport
+{
+    size_t region_files = 0;
+    size_t unreadable_files = 0;
+
+    void add(const RegionReport& region)
+    {
+        region_files++;
+        unreadable_files += region.unreadable;
+        chunks += region.chunks;
+        generated += region.generated;
+        corrupted += region.corrupted;
+        pruned += region.pruned;
+        stored_bytes += region.stored_bytes;
+        file_bytes += region.file_bytes;
+        compacted_file_bytes += region.compacted_file_bytes;
+        for (const auto& [compression, count] : region.compressions)
+            compressions[compression] += count;
+    }
+};
+
+/**
+ * Runtime ids of the registered blocks, the air included.
+ */
+static std::vector<bool> known_block_ids()
+{
+    const GameRegistry& registry = Engine::get().registry();
+
+    std::vector<bool> known(UINT16_MAX + 1);
+    for (size_t id = 0; id < known.size(); id++)
+        known[id] = id == 0 || registry.from_runtime_id(RuntimeId<Block>((uint16_t)id)).valid();
+    return known;
+}
+
+/**
+ * Decode a chunk into `decoded` and check its content, like `Dimension::decode_chunk` without creating the chunk or its
+ * entities.
+ */
+static Result<void> verify_chunk(const RegionChunkView& view, const std::vector<bool>& known_ids, std::vector<uint8_t>& decoded)
+{
+    const ChunkCodec *codec = ChunkCodec::get(view.compression);
+    if (codec == nullptr)
+        return Error(ErrorKind::InvalidData);
+
+    decoded.clear();
+    TRY(codec->decode(view.data, decoded));
+
+    const size_t blocks_size = sizeof(BlockState) * Chunk::block_count;
+    if (decoded.size() < blocks_size)
+        return Error(ErrorKind::InvalidData);
+
+    for (size_t i = 0; i < (size_t)Chunk::block_count; i++)
+    {
+        uint16_t id;
+        std::memcpy(&id, decoded.data() + i * sizeof(BlockState), sizeof(id));
+        if (!known_ids[id])
+            return Error(ErrorKind::InvalidData);
+    }
+
+    std::map<int64_t, BlockTags> tags;
+    BufferReader reader(decoded.data() + blocks_size, decoded.size() - blocks_size);
+    TRY(TagCodec::decode(reader, tags));
+
+    std::vector<SavedEntity> entities;
+    TRY(EntityCodec::decode(reader, entities));
+
+    return Result<void>();
+}
+
+/**
+ * Replace the region file at `path` by a new one containing only `chunks`, or remove it if there are none.
+ */
+static Result<size_t> rewrite_region(const std::string& path, const std::vector<std::pair<ChunkPos, RegionChunk>>& chunks)
+{
+    std::error_code ec;
+    if (chunks.empty())
+    {
+        fs::remove(path, ec);
+        return size_t(0);
+    }
+
+    const std::string new_path = path + ".new";
+    fs::remove(new_path, ec);
+
+    size_t file_bytes;
+    {
+        std::shared_ptr<RegionFile> file = TRY(RegionFile::open(new_path, true));
+
+        std::vector<std::pair<ChunkPos, const RegionChunk *>> writes;
+        writes.reserve(chunks.size());
+        for (const auto& [pos, chunk] : chunks)
+            writes.push_back({pos, &chunk});
+        TRY(file->write(writes));
+
+        file_bytes = file->sector_count() * RegionFile::sector_size;
+    }
+
+    // The new file is complete and synced, a crash before the rename leaves the old one.
+    fs::rename(new_path, path, ec);
+    if (ec)
+        return Error(ErrorKind::WriteFailure);
+    return file_bytes;
+}
+
+static RegionReport process_region(const std::string& path, ChunkPos region, const MaintenanceOptions& options, const std::vector<bool>& known_ids)
+{
+    RegionReport report;
+
+    std::shared_ptr<RegionFile> file;
+    {
+        Result<std::shared_ptr<RegionFile>> opened = RegionFile::open(path, false);
+        if (opened.has_error())
+        {
+            error("region file `{}` is unreadable", path);
+            report.unreadable = true;
+            return report;
+        }
+        file = opened.value();
+    }
+
+    report.file_bytes = file->sector_count() * RegionFile::sector_size;
+    report.compacted_file_bytes = report.file_bytes;
+
+    const bool rewrite = options.prune || options.compact;
+    std::vector<std::pair<ChunkPos, RegionChunk>> kept;
+    std::vector<uint8_t> decoded;
+
+    for (int64_t z = 0; z < RegionFile::size; z++)
+    {
+        for (int64_t x = 0; x < RegionFile::size; x++)
+        {
+            const ChunkPos pos(region.x * RegionFile::size + x, region.z * RegionFile::size + z);
+
+            Result<std::optional<RegionChunkView>> view = file->view(pos);
+            if (view.has_error())
+            {
+                warn("chunk {} {} of `{}` points outside of the file", pos.x, pos.z, path);
+                report.corrupted++;
+                continue;
+            }
+            if (!view.value().has_value())
+                continue;
+
+            const RegionChunkView& chunk = view.value().value();
+            report.chunks++;
+            report.generated += chunk.generated;
+            report.stored_bytes += chunk.data.size();
+            report.compressions[chunk.compression]++;
+
+            const bool valid = verify_chunk(chunk, known_ids, decoded).has_value();
+            if (!valid)
+            {
+                warn("chunk {} {} of `{}` is corrupted", pos.x, pos.z, path);
+                report.corrupted++;
+            }
+
+            if (!rewrite || report.corrupted > 0)
+                continue;
+
+            if (options.prune && chunk.generated)
+            {
+                report.pruned++;
+                continue;
+            }
+
+            RegionChunk copy{.compression = chunk.compression, .data = {}, .generated = chunk.generated};
+            if (options.compact && chunk.compression != save_compression && ChunkCodec::get(save_compression)->encode(decoded, copy.data).has_value())
+                copy.compression = save_compression;
+            else
+                copy.data.assign(chunk.data.begin(), chunk.data.end());
+            kept.push_back({pos, std::move(copy)});
+        }
+    }
+
+    if (!rewrite)
+        return report;
+
+    if (report.corrupted > 0)
+    {
+        warn("region file `{}` is left as is because of its corrupted chunks", path);
+        report.pruned = 0;
+        return report;
+    }
+
+    // Views keep the file mapped, they are all destroyed by now.
+    file = nullptr;
+
+    Result<size_t> rewritten = rewrite_region(path, kept);
+    if (rewritten.has_error())
+    {
+        error("failed to rewrite region file `{}`", path);
+        report.pruned = 0;
+        return report;
+    }
+
+    report.compacted_file_bytes = rewritten.value();
+    return report;
+}
+
+/**
+ * Edits left in the block log by a crash are only applied to the chunks when the world is loaded, pruning or
+ * rewriting the chunks before would lose them.
+ */
+static bool has_block_log(const fs::path& world_directory)
+{
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(world_directory / "log", ec))
+    {
+        if (entry.is_regular_file() && entry.file_size(ec) > 0)
+            return true;
+    }
+    return false;
+}
+
+static double mib(size_t bytes)
+{
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+static void print_report(int dimension, const DimensionReport& report, const MaintenanceOptions& options)
+{
+    info("DIM{}: {} chunks in {} region files, {} never modified since their generation", dimension, report.chunks, report.region_files, report.generated);
+    info("  {:.2f} MiB of chunks in {:.2f} MiB of region files, {:.0f} bytes per chunk", mib(report.stored_bytes), mib(report.file_bytes), report.chunks > 0 ? double(report.stored_bytes) / double(report.chunks) : 0.0);
+
+    for (const auto& [compression, count] : report.compressions)
+    {
+        const ChunkCodec *codec = ChunkCodec::get(compression);
+        info("  {:>6}: {} chunks", codec != nullptr ? codec->name() : "?", count);
+    }
+
+    if (report.corrupted > 0 || report.unreadable_files > 0)
+        warn("  {} corrupted chunks, {} unreadable region files", report.corrupted, report.unreadable_files);
+
+    if (options.prune || options.compact)
+        info("  {} chunks pruned, region files {:.2f} MiB -> {:.2f} MiB", report.pruned, mib(report.file_bytes), mib(report.compacted_file_bytes));
+}
+
+Result<size_t> maintain_world(const MaintenanceOptions& options)
+{
+    const fs::path world_directory = std::format("{}saves/{}", Filesystem::get_data_directory(), options.world_name);
+    if (!fs::is_directory(world_directory))
+    {
+        error("world `{}` does not exist", options.world_name);
+        return Error(ErrorKind::FileNotFound);
+    }
+
+    if ((options.prune || options.compact) && has_block_log(world_directory))
+    {
+        error("world `{}` was not closed properly, load it once before pruning or compacting it", options.world_name);
+        return Error(ErrorKind::InvalidData);
+    }
+
+    struct RegionJob
+    {
+        int dimension;
+        TaskHandle<RegionReport> task;
+    };
+
+    const std::vector<bool> known_ids = known_block_ids();
+    ThreadPool& pool = Engine::get().get_thread_pool();
+    const auto start_time = std::chrono::steady_clock::now();
+
+    std::vector<RegionJob> jobs;
+    std::error_code ec;
+    for (const fs::directory_entry& dimension_entry : fs::directory_iterator(world_directory, ec))
+    {
+        int dimension;
+        if (!dimension_entry.is_directory() || std::sscanf(dimension_entry.path().filename().string().c_str(), "DIM%d", &dimension) != 1)
+            continue;
+
+        for (const fs::directory_entry& entry : fs::directory_iterator(dimension_entry.path() / "region", ec))
+        {
+            int64_t x, z;
+            char end;
+            if (std::sscanf(entry.path().filename().string().c_str(), "r.%" SCNd64 ".%" SCNd64 ".da%c", &x, &z, &end) != 3 || end != 't')
+                continue;
+
+            // One task per region file, a region file is not shared between threads.
+            jobs.push_back(RegionJob{
+                .dimension = dimension,
+                .task = pool.async([path = entry.path().string(), region = ChunkPos(x, z), &options, &known_ids]()
+                                   { return process_region(path, region, options, known_ids); }),
+            });
+        }
+    }
+
+    std::map<int, DimensionReport> reports;
+    for (RegionJob& job : jobs)
+    {
+        job.task.wait();
+        reports[job.dimension].add(job.task.get().value());
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    size_t chunks = 0;
+    size_t corrupted = 0;
+    for (const auto& [dimension, report] : reports)
+    {
+        print_report(dimension, report, options);
+        chunks += report.chunks;
+        corrupted += report.corrupted + report.unreadable_files;
+    }
+
+    info("checked {} chunks of `{}` in {:.2f} s ({:.0f} chunks/s) on {} threads", chunks, options.world_name, elapsed, elapsed > 0.0 ? double(chunks) / elapsed : 0.0, pool.thread_count());
+    return corrupted;
+}
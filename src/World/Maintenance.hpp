@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Core/Result.hpp"
+
+#include <cstddef>
+#include <string>
+
+struct MaintenanceOptions
+{
+    std::string world_name;
+
+    /**
+     * Remove the chunks never modified since their generation, they are generated again the next time they are loaded.
+     */
+    bool prune = false;
+
+    /**
+     * Rewrite the region files into fresh ones without their unused sectors, with the chunks encoded by
+     * `save_compression`.
+     */
+    bool compact = false;
+};
+
+/**
+ * Check every chunk saved by a world without loading the world: its data must decode to the size of a chunk, with only
+ * known blocks, valid tags and valid entities. Statistics are reported for each dimension. Region files are processed in
+ * parallel on the thread pool of the engine, which can be headless. The game must not use the world meanwhile.
+ *
+ * A region file with a corrupted chunk is never rewritten. Returns the number of corrupted chunks and unreadable region
+ * files.
+ */
+Result<size_t> maintain_world(const MaintenanceOptions& options);
@@ -2,9 +2,13 @@
 
 #include "Core/Math.hpp"
 #include "Engine.hpp"
+#include "Profiler.hpp"
 #include "World/Biome.hpp"
 #include "World/Registry.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <random>
 
 #define TREE_TYPE_SHORT 0
@@ -27,7 +31,7 @@ void TreePass::place_short_tree(ChunkPos pos, std::shared_ptr<PreLoadedChunk> ch
     int64_t elevation = chunk->heights[lx + lz * 16];
     const int64_t log_xz = width / 2 + 1;
 
-    BlockState *blocks = new BlockState[width * height * width](); // TODO: free this
+    std::shared_ptr<BlockState[]> blocks = std::make_shared<BlockState[]>(width * height * width);
     for (int64_t y = 0; y < tree_height; y++)
         blocks[log_xz + y * width + log_xz * width * height] = Engine::get().registry().get_default_state(Blocks::log);
 
@@ -64,7 +68,7 @@ void TreePass::place_big_tree(ChunkPos pos, std::shared_ptr<PreLoadedChunk> chun
     int64_t elevation = chunk->heights[lx + lz * 16];
     const int64_t log_xz = width / 2 + 1;
 
-    BlockState *blocks = new BlockState[width * height * width](); // TODO: free this
+    std::shared_ptr<BlockState[]> blocks = std::make_shared<BlockState[]>(width * height * width);
     for (int64_t y = 0; y < tree_height; y++)
         blocks[log_xz + y * width + log_xz * width * height] = Engine::get().registry().get_default_state(Blocks::log);
 
@@ -105,9 +109,12 @@ void TreePass::place(ChunkPos pos, std::shared_ptr<PreLoadedChunk> chunk, Dimens
 OverworldGen::OverworldGen(WorldSettings settings)
     : Gen(settings)
 {
-    std::vector<double> x{0.0f, 0.45f, 0.55f, 1.0f};
-    std::vector<double> y{0.0f, 0.1f, 0.9f, 1.0f};
-    m_continent_spline = tk::spline(x, y);
+    static constexpr std::array<std::string_view, 4> outputs{"height", "continentalness", "mountains", "forest"};
+    m_terrain = EXPECT(DensityProgram::compile(*Engine::get().registry().get_density_graph("overworld"), settings.seed, outputs));
+
+    // Separate program, so preloading does not evaluate 3D fields.
+    static constexpr std::array<std::string_view, 2> carver_outputs{"surface_offset", "caves"};
+    m_carver = EXPECT(DensityProgram::compile(*Engine::get().registry().get_density_graph("overworld"), settings.seed, carver_outputs));
 
     m_tree = Engine::get().registry().get_struct("tree");
 
@@ -116,47 +123,141 @@ OverworldGen::OverworldGen(WorldSettings settings)
 
 void OverworldGen::preload(int64_t cx, int64_t cz, std::shared_ptr<PreLoadedChunk> chunk)
 {
-    const float ocean_amplitude = float(m_settings.ocean_level) - float(m_settings.ocean_floor) + 3.0f;
+    thread_local DensityContext context;
+    m_terrain->evaluate(DensityGrid::columns(cx, cz), context);
 
-    for (int64_t x = 0; x < 16; x++)
+    std::span<const float> heights = context.output(0);
+    std::span<const float> continentalness = context.output(1);
+    std::span<const float> mountains = context.output(2);
+    std::span<const float> forest = context.output(3);
+
+    for (size_t i = 0; i < 16 * 16; i++)
     {
-        for (int64_t z = 0; z < 16; z++)
-        {
-            int64_t gx = x + cx * 16;
-            int64_t gz = z + cz * 16;
+        Biome biome = Biome::Plain;
+        if (mountains[i] > 52.0f)
+            biome = Biome::Mountain;
+        else if (continentalness[i] < 0.62f)
+            biome = Biome::Beach;
+        else if (forest[i] > 0.2f)
+            biome = Biome::Forest;
+
+        chunk->heights[i] = int64_t(heights[i]);
+        chunk->biomes[i] = biome;
+    }
+}
 
-            float continent_s0 = m_noise.sample(glm::vec2((float)gx, (float)gz) / 4000.0f) / 2.0f + 0.5f;
-            float continent = (float)m_continent_spline(continent_s0);
+static constexpr int32_t cell_width = 4;
+static constexpr int32_t cell_height = 8;
+static constexpr int32_t corners_xz = Chunk::width / cell_width + 1;
+static constexpr int32_t corners_y = Chunk::height / cell_height + 1;
 
-            float mountain_s0 = m_noise.fractal<1>(glm::vec2((float)gx, (float)gz), 0.001f, 20.0, 15.0, 7.0) / 2.0f + 0.5f;
-            float mountain_s1 = m_noise.sample(glm::vec2((float)gx, (float)gz) / 80.0f) / 2.0f + 0.5f;
-            float mountain_s2 = m_noise.sample(glm::vec2((float)gx, (float)gz) / 30.0f) / 2.0f + 0.5f;
-            float mountain = mountain_s0 * 100.0f + mountain_s1 * 20.0f + mountain_s2 * 5.0f;
+static float trilinear(const std::array<float, 8>& corners, float tx, float ty, float tz)
+{
+    const float x00 = std::lerp(corners[0], corners[1], tx);
+    const float x10 = std::lerp(corners[2], corners[3], tx);
+    const float x01 = std::lerp(corners[4], corners[5], tx);
+    const float x11 = std::lerp(corners[6], corners[7], tx);
+    return std::lerp(std::lerp(x00, x10, tz), std::lerp(x01, x11, tz), ty);
+}
 
-            float lakes_s0 = m_noise.sample(glm::vec2((float)gx, (float)gz) / 700.0f) / 2.0f + 0.5f;
+void OverworldGen::carve(Chunk& chunk, const PreLoadedChunk& preloaded_chunk) const
+{
+    ZoneScoped;
+
+    // The cost of sampling is fixed: 5x33x5 corners per chunk, instead of one sample per block.
+    thread_local DensityContext context;
+    const ChunkPos cpos = chunk.pos();
+    m_carver->evaluate(DensityGrid{.x = cpos.x * Chunk::width,
+                                   .z = cpos.z * Chunk::width,
+                                   .step_xz = cell_width,
+                                   .step_y = cell_height,
+                                   .size_xz = corners_xz,
+                                   .size_y = corners_y},
+                       context);
+
+    std::span<const float> offsets = context.output(0);
+    std::span<const float> caves = context.output(1);
+
+    // Fields that do not depend on `y` only have one plane of values.
+    const auto corner = [](std::span<const float> values, int32_t x, int32_t y, int32_t z)
+    {
+        const size_t plane = size_t(corners_xz) * corners_xz;
+        const size_t i = size_t(x) + size_t(z) * corners_xz;
+        return values.size() == plane ? values[i] : values[i + size_t(y) * plane];
+    };
+
+    BlockState *blocks = chunk.get_blocks();
+    const BlockState stone = Engine::get().registry().get_default_state(Blocks::stone);
 
-            float mountain_mask = m_noise.sample(glm::vec2((float)gx, (float)gz) / 800.0f) / 2.0f + 0.5f;
+    for (int32_t cz = 0; cz < Chunk::width / cell_width; cz++)
+    {
+        for (int32_t cx = 0; cx < Chunk::width / cell_width; cx++)
+        {
+            // The surface follows the heightmap of each column, so it matches the preloaded heights used by structures.
+            int64_t min_height = INT64_MAX;
+            int64_t max_height = INT64_MIN;
+            for (int32_t lz = 0; lz < cell_width; lz++)
+                for (int32_t lx = 0; lx < cell_width; lx++)
+                {
+                    const int64_t height = preloaded_chunk.heights[(cx * cell_width + lx) + (cz * cell_width + lz) * 16];
+                    min_height = std::min(min_height, height);
+                    max_height = std::max(max_height, height);
+                }
+
+            for (int32_t cy = 0; cy < Chunk::height / cell_height; cy++)
+            {
+                std::array<float, 8> offset_corners;
+                std::array<float, 8> cave_corners;
+                for (int32_t i = 0; i < 8; i++)
+                {
+                    const int32_t x = cx + (i & 1);
+                    const int32_t z = cz + ((i >> 1) & 1);
+                    const int32_t y = cy + (i >> 2);
+                    offset_corners[i] = corner(offsets, x, y, z);
+                    cave_corners[i] = corner(caves, x, y, z);
+                }
 
-            float forest_mask = m_noise.sample(glm::vec2((float)gx, (float)gz) / 900.0f) / 2.0f + 0.5f;
+                // Interpolated values stay between the values of the corners, so these bound the whole cell.
+                const auto [min_offset, max_offset] = std::minmax_element(offset_corners.begin(), offset_corners.end());
+                const auto [min_cave, max_cave] = std::minmax_element(cave_corners.begin(), cave_corners.end());
 
-            Biome biome = Biome::Plain;
-            if (mountain * mountain_mask > 52.0)
-                biome = Biome::Mountain;
-            else if (continent_s0 < 0.62f)
-                biome = Biome::Beach;
-            else if (forest_mask > 0.2)
-                biome = Biome::Forest;
+                const int64_t y0 = int64_t(cy) * cell_height;
+                const float min_surface = float(min_height - (y0 + cell_height - 1)) + *min_offset;
+                const float max_surface = float(max_height - y0) + *max_offset;
 
-            float elevation = float(m_settings.ocean_floor);
-            elevation += continent * (ocean_amplitude);
-            elevation += mountain_mask * mountain_mask * continent * mountain;
-            elevation -= lakes_s0 * 15.0f;
+                if (max_surface <= 0.0f || *max_cave <= 0.0f)
+                    continue;
 
-            int64_t height = int64_t(elevation);
-            height = std::min(height, (int64_t)255l);
+                if (min_surface > 0.0f && *min_cave > 0.0f)
+                {
+                    for (int64_t y = y0; y < y0 + cell_height; y++)
+                        for (int64_t z = cz * cell_width; z < (cz + 1) * cell_width; z++)
+                            std::fill_n(&blocks[cx * cell_width + y * Chunk::width + z * Chunk::width * Chunk::height], cell_width, stone);
+                    continue;
+                }
 
-            chunk->heights[x + z * 16] = height;
-            chunk->biomes[x + z * 16] = biome;
+                for (int32_t ly = 0; ly < cell_height; ly++)
+                {
+                    const float ty = float(ly) / cell_height;
+                    const int64_t y = y0 + ly;
+
+                    for (int32_t lz = 0; lz < cell_width; lz++)
+                    {
+                        const float tz = float(lz) / cell_width;
+                        const int64_t z = cz * cell_width + lz;
+
+                        for (int32_t lx = 0; lx < cell_width; lx++)
+                        {
+                            const float tx = float(lx) / cell_width;
+                            const int64_t x = cx * cell_width + lx;
+
+                            const int64_t height = preloaded_chunk.heights[x + z * 16];
+                            if (float(height - y) + trilinear(offset_corners, tx, ty, tz) > 0.0f && trilinear(cave_corners, tx, ty, tz) > 0.0f)
+                                blocks[x + y * Chunk::width + z * Chunk::width * Chunk::height] = stone;
+                        }
+                    }
+                }
+            }
         }
     }
 }
@@ -169,6 +270,8 @@ void OverworldGen::generate_chunk(std::shared_ptr<Chunk> chunk, std::shared_ptr<
     std::vector<StructureGen> structures;
     dim.get_structures_overlap(cpos, structures);
 
+    carve(*chunk, *preloaded_chunk);
+
     const BlockState stone = Engine::get().registry().get_default_state(Blocks::stone);
     const BlockState dirt = Engine::get().registry().get_default_state(Blocks::dirt);
     const BlockState grass = Engine::get().registry().get_default_state(Blocks::grass);
@@ -182,10 +285,6 @@ void OverworldGen::generate_chunk(std::shared_ptr<Chunk> chunk, std::shared_ptr<
             Biome biome = preloaded_chunk->biomes[x + z * 16];
             int64_t height = preloaded_chunk->heights[x + z * 16];
 
-            int64_t y = 0;
-            for (; y < height - 3; y++)
-                blocks[x + y * 16 + z * 16 * 256] = stone;
-
             BlockState ground;
             BlockState surface;
             switch (biome)
@@ -209,12 +308,33 @@ void OverworldGen::generate_chunk(std::shared_ptr<Chunk> chunk, std::shared_ptr<
                 break;
             }
 
-            for (; y < height - 1; y++)
-                blocks[x + y * 16 + z * 16 * 256] = ground;
-            blocks[x + (y++) * 16 + z * 16 * 256] = surface;
+            int64_t top = Chunk::height - 1;
+            while (top >= 0 && blocks[x + top * 16 + z * 16 * 256].is_air())
+                top--;
+
+            // Cover the terrain and overhangs, but not the floor of caves. `layer` is the number of solid blocks since
+            // the last air block.
+            int64_t layer = 0;
+            for (int64_t y = top; y >= 0 && y >= height - 8; y--)
+            {
+                BlockState& block = blocks[x + y * 16 + z * 16 * 256];
+                if (block.is_air())
+                {
+                    layer = 0;
+                    continue;
+                }
+
+                if (layer == 0)
+                    block = surface;
+                else if (layer < 3)
+                    block = ground;
+                layer++;
+            }
+
+            int64_t y = top + 1;
 
             // Add snow on top of mountains
-            if (height > 160 && biome == Biome::Mountain)
+            if (y > 160 && y < Chunk::height && biome == Biome::Mountain)
                 blocks[x + y * 16 + z * 16 * 256] = snow;
 
             // Fill oceans
@@ -0,0 +1,83 @@
+#include "World/PlayerSaver.hpp"
+#include "Entity/Player.hpp"
+
+/**
+ * Items and counts of the inventory, their tags are only saved by the periodic saves.
+ */
+static uint32_t hash_inventory(const Player& player)
+{
+    const uint32_t fnv_32_prime = 0x01000193;
+    uint32_t h = 0x811c9dc5;
+
+    const std::shared_ptr<InventoryContainer> container = player.get_inventory_container();
+    for (uint32_t layer = 0; layer < 2; layer++)
+    {
+        for (const ItemStack& stack : container->get_layer(layer).stacks)
+        {
+            h = (h ^ stack.item().hash) * fnv_32_prime;
+            h = (h ^ (uint32_t)stack.count()) * fnv_32_prime;
+        }
+    }
+
+    return h;
+}
+
+bool PlayerSaver::needs_save(const Player& player)
+{
+    const Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto iter = m_states.find(player.id());
+    if (iter == m_states.end())
+    {
+        m_states.emplace(player.id(), state_of(player, now));
+        return false;
+    }
+
+    const State& state = iter->second;
+    const Clock::duration elapsed = now - state.last_save;
+    if (elapsed >= max_interval)
+        return true;
+    if (elapsed < min_interval)
+        return false;
+
+    const glm::dvec3 moved = player.get_position() - state.position;
+    if (glm::dot(moved, moved) >= min_distance * min_distance || hash_inventory(player) != state.inventory_hash)
+        return true;
+
+    m_skipped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void PlayerSaver::saved(const Player& player)
+{
+    const State state = state_of(player, Clock::now());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[player.id()] = state;
+    m_saves.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PlayerSaver::forget(EntityId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states.erase(id);
+}
+
+PlayerSaver::Stats PlayerSaver::stats() const
+{
+    return Stats{
+        .saves = m_saves.load(std::memory_order_relaxed),
+        .skipped = m_skipped.load(std::memory_order_relaxed),
+    };
+}
+
+PlayerSaver::State PlayerSaver::state_of(const Player& player, Clock::time_point now)
+{
+    return State{
+        .position = player.get_position(),
+        .inventory_hash = hash_inventory(player),
+        .last_save = now,
+    };
+}
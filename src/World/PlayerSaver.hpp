@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Entity/Entity.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+class Player;
+
+/**
+ * Decides when a player is saved: once it moved far enough or its inventory changed, at most once per
+ * `min_interval`, and at least once per `max_interval` while it is connected.
+ *
+ * Can be called by the threads ticking the dimensions at the same time.
+ */
+class PlayerSaver
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds min_interval{1000};
+    static constexpr std::chrono::milliseconds max_interval{30000};
+
+    /**
+     * Distance in blocks a player moves before being saved again.
+     */
+    static constexpr double min_distance = 8.0;
+
+    struct Stats
+    {
+        uint64_t saves = 0;
+        uint64_t skipped = 0;
+    };
+
+    /**
+     * Whether the player changed enough since its last save. A player seen for the first time was just loaded, it
+     * counts as saved.
+     */
+    bool needs_save(const Player& player);
+
+    /**
+     * Called after each save of the player, whatever the reason.
+     */
+    void saved(const Player& player);
+
+    /**
+     * Forget a player removed from the world.
+     */
+    void forget(EntityId id);
+
+    Stats stats() const;
+
+private:
+    struct State
+    {
+        glm::dvec3 position;
+        uint32_t inventory_hash = 0;
+        Clock::time_point last_save;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<EntityId, State> m_states;
+
+    std::atomic<uint64_t> m_saves = 0;
+    std::atomic<uint64_t> m_skipped = 0;
+
+    static State state_of(const Player& player, Clock::time_point now);
+};
@@ -0,0 +1,106 @@
+#include "World/Pregen.hpp"
+
+#include "Core/Filesystem.hpp"
+#include "Core/Logger.hpp"
+#include "Engine.hpp"
+#include "World/World.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <thread>
+
+static size_t peak_memory_usage()
+{
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __platform_macos
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static void print_stage(const char *name, const GenStats& stats, GenStage stage)
+{
+    const uint64_t jobs = stats.jobs[(size_t)stage].load();
+    const uint64_t time_us = stats.time_us[(size_t)stage].load();
+    const double average_ms = jobs > 0 ? double(time_us) / double(jobs) / 1000.0 : 0.0;
+
+    info("  {:<10} {:>8} jobs {:>10.1f} ms total {:>8.3f} ms/chunk", name, jobs, double(time_us) / 1000.0, average_ms);
+}
+
+Result<void> pregenerate_world(const PregenOptions& options)
+{
+    std::shared_ptr<World> world;
+
+    if (Filesystem::exists(std::format("{}saves/{}", Filesystem::get_data_directory(), options.world_name)))
+    {
+        info("loading existing world `{}`", options.world_name);
+        world = TRY(World::load(options.world_name));
+    }
+    else
+    {
+        info("creating world `{}` with seed {}", options.world_name, options.seed);
+        world = TRY(World::create(options.world_name, options.seed, WorldPresetNormal));
+    }
+
+    Dimension& dimension = world->get_dimension(options.dimension);
+    GenScheduler& scheduler = dimension.get_scheduler();
+
+    const glm::dvec3 spawn = world->get_spawn_position();
+    const int64_t side = options.radius * 2 + 1;
+    const size_t total_chunks = size_t(side * side);
+
+    info("pregenerating {} chunks around [{}, {}] in DIM{}", total_chunks, spawn.x, spawn.z, options.dimension);
+
+    const auto start_time = std::chrono::steady_clock::now();
+    auto last_report_time = start_time;
+
+    scheduler.set_chunk_distance(options.radius);
+    dimension.load((int64_t)spawn.x, (int64_t)spawn.y, (int64_t)spawn.z, options.radius);
+
+    size_t generated = 0;
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        // Chunks are saved by the scheduler, keeping them in memory is not needed.
+        generated += dimension.discard_flushed_chunks();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_report_time >= std::chrono::seconds(1))
+        {
+            const double elapsed = std::chrono::duration<double>(now - start_time).count();
+            info("{}/{} chunks ({:.1f} chunks/s)", generated, total_chunks, double(generated) / elapsed);
+            last_report_time = now;
+        }
+
+        if (scheduler.is_idle())
+        {
+            generated += dimension.discard_flushed_chunks();
+            break;
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    const GenStats& stats = scheduler.stats();
+
+    info("generated {} chunks in {:.2f} s ({:.1f} chunks/s)", generated, elapsed, double(generated) / elapsed);
+    print_stage("preload", stats, GenStage::Preloaded);
+    info("  preload cache hits: {}", stats.preload_cache_hits.load());
+    print_stage("structures", stats, GenStage::Structures);
+    print_stage("realize", stats, GenStage::Realized);
+
+    info("task latency (p50 / p90 / p99):");
+    for (size_t i = 0; i < task_priority_count; i++)
+    {
+        const TaskLatency latency = Engine::get().get_thread_pool().latency(TaskPriority(i));
+        if (latency.count > 0)
+            info("  {}: {} samples, {} / {} / {} us", task_priority_name(TaskPriority(i)), latency.count, latency.p50_us, latency.p90_us, latency.p99_us);
+    }
+    info("peak memory usage: {:.1f} MiB", double(peak_memory_usage()) / (1024.0 * 1024.0));
+
+    return Result<void>();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Core/Result.hpp"
+
+#include <cstdint>
+#include <string>
+
+struct PregenOptions
+{
+    std::string world_name;
+    uint64_t seed = 0;
+
+    /**
+     * Radius in chunks around the spawn to generate.
+     */
+    int64_t radius = 16;
+    int dimension = 0;
+};
+
+/**
+ * Generate and save every chunk around the spawn of a world without a window or a renderer. The world is created if it
+ * does not exist yet. Throughput, time spent in each generation stage and the peak memory usage are reported.
+ */
+Result<void> pregenerate_world(const PregenOptions& options);
@@ -0,0 +1,269 @@
+#include "World/PreloadCache.hpp"
+
+#include "Core/Hash.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <string_view>
+
+// Region file layout:
+//   header: magic (u32), version (u32)
+//   slots:  `region_size * region_size` slots of `slot_size` bytes, indexed by `x + z * region_size`.
+//
+// Slots are written without synchronization, a slot whose checksum does not match (never preloaded, or torn by a crash)
+// is a miss. Version 1 slots had a `present` flag instead of the checksum, so they are all misses.
+static constexpr uint32_t region_magic = 0x52434c50; // "PLCR"
+static constexpr uint32_t region_version = 2;
+static constexpr size_t header_size = sizeof(uint32_t) * 2;
+
+struct PreloadSlot
+{
+    /**
+     * FNV-1a of the rest of the slot.
+     */
+    uint32_t checksum;
+    int16_t heights[16 * 16];
+    uint8_t biomes[16 * 16];
+};
+
+static constexpr size_t slot_size = sizeof(PreloadSlot);
+
+static uint32_t slot_checksum(const PreloadSlot& slot)
+{
+    const size_t offset = offsetof(PreloadSlot, heights);
+    return hash_fnv32(std::string_view((const char *)&slot + offset, sizeof(PreloadSlot) - offset));
+}
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t d = a / b;
+    if (a % b != 0 && (a < 0) != (b < 0))
+        d--;
+    return d;
+}
+
+static ChunkPos region_of(ChunkPos pos)
+{
+    return ChunkPos(floor_div(pos.x, PreloadCache::region_size), floor_div(pos.z, PreloadCache::region_size));
+}
+
+static size_t slot_offset(ChunkPos pos)
+{
+    const ChunkPos region = region_of(pos);
+    const int64_t x = pos.x - region.x * PreloadCache::region_size;
+    const int64_t z = pos.z - region.z * PreloadCache::region_size;
+    return header_size + size_t(x + z * PreloadCache::region_size) * slot_size;
+}
+
+PreloadCache::~PreloadCache()
+{
+    for (auto& [region, file] : m_files)
+        file.close();
+}
+
+void PreloadCache::set_directory(std::string directory, uint64_t fingerprint)
+{
+    std::lock_guard<std::mutex> lock(m_files_mutex);
+    m_directory = directory;
+    m_fingerprint = fingerprint;
+
+    // Opened for the previous generator.
+    for (auto& [region, file] : m_files)
+        file.close();
+    m_files.clear();
+}
+
+std::shared_ptr<PreLoadedChunk> PreloadCache::load(ChunkPos pos)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto iter = m_entries.find(pos);
+        if (iter != m_entries.end())
+        {
+            Entry& entry = iter->second;
+            if (!entry.pinned)
+                m_lru.splice(m_lru.begin(), m_lru, entry.lru_iter);
+            return entry.chunk;
+        }
+    }
+
+    return read_from_disk(pos);
+}
+
+std::shared_ptr<PreLoadedChunk> PreloadCache::get(ChunkPos pos)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto iter = m_entries.find(pos);
+    if (iter == m_entries.end())
+        return nullptr;
+    return iter->second.chunk;
+}
+
+bool PreloadCache::contains(ChunkPos pos)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.contains(pos);
+}
+
+void PreloadCache::insert(ChunkPos pos, std::shared_ptr<PreLoadedChunk> chunk)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto [iter, inserted] = m_entries.try_emplace(pos);
+    Entry& entry = iter->second;
+
+    if (!inserted && !entry.pinned)
+        m_lru.erase(entry.lru_iter);
+
+    entry.chunk = chunk;
+    entry.pinned = true;
+}
+
+void PreloadCache::release(ChunkPos pos)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto iter = m_entries.find(pos);
+    if (iter == m_entries.end() || !iter->second.pinned)
+        return;
+
+    iter->second.pinned = false;
+    m_lru.push_front(pos);
+    iter->second.lru_iter = m_lru.begin();
+
+    evict();
+}
+
+size_t PreloadCache::memory_usage()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size() * PreLoadedChunk::memory_size;
+}
+
+void PreloadCache::evict()
+{
+    if (m_entries.size() * PreLoadedChunk::memory_size <= m_memory_limit)
+        return;
+
+    // Evict more than needed, otherwise every release after reaching the limit would evict one chunk.
+    const size_t low_watermark = m_memory_limit / 4 * 3;
+
+    while (!m_lru.empty() && m_entries.size() * PreLoadedChunk::memory_size > low_watermark)
+    {
+        m_entries.erase(m_lru.back());
+        m_lru.pop_back();
+    }
+}
+
+File *PreloadCache::region_file(ChunkPos pos, bool create)
+{
+    if (m_directory.empty())
+        return nullptr;
+
+    const ChunkPos region = region_of(pos);
+
+    auto iter = m_files.find(region);
+    if (iter != m_files.end())
+        return &iter->second;
+
+    const std::string directory = std::format("{}preload/{:016x}/", m_directory, m_fingerprint);
+    const std::string path = std::format("{}{}.{}.dat", directory, region.x, region.z);
+    if (!create && !Filesystem::exists(path))
+        return nullptr;
+
+    if (create)
+    {
+        Result<void> result = Filesystem::make_dirs(directory);
+        if (result.has_error())
+            return nullptr;
+    }
+
+    Result<File> file_result = Filesystem::open_file(path, true);
+    if (file_result.has_error())
+        return nullptr;
+
+    File file = file_result.value();
+
+    bool write_header = file.size() == 0;
+    if (!write_header)
+    {
+        uint32_t header[2]{};
+        Result<size_t> read = file.read_at(header, sizeof(header), 0);
+        if (read.has_error() || read.value() != sizeof(header) || header[0] != region_magic || header[1] > region_version)
+        {
+            warn("ignoring invalid preload region `{}`", path);
+            file.close();
+            return nullptr;
+        }
+
+        // The slots of older versions fail the checksum, they are overwritten as their chunks are preloaded again.
+        write_header = header[1] != region_version;
+    }
+
+    if (write_header)
+    {
+        const uint32_t header[2] = {region_magic, region_version};
+        if (file.write_at(header, sizeof(header), 0).has_error())
+        {
+            file.close();
+            return nullptr;
+        }
+    }
+
+    return &m_files.emplace(region, file).first->second;
+}
+
+void PreloadCache::store(ChunkPos pos, const PreLoadedChunk& chunk)
+{
+    PreloadSlot slot{};
+
+    for (size_t i = 0; i < 16 * 16; i++)
+    {
+        slot.heights[i] = (int16_t)std::clamp<int64_t>(chunk.heights[i], INT16_MIN, INT16_MAX);
+        slot.biomes[i] = (uint8_t)chunk.biomes[i];
+    }
+    slot.checksum = slot_checksum(slot);
+
+    File *file;
+    {
+        std::lock_guard<std::mutex> lock(m_files_mutex);
+        file = region_file(pos, true);
+    }
+
+    if (file == nullptr)
+        return;
+
+    // Losing a slot is not an issue, it will be computed again.
+    (void)file->write_at(&slot, sizeof(slot), slot_offset(pos));
+}
+
+std::shared_ptr<PreLoadedChunk> PreloadCache::read_from_disk(ChunkPos pos)
+{
+    PreloadSlot slot{};
+
+    File *file;
+    {
+        std::lock_guard<std::mutex> lock(m_files_mutex);
+        file = region_file(pos, false);
+    }
+
+    if (file == nullptr)
+        return nullptr;
+
+    Result<size_t> read = file->read_at(&slot, sizeof(slot), slot_offset(pos));
+    if (read.has_error() || read.value() != sizeof(slot) || slot.checksum != slot_checksum(slot))
+        return nullptr;
+
+    std::shared_ptr<PreLoadedChunk> chunk = std::make_shared<PreLoadedChunk>();
+    for (size_t i = 0; i < 16 * 16; i++)
+    {
+        chunk->heights[i] = slot.heights[i];
+        chunk->biomes[i] = Biome(slot.biomes[i]);
+    }
+
+    return chunk;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Core/Filesystem.hpp"
+#include "World/Biome.hpp"
+#include "World/Chunk.hpp"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct PreLoadedChunk
+{
+    Biome *biomes;
+    int64_t *heights;
+
+    PreLoadedChunk()
+        : biomes(new Biome[16 * 16](Biome::Plain)), heights(new int64_t[16 * 16](0))
+    {
+    }
+
+    ~PreLoadedChunk()
+    {
+        delete[] biomes;
+        delete[] heights;
+    }
+
+    /**
+     * Approximation of the memory used by one preloaded chunk.
+     */
+    static constexpr size_t memory_size = sizeof(Biome *) + sizeof(int64_t *) + 16 * 16 * (sizeof(Biome) + sizeof(int64_t));
+};
+
+/**
+ * Keeps preloaded chunks (heights and biomes) around so that terrain noise is computed only once per column.
+ *
+ * Chunks used by the generation are pinned and always stay in memory. Released chunks are kept in a LRU list until the
+ * memory limit is reached, then the least recently used ones are evicted until the usage goes under the low watermark.
+ *
+ * Preloaded chunks are also stored on the disk, in region files of 32x32 chunks next to the chunk data, so reloading a
+ * world does not compute terrain noise again.
+ */
+class PreloadCache
+{
+public:
+    static constexpr int64_t region_size = 32;
+
+    PreloadCache(size_t memory_limit = 32 * 1024 * 1024)
+        : m_memory_limit(memory_limit)
+    {
+    }
+
+    ~PreloadCache();
+
+    /**
+     * Set the directory where region files are stored. If empty, nothing is stored on the disk. Region files are
+     * separated by the fingerprint of the generator, so changing the terrain does not reuse stale heights. Must be
+     * called before the cache is used, the region files opened before are closed.
+     */
+    void set_directory(std::string directory, uint64_t fingerprint);
+
+    /**
+     * Returns a preloaded chunk from the memory or the disk, or `nullptr` if it was never preloaded.
+     */
+    std::shared_ptr<PreLoadedChunk> load(ChunkPos pos);
+
+    /**
+     * Returns a preloaded chunk only if it is in memory.
+     */
+    std::shared_ptr<PreLoadedChunk> get(ChunkPos pos);
+
+    bool contains(ChunkPos pos);
+
+    /**
+     * Write a preloaded chunk to the disk.
+     */
+    void store(ChunkPos pos, const PreLoadedChunk& chunk);
+
+    /**
+     * Insert a chunk in memory and pin it, so it is never evicted.
+     */
+    void insert(ChunkPos pos, std::shared_ptr<PreLoadedChunk> chunk);
+
+    /**
+     * Unpin a chunk, it can now be evicted.
+     */
+    void release(ChunkPos pos);
+
+    size_t memory_usage();
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<PreLoadedChunk> chunk;
+        bool pinned = false;
+
+        /**
+         * Position in `m_lru`, only valid when the entry is not pinned.
+         */
+        std::list<ChunkPos>::iterator lru_iter;
+    };
+
+    size_t m_memory_limit;
+
+    std::mutex m_mutex;
+    std::map<ChunkPos, Entry> m_entries;
+
+    /**
+     * Released chunks, the most recently used first.
+     */
+    std::list<ChunkPos> m_lru;
+
+    std::mutex m_files_mutex;
+    std::string m_directory;
+    uint64_t m_fingerprint = 0;
+    std::map<ChunkPos, File> m_files;
+
+    void evict();
+
+    /**
+     * Returns the region file containing `pos`. If `create` is false and the file does not exist, `nullptr` is
+     * returned. `m_files_mutex` must be locked, the returned file stays valid until the cache is destroyed.
+     */
+    File *region_file(ChunkPos pos, bool create);
+
+    std::shared_ptr<PreLoadedChunk> read_from_disk(ChunkPos pos);
+};
@@ -0,0 +1,546 @@
+#include "World/Region.hpp"
+
+#include "Core/Hash.hpp"
+#include "Core/Logger.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <future>
+#include <string_view>
+
+// Region file layout, in sectors of `RegionFile::sector_size` bytes:
+//   header copy 0 (`header_sectors`), header copy 1 (`header_sectors`), chunk data...
+//
+// A header copy is a `HeaderPrefix` followed by one `SectorRange` per chunk, indexed by `x + z * RegionFile::size`. The
+// copy with the highest generation and a valid checksum is used. The data of a chunk starts with a `ChunkPrefix`.
+static constexpr uint32_t region_magic = 0x4e474552; // "REGN"
+static constexpr uint32_t region_version = 1;
+
+struct HeaderPrefix
+{
+    uint32_t magic;
+    uint32_t version;
+
+    /**
+     * FNV-1a of the rest of the header, from the generation to the end of the table.
+     */
+    uint32_t checksum;
+    uint32_t reserved;
+    uint64_t generation;
+};
+
+struct SectorRange
+{
+    uint32_t sector;
+    uint32_t count;
+};
+
+struct ChunkPrefix
+{
+    uint32_t size;
+    ChunkCompression compression;
+    uint8_t flags;
+    uint8_t reserved[2];
+};
+
+/**
+ * Flags of `ChunkPrefix`, chunks written before the flags existed have none.
+ */
+static constexpr uint8_t chunk_flag_generated = 1;
+
+static constexpr size_t header_size = sizeof(HeaderPrefix) + sizeof(SectorRange) * RegionFile::chunk_count;
+static constexpr size_t header_sectors = (header_size + RegionFile::sector_size - 1) / RegionFile::sector_size;
+static constexpr uint32_t first_data_sector = header_sectors * 2;
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t d = a / b;
+    if (a % b != 0 && (a < 0) != (b < 0))
+        d--;
+    return d;
+}
+
+static uint32_t header_checksum(const std::vector<uint8_t>& bytes)
+{
+    const size_t offset = offsetof(HeaderPrefix, generation);
+    return hash_fnv32(std::string_view((const char *)bytes.data() + offset, header_size - offset));
+}
+
+ChunkPos RegionFile::region_of(ChunkPos pos)
+{
+    return ChunkPos(floor_div(pos.x, size), floor_div(pos.z, size));
+}
+
+size_t RegionFile::index_of(ChunkPos pos)
+{
+    const ChunkPos region = region_of(pos);
+    return size_t((pos.x - region.x * size) + (pos.z - region.z * size) * size);
+}
+
+RegionFile::RegionFile(File file)
+    : m_file(file), m_file_size(file.size()), m_locations(chunk_count), m_used(first_data_sector, true)
+{
+}
+
+RegionFile::~RegionFile()
+{
+    m_file.close();
+}
+
+Result<std::shared_ptr<RegionFile>> RegionFile::open(const std::string& path, bool create)
+{
+    if (!create && !Filesystem::exists(path))
+        return Error(ErrorKind::FileNotFound);
+
+    File file = TRY(Filesystem::open_file(path, true));
+
+    std::shared_ptr<RegionFile> region(new RegionFile(file));
+    if (file.size() > 0)
+    {
+        Result<void> result = region->load_header();
+        if (result.has_error())
+        {
+            warn("invalid region file `{}`", path);
+            return result.error();
+        }
+    }
+
+    return region;
+}
+
+Result<void> RegionFile::load_header()
+{
+    std::vector<uint8_t> bytes(header_size);
+    std::vector<SectorRange> table(chunk_count);
+    bool found = false;
+
+    for (size_t copy = 0; copy < 2; copy++)
+    {
+        const size_t read = TRY(m_file.read_at(bytes.data(), header_size, copy * header_sectors * sector_size));
+        if (read != header_size)
+            continue;
+
+        HeaderPrefix prefix;
+        std::memcpy(&prefix, bytes.data(), sizeof(prefix));
+        std::memcpy(table.data(), bytes.data() + sizeof(prefix), sizeof(SectorRange) * chunk_count);
+
+        if (prefix.magic != region_magic || prefix.version != region_version || prefix.checksum != header_checksum(bytes))
+            continue;
+        if (found && prefix.generation <= m_generation)
+            continue;
+
+        found = true;
+        m_generation = prefix.generation;
+        for (size_t i = 0; i < chunk_count; i++)
+            m_locations[i] = Location{table[i].sector, table[i].count};
+    }
+
+    if (!found)
+        return Error(ErrorKind::InvalidData);
+
+    m_used.assign(first_data_sector, true);
+    for (const Location& location : m_locations)
+    {
+        if (location.sector == 0)
+            continue;
+        if (location.sector < first_data_sector)
+            return Error(ErrorKind::InvalidData);
+        mark(location, true);
+    }
+
+    return Result<void>();
+}
+
+Result<void> RegionFile::write_header()
+{
+    std::vector<SectorRange> table(chunk_count);
+    for (size_t i = 0; i < chunk_count; i++)
+        table[i] = SectorRange{m_locations[i].sector, m_locations[i].sector_count};
+
+    HeaderPrefix prefix{
+        .magic = region_magic,
+        .version = region_version,
+        .checksum = 0,
+        .reserved = 0,
+        .generation = m_generation,
+    };
+
+    std::vector<uint8_t> bytes(header_sectors * sector_size);
+    std::memcpy(bytes.data(), &prefix, sizeof(prefix));
+    std::memcpy(bytes.data() + sizeof(prefix), table.data(), sizeof(SectorRange) * chunk_count);
+
+    prefix.checksum = header_checksum(bytes);
+    std::memcpy(bytes.data(), &prefix, sizeof(prefix));
+
+    // Generations alternate between the two copies, the previous header stays intact.
+    TRY(m_file.write_at(bytes.data(), bytes.size(), (m_generation % 2) * header_sectors * sector_size));
+    TRY(m_file.sync());
+    return Result<void>();
+}
+
+Result<std::optional<RegionChunk>> RegionFile::read(ChunkPos pos) const
+{
+    const Location& location = m_locations[index_of(pos)];
+    if (location.sector == 0)
+        return std::optional<RegionChunk>();
+
+    std::vector<uint8_t> bytes((size_t)location.sector_count * sector_size);
+    const size_t read = TRY(m_file.read_at(bytes.data(), bytes.size(), (size_t)location.sector * sector_size));
+
+    ChunkPrefix prefix;
+    if (read < sizeof(prefix))
+        return Error(ErrorKind::InvalidData);
+    std::memcpy(&prefix, bytes.data(), sizeof(prefix));
+
+    if (sizeof(prefix) + prefix.size > read)
+        return Error(ErrorKind::InvalidData);
+
+    RegionChunk chunk;
+    chunk.compression = prefix.compression;
+    chunk.generated = (prefix.flags & chunk_flag_generated) != 0;
+    chunk.data.assign(bytes.begin() + sizeof(prefix), bytes.begin() + sizeof(prefix) + prefix.size);
+    return std::optional<RegionChunk>(std::move(chunk));
+}
+
+Result<std::optional<RegionChunkView>> RegionFile::view(ChunkPos pos)
+{
+    const Location& location = m_locations[index_of(pos)];
+    if (location.sector == 0)
+        return std::optional<RegionChunkView>();
+
+    // A header pointing past the end of the file would fault in the mapping instead of failing.
+    const size_t offset = (size_t)location.sector * sector_size;
+    const size_t end = std::min(offset + (size_t)location.sector_count * sector_size, m_file_size);
+    if (offset + sizeof(ChunkPrefix) > end)
+        return Error(ErrorKind::InvalidData);
+    TRY(map(end));
+
+    const uint8_t *bytes = m_mapping->data().data() + offset;
+
+    ChunkPrefix prefix;
+    std::memcpy(&prefix, bytes, sizeof(prefix));
+    if (sizeof(prefix) + prefix.size > end - offset)
+        return Error(ErrorKind::InvalidData);
+
+    return std::optional<RegionChunkView>(RegionChunkView{
+        .compression = prefix.compression,
+        .data = std::span(bytes + sizeof(prefix), prefix.size),
+        .generated = (prefix.flags & chunk_flag_generated) != 0,
+        .mapping = m_mapping,
+    });
+}
+
+void RegionFile::prefetch(ChunkPos min, ChunkPos max)
+{
+    std::vector<Location> locations;
+    for (int64_t x = min.x; x <= max.x; x++)
+    {
+        for (int64_t z = min.z; z <= max.z; z++)
+        {
+            const ChunkPos pos(x, z);
+            if (region_of(pos) != region_of(min))
+                continue;
+
+            const Location& location = m_locations[index_of(pos)];
+            if (location.sector != 0)
+                locations.push_back(location);
+        }
+    }
+
+    if (locations.empty() || map(m_file_size).has_error())
+        return;
+
+    // Sectors are read in the order of the file, neighbour chunks are often written next to each other.
+    std::sort(locations.begin(), locations.end(), [](const Location& a, const Location& b)
+              { return a.sector < b.sector; });
+
+    const bool whole_region = size_t(max.x - min.x + 1) * size_t(max.z - min.z + 1) == chunk_count;
+    if (whole_region)
+        m_mapping->advise(0, m_mapping->size(), FileMapping::Advice::Sequential);
+
+    size_t start = (size_t)locations[0].sector * sector_size;
+    size_t end = start;
+    for (const Location& location : locations)
+    {
+        const size_t offset = (size_t)location.sector * sector_size;
+        if (offset > end)
+        {
+            m_mapping->advise(start, end - start, FileMapping::Advice::WillNeed);
+            start = offset;
+        }
+        end = std::max(end, offset + (size_t)location.sector_count * sector_size);
+    }
+    m_mapping->advise(start, end - start, FileMapping::Advice::WillNeed);
+}
+
+Result<void> RegionFile::map(size_t end)
+{
+    if (m_mapping != nullptr && m_mapping->size() >= end)
+        return Result<void>();
+
+    // Views of the previous mapping keep it alive, its sectors may not be reused before they are gone.
+    std::shared_ptr<FileMapping> mapping = TRY(m_file.map(m_file_size));
+    if (m_mapping != nullptr)
+        m_old_mappings.push_back(std::move(m_mapping));
+    m_mapping = std::move(mapping);
+    return Result<void>();
+}
+
+bool RegionFile::has_views()
+{
+    std::erase_if(m_old_mappings, [](const std::shared_ptr<FileMapping>& mapping)
+                  { return mapping.use_count() == 1; });
+    if (!m_old_mappings.empty() || (m_mapping != nullptr && m_mapping.use_count() > 1))
+        return true;
+
+    // Pairs with the release of the last view, its reads are done before the sectors are written again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+}
+
+bool RegionFile::contains(ChunkPos pos) const
+{
+    return m_locations[index_of(pos)].sector != 0;
+}
+
+Result<void> RegionFile::write(const std::vector<std::pair<ChunkPos, const RegionChunk *>>& chunks)
+{
+    if (!m_quarantine.empty() && !has_views())
+    {
+        for (const Location& location : m_quarantine)
+            mark(location, false);
+        m_quarantine.clear();
+    }
+
+    std::vector<Location> new_locations = m_locations;
+    std::vector<Location> freed;
+
+    for (const auto& [pos, chunk] : chunks)
+    {
+        const size_t size = sizeof(ChunkPrefix) + chunk->data.size();
+        const uint32_t count = uint32_t((size + sector_size - 1) / sector_size);
+        const uint32_t sector = allocate(count);
+
+        // Sectors allocated in this write stay used even if the write fails, they are reclaimed on the next open.
+        mark(Location{sector, count}, true);
+
+        std::vector<uint8_t> bytes((size_t)count * sector_size);
+        const ChunkPrefix prefix{
+            .size = (uint32_t)chunk->data.size(),
+            .compression = chunk->compression,
+            .flags = chunk->generated ? chunk_flag_generated : uint8_t(0),
+            .reserved = {},
+        };
+        std::memcpy(bytes.data(), &prefix, sizeof(prefix));
+        if (!chunk->data.empty())
+            std::memcpy(bytes.data() + sizeof(prefix), chunk->data.data(), chunk->data.size());
+        TRY(m_file.write_at(bytes.data(), bytes.size(), (size_t)sector * sector_size));
+        m_file_size = std::max(m_file_size, ((size_t)sector + count) * sector_size);
+
+        Location& location = new_locations[index_of(pos)];
+        if (location.sector != 0)
+            freed.push_back(location);
+        location = Location{sector, count};
+    }
+
+    // The data must be on the disk before the header pointing to it.
+    TRY(m_file.sync());
+
+    m_generation++;
+    std::swap(m_locations, new_locations);
+    Result<void> result = write_header();
+    if (result.has_error())
+    {
+        m_generation--;
+        std::swap(m_locations, new_locations);
+        return result;
+    }
+
+    if (has_views())
+        m_quarantine.insert(m_quarantine.end(), freed.begin(), freed.end());
+    else
+    {
+        for (const Location& location : freed)
+            mark(location, false);
+    }
+
+    return Result<void>();
+}
+
+uint32_t RegionFile::allocate(uint32_t count)
+{
+    // First fit, or at the end of the file.
+    uint32_t run = 0;
+    for (uint32_t i = first_data_sector; i < m_used.size(); i++)
+    {
+        run = m_used[i] ? 0 : run + 1;
+        if (run == count)
+            return i + 1 - count;
+    }
+
+    return uint32_t(m_used.size()) - run;
+}
+
+void RegionFile::mark(Location location, bool used)
+{
+    if (m_used.size() < (size_t)location.sector + location.sector_count)
+        m_used.resize((size_t)location.sector + location.sector_count, false);
+
+    for (uint32_t i = 0; i < location.sector_count; i++)
+        m_used[location.sector + i] = used;
+}
+
+RegionStore::RegionStore(IOService& io, std::string directory)
+    : m_io(io), m_directory(std::move(directory))
+{
+}
+
+void RegionStore::write(ChunkPos pos, RegionChunk chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+
+        // A newer save of the same chunk replaces the one not written yet.
+        m_pending[pos] = std::move(chunk);
+        if (m_write_queued)
+            return;
+        m_write_queued = true;
+    }
+
+    m_io.run([store = shared_from_this()]()
+             { store->write_pending(); });
+}
+
+Result<std::optional<RegionChunk>> RegionStore::read_wait(ChunkPos pos)
+{
+    std::promise<Result<std::optional<RegionChunk>>> promise;
+    std::future<Result<std::optional<RegionChunk>>> future = promise.get_future();
+
+    m_io.run([this, pos, &promise]()
+             {
+                 Result<RegionFile *> file = this->file(RegionFile::region_of(pos), false);
+                 if (file.has_error())
+                     promise.set_value(file.error().kind() == ErrorKind::FileNotFound ? Result<std::optional<RegionChunk>>(std::optional<RegionChunk>()) : file.error());
+                 else
+                     promise.set_value(file.value()->read(pos)); });
+
+    return future.get();
+}
+
+Result<std::optional<RegionChunkView>> RegionStore::view_wait(ChunkPos pos)
+{
+    std::promise<Result<std::optional<RegionChunkView>>> promise;
+    std::future<Result<std::optional<RegionChunkView>>> future = promise.get_future();
+
+    // Only finding the chunk in the mapping happens on the I/O thread, the caller decodes it.
+    m_io.run([this, pos, &promise]()
+             {
+                 Result<RegionFile *> file = this->file(RegionFile::region_of(pos), false);
+                 if (file.has_error())
+                     promise.set_value(file.error().kind() == ErrorKind::FileNotFound ? Result<std::optional<RegionChunkView>>(std::optional<RegionChunkView>()) : file.error());
+                 else
+                     promise.set_value(file.value()->view(pos)); });
+
+    return future.get();
+}
+
+void RegionStore::prefetch(ChunkPos min, ChunkPos max)
+{
+    m_io.run([store = shared_from_this(), min, max]()
+             {
+                 const ChunkPos min_region = RegionFile::region_of(min);
+                 const ChunkPos max_region = RegionFile::region_of(max);
+                 for (int64_t x = min_region.x; x <= max_region.x; x++)
+                 {
+                     for (int64_t z = min_region.z; z <= max_region.z; z++)
+                     {
+                         Result<RegionFile *> file = store->file(ChunkPos(x, z), false);
+                         if (file.has_error())
+                             continue;
+
+                         // Clamped to the region, `RegionFile::prefetch` only reads its own chunks.
+                         const ChunkPos region_min(std::max(min.x, x * RegionFile::size), std::max(min.z, z * RegionFile::size));
+                         const ChunkPos region_max(std::min(max.x, x * RegionFile::size + RegionFile::size - 1), std::min(max.z, z * RegionFile::size + RegionFile::size - 1));
+                         file.value()->prefetch(region_min, region_max);
+                     }
+                 } });
+}
+
+std::set<ChunkPos> RegionStore::failed_writes()
+{
+    std::lock_guard<std::mutex> lock(m_pending_mutex);
+    return m_failed;
+}
+
+Result<RegionFile *> RegionStore::file(ChunkPos region, bool create)
+{
+    auto iter = m_files.find(region);
+    if (iter != m_files.end())
+        return iter->second.get();
+
+    if (create)
+        TRY(Filesystem::make_dirs(m_directory));
+
+    std::shared_ptr<RegionFile> file = TRY(RegionFile::open(std::format("{}r.{}.{}.dat", m_directory, region.x, region.z), create));
+    return m_files.emplace(region, std::move(file)).first->second.get();
+}
+
+void RegionStore::write_pending()
+{
+    ZoneScoped;
+
+    std::map<ChunkPos, RegionChunk> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+        pending.swap(m_pending);
+        m_write_queued = false;
+    }
+
+    // Chunks of the same region are next to each other in the map only by rows, so they are grouped first.
+    std::map<ChunkPos, std::vector<std::pair<ChunkPos, const RegionChunk *>>> regions;
+    for (const auto& [pos, chunk] : pending)
+        regions[RegionFile::region_of(pos)].push_back({pos, &chunk});
+
+    std::vector<ChunkPos> failed;
+    for (const auto& [region, chunks] : regions)
+    {
+        Result<RegionFile *> file = this->file(region, true);
+        Result<void> result = file.has_value() ? file.value()->write(chunks) : Result<void>(file.error());
+        if (result.has_error())
+        {
+            error("failed to save {} chunks of region {} {} in `{}`", chunks.size(), region.x, region.z, m_directory);
+            result.error().print();
+
+            for (const auto& [pos, chunk] : chunks)
+                failed.push_back(pos);
+        }
+    }
+
+    m_write_failures = failed.empty() ? 0 : m_write_failures + 1;
+    const bool retry = !failed.empty() && m_write_failures <= max_write_retries;
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+
+        for (const auto& [pos, chunk] : pending)
+            m_failed.erase(pos);
+
+        // Failed chunks are written again with the next batch, unless a newer save of them is already waiting.
+        for (ChunkPos pos : failed)
+        {
+            m_failed.insert(pos);
+            m_pending.try_emplace(pos, std::move(pending.at(pos)));
+        }
+
+        // After a few failures in a row the error is unlikely to be transient, the next save retries them instead.
+        if (!retry || m_write_queued)
+            return;
+        m_write_queued = true;
+    }
+
+    m_io.run([store = shared_from_this()]()
+             { store->write_pending(); });
+}
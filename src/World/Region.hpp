@@ -0,0 +1,216 @@
+#pragma once
+
+#include "Core/Filesystem.hpp"
+#include "Core/IOService.hpp"
+#include "Core/Result.hpp"
+#include "World/Chunk.hpp"
+#include "World/ChunkCodec.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Saved data of a chunk, as stored in a region file.
+ */
+struct RegionChunk
+{
+    ChunkCompression compression = ChunkCompression::None;
+    std::vector<uint8_t> data;
+
+    /**
+     * Saved right after its generation and never modified since, it can be generated again instead of being stored.
+     */
+    bool generated = false;
+};
+
+/**
+ * Saved data of a chunk read in place from the mapping of its region file, without copying it.
+ */
+struct RegionChunkView
+{
+    ChunkCompression compression = ChunkCompression::None;
+    std::span<const uint8_t> data;
+    bool generated = false;
+
+    /**
+     * Keeps `data` mapped, and its sectors from being reused by later writes.
+     */
+    std::shared_ptr<const FileMapping> mapping;
+};
+
+/**
+ * File storing the chunks of a 32x32 area.
+ *
+ * The file is divided in sectors of 4 KiB. The first sectors hold two copies of the header, each one with a table of
+ * the sectors used by every chunk, a generation and a checksum. A chunk is never written over its previous sectors:
+ * new data goes to free sectors, then the older header copy is replaced. If a crash tears the header, the other copy is
+ * still valid and points to the previous data.
+ */
+class RegionFile
+{
+public:
+    static constexpr int64_t size = 32;
+    static constexpr size_t chunk_count = size * size;
+    static constexpr size_t sector_size = 4096;
+
+    /**
+     * Open or create the region file at `path`. Returns `FileNotFound` if it does not exist and `create` is false.
+     */
+    static Result<std::shared_ptr<RegionFile>> open(const std::string& path, bool create);
+
+    ~RegionFile();
+
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    /**
+     * Returns nothing if the chunk was never saved.
+     */
+    Result<std::optional<RegionChunk>> read(ChunkPos pos) const;
+
+    /**
+     * Same as `read` but the data stays in the mapping of the file. Sectors of a chunk replaced while views exist are
+     * only reused once they are all destroyed.
+     */
+    Result<std::optional<RegionChunkView>> view(ChunkPos pos);
+
+    /**
+     * Start reading the chunks between `min` and `max` (inclusive) in the background, before loading all of them.
+     */
+    void prefetch(ChunkPos min, ChunkPos max);
+
+    /**
+     * Write chunks of this region. They are all committed by a single header update.
+     */
+    Result<void> write(const std::vector<std::pair<ChunkPos, const RegionChunk *>>& chunks);
+
+    bool contains(ChunkPos pos) const;
+
+    /**
+     * Number of sectors of the file, used or not.
+     */
+    size_t sector_count() const { return m_used.size(); }
+
+    static ChunkPos region_of(ChunkPos pos);
+
+private:
+    struct Location
+    {
+        /**
+         * First sector of the chunk, 0 if the chunk was never saved.
+         */
+        uint32_t sector = 0;
+        uint32_t sector_count = 0;
+    };
+
+    File m_file;
+    size_t m_file_size = 0;
+    uint64_t m_generation = 0;
+    std::vector<Location> m_locations;
+
+    /**
+     * One entry per sector of the file.
+     */
+    std::vector<bool> m_used;
+
+    /**
+     * Mapping of the file, replaced by a larger one when the file grows.
+     */
+    std::shared_ptr<FileMapping> m_mapping;
+    std::vector<std::shared_ptr<FileMapping>> m_old_mappings;
+
+    /**
+     * Sectors freed while views may still read them.
+     */
+    std::vector<Location> m_quarantine;
+
+    RegionFile(File file);
+
+    /**
+     * Map the file up to `end` at least.
+     */
+    Result<void> map(size_t end);
+
+    bool has_views();
+
+    Result<void> load_header();
+    Result<void> write_header();
+
+    uint32_t allocate(uint32_t count);
+    void mark(Location location, bool used);
+
+    static size_t index_of(ChunkPos pos);
+};
+
+/**
+ * Region files of a dimension, accessed on the I/O thread.
+ *
+ * Saves are queued and written by a single I/O job, chunks saved while the previous job runs are grouped in the next
+ * one. Reads are ordered after the saves queued before them. Chunks whose save failed are kept and written again with a
+ * later batch.
+ */
+class RegionStore : public std::enable_shared_from_this<RegionStore>
+{
+public:
+    RegionStore(IOService& io, std::string directory);
+
+    void write(ChunkPos pos, RegionChunk chunk);
+
+    /**
+     * Read a chunk and wait for the result. Returns nothing if the chunk was never saved.
+     */
+    Result<std::optional<RegionChunk>> read_wait(ChunkPos pos);
+
+    /**
+     * Same as `read_wait` but without copying the data, which is decoded straight from the mapping of the file.
+     */
+    Result<std::optional<RegionChunkView>> view_wait(ChunkPos pos);
+
+    /**
+     * Start reading the saved chunks between `min` and `max` (inclusive) in the background, ex: before loading a
+     * whole area after a teleport or for a pregeneration.
+     */
+    void prefetch(ChunkPos min, ChunkPos max);
+
+    /**
+     * Chunks whose last save failed, they are not on the disk until a later batch writes them. Called in a job of the
+     * I/O thread or after `IOService::flush`, the result covers every save queued before.
+     */
+    std::set<ChunkPos> failed_writes();
+
+    const std::string& directory() const { return m_directory; }
+
+private:
+    IOService& m_io;
+    std::string m_directory;
+
+    /**
+     * Batches that failed in a row before the failed chunks are only retried with the next save.
+     */
+    static constexpr uint32_t max_write_retries = 3;
+
+    std::mutex m_pending_mutex;
+    std::map<ChunkPos, RegionChunk> m_pending;
+    std::set<ChunkPos> m_failed;
+    bool m_write_queued = false;
+
+    /**
+     * Only used on the I/O thread.
+     */
+    std::map<ChunkPos, std::shared_ptr<RegionFile>> m_files;
+    uint32_t m_write_failures = 0;
+
+    /**
+     * Returns the file of `region`, or `nullptr` if it does not exist and `create` is false.
+     */
+    Result<RegionFile *> file(ChunkPos region, bool create);
+
+    void write_pending();
+};
@@ -21,7 +21,18 @@ constexpr int two_d_to_1d(int x, int y, int w)
 
 Result<std::shared_ptr<Entity>> EntityRegistry::create_entity(ClassHashCode class_hash)
 {
-    return m_entries[class_hash].c();
+    auto iter = m_entries.find(class_hash);
+    if (iter == m_entries.end())
+        return Error(ErrorKind::InvalidData);
+    return iter->second.c();
+}
+
+Result<std::shared_ptr<Entity>> EntityRegistry::create_entity(std::string_view class_name)
+{
+    auto iter = m_class_names.find(class_name);
+    if (iter == m_class_names.end())
+        return Error(ErrorKind::InvalidData);
+    return create_entity(iter->second);
 }
 
 GameRegistry::GameRegistry()
@@ -31,6 +42,7 @@ GameRegistry::GameRegistry()
 
 #define TEX(name) ("assets/textures/" name ".png")
 #define STRUCT(name) ("assets/structures/" name ".yml")
+#define WORLDGEN(name) ("assets/worldgen/" name ".yml")
 
 void GameRegistry::register_all()
 {
@@ -59,12 +71,20 @@ void GameRegistry::register_all()
     add_item(Items::crystal, std::make_shared<CrystalItem>());
 
     add_structure("tree", Structure::load(STRUCT("tree")));
+
+    add_density_graph("overworld", EXPECT(DensityGraph::load(WORLDGEN("overworld"))));
+    add_density_graph("underworld", EXPECT(DensityGraph::load(WORLDGEN("underworld"))));
 }
 
-Result<void> GameRegistry::post_register()
+void GameRegistry::assign_runtime_ids()
 {
     for (size_t id = 1; id < m_block_runtime_ids.size(); id++)
         m_blocks[m_block_runtime_ids[id]]->set_runtime_id(RuntimeId<Block>(id));
+}
+
+Result<void> GameRegistry::post_register()
+{
+    assign_runtime_ids();
 
     uint32_t mip_level = 1;
     m_texture_array = TRY(Texture::create(16, 16, WGPUTextureFormat_RGBA8Unorm, WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding, WGPUTextureDimension_2D, m_images.size() + 1, mip_level));
@@ -122,6 +142,11 @@ void GameRegistry::add_structure(std::string_view name, std::shared_ptr<Structur
     m_structures[std::string(name)] = structure;
 }
 
+void GameRegistry::add_density_graph(std::string_view name, std::shared_ptr<DensityGraph> graph)
+{
+    m_density_graphs[std::string(name)] = graph;
+}
+
 std::optional<Id<Block>> GameRegistry::to_block(Id<Item> id)
 {
     if (!id.valid())
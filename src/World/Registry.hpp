@@ -6,6 +6,7 @@
 #include "Item/ItemStack.hpp"
 #include "Render/Renderer.hpp"
 #include "Structure.hpp"
+#include "World/Density.hpp"
 
 #include <memory>
 #include <stb_image.h>
@@ -52,6 +53,7 @@ public:
         // T::bind_methods();
         m_entries[T::get_static_hash_code()] = Entry{.c = []() -> std::shared_ptr<Entity>
                                                      { return std::make_shared<T>(); }};
+        m_class_names[T::get_static_class_name()] = T::get_static_hash_code();
     }
 
     template <typename T>
@@ -59,12 +61,20 @@ public:
     {
         m_entries[T::get_static_hash_code()] = Entry{.c = []() -> std::shared_ptr<Entity>
                                                      { return std::make_shared<T>(); }};
+        m_class_names[T::get_static_class_name()] = T::get_static_hash_code();
     }
 
     Result<std::shared_ptr<Entity>> create_entity(ClassHashCode class_hash);
 
+    /**
+     * Create an entity from the name of its class, the hash of a class depends on the path of its source file and is
+     * not saved.
+     */
+    Result<std::shared_ptr<Entity>> create_entity(std::string_view class_name);
+
 private:
     std::map<ClassHashCode, Entry> m_entries;
+    stdext::string_map<ClassHashCode> m_class_names;
 };
 
 namespace Blocks
@@ -110,11 +120,21 @@ public:
     GameRegistry();
 
     void register_all();
+
+    /**
+     * Assign runtime ids to registered blocks. This does not need a renderer.
+     */
+    void assign_runtime_ids();
+
+    /**
+     * Assign runtime ids and create GPU resources of registered blocks and items.
+     */
     Result<void> post_register();
 
     void add_block(Id<Block> id, std::shared_ptr<Block> block);
     void add_item(Id<Item> id, std::shared_ptr<Item> item);
     void add_structure(std::string_view name, std::shared_ptr<Structure> structure);
+    void add_density_graph(std::string_view name, std::shared_ptr<DensityGraph> graph);
 
     std::shared_ptr<Block> get_block(Id<Block> key) const { return m_blocks.at(key); }
 
@@ -131,6 +151,7 @@ public:
         return m_items.at(key);
     }
     std::shared_ptr<Structure> get_struct(std::string_view name) const { return m_structures.find(name)->second; }
+    std::shared_ptr<DensityGraph> get_density_graph(std::string_view name) const { return m_density_graphs.find(name)->second; }
 
     Id<Block> from_runtime_id(RuntimeId<Block> id) const
     {
@@ -203,6 +224,7 @@ private:
     std::map<Id<Item>, std::shared_ptr<Item>> m_items;
 
     stdext::string_map<std::shared_ptr<Structure>> m_structures;
+    stdext::string_map<std::shared_ptr<DensityGraph>> m_density_graphs;
 
     std::map<Id<Block>, Id<Item>> m_block_items;
 
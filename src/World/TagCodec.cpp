@@ -0,0 +1,345 @@
+#include "World/TagCodec.hpp"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+// Columnar format, all integers little-endian:
+//   uint32_t magic, uint32_t version, uint32_t name count
+//   for each name:   uint16_t size, name
+//   for each name:   uint32_t block count
+//                    uint32_t size, varint deltas between the sorted block indices, the first one from 0
+//                    uint8_t value kind, then the values of the blocks in the same order
+//
+// Files written before had no magic, their first 4 bytes are the type of the variant map.
+static constexpr uint32_t tags_magic = 0x53474154; // "TAGS"
+
+enum class ValueKind : uint8_t
+{
+    /**
+     * Every block has the same value, stored once.
+     */
+    Constant = 0,
+
+    /**
+     * uint32_t size, then a zigzag varint per block.
+     */
+    Integer = 1,
+
+    /**
+     * A variant per block.
+     */
+    Variant = 2,
+};
+
+struct Column
+{
+    std::vector<uint16_t> indices;
+    std::vector<const Variant *> values;
+};
+
+/**
+ * Largest varint of a delta between two block indices.
+ */
+static constexpr size_t max_index_varint_size = 3;
+static constexpr size_t max_varint_size = 10;
+
+template <typename T>
+static Result<void> write_value(Writer& writer, T value)
+{
+    TRY(writer.write_raw(&value, sizeof(T)));
+    return Result<void>();
+}
+
+template <typename T>
+static Result<T> read_value(Reader& reader)
+{
+    T value;
+    if (TRY(reader.read_raw(&value, sizeof(T))) != sizeof(T))
+        return Error(ErrorKind::InvalidData);
+    return value;
+}
+
+static void write_varint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static Result<uint64_t> read_varint(std::span<const uint8_t> data, size_t& offset)
+{
+    uint64_t value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7)
+    {
+        if (offset >= data.size())
+            return Error(ErrorKind::InvalidData);
+
+        const uint8_t byte = data[offset++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    return Error(ErrorKind::InvalidData);
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+/**
+ * Write `bytes` prefixed by their size.
+ */
+static Result<void> write_blob(Writer& writer, std::span<const uint8_t> bytes)
+{
+    TRY(write_value(writer, (uint32_t)bytes.size()));
+    if (!bytes.empty())
+        TRY(writer.write_raw(bytes.data(), bytes.size()));
+    return Result<void>();
+}
+
+/**
+ * Read bytes written by `write_blob` into `bytes`, at most `max_size` of them.
+ */
+static Result<void> read_blob(Reader& reader, std::vector<uint8_t>& bytes, size_t max_size)
+{
+    const uint32_t size = TRY(read_value<uint32_t>(reader));
+    if (size > max_size)
+        return Error(ErrorKind::InvalidData);
+
+    bytes.resize(size);
+    if (size > 0 && TRY(reader.read_raw(bytes.data(), size)) != size)
+        return Error(ErrorKind::InvalidData);
+    return Result<void>();
+}
+
+/**
+ * Whether `==` compares the values of variants of this type, it aborts on doubles and is always false for vectors.
+ */
+static bool is_comparable(const Variant& value)
+{
+    return value.has(VariantType::Null) || value.has(VariantType::Bool) || value.has(VariantType::Integer) ||
+           value.has(VariantType::String);
+}
+
+static Result<void> encode_column(Writer& writer, const Column& column, std::vector<uint8_t>& scratch)
+{
+    TRY(write_value(writer, (uint32_t)column.indices.size()));
+
+    scratch.clear();
+    uint16_t previous = 0;
+    for (uint16_t index : column.indices)
+    {
+        write_varint(scratch, index - previous);
+        previous = index;
+    }
+    TRY(write_blob(writer, scratch));
+
+    bool constant = true;
+    bool integers = true;
+    for (const Variant *value : column.values)
+    {
+        constant = constant && is_comparable(*value) && *value == *column.values[0];
+        integers = integers && value->has(VariantType::Integer);
+    }
+
+    if (constant)
+    {
+        TRY(write_value(writer, ValueKind::Constant));
+        TRY(writer.write_variant(*column.values[0]));
+    }
+    else if (integers)
+    {
+        TRY(write_value(writer, ValueKind::Integer));
+
+        scratch.clear();
+        for (const Variant *value : column.values)
+            write_varint(scratch, zigzag(value->get_unchecked<int64_t>()));
+        TRY(write_blob(writer, scratch));
+    }
+    else
+    {
+        TRY(write_value(writer, ValueKind::Variant));
+        for (const Variant *value : column.values)
+            TRY(writer.write_variant(*value));
+    }
+
+    return Result<void>();
+}
+
+static Result<void> decode_column(Reader& reader, const std::string& name, std::map<int64_t, BlockTags>& tags, std::vector<uint8_t>& scratch)
+{
+    const uint32_t count = TRY(read_value<uint32_t>(reader));
+    if (count == 0 || count > Chunk::block_count)
+        return Error(ErrorKind::InvalidData);
+
+    TRY(read_blob(reader, scratch, count * max_index_varint_size));
+
+    std::vector<uint16_t> indices(count);
+    size_t offset = 0;
+    uint64_t index = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // Indices are strictly increasing, a block has a tag once.
+        const uint64_t delta = TRY(read_varint(scratch, offset));
+        if ((i > 0 && delta == 0) || delta >= Chunk::block_count)
+            return Error(ErrorKind::InvalidData);
+
+        index += delta;
+        if (index >= Chunk::block_count)
+            return Error(ErrorKind::InvalidData);
+        indices[i] = (uint16_t)index;
+    }
+
+    // Indices are sorted, each block goes right before the one after the previous block.
+    std::map<int64_t, BlockTags>::iterator hint = tags.begin();
+    auto block_tags = [&](uint16_t block) -> stdext::string_map<Variant>&
+    {
+        auto iter = tags.try_emplace(hint, block);
+        hint = std::next(iter);
+        return iter->second.tags;
+    };
+
+    const ValueKind kind = TRY(read_value<ValueKind>(reader));
+    switch (kind)
+    {
+    case ValueKind::Constant:
+    {
+        std::optional<Variant> value = TRY(reader.read_variant());
+        if (!value.has_value())
+            return Error(ErrorKind::InvalidData);
+
+        for (uint16_t block : indices)
+            block_tags(block)[name] = value.value();
+    }
+    break;
+    case ValueKind::Integer:
+    {
+        TRY(read_blob(reader, scratch, count * max_varint_size));
+
+        offset = 0;
+        for (uint16_t block : indices)
+            block_tags(block)[name] = Variant(unzigzag(TRY(read_varint(scratch, offset))));
+    }
+    break;
+    case ValueKind::Variant:
+        for (uint16_t block : indices)
+        {
+            std::optional<Variant> value = TRY(reader.read_variant());
+            if (!value.has_value())
+                return Error(ErrorKind::InvalidData);
+
+            block_tags(block)[name] = value.value();
+        }
+        break;
+    default:
+        return Error(ErrorKind::InvalidData);
+    }
+
+    return Result<void>();
+}
+
+/**
+ * Rest of the map of variants written before the columnar format, after its type.
+ */
+static Result<void> decode_legacy(Reader& reader, std::map<int64_t, BlockTags>& tags)
+{
+    const uint32_t size = TRY(read_value<uint32_t>(reader));
+    for (uint32_t i = 0; i < size; i++)
+    {
+        std::optional<Variant> key = TRY(reader.read_variant());
+        std::optional<Variant> value = TRY(reader.read_variant());
+        if (!key.has_value() || !key->has(VariantType::Integer) || !value.has_value() || !value->has(VariantType::Map))
+            return Error(ErrorKind::InvalidData);
+
+        BlockTags& block_tags = tags[key->get_unchecked<int64_t>()];
+        for (const auto& [name, tag] : value->get_unchecked<std::map<Variant, Variant>>())
+        {
+            if (!name.has(VariantType::String))
+                return Error(ErrorKind::InvalidData);
+            block_tags.tags[name.get_unchecked<std::string>()] = tag;
+        }
+    }
+
+    return Result<void>();
+}
+
+void TagCodec::encode(Writer& writer, const std::map<int64_t, BlockTags>& tags)
+{
+    // Sorted by name so the same tags always give the same bytes.
+    std::map<std::string_view, Column> columns;
+    for (const auto& [index, block_tags] : tags)
+    {
+        for (const auto& [name, value] : block_tags.tags)
+        {
+            Column& column = columns[name];
+            column.indices.push_back((uint16_t)index);
+            column.values.push_back(&value);
+        }
+    }
+
+    EXPECT(write_value(writer, tags_magic));
+    EXPECT(write_value(writer, version));
+    EXPECT(write_value(writer, (uint32_t)columns.size()));
+
+    for (const auto& [name, column] : columns)
+    {
+        const uint16_t size = (uint16_t)std::min<size_t>(name.size(), UINT16_MAX);
+        EXPECT(write_value(writer, size));
+        EXPECT(writer.write_raw(name.data(), size));
+    }
+
+    std::vector<uint8_t> scratch;
+    for (const auto& [name, column] : columns)
+        EXPECT(encode_column(writer, column, scratch));
+}
+
+Result<void> TagCodec::decode(Reader& reader, std::map<int64_t, BlockTags>& tags)
+{
+    uint32_t magic;
+    const size_t read = TRY(reader.read_raw(&magic, sizeof(uint32_t)));
+    if (read == 0)
+        return Result<void>();
+    if (read != sizeof(uint32_t))
+        return Error(ErrorKind::InvalidData);
+
+    if (magic != tags_magic)
+    {
+        if (VariantType((uint8_t)magic) != VariantType::Map)
+            return Error(ErrorKind::InvalidData);
+        return decode_legacy(reader, tags);
+    }
+
+    if (TRY(read_value<uint32_t>(reader)) > version)
+        return Error(ErrorKind::InvalidData);
+
+    const uint32_t name_count = TRY(read_value<uint32_t>(reader));
+    if (name_count > Chunk::block_count)
+        return Error(ErrorKind::InvalidData);
+
+    std::vector<std::string> names;
+    names.reserve(name_count);
+    for (uint32_t i = 0; i < name_count; i++)
+    {
+        const uint16_t size = TRY(read_value<uint16_t>(reader));
+        std::string name(size, '\0');
+        if (size > 0 && TRY(reader.read_raw(name.data(), size)) != size)
+            return Error(ErrorKind::InvalidData);
+        names.push_back(std::move(name));
+    }
+
+    std::vector<uint8_t> scratch;
+    for (const std::string& name : names)
+        TRY(decode_column(reader, name, tags, scratch));
+
+    return Result<void>();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Core/IO.hpp"
+#include "Core/Result.hpp"
+#include "World/Chunk.hpp"
+
+#include <cstdint>
+#include <map>
+
+/**
+ * Serialized form of the tags of a chunk, saved with its blocks and sent with them to the clients.
+ *
+ * Tags are stored by column: a table of the tag names, then for each name the sorted indices of the blocks having it,
+ * delta-encoded, and a column of their values. Chunks full of water store one byte or two per water block instead of a
+ * map of strings per block.
+ */
+class TagCodec
+{
+public:
+    /**
+     * Written after the magic, bumped on each change of the format. Older versions must stay readable.
+     */
+    static constexpr uint32_t version = 1;
+
+    static void encode(Writer& writer, const std::map<int64_t, BlockTags>& tags);
+
+    /**
+     * Read tags written by `encode`, or by the map of variants saved before the columnar format.
+     */
+    static Result<void> decode(Reader& reader, std::map<int64_t, BlockTags>& tags);
+};
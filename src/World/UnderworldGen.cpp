@@ -4,28 +4,37 @@
 #include "World/Dimension.hpp"
 #include "World/Registry.hpp"
 
+#include <array>
+
 UnderworldGen::UnderworldGen(WorldSettings settings)
     : Gen(settings)
 {
+    static constexpr std::array<std::string_view, 1> outputs{"height"};
+    m_terrain = EXPECT(DensityProgram::compile(*Engine::get().registry().get_density_graph("underworld"), settings.seed, outputs));
 }
 
 void UnderworldGen::preload(int64_t cx, int64_t cz, std::shared_ptr<PreLoadedChunk> chunk)
 {
-    (void)cx;
-    (void)cz;
+    thread_local DensityContext context;
+    m_terrain->evaluate(DensityGrid::columns(cx, cz), context);
+
+    std::span<const float> heights = context.output(0);
 
     for (size_t i = 0; i < 16 * 16; i++)
+    {
+        chunk->heights[i] = int64_t(heights[i]);
         chunk->biomes[i] = Biome::Underworld;
+    }
 }
 
 void UnderworldGen::generate_chunk(std::shared_ptr<Chunk> chunk, std::shared_ptr<PreLoadedChunk> preloaded_chunk, Dimension& dim)
 {
-    (void)chunk;
-    (void)preloaded_chunk;
     (void)dim;
 
-    for (int64_t y = 0; y < 70; y++)
-        for (int64_t x = 0; x < 16; x++)
-            for (int64_t z = 0; z < 16; z++)
-                chunk->get_blocks()[x + y * Chunk::width + z * Chunk::width * Chunk::height] = Engine::get().registry().get_default_state(Blocks::stone);
+    const BlockState stone = Engine::get().registry().get_default_state(Blocks::stone);
+
+    for (int64_t x = 0; x < 16; x++)
+        for (int64_t z = 0; z < 16; z++)
+            for (int64_t y = 0; y < preloaded_chunk->heights[x + z * 16]; y++)
+                chunk->get_blocks()[x + y * Chunk::width + z * Chunk::width * Chunk::height] = stone;
 }
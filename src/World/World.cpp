@@ -1,25 +1,58 @@
 #include "World/World.hpp"
 
 #include "AABB.hpp"
+#include "Core/Epoch.hpp"
 #include "Core/Filesystem.hpp"
 #include "Core/ZLib.hpp"
 #include "Engine.hpp"
 #include "Entity/Entity.hpp"
 #include "Entity/Item.hpp"
 #include "Profiler.hpp"
+#include "World/BlockLog.hpp"
 #include "World/Chunk.hpp"
 #include "World/Dimension.hpp"
+#include "World/EntityCodec.hpp"
 #include "World/Settings.hpp"
 
 #include <SDL3/SDL.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
 #include <cstdlib>
+#include <filesystem>
 #include <format>
 #include <limits>
 #include <memory>
 #include <mutex>
 
+/**
+ * Estimated main thread cost of the integration queue items, in microseconds.
+ */
+static constexpr uint32_t flush_cost_us = 100;
+
+/**
+ * Version of the player files. Older files have no version, fields added later must have a default value.
+ */
+static constexpr int64_t player_data_version = 1;
+
+/**
+ * Number of entities ticked by a task of the parallel entity phase.
+ */
+static constexpr size_t entity_batch_size = 16;
+
+/**
+ * Buffer of the batch ticked by this thread during the parallel entity phase.
+ */
+static thread_local CommandBuffer *current_commands = nullptr;
+
+static void log_io_error(Result<void> result)
+{
+    if (result.has_error())
+        result.error().print();
+}
+
 // https://gamedev.stackexchange.com/questions/18436/most-efficient-aabb-vs-ray-collision-algorithms
 static bool ray_intersect_aabb(const Ray& ray, const AABBd& aabb, double& t_min, glm::dvec3& normal)
 {
@@ -118,29 +151,24 @@ Result<std::shared_ptr<World>> World::create(std::string name, uint64_t seed, in
     world->m_seed = seed;
     world->m_name = name;
 
-    // TODO: find a common place to put this.
-    world->m_dims[overworld].m_world = world.get();
-    world->m_dims[overworld].m_gen = std::make_shared<OverworldGen>(WorldSettings{});
-    world->m_dims[underworld].m_world = world.get();
-    world->m_dims[underworld].m_gen = std::make_shared<UnderworldGen>(WorldSettings{});
+    world->init_dimensions();
 
     // world->find_safe_spawn();
 
     if (!Engine::get().is_save_disabled())
     {
-        std::string path = std::format("{}saves/{}/", Filesystem::get_data_directory(), name);
-        TRY(Filesystem::make_dirs(path));
-        path.append("info.dat");
-        File file = TRY(Filesystem::open_file(path, true));
-
         WorldSaveInfo wi{};
         wi.seed = seed;
         wi.type = WorldPresetType(type);
         wi.spawn_position = glm::vec3(0, 80, 0); // world->get_spawn_position();
-        TRY(file.writer().write_raw(&wi, sizeof(WorldSaveInfo)));
-        file.close();
+
+        std::vector<uint8_t> data(sizeof(WorldSaveInfo));
+        memcpy(data.data(), &wi, sizeof(WorldSaveInfo));
+        Engine::get().io().write_file(std::format("{}saves/{}/info.dat", Filesystem::get_data_directory(), name), std::move(data), log_io_error);
     }
 
+    world->reserve_entity_ids();
+
     return world;
 }
 
@@ -159,29 +187,354 @@ Result<std::shared_ptr<World>> World::load(std::string name)
 
     if (!Engine::get().is_save_disabled())
     {
-        std::string path = std::format("{}saves/{}/info.dat", Filesystem::get_data_directory(), name);
-        File file = TRY(Filesystem::open_file(path));
+        std::vector<uint8_t> data = TRY(Engine::get().io().read_file_wait(std::format("{}saves/{}/info.dat", Filesystem::get_data_directory(), name)));
+        if (data.size() < sizeof(WorldSaveInfo))
+            return Error(ErrorKind::InvalidData);
 
         WorldSaveInfo wi{};
-        TRY(file.reader().read_raw(&wi, sizeof(WorldSaveInfo)));
-        file.close();
+        memcpy(&wi, data.data(), sizeof(WorldSaveInfo));
 
         world->m_seed = wi.seed;
         world->m_spawn_position = wi.spawn_position;
     }
 
     world->m_name = name;
+    world->init_dimensions();
 
-    world->m_dims[overworld].m_world = world.get();
-    world->m_dims[overworld].m_gen = std::make_shared<OverworldGen>(WorldSettings{});
-    world->m_dims[underworld].m_world = world.get();
-    world->m_dims[underworld].m_gen = std::make_shared<UnderworldGen>(WorldSettings{});
+    if (!Engine::get().is_save_disabled())
+    {
+        for (Dimension& dim : world->m_dims)
+            world->import_legacy_chunks(dim);
+        TRY(world->replay_block_log());
+
+        // Entities saved by the previous sessions have ids below their last reservation. Older saves have no
+        // reservation and no saved entities.
+        Result<std::vector<uint8_t>> ids = Engine::get().io().read_file_wait(std::format("{}saves/{}/entity_ids.dat", Filesystem::get_data_directory(), name));
+        if (ids.has_value() && ids->size() >= sizeof(uint32_t))
+        {
+            uint32_t reserved;
+            memcpy(&reserved, ids->data(), sizeof(uint32_t));
+            skip_entity_ids(EntityId(reserved));
+        }
+        world->reserve_entity_ids();
+    }
 
     return world;
 }
 
+void World::init_dimensions()
+{
+    m_dims[overworld].m_world = this;
+    m_dims[overworld].m_gen = std::make_shared<OverworldGen>(WorldSettings{.seed = m_seed});
+    m_dims[underworld].m_world = this;
+    m_dims[underworld].m_gen = std::make_shared<UnderworldGen>(WorldSettings{.seed = m_seed});
+
+    if (Engine::get().is_save_disabled())
+        return;
+
+    for (Dimension& dim : m_dims)
+    {
+        const std::string directory = std::format("{}saves/{}/DIM{}/", Filesystem::get_data_directory(), m_name, dim.m_id);
+        dim.m_preload_cache.set_directory(directory, dim.m_gen->fingerprint());
+        dim.m_region_store = std::make_shared<RegionStore>(Engine::get().io(), directory + "region/");
+        dim.m_saver.set_store(dim.m_region_store);
+        dim.m_saver.set_snapshot_entities([&dim](ChunkPos pos)
+                                          { return dim.snapshot_entities(pos); });
+    }
+
+    // Logged edits must be on the disk before a chunk containing them is, otherwise a replay could undo newer edits.
+    m_block_log = std::make_shared<BlockLog>(Engine::get().io(), std::format("{}saves/{}/log/", Filesystem::get_data_directory(), m_name));
+    for (Dimension& dim : m_dims)
+    {
+        dim.m_block_log = m_block_log;
+        dim.m_saver.set_before_save([log = m_block_log]()
+                                    { log->flush(true); });
+    }
+}
+
+void World::import_legacy_chunks(Dimension& dim)
+{
+    namespace fs = std::filesystem;
+
+    const fs::path directory = std::format("{}saves/{}/DIM{}/", Filesystem::get_data_directory(), m_name, dim.m_id);
+
+    std::error_code ec;
+    if (!fs::is_directory(directory, ec))
+        return;
+
+    // Older saves have a directory per chunk, named `x$z`, with the blocks and the tags in two compressed files.
+    std::vector<std::pair<ChunkPos, fs::path>> imported;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory, ec))
+    {
+        int64_t x, z;
+        const std::string name = entry.path().filename().string();
+        if (!entry.is_directory() || std::sscanf(name.c_str(), "%" SCNd64 "$%" SCNd64, &x, &z) != 2)
+            continue;
+
+        IOService& io = Engine::get().io();
+        Result<std::vector<uint8_t>> blocks = io.read_file_wait((entry.path() / "blocks.dat").string());
+        if (blocks.has_error())
+            continue;
+
+        std::vector<uint8_t> data;
+        if (ZLib::inflate(std::as_bytes(std::span(blocks.value())), data, sizeof(BlockState) * Chunk::block_count).has_error() || data.size() != sizeof(BlockState) * Chunk::block_count)
+        {
+            warn("skipping corrupted chunk `{}`", entry.path().string());
+            continue;
+        }
+
+        std::vector<uint8_t> tags_data;
+        Result<std::vector<uint8_t>> tags = io.read_file_wait((entry.path() / "tags.dat").string());
+        if (tags.has_value() && ZLib::inflate(std::as_bytes(std::span(tags.value())), tags_data).has_error())
+            tags_data.clear();
+
+        if (tags_data.empty())
+        {
+            // Same bytes as the tags of a chunk without any.
+            BufferWriter writer;
+            Dimension::write_tags(writer, std::make_shared<Chunk>(&dim, x, z));
+            tags_data = writer.release();
+        }
+
+        data.insert(data.end(), tags_data.begin(), tags_data.end());
+
+        RegionChunk saved;
+        saved.compression = save_compression;
+        if (ChunkCodec::get(save_compression)->encode(data, saved.data).has_error())
+            continue;
+
+        dim.m_region_store->write(ChunkPos(x, z), std::move(saved));
+        imported.emplace_back(ChunkPos(x, z), entry.path());
+    }
+
+    if (imported.empty())
+        return;
+
+    // The old files are only removed once the region files are on the disk, chunks that failed to be written are
+    // imported again by the next load.
+    Engine::get().io().flush();
+    const std::set<ChunkPos> failed = dim.m_region_store->failed_writes();
+
+    size_t kept = 0;
+    for (const auto& [pos, path] : imported)
+    {
+        if (failed.contains(pos))
+        {
+            kept++;
+            continue;
+        }
+
+        fs::remove(path / "blocks.dat", ec);
+        fs::remove(path / "tags.dat", ec);
+        fs::remove(path, ec); // Only if empty.
+    }
+
+    if (kept > 0)
+        warn("kept the old files of {} chunks of DIM{} that failed to be written", kept, dim.m_id);
+    info("imported {} chunks of DIM{} in region files", imported.size() - kept, dim.m_id);
+}
+
 World::~World()
 {
+    close();
+}
+
+void World::close()
+{
+    if (m_closed)
+        return;
+    m_closed = true;
+
+    // Generation jobs load and save chunks through the region stores, they must be done before the I/O service goes.
+    for (Dimension& dim : m_dims)
+        dim.get_scheduler().stop();
+
+    flush_saves();
+}
+
+void World::flush_saves()
+{
+    if (!m_proxy)
+    {
+        for (Dimension& dim : m_dims)
+        {
+            for (const std::shared_ptr<Entity>& entity : dim.get_entities())
+            {
+                if (std::shared_ptr<Player> player = std::dynamic_pointer_cast<Player>(entity))
+                    EXPECT(save_player(player));
+            }
+        }
+    }
+
+    for (int dimension = 0; dimension < (int)max_dimensions; dimension++)
+    {
+        if (!m_proxy)
+            mark_entity_chunks(dimension);
+        m_dims[dimension].m_saver.flush();
+    }
+
+    // Every edit is in a saved chunk now.
+    if (m_block_log != nullptr)
+        truncate_block_log(m_block_log->rotate());
+}
+
+void World::truncate_block_log(uint64_t segment)
+{
+    std::vector<std::shared_ptr<RegionStore>> stores;
+    for (const Dimension& dim : m_dims)
+    {
+        if (dim.m_region_store != nullptr)
+            stores.push_back(dim.m_region_store);
+    }
+
+    // Queued after the region writes of the saved chunks. The edits of a chunk that failed to be written are only in
+    // memory, the segments are kept until a later checkpoint once it is written.
+    Engine::get().io().run([log = m_block_log, stores = std::move(stores), segment]()
+                           {
+                               for (const std::shared_ptr<RegionStore>& store : stores)
+                               {
+                                   const size_t failed = store->failed_writes().size();
+                                   if (failed > 0)
+                                   {
+                                       warn("keeping the block log, {} chunks of `{}` are not saved", failed, store->directory());
+                                       return;
+                                   }
+                               }
+
+                               log->truncate(segment); });
+}
+
+void World::mark_modified_chunks(int dimension)
+{
+    // Only marked here, the saver writes a chunk at most once per interval however often it is modified.
+    for (auto& [pos, chunk] : m_dims[dimension].m_chunks)
+    {
+        if (!chunk->is_modified())
+            continue;
+        chunk->clear_modified();
+        m_dims[dimension].m_saver.mark_dirty(chunk);
+    }
+}
+
+void World::update_block_log()
+{
+    if (m_block_log == nullptr)
+        return;
+
+    // Written without waiting for the disk, only a chunk save needs its edits to be durable.
+    m_block_log->flush(false);
+
+    if (m_checkpoint.has_value())
+    {
+        for (const TaskHandle<void>& save : m_checkpoint->saves)
+        {
+            if (!save.is_done())
+                return;
+        }
+
+        // The region writes of the saves were queued before, the segments are deleted after them.
+        truncate_block_log(m_checkpoint->segment);
+        m_checkpoint.reset();
+    }
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - m_last_checkpoint < checkpoint_interval)
+        return;
+    m_last_checkpoint = now;
+
+    // Every edit logged before the rotation is in a chunk saved by this checkpoint, or by an earlier save.
+    Checkpoint checkpoint{.segment = m_block_log->rotate(), .saves = {}};
+    for (int dimension = 0; dimension < (int)max_dimensions; dimension++)
+    {
+        mark_modified_chunks(dimension);
+        mark_entity_chunks(dimension);
+        std::vector<TaskHandle<void>> saves = m_dims[dimension].m_saver.save_all();
+        checkpoint.saves.insert(checkpoint.saves.end(), saves.begin(), saves.end());
+    }
+    m_checkpoint = std::move(checkpoint);
+}
+
+Result<void> World::replay_block_log()
+{
+    ZoneScoped;
+
+    std::vector<BlockLog::Record> records = TRY(m_block_log->read_all());
+    if (records.empty())
+        return Result<void>();
+
+    // Edits of a chunk are applied in the order of the log over its last saved version. A chunk never saved is
+    // generated again with its structures later, its edits are lost.
+    std::map<std::pair<int, ChunkPos>, std::shared_ptr<Chunk>> chunks;
+    size_t skipped = 0;
+    for (const BlockLog::Record& record : records)
+    {
+        if (record.dimension >= max_dimensions)
+        {
+            skipped++;
+            continue;
+        }
+
+        const ChunkPos pos(chunk_index(record.pos.x), chunk_index(record.pos.z));
+        auto [iter, inserted] = chunks.try_emplace(std::make_pair((int)record.dimension, pos));
+        if (inserted)
+        {
+            // A corrupted chunk is generated again without its edits, a chunk that can not be read stops the load
+            // rather than losing them.
+            Result<std::shared_ptr<Chunk>> chunk = m_dims[record.dimension].load_saved_chunk(pos);
+            if (chunk.has_error() && chunk.error().kind() != ErrorKind::InvalidData)
+                return chunk.error();
+            iter->second = chunk.has_value() ? chunk.value() : nullptr;
+        }
+
+        std::shared_ptr<Chunk>& chunk = iter->second;
+        if (chunk == nullptr)
+        {
+            skipped++;
+            continue;
+        }
+
+        const glm::i64vec3 local(local_coords(record.pos.x), record.pos.y, local_coords(record.pos.z));
+        switch (record.kind)
+        {
+        case BlockLog::RecordKind::Block:
+            chunk->set_block(local.x, local.y, local.z, record.new_state);
+            break;
+        case BlockLog::RecordKind::SetTag:
+            chunk->set_tag(local, record.tag, record.value);
+            break;
+        case BlockLog::RecordKind::RemoveTag:
+            chunk->remove_tag(local, record.tag);
+            break;
+        }
+    }
+
+    for (const auto& [key, chunk] : chunks)
+    {
+        if (chunk != nullptr)
+            TRY(save_chunk(chunk, key.first));
+    }
+
+    // The replayed segments are deleted once the chunks are written.
+    truncate_block_log(m_block_log->segment());
+    Engine::get().io().flush();
+
+    info("replayed {} block edits on {} chunks, {} skipped", records.size() - skipped, chunks.size(), skipped);
+    return Result<void>();
+}
+
+ChunkSaver::Stats World::save_stats() const
+{
+    ChunkSaver::Stats stats;
+    for (const Dimension& dim : m_dims)
+    {
+        const ChunkSaver::Stats dim_stats = dim.m_saver.stats();
+        stats.dirty += dim_stats.dirty;
+        stats.in_flight += dim_stats.in_flight;
+        stats.saves += dim_stats.saves;
+        stats.bytes_written += dim_stats.bytes_written;
+        stats.bytes_per_second += dim_stats.bytes_per_second;
+    }
+    return stats;
 }
 
 static void add_neighbour_chunk(ChunkPos pos, std::set<ChunkPos>& chunks)
@@ -201,76 +554,209 @@ static void add_neighbour_chunk(ChunkPos pos, std::set<ChunkPos>& chunks)
 
 void World::tick(float delta)
 {
-    // int dimension = m_player->get_dimension();
+    ZoneScoped;
+
+    // Entities that can not tick in parallel, like players, may touch anything. They tick first, on the main thread.
+    for (int dimension = 0; dimension < (int)max_dimensions; dimension++)
+        tick_serial_entities(delta, dimension);
+
+    // Dimensions share no blocks or entities, each one is ticked by its own job. The main thread takes the overworld,
+    // jobs that did not start when it is done are taken back instead of waited for.
+    ThreadPool& pool = Engine::get().get_thread_pool();
+    std::array<TaskHandle<void>, max_dimensions> jobs;
+    for (int dimension = 1; dimension < (int)max_dimensions; dimension++)
+        jobs[dimension] = pool.async([this, delta, dimension]()
+                                     { tick_dimension(delta, dimension); },
+                                     TaskPriority::Interactive);
 
-    // tick_dimension(delta, dimension);
     tick_dimension(delta, overworld);
-    tick_dimension(delta, underworld);
+
+    for (int dimension = 1; dimension < (int)max_dimensions; dimension++)
+    {
+        if (jobs[dimension].cancel())
+            tick_dimension(delta, dimension);
+        else
+            jobs[dimension].wait();
+    }
+
+    // Sync point, every dimension is done.
+    for (CommandBuffer& hand_offs : m_hand_offs)
+        hand_offs.apply();
+
+    if (!m_proxy)
+    {
+        update_block_log();
+        reserve_entity_ids();
+    }
+
+    tick_network();
+
+    m_integration_queue.drain(Engine::get().integration_budget_us());
 
     m_debug_display.update(delta);
 }
 
-void World::tick_dimension(float delta, int dimension)
+void World::flush_chunk(int dimension, ChunkPos pos)
+{
+    Dimension& dim = m_dims[dimension];
+    dim.m_chunks_queued_for_flush.erase(pos);
+
+    std::shared_ptr<Chunk> chunk;
+    {
+        std::lock_guard<std::mutex> lock(dim.m_chunk_mutex);
+
+        // The chunk has been unloaded before being flushed.
+        auto iter = dim.m_chunks_to_flush.find(pos);
+        if (iter == dim.m_chunks_to_flush.end())
+            return;
+
+        chunk = iter->second;
+        dim.m_chunks[pos] = chunk;
+        dim.m_chunk_lookup.insert(pos, chunk);
+        dim.m_chunks_to_flush.erase(iter);
+    }
+
+    if (!chunk->m_entity_data.empty())
+        restore_entities(dimension, chunk);
+
+    // The scheduler decides which chunks can be meshed, this avoid meshing chunks multiple times while their neighbours
+    // are not generated yet.
+    std::set<ChunkPos> rebuild;
+    dim.m_scheduler.chunk_flushed(pos, rebuild);
+
+    for (ChunkPos p : rebuild)
+        dim.queue_rebuild(p);
+}
+
+void World::defer(Task command)
+{
+    if (current_commands != nullptr)
+        current_commands->push(std::move(command));
+    else
+        command();
+}
+
+void World::hand_off(int dimension, Task command)
+{
+    ASSERT(current_commands == nullptr, "hand-offs can not be recorded by entities ticked in parallel, defer them first");
+    m_hand_offs[dimension].push(std::move(command));
+}
+
+void World::tick_serial_entities(float delta, int dimension)
 {
     ZoneScoped;
 
-    for (std::shared_ptr<Entity> entity : m_dims[dimension].get_entities())
+    for (const std::shared_ptr<Entity>& entity : m_dims[dimension].get_entities())
     {
-        if (entity->is_active())
-            entity->recurse_tick(delta);
-        else
+        if (!entity->is_active())
             remove_entity(entity->m_dimension, entity);
+        else if (!entity->ticks_in_parallel())
+            entity->recurse_tick(delta);
     }
+}
+
+void World::tick_parallel_entities(float delta, int dimension)
+{
+    ZoneScoped;
+
+    Dimension& dim = m_dims[dimension];
+
+    std::vector<std::shared_ptr<Entity>> parallel;
+    for (const std::shared_ptr<Entity>& entity : dim.get_entities())
+    {
+        if (entity->is_active() && entity->ticks_in_parallel())
+            parallel.push_back(entity);
+    }
+
+    if (parallel.empty())
+        return;
+
+    dim.snapshot_entity_boxes();
+
+    std::vector<CommandBuffer> commands = tick_in_batches(parallel.size(), entity_batch_size, &Engine::get().get_thread_pool(),
+                                                          [&](size_t begin, size_t end, CommandBuffer& buffer)
+                                                          {
+                                                              current_commands = &buffer;
+                                                              for (size_t i = begin; i < end; i++)
+                                                                  parallel[i]->recurse_tick(delta);
+                                                              current_commands = nullptr;
+                                                          });
 
+    dim.release_entity_boxes();
+
+    CommandBuffer::apply_all(commands);
+}
+
+void World::tick_dimension(float delta, int dimension)
+{
+    ZoneScoped;
+
+    tick_parallel_entities(delta, dimension);
+
+    // An entity can be removed twice in a tick, ex: killed by two arrows.
     for (std::shared_ptr<Entity> entity : m_dims[dimension].m_entities_to_remove)
-        m_dims[dimension].m_entities.erase(std::find(m_dims[dimension].m_entities.begin(), m_dims[dimension].m_entities.end(), entity));
+    {
+        auto iter = std::find(m_dims[dimension].m_entities.begin(), m_dims[dimension].m_entities.end(), entity);
+        if (iter != m_dims[dimension].m_entities.end())
+            m_dims[dimension].m_entities.erase(iter);
+        if (entity->is<Player>())
+            m_player_saver.forget(entity->id());
+
+        // The chunk it was saved with is saved again without it.
+        auto tracked = m_dims[dimension].m_entity_chunks.find(entity->id());
+        if (tracked != m_dims[dimension].m_entity_chunks.end())
+        {
+            mark_chunk_dirty(dimension, tracked->second);
+            m_dims[dimension].m_entity_chunks.erase(tracked);
+        }
+    }
     for (std::shared_ptr<Entity> entity : m_dims[dimension].m_entities_to_add)
         m_dims[dimension].m_entities.push_back(entity);
 
     if (!m_proxy)
     {
-        for (auto& [pos, chunk] : m_dims[dimension].m_chunks)
-        {
-            if (chunk->is_modified())
-                EXPECT(save_chunk(chunk, dimension));
-            chunk->clear_modified();
-        }
+        track_entity_chunks(dimension);
+        mark_modified_chunks(dimension);
+        m_dims[dimension].m_saver.update();
 
-        // TODO: Don't save every players each frames.
         for (const std::shared_ptr<Entity>& entity : m_dims[dimension].get_entities())
         {
-            if (std::shared_ptr<Player> player = std::dynamic_pointer_cast<Player>(entity))
+            std::shared_ptr<Player> player = std::dynamic_pointer_cast<Player>(entity);
+            if (player != nullptr && m_player_saver.needs_save(*player))
                 EXPECT(save_player(player));
         }
 
         load_around_player(dimension);
     }
-    else if (Engine::get().is_online() && !Engine::get().is_server())
-    {
-        request_load_around(dimension);
-    }
 
-    // Flush all new chunks.
+    // New chunks are flushed by the integration queue, a few per tick.
     std::set<ChunkPos> chunk_modified;
 
     {
         std::lock_guard<std::mutex> lock(m_dims[dimension].m_chunk_mutex);
 
-        for (auto& [pos, chunk] : m_dims[dimension].m_chunks_to_flush)
-        {
-            m_dims[dimension].m_chunks[pos] = chunk;
-            chunk_modified.insert(pos);
-            add_neighbour_chunk(pos, chunk_modified);
-        }
-        m_dims[dimension].m_chunks_to_flush.clear();
-
+        // Removals are applied first, a chunk may be unloaded and realized again before being flushed.
         for (auto pos : m_dims[dimension].m_chunks_to_remove)
         {
+            if (!m_proxy)
+                unload_entities(dimension, pos);
+            m_dims[dimension].m_saver.save_now(pos);
+            m_dims[dimension].cancel_chunk_tasks(pos);
             m_dims[dimension].m_chunks.erase(pos);
-            chunk_modified.insert(pos);
+            m_dims[dimension].m_chunk_lookup.erase(pos);
             add_neighbour_chunk(pos, chunk_modified);
         }
         m_dims[dimension].m_chunks_to_remove.clear();
+
+        for (auto& [pos, chunk] : m_dims[dimension].m_chunks_to_flush)
+        {
+            if (!m_dims[dimension].m_chunks_queued_for_flush.insert(pos).second)
+                continue;
+
+            m_integration_queue.push([this, dimension, pos]()
+                                     { flush_chunk(dimension, pos); },
+                                     flush_cost_us);
+        }
     }
 
     for (ChunkPos pos : chunk_modified)
@@ -278,35 +764,6 @@ void World::tick_dimension(float delta, int dimension)
         m_dims[dimension].queue_rebuild(pos);
     }
 
-    if (!m_proxy && Engine::get().is_online() && Engine::get().is_server())
-    {
-        for (std::shared_ptr<Entity> entity : m_dims[dimension].get_entities())
-        {
-            UpdateEntityPacket p{};
-            p.id = entity->id();
-            p.position = entity->get_transform().position();
-            p.rotation = entity->get_transform().rotation();
-            Engine::get().connection().broadcast(Engine::get().connection().create_packet(p));
-        }
-
-        for (const ChunkLoadRequest& req : m_load_requests)
-        {
-            std::optional<std::shared_ptr<Chunk>> chunk_opt = get_dimension(req.dimension).get_chunk(req.x, req.z);
-            if (chunk_opt.has_value())
-            {
-                std::shared_ptr<Chunk> chunk = chunk_opt.value();
-                Engine::get().get_thread_pool().async([this, req, chunk]
-                                                      { send_chunk(req.peer, chunk); });
-            }
-            else
-            {
-                // TODO: chunk is loaded but requested by a client, so we load the chunk and send it when its ready.
-                //       This will require to split chunks in two: chunks loaded or visible chunks.
-            }
-        }
-        m_load_requests.clear();
-    }
-
     m_dims[dimension].m_entities_to_remove.clear();
     m_dims[dimension].m_entities_to_add.clear();
 
@@ -359,6 +816,55 @@ void World::tick_dimension(float delta, int dimension)
     }
 }
 
+void World::tick_network()
+{
+    if (!Engine::get().is_online())
+        return;
+
+    if (m_proxy)
+    {
+        if (!Engine::get().is_server())
+        {
+            for (int dimension = 0; dimension < (int)max_dimensions; dimension++)
+                request_load_around(dimension);
+        }
+        return;
+    }
+
+    if (!Engine::get().is_server())
+        return;
+
+    for (const Dimension& dim : m_dims)
+    {
+        for (const std::shared_ptr<Entity>& entity : dim.get_entities())
+        {
+            UpdateEntityPacket p{};
+            p.id = entity->id();
+            p.position = entity->get_transform().position();
+            p.rotation = entity->get_transform().rotation();
+            Engine::get().connection().broadcast(p);
+        }
+    }
+
+    for (const ChunkLoadRequest& req : m_load_requests)
+    {
+        std::optional<std::shared_ptr<Chunk>> chunk_opt = get_dimension(req.dimension).get_chunk(req.x, req.z);
+        if (chunk_opt.has_value())
+        {
+            std::shared_ptr<Chunk> chunk = chunk_opt.value();
+            Engine::get().get_thread_pool().run([this, peer = req.peer, chunk]
+                                                { send_chunk(peer, chunk); },
+                                                TaskPriority::IO);
+        }
+        else
+        {
+            // TODO: chunk is loaded but requested by a client, so we load the chunk and send it when its ready.
+            //       This will require to split chunks in two: chunks loaded or visible chunks.
+        }
+    }
+    m_load_requests.clear();
+}
+
 BlockState World::get_block_state(int dimension, int64_t x, int64_t y, int64_t z) const
 {
     return m_dims[dimension].get_block(x, y, z);
@@ -417,7 +923,7 @@ void World::request_load_around(int dimension)
             p.x = x;
             p.z = z;
             // TODO: dimension
-            Engine::get().connection().send(Engine::get().connection().create_packet(p));
+            Engine::get().connection().send(p);
         }
     }
 }
@@ -503,86 +1009,225 @@ void World::break_block(int dimension, int64_t x, int64_t y, int64_t z)
     add_entity(World::overworld, item_entity);
 }
 
-Result<void> World::save_chunk(std::shared_ptr<Chunk> chunk, int dimension)
+Result<void> World::save_chunk(std::shared_ptr<Chunk> chunk, int dimension, bool generated)
 {
     if (Engine::get().is_save_disabled())
     {
         return Result<void>();
     }
 
-    std::string path = std::format("{}/saves/{}/DIM{}/{}${}/", Filesystem::get_data_directory(), m_name, dimension, chunk->x(), chunk->z());
-    TRY(Filesystem::make_dirs(path));
+    // Only the compression happens here, the region files are written by the I/O thread.
+    RegionChunk saved = TRY(Dimension::encode_chunk(Dimension::snapshot_chunk(chunk)));
+    saved.generated = generated;
+    m_dims[dimension].m_region_store->write(chunk->pos(), std::move(saved));
+
+    return Result<void>();
+}
+
+void World::save_entity(const std::shared_ptr<Entity>& entity)
+{
+    const Dimension& dim = m_dims[entity->get_dimension()];
+    auto iter = dim.m_entity_chunks.find(entity->id());
+    if (iter != dim.m_entity_chunks.end())
+        mark_chunk_dirty(entity->get_dimension(), iter->second);
+}
+
+void World::skip_entity_ids(EntityId id)
+{
+    uint32_t last = s_last_entity_id.load(std::memory_order_relaxed);
+    while (last < id.value() && !s_last_entity_id.compare_exchange_weak(last, id.value(), std::memory_order_relaxed))
+    {
+    }
+}
+
+void World::reserve_entity_ids()
+{
+    if (m_proxy || Engine::get().is_save_disabled())
+        return;
 
-    path.append("blocks.dat");
-    File file = TRY(Filesystem::open_file(path, true));
+    // Reserved again once half of the reservation is used, the write is queued on the I/O thread long before an
+    // entity with an id above the previous reservation can be saved.
+    const uint64_t last = s_last_entity_id.load(std::memory_order_relaxed);
+    if (last + entity_id_reservation / 2 < m_reserved_entity_ids)
+        return;
+    m_reserved_entity_ids = last + entity_id_reservation;
 
-    std::vector<uint8_t> compressed_data;
-    TRY(ZLib::deflate(std::as_bytes(std::span((uint8_t *)chunk->get_blocks(), sizeof(BlockState) * Chunk::block_count)), compressed_data));
+    const uint32_t reserved = (uint32_t)std::min<uint64_t>(m_reserved_entity_ids, std::numeric_limits<uint32_t>::max());
+    std::vector<uint8_t> data(sizeof(uint32_t));
+    memcpy(data.data(), &reserved, sizeof(uint32_t));
+    Engine::get().io().write_file(std::format("{}saves/{}/entity_ids.dat", Filesystem::get_data_directory(), m_name), std::move(data), log_io_error);
+}
 
-    TRY(file.writer().write_raw(compressed_data.data(), compressed_data.size()));
+bool World::is_entity_id_used(EntityId id) const
+{
+    for (const Dimension& dim : m_dims)
+    {
+        if (dim.m_entity_chunks.contains(id))
+            return true;
+        for (const std::shared_ptr<Entity>& entity : dim.m_entities_to_add)
+        {
+            if (entity->id() == id)
+                return true;
+        }
+    }
+    return get_entity(id) != nullptr;
+}
 
-    file.close();
+void World::track_entity_chunks(int dimension)
+{
+    Dimension& dim = m_dims[dimension];
 
-    path = std::format("{}/saves/{}/DIM{}/{}${}/tags.dat", Filesystem::get_data_directory(), m_name, dimension, chunk->x(), chunk->z());
-    file = TRY(Filesystem::open_file(path, true));
+    for (const std::shared_ptr<Entity>& entity : dim.m_entities)
+    {
+        const std::optional<ChunkPos> pos = Dimension::saved_chunk_of(*entity);
+        auto iter = dim.m_entity_chunks.find(entity->id());
+        if (iter != dim.m_entity_chunks.end() && iter->second == pos)
+            continue;
 
-    BufferWriter writer;
-    Dimension::write_tags(writer, chunk);
+        // Outside of the loaded chunks, it stays with the last loaded chunk it was in. An entity never tracked, ex:
+        // spawned in a chunk not loaded yet, is tracked once its chunk is loaded.
+        if (pos.has_value() && !dim.m_chunks.contains(pos.value()))
+            continue;
 
-    std::vector<uint8_t> tags_data;
-    TRY(ZLib::deflate(std::as_bytes(writer.buffer()), tags_data));
+        // Moved to another chunk, or died.
+        if (iter != dim.m_entity_chunks.end())
+        {
+            mark_chunk_dirty(dimension, iter->second);
+            dim.m_entity_chunks.erase(iter);
+        }
 
-    TRY(file.writer().write_raw(tags_data.data(), tags_data.size()));
+        if (pos.has_value())
+        {
+            dim.m_entity_chunks[entity->id()] = pos.value();
+            mark_chunk_dirty(dimension, pos.value());
+        }
+    }
+}
 
-    // FileWriter writer = file.writer();
-    // write_tags(writer, chunk);
-    file.close();
+void World::mark_entity_chunks(int dimension)
+{
+    for (const auto& [id, pos] : m_dims[dimension].m_entity_chunks)
+        mark_chunk_dirty(dimension, pos);
+}
 
-    return Result<void>();
+void World::mark_chunk_dirty(int dimension, ChunkPos pos)
+{
+    auto iter = m_dims[dimension].m_chunks.find(pos);
+    if (iter != m_dims[dimension].m_chunks.end())
+        m_dims[dimension].m_saver.mark_dirty(iter->second);
 }
 
-Result<void> World::save_entity(const std::shared_ptr<Entity>& entity)
+void World::unload_entities(int dimension, ChunkPos pos)
 {
-    int64_t cx = chunk_index(int64_t(entity->get_position().x));
-    int64_t cz = chunk_index(int64_t(entity->get_position().z));
+    Dimension& dim = m_dims[dimension];
 
-    std::string path = std::format("{}saves/{}/DIM0/{}${}/entities/", Filesystem::get_data_directory(), m_name, cx, cz);
-    TRY(Filesystem::make_dirs(path));
+    // Entities saved with the chunk, including those that walked out of the loaded chunks from it.
+    const auto saved_with_chunk = [&dim, pos](const std::shared_ptr<Entity>& entity)
+    {
+        auto iter = dim.m_entity_chunks.find(entity->id());
+        return iter != dim.m_entity_chunks.end() && iter->second == pos;
+    };
 
-    EntitySerializer serializer;
-    serializer.set("position", entity->get_position());
-    serializer.set("rotation", entity->get_rotation());
-    entity->save(serializer);
+    if (std::none_of(dim.m_entities.begin(), dim.m_entities.end(), saved_with_chunk))
+        return;
 
-    path.append("");
-    // TODO: save to disk
+    // Saved before being removed, the snapshot of the chunk serializes them.
+    mark_chunk_dirty(dimension, pos);
+    dim.m_saver.save_now(pos);
 
-    return Result<void>();
+    std::erase_if(dim.m_entities, [&dim, &saved_with_chunk](const std::shared_ptr<Entity>& entity)
+                  {
+                      if (!saved_with_chunk(entity))
+                          return false;
+                      dim.m_entity_chunks.erase(entity->id());
+                      return true; });
 }
 
-Result<void> World::save_player(const std::shared_ptr<Player>& player)
+void World::restore_entities(int dimension, const std::shared_ptr<Chunk>& chunk)
 {
-    std::string path = std::format("{}saves/{}/players/", Filesystem::get_data_directory(), m_name);
-    TRY(Filesystem::make_dirs(path));
+    Dimension& dim = m_dims[dimension];
 
-    path.append(std::format("{}.dat", player->get_username()));
+    std::vector<uint8_t> data = std::move(chunk->m_entity_data);
+    chunk->m_entity_data.clear();
+
+    std::vector<SavedEntity> saved;
+    BufferReader reader(data.data(), data.size());
+    if (EntityCodec::decode(reader, saved).has_error())
+    {
+        error("corrupted entities in chunk {} {} of DIM{}", chunk->x(), chunk->z(), dimension);
+        return;
+    }
+
+    for (SavedEntity& entry : saved)
+    {
+        Result<std::shared_ptr<Entity>> created = Engine::get().entities().create_entity(entry.class_name);
+        if (created.has_error())
+        {
+            warn("unknown entity `{}` in chunk {} {} of DIM{}", entry.class_name, chunk->x(), chunk->z(), dimension);
+            continue;
+        }
+
+        std::shared_ptr<Entity> entity = created.value();
+        entity->set_position(entry.data.get<glm::dvec3>("position").value_or(glm::dvec3()));
+        entity->set_rotation(entry.data.get<glm::dquat>("rotation").value_or({}));
+        entity->load(entry.data);
+        if (!entity->is_active())
+            continue;
+
+        // A crash between the saves of the chunk an entity left and the one it entered leaves it in both, the copy
+        // gets a new id.
+        if (entry.id.is_valid() && !is_entity_id_used(entry.id))
+        {
+            skip_entity_ids(entry.id);
+            entity->set_id(entry.id);
+        }
+
+        add_entity(dimension, entity);
+        dim.m_entity_chunks[entity->id()] = chunk->pos();
+    }
+}
+
+Result<void> World::save_player(const std::shared_ptr<Player>& player)
+{
+    if (Engine::get().is_save_disabled())
+        return Result<void>();
 
     EntitySerializer serializer;
+    serializer.set("version", player_data_version);
     serializer.set("position", player->get_position());
     serializer.set("rotation", player->get_rotation());
     player->save(serializer);
 
-    TRY(serializer.save(path));
+    // Reused by the saves of a ticking thread, only the final copy handed to the I/O thread is allocated.
+    static thread_local BufferWriter writer;
+    writer.clear();
+    TRY(serializer.save(writer));
+
+    std::span<const uint8_t> buffer = writer.buffer();
+    Engine::get().io().write_file(std::format("{}saves/{}/players/{}.dat", Filesystem::get_data_directory(), m_name, player->get_username()), std::vector<uint8_t>(buffer.begin(), buffer.end()), log_io_error);
+    m_player_saver.saved(*player);
 
     return Result<void>();
 }
 
-void World::load_player(std::string_view username, std::shared_ptr<Player>& player)
+bool World::load_player(std::string_view username, std::shared_ptr<Player>& player)
 {
-    std::string path = std::format("{}saves/{}/players/{}.dat", Filesystem::get_data_directory(), get_name(), username);
+    if (Engine::get().is_save_disabled())
+        return false;
 
+    // The player can not be spawned without its data, but the file is still read by the I/O thread.
+    Result<std::vector<uint8_t>> data = Engine::get().io().read_file_wait(std::format("{}saves/{}/players/{}.dat", Filesystem::get_data_directory(), get_name(), username));
+    if (data.has_error())
+        return false;
+
+    BufferReader reader(data->data(), data->size());
     EntitySerializer serializer;
-    EXPECT(serializer.load(path));
+    EXPECT(serializer.load(reader));
+
+    // Newer files are read as well as possible, their unknown fields are ignored.
+    const int64_t version = serializer.get<int64_t>("version").value_or(0);
+    if (version > player_data_version)
+        warn("player `{}` was saved by a newer version ({} > {})", username, version, player_data_version);
 
     glm::dvec3 position = serializer.get<glm::dvec3>("position").value_or(get_spawn_position());
     glm::dquat rotation = serializer.get<glm::dquat>("rotation").value_or({});
@@ -590,29 +1235,32 @@ void World::load_player(std::string_view username, std::shared_ptr<Player>& play
     player->set_position(position);
     player->set_rotation(rotation);
     player->load(serializer);
+    return true;
 }
 
-void World::send_chunk(ENetPeer *peer, const std::shared_ptr<Chunk>& chunk) const
+void World::send_chunk(ENetPeer *peer, const std::shared_ptr<Chunk>& chunk)
 {
-    std::vector<uint8_t> blocks_data;
-    EXPECT(ZLib::deflate(std::as_bytes(std::span((uint8_t *)chunk->get_blocks(), sizeof(BlockState) * Chunk::block_count)), blocks_data));
-
-    BufferWriter writer;
-    Dimension::write_tags(writer, chunk);
-    std::vector<uint8_t> tags_data;
-    EXPECT(ZLib::deflate(std::as_bytes(writer.buffer()), tags_data));
-
     ChunkDataPacket p;
     p.x = chunk->x();
     p.z = chunk->z();
 
-    p.blocks.resize(blocks_data.size());
-    memcpy(p.blocks.data(), blocks_data.data(), blocks_data.size());
+    p.compression = network_compression;
 
-    p.tags.resize(tags_data.size());
-    memcpy(p.tags.data(), tags_data.data(), tags_data.size());
+    const ChunkCodec *codec = ChunkCodec::get(network_compression);
+    {
+        // The blocks may be replaced by a copy-on-write while they are encoded.
+        Epoch::Guard guard;
+        EXPECT(codec->encode(std::span((const uint8_t *)chunk->get_blocks(), sizeof(BlockState) * Chunk::block_count), p.blocks));
+    }
 
-    Engine::get().connection().send(peer, Engine::get().connection().create_packet(p));
+    BufferWriter writer;
+    Dimension::write_tags(writer, chunk);
+    EXPECT(codec->encode(writer.buffer(), p.tags));
+
+    // Packets are only queued on the connection by the main thread.
+    m_integration_queue.push([peer, p = std::make_shared<ChunkDataPacket>(std::move(p))]()
+                             { Engine::get().connection().send(peer, std::move(*p)); },
+                             1);
 }
 
 void World::receive_chunk(const ChunkDataPacket& p)
@@ -631,9 +1279,15 @@ void World::receive_chunk(const ChunkDataPacket& p)
         chunk = std::make_shared<Chunk>(&dimension, p.x, p.z);
     }
 
+    const ChunkCodec *codec = ChunkCodec::get(p.compression);
+    if (codec == nullptr)
+    {
+        debug("received chunk {} {} with unknown compression {}", p.x, p.z, (int)p.compression);
+        return;
+    }
+
     std::vector<uint8_t> blocks_data;
-    EXPECT(ZLib::inflate(std::as_bytes(std::span(p.blocks)), blocks_data));
-    if (blocks_data.size() != sizeof(BlockState) * Chunk::block_count)
+    if (codec->decode(p.blocks, blocks_data).has_error() || blocks_data.size() != sizeof(BlockState) * Chunk::block_count)
     {
         debug("received bad or corrupted blocks data for {} {}", p.x, p.z);
         return;
@@ -641,12 +1295,20 @@ void World::receive_chunk(const ChunkDataPacket& p)
     memcpy(chunk->get_blocks(), blocks_data.data(), blocks_data.size());
 
     std::vector<uint8_t> tags_data;
-    EXPECT(ZLib::inflate(std::as_bytes(std::span(p.tags)), tags_data));
+    if (codec->decode(p.tags, tags_data).has_error())
+    {
+        debug("received bad or corrupted tags data for {} {}", p.x, p.z);
+        return;
+    }
 
     // debug("tags received = {}", tags_data.size());
 
     BufferReader reader(tags_data.data(), tags_data.size());
-    Dimension::read_tags(reader, chunk);
+    if (Dimension::read_tags(reader, chunk).has_error())
+    {
+        debug("received bad or corrupted tags data for {} {}", p.x, p.z);
+        return;
+    }
 
     // for (size_t i = 0; i < Chunk::slice_count; i++) {
     //  	EXPECT(chunk->build_simple_mesh(i));
@@ -657,17 +1319,13 @@ void World::receive_chunk(const ChunkDataPacket& p)
         dimension.add_chunk(chunk);
 }
 
-void World::queue_receive_chunk(const ChunkDataPacket& p)
+void World::queue_receive_chunk(ChunkDataPacket p)
 {
     // Maybe I'm dumb and I don't know anything but using `[&]` creates segfaults, but manually specifying captures don't.
-    Engine::get().get_thread_pool().async([this, p]()
-                                          { receive_chunk(p); });
-}
-
-bool World::is_player_saved(std::string_view name) const
-{
-    std::string path = std::format("{}saves/{}/players/{}.dat", Filesystem::get_data_directory(), m_name, name);
-    return Filesystem::exists(path);
+    // The packet is too large to be captured in a task.
+    Engine::get().get_thread_pool().run([this, p = std::make_shared<ChunkDataPacket>(std::move(p))]()
+                                        { receive_chunk(*p); },
+                                        TaskPriority::IO);
 }
 
 void World::request_chunk(ENetPeer *peer, int dimension, int64_t x, int64_t z)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Core/IntegrationQueue.hpp"
 #include "Core/Types.hpp"
 #include "DebugDisplay.hpp"
 #include "Entity/Camera.hpp"
@@ -7,11 +8,16 @@
 #include "Network/Packet.hpp"
 #include "Ray.hpp"
 #include "World/Chunk.hpp"
+#include "World/CommandBuffer.hpp"
 #include "World/Dimension.hpp"
+#include "World/PlayerSaver.hpp"
 
 #include <enet/enet.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <optional>
 
 class Player;
 
@@ -176,6 +182,18 @@ public:
         add_entity(new_dimension, entity, false);
     }
 
+    /**
+     * Run `command` after the entities ticked in parallel, in the order of the entities. Runs it immediately when
+     * called outside of the parallel entity phase.
+     */
+    void defer(Task command);
+
+    /**
+     * Run `command` on the main thread once every dimension has ticked. Anything touching another dimension, like
+     * moving an entity through a portal, goes through here. Entities ticked in parallel must defer the call.
+     */
+    void hand_off(int dimension, Task command);
+
     glm::dvec3 get_spawn_position() const { return m_spawn_position; }
 
     /**
@@ -193,38 +211,78 @@ public:
     void break_block(int dimension, int64_t x, int64_t y, int64_t z);
 
     /**
-     * Save chunk to the disk.
+     * Save chunk to the disk. `generated` is true for the first save of a chunk right after its generation.
+     */
+    Result<void> save_chunk(std::shared_ptr<Chunk> chunk, int dimension, bool generated = false);
+
+    /**
+     * Stop the chunk generation, hand every player and modified chunk to the I/O thread and stop saving. Must be
+     * called before the I/O service is destroyed, the destructor closes the world if it was not.
+     */
+    void close();
+
+    /**
+     * Statistics of the chunk savers of all dimensions.
      */
-    Result<void> save_chunk(std::shared_ptr<Chunk> chunk, int dimension);
+    ChunkSaver::Stats save_stats() const;
+
+    /**
+     * `nullptr` if the world is not saved.
+     */
+    const std::shared_ptr<BlockLog>& block_log() const { return m_block_log; }
+
+    /**
+     * Save an entity with the chunk it is in at the next save of the chunk, ex: after changing its state. Moves
+     * between chunks are saved without calling it. Called by the thread ticking the dimension of the entity.
+     */
+    void save_entity(const std::shared_ptr<Entity>& entity);
 
-    Result<void> save_entity(const std::shared_ptr<Entity>& entity);
     Result<void> save_player(const std::shared_ptr<Player>& player);
 
     /**
-     * Load player data from the disk.
+     * Load player data from the disk, returns false if the player was never saved.
      */
-    void load_player(std::string_view name, std::shared_ptr<Player>& player);
+    bool load_player(std::string_view name, std::shared_ptr<Player>& player);
 
-    void queue_receive_chunk(const ChunkDataPacket& p);
+    void queue_receive_chunk(ChunkDataPacket p);
 
-    void send_chunk(ENetPeer *peer, const std::shared_ptr<Chunk>& chunk) const;
+    void send_chunk(ENetPeer *peer, const std::shared_ptr<Chunk>& chunk);
     void receive_chunk(const ChunkDataPacket& p);
 
-    bool is_player_saved(std::string_view name) const;
-
     void request_chunk(ENetPeer *peer, int dimension, int64_t x, int64_t z);
 
+    /**
+     * Main thread work of the world, drained with a time budget at the end of every tick.
+     */
+    IntegrationQueue& integration_queue() { return m_integration_queue; }
+
+    const PlayerSaver& player_saver() const { return m_player_saver; }
+
     const DebugDisplay& dd() const { return m_debug_display; }
     DebugDisplay& dd() { return m_debug_display; }
 
     static EntityId next_id()
     {
-        static uint32_t id = 0;
-        id++;
-        return EntityId(id);
+        return EntityId(s_last_entity_id.fetch_add(1, std::memory_order_relaxed) + 1);
     }
 
 private:
+    /**
+     * Last id given by `next_id`, shared by every world of the process.
+     */
+    static inline std::atomic<uint32_t> s_last_entity_id = 0;
+
+    /**
+     * Ids reserved at once in the save of the world. Saved entities keep their id, a new session starts after the
+     * ids reserved by the previous ones so it never gives an id already used by a saved entity.
+     */
+    static constexpr uint32_t entity_id_reservation = 65536;
+
+    /**
+     * Ids below it are reserved in the save.
+     */
+    uint64_t m_reserved_entity_ids = 0;
+
     uint64_t m_seed = 0;
     std::string m_name;
 
@@ -244,7 +302,120 @@ private:
 
     DebugDisplay m_debug_display;
 
+    IntegrationQueue m_integration_queue;
+
+    PlayerSaver m_player_saver;
+
+    static constexpr std::chrono::seconds checkpoint_interval{60};
+
+    /**
+     * Saves started by a checkpoint, the log segments before `segment` are deleted once they are all done and written.
+     */
+    struct Checkpoint
+    {
+        uint64_t segment;
+        std::vector<TaskHandle<void>> saves;
+    };
+
+    std::shared_ptr<BlockLog> m_block_log;
+    std::chrono::steady_clock::time_point m_last_checkpoint = std::chrono::steady_clock::now();
+    std::optional<Checkpoint> m_checkpoint;
+    bool m_closed = false;
+
+    std::array<CommandBuffer, max_dimensions> m_hand_offs;
+
     void find_safe_spawn();
+
+    /**
+     * Setup generators and save directories of the dimensions, once the seed and the name are known.
+     */
+    void init_dimensions();
+
+    /**
+     * Move the chunks of older saves, stored in a directory per chunk, into region files.
+     */
+    void import_legacy_chunks(Dimension& dim);
+
+    /**
+     * Apply the edits logged by a previous run that crashed to the saved chunks, and save them again.
+     */
+    Result<void> replay_block_log();
+
+    /**
+     * Move the modified flag of the chunks to the dirty set of the saver.
+     */
+    void mark_modified_chunks(int dimension);
+
+    /**
+     * Flush the logged edits of the tick, and start or complete a checkpoint.
+     */
+    void update_block_log();
+
+    void flush_saves();
+
+    /**
+     * Delete the log segments before `segment` once the chunk saves queued before are written, or keep them if one of
+     * the chunks failed to be written.
+     */
+    void truncate_block_log(uint64_t segment);
+
+    /**
+     * Make `next_id` return ids above `id`.
+     */
+    static void skip_entity_ids(EntityId id);
+
+    /**
+     * Reserve more ids in the save before `next_id` runs out of reserved ones.
+     */
+    void reserve_entity_ids();
+
+    bool is_entity_id_used(EntityId id) const;
+
+    /**
+     * Mark the chunks whose saved entities changed since the last tick, entities moved to another loaded chunk or
+     * removed.
+     */
+    void track_entity_chunks(int dimension);
+
+    /**
+     * Mark every loaded chunk with entities dirty, to save the entities that moved inside their chunk.
+     */
+    void mark_entity_chunks(int dimension);
+
+    void mark_chunk_dirty(int dimension, ChunkPos pos);
+
+    /**
+     * Save the entities of a chunk being unloaded with it and remove them from the dimension, including those that
+     * left the loaded chunks from it.
+     */
+    void unload_entities(int dimension, ChunkPos pos);
+
+    /**
+     * Create the entities saved with a chunk added to the dimension.
+     */
+    void restore_entities(int dimension, const std::shared_ptr<Chunk>& chunk);
+
     void load_around_player(int dimension);
+
+    /**
+     * Tick entities that do not support parallel ticking, on the main thread before the dimensions are ticked.
+     */
+    void tick_serial_entities(float delta, int dimension);
+
+    /**
+     * Tick the other entities in parallel batches. The commands recorded by the batches are applied in order once
+     * every batch is done.
+     */
+    void tick_parallel_entities(float delta, int dimension);
+
+    /**
+     * Network work of every dimension, on the main thread after the sync point.
+     */
+    void tick_network();
+
+    /**
+     * Move a realized chunk into the dimension and queue the meshes it allows to build.
+     */
+    void flush_chunk(int dimension, ChunkPos pos);
     void request_load_around(int dimension);
 };
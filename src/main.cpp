@@ -4,12 +4,31 @@
 #include "Input.hpp"
 #include "Profiler.hpp"
 #include "UI/Widget.hpp"
+#include "World/Pregen.hpp"
 
 #include <imgui.h>
 
+#include <charconv>
+#include <string_view>
+
 static constexpr double fixed_update_time = 1.0 / 60.0;
 static clock_t last_update_time;
 
+static void print_usage(const char *name)
+{
+    info("usage: {} [--world <name>] [--seed <seed>] [--pregen <radius>] [--disable-save] [--frame-stats] [--integration-budget <us>]", name);
+}
+
+/**
+ * Parse a whole argument as a number, returns false if it is not one or does not fit in `T`.
+ */
+template <typename T>
+static bool parse_number(std::string_view arg, T& value)
+{
+    const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return error == std::errc() && end == arg.data() + arg.size();
+}
+
 int main(int argc, char *argv[])
 {
 #if !defined(__has_address_sanitizer) && !defined(__platform_web)
@@ -18,15 +37,61 @@ int main(int argc, char *argv[])
 #endif
 
     bool disable_save = false;
+    bool frame_stats = false;
+    std::optional<uint32_t> integration_budget;
+    std::optional<int64_t> pregen_radius;
+    std::string world_name = "unamed";
+    uint64_t seed = 0;
+
     for (int i = 0; i < argc; i++)
     {
-        if (std::string_view(argv[i]) == "--disable-save")
+        const std::string_view arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--disable-save")
             disable_save = true;
+        else if (arg == "--pregen" && i + 1 < argc)
+            valid = parse_number(argv[++i], pregen_radius.emplace());
+        else if (arg == "--world" && i + 1 < argc)
+            world_name = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc)
+            valid = parse_number(argv[++i], seed);
+        else if (arg == "--frame-stats")
+            frame_stats = true;
+        else if (arg == "--integration-budget" && i + 1 < argc)
+            valid = parse_number(argv[++i], integration_budget.emplace());
+
+        if (!valid)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
     }
 
     TracySetThreadName("Main");
 
+    if (pregen_radius.has_value())
+    {
+        // Generate the world without opening a window, ex: `--pregen 32 --world foo --seed 42`.
+        Engine engine(disable_save, true);
+
+        Result<void> result = pregenerate_world(PregenOptions{.world_name = world_name, .seed = seed, .radius = pregen_radius.value()});
+        if (result.has_error())
+        {
+            result.error().print();
+            return 1;
+        }
+
+        return 0;
+    }
+
     Engine engine(disable_save);
+    engine.set_world_name(world_name);
+
+    // Compare tick times with `--frame-stats`, and `--integration-budget 0` to flush everything in the same tick.
+    engine.set_print_frame_stats(frame_stats);
+    if (integration_budget.has_value())
+        engine.set_integration_budget_us(integration_budget.value());
 
     Widget::bind_static();
     ColorRectWidget::bind_static();
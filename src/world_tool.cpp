@@ -0,0 +1,62 @@
+#include "Core/Filesystem.hpp"
+#include "Core/Logger.hpp"
+#include "Engine.hpp"
+#include "Profiler.hpp"
+#include "World/Maintenance.hpp"
+
+#include <string_view>
+
+static void print_usage(const char *name)
+{
+    info("usage: {} --world <name> [--prune] [--compact]", name);
+    info("  --prune    remove the chunks never modified since their generation");
+    info("  --compact  rewrite the region files without their unused sectors");
+}
+
+int main(int argc, char *argv[])
+{
+#if !defined(__has_address_sanitizer) && !defined(__platform_web)
+    initialize_error_handling(Filesystem::current_executable_path().c_str());
+#endif
+
+    MaintenanceOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+
+        if (arg == "--world" && i + 1 < argc)
+            options.world_name = argv[++i];
+        else if (arg == "--prune")
+            options.prune = true;
+        else if (arg == "--compact")
+            options.compact = true;
+        else
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (options.world_name.empty())
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    TracySetThreadName("Main");
+
+    // Without a window or a renderer, only the registry, the thread pool and the I/O are needed.
+    Engine engine(false, true);
+
+    info("using data directory `{}`", Filesystem::get_data_directory());
+
+    Result<size_t> result = maintain_world(options);
+    if (result.has_error())
+    {
+        result.error().print();
+        return 1;
+    }
+
+    return result.value() > 0 ? 1 : 0;
+}
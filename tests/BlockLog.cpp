@@ -0,0 +1,88 @@
+#include "World/BlockLog.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+static BlockState state(uint16_t id)
+{
+    BlockState state;
+    state.id.value = id;
+    return state;
+}
+
+TEST_CASE("BlockLog")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_block_log";
+    std::filesystem::remove_all(directory);
+    const std::string path = (directory / "").string();
+
+    IOService io;
+
+    {
+        std::shared_ptr<BlockLog> log = std::make_shared<BlockLog>(io, path);
+        CHECK(log->read_all().value().empty());
+
+        log->set_block(0, {-17, 64, 3}, state(1), state(2));
+        log->set_tag(1, {5, 10, -40}, "water", Variant(int64_t(3)));
+        log->flush(false);
+
+        log->remove_tag(1, {5, 10, -40}, "water");
+        log->flush(true);
+
+        // Edits buffered but never flushed are lost, like on a crash.
+        log->set_block(0, {0, 0, 0}, state(2), state(3));
+        io.flush();
+    }
+
+    {
+        // A new log appends to a new segment, after the ones left.
+        std::shared_ptr<BlockLog> log = std::make_shared<BlockLog>(io, path);
+        CHECK(log->segment() == 1);
+
+        std::vector<BlockLog::Record> records = log->read_all().value();
+        REQUIRE(records.size() == 3);
+
+        CHECK(records[0].kind == BlockLog::RecordKind::Block);
+        CHECK(records[0].dimension == 0);
+        CHECK(records[0].pos == glm::i64vec3(-17, 64, 3));
+        CHECK(records[0].old_state.id.value == 1);
+        CHECK(records[0].new_state.id.value == 2);
+
+        CHECK(records[1].kind == BlockLog::RecordKind::SetTag);
+        CHECK(records[1].dimension == 1);
+        CHECK(records[1].tag == "water");
+        CHECK(records[1].value.get_unchecked<int64_t>() == 3);
+
+        CHECK(records[2].kind == BlockLog::RecordKind::RemoveTag);
+        CHECK(records[2].pos == glm::i64vec3(5, 10, -40));
+
+        // A torn block at the end of a segment is ignored.
+        log->set_block(0, {1, 2, 3}, state(4), state(5));
+        log->set_block(0, {1, 2, 4}, state(4), state(5));
+        log->flush(true);
+        io.flush();
+
+        const std::filesystem::path segment = directory / "blocks.1.log";
+        std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 3);
+        CHECK(log->read_all().value().size() == 3);
+
+        // Checkpoints delete the segments before the current one.
+        const uint64_t current = log->rotate();
+        log->set_block(0, {7, 8, 9}, state(0), state(1));
+        log->flush(true);
+        log->truncate(current);
+        io.flush();
+
+        records = log->read_all().value();
+        REQUIRE(records.size() == 1);
+        CHECK(records[0].pos == glm::i64vec3(7, 8, 9));
+        CHECK(!std::filesystem::exists(directory / "blocks.0.log"));
+    }
+
+    io.flush();
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,180 @@
+#include "World/ChunkCodec.hpp"
+#include "World/Chunk.hpp"
+#include "World/Density.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+
+struct NamedCodec
+{
+    const char *name;
+    std::shared_ptr<ChunkCodec> codec;
+};
+
+static const std::array<NamedCodec, 9> codecs{{
+    {"raw", std::make_shared<RawCodec>()},
+    {"rle", std::make_shared<RleCodec>()},
+    {"zlib 1", std::make_shared<ZlibCodec>(1)},
+    {"zlib 6", std::make_shared<ZlibCodec>(6)},
+    {"zlib 9", std::make_shared<ZlibCodec>(9)},
+    {"lz4", std::make_shared<Lz4Codec>()},
+    {"zstd 1", std::make_shared<ZstdCodec>(1)},
+    {"zstd 3", std::make_shared<ZstdCodec>(3)},
+    {"zstd 9", std::make_shared<ZstdCodec>(9)},
+}};
+
+/**
+ * Blocks of a chunk with layers like the generated ones: stone, dirt, grass, water then air. Block ids are arbitrary.
+ */
+static std::vector<uint8_t> make_chunk(std::span<const float> heights)
+{
+    std::vector<uint16_t> blocks(Chunk::block_count);
+    for (int64_t x = 0; x < Chunk::width; x++)
+    {
+        for (int64_t z = 0; z < Chunk::width; z++)
+        {
+            const int64_t height = std::clamp<int64_t>((int64_t)heights[x + z * Chunk::width], 1, Chunk::height - 1);
+            for (int64_t y = 0; y < Chunk::height; y++)
+            {
+                uint16_t id = 0;
+                if (y < height - 4)
+                    id = 1;
+                else if (y < height)
+                    id = 2;
+                else if (y == height)
+                    id = 3;
+                else if (y < 64)
+                    id = 4;
+                blocks[Chunk::linearize(x, y, z)] = id;
+            }
+        }
+    }
+
+    std::vector<uint8_t> bytes(blocks.size() * sizeof(uint16_t));
+    std::memcpy(bytes.data(), blocks.data(), bytes.size());
+    return bytes;
+}
+
+static std::vector<uint8_t> make_random(size_t size, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data(size);
+    for (uint8_t& byte : data)
+        byte = uint8_t(random());
+    return data;
+}
+
+TEST_CASE("ChunkCodec round trip")
+{
+    std::vector<float> heights(Chunk::width * Chunk::width);
+    for (size_t i = 0; i < heights.size(); i++)
+        heights[i] = 60.0f + float(i % 7);
+
+    const std::array<std::vector<uint8_t>, 5> inputs{
+        std::vector<uint8_t>(),
+        std::vector<uint8_t>{42},
+        make_random(1001, 1),
+        make_random(100000, 2),
+        make_chunk(heights),
+    };
+
+    for (const auto& [name, codec] : codecs)
+    {
+        INFO(name);
+        CHECK(ChunkCodec::get(codec->id())->id() == codec->id());
+
+        for (const std::vector<uint8_t>& input : inputs)
+        {
+            // Data already in the output is kept.
+            std::vector<uint8_t> encoded{1, 2, 3};
+            REQUIRE(codec->encode(input, encoded).has_value());
+            CHECK(encoded[0] == 1);
+
+            std::vector<uint8_t> decoded{4};
+            REQUIRE(codec->decode(std::span(encoded).subspan(3), decoded).has_value());
+            CHECK(decoded.size() == input.size() + 1);
+            CHECK(std::equal(input.begin(), input.end(), decoded.begin() + 1));
+        }
+    }
+
+    CHECK(ChunkCodec::get(ChunkCompression(200)) == nullptr);
+}
+
+TEST_CASE("ChunkCodec rejects corrupted data")
+{
+    const std::vector<uint8_t> input = make_random(5000, 3);
+
+    for (const auto& [name, codec] : codecs)
+    {
+        if (codec->id() == ChunkCompression::None)
+            continue;
+
+        INFO(name);
+        std::vector<uint8_t> encoded;
+        REQUIRE(codec->encode(input, encoded).has_value());
+
+        // Truncated data never decodes to the original size.
+        std::vector<uint8_t> decoded;
+        Result<void> result = codec->decode(std::span(encoded).first(encoded.size() / 2), decoded);
+        CHECK((result.has_error() || decoded != input));
+
+        // A size larger than allowed is rejected before allocating.
+        std::vector<uint8_t> huge(16, 0xff);
+        decoded.clear();
+        CHECK(codec->decode(huge, decoded).has_error());
+    }
+}
+
+TEST_CASE("ChunkCodec benchmark" * doctest::skip())
+{
+    // Must run from the repository root. Run with `--no-skip -tc="ChunkCodec benchmark"`.
+    std::shared_ptr<DensityGraph> graph = DensityGraph::load("assets/worldgen/overworld.yml").value();
+    static constexpr std::array<std::string_view, 1> outputs{"height"};
+    std::shared_ptr<DensityProgram> program = DensityProgram::compile(*graph, 0, outputs).value();
+
+    // A fixed 16x16 chunks area of the overworld.
+    std::vector<std::vector<uint8_t>> chunks;
+    DensityContext context;
+    for (int64_t cx = 0; cx < 16; cx++)
+    {
+        for (int64_t cz = 0; cz < 16; cz++)
+        {
+            program->evaluate(DensityGrid::columns(cx, cz), context);
+            chunks.push_back(make_chunk(context.output(0)));
+        }
+    }
+
+    const double total_mb = double(chunks.size() * chunks[0].size()) / (1024.0 * 1024.0);
+
+    for (const auto& [name, codec] : codecs)
+    {
+        std::vector<std::vector<uint8_t>> encoded(chunks.size());
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < chunks.size(); i++)
+            REQUIRE(codec->encode(chunks[i], encoded[i]).has_value());
+        const auto middle = std::chrono::steady_clock::now();
+
+        std::vector<uint8_t> decoded;
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            decoded.clear();
+            REQUIRE(codec->decode(encoded[i], decoded).has_value());
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        size_t encoded_size = 0;
+        for (const std::vector<uint8_t>& data : encoded)
+            encoded_size += data.size();
+
+        const std::chrono::duration<double> encode_time = middle - start;
+        const std::chrono::duration<double> decode_time = end - middle;
+        info("{:>6} {:>8.1f}x {:>9.1f} MB/s encode {:>9.1f} MB/s decode", name, double(chunks.size() * chunks[0].size()) / double(encoded_size), total_mb / encode_time.count(), total_mb / decode_time.count());
+    }
+}
@@ -0,0 +1,80 @@
+#include "Core/ThreadPool.hpp"
+#include "World/CommandBuffer.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+namespace
+{
+struct TestEntity
+{
+    uint32_t id;
+    std::minstd_rand random;
+    int64_t position = 0;
+};
+
+/**
+ * Tick `entities` with `tick_in_batches`, like `World::tick_parallel_entities`. Commands append to the returned log.
+ */
+std::vector<int64_t> tick(std::vector<TestEntity> entities, size_t batch_size, ThreadPool *pool)
+{
+    std::vector<int64_t> log;
+
+    std::vector<CommandBuffer> commands = tick_in_batches(entities.size(), batch_size, pool,
+                                                          [&](size_t begin, size_t end, CommandBuffer& buffer)
+                                                          {
+                                                              for (size_t i = begin; i < end; i++)
+                                                              {
+                                                                  TestEntity& entity = entities[i];
+                                                                  entity.position += int64_t(entity.random() % 7) - 3;
+                                                                  if (entity.position % 2 == 0)
+                                                                      buffer.push([&log, id = entity.id, position = entity.position]()
+                                                                                  { log.push_back(position * 1000 + id); });
+                                                              }
+                                                          });
+
+    CHECK(commands.size() == (entities.size() + batch_size - 1) / batch_size);
+    CommandBuffer::apply_all(commands);
+    return log;
+}
+} // namespace
+
+TEST_CASE("tick_in_batches matches serial execution")
+{
+    std::vector<TestEntity> entities;
+    for (uint32_t id = 1; id <= 1000; id++)
+        entities.push_back(TestEntity{.id = id, .random = std::minstd_rand(42 + id)});
+
+    ThreadPool pool(4);
+
+    const std::vector<int64_t> serial = tick(entities, entities.size(), nullptr);
+    CHECK(!serial.empty());
+
+    for (size_t batch_size : {1, 16, 100, 999})
+    {
+        CHECK(tick(entities, batch_size, nullptr) == serial);
+        CHECK(tick(entities, batch_size, &pool) == serial);
+    }
+}
+
+TEST_CASE("tick_in_batches ticks every item once")
+{
+    ThreadPool pool(4);
+
+    std::vector<std::atomic<int>> ticks(1000);
+    const std::vector<CommandBuffer> commands = tick_in_batches(ticks.size(), 7, &pool,
+                                                                [&](size_t begin, size_t end, CommandBuffer&)
+                                                                {
+                                                                    for (size_t i = begin; i < end; i++)
+                                                                        ticks[i]++;
+                                                                });
+
+    CHECK(commands.size() == 143);
+    for (const std::atomic<int>& count : ticks)
+        CHECK(count.load() == 1);
+
+    CHECK(tick_in_batches(0, 7, &pool, [](size_t, size_t, CommandBuffer&) {}).empty());
+}
@@ -0,0 +1,153 @@
+#include "Core/Hash.hpp"
+#include "World/Density.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+static std::shared_ptr<DensityProgram> compile(std::string_view source, std::span<const std::string_view> outputs, uint64_t seed = 0)
+{
+    Result<std::shared_ptr<DensityGraph>> graph = DensityGraph::parse(source);
+    REQUIRE(graph.has_value());
+
+    Result<std::shared_ptr<DensityProgram>> program = DensityProgram::compile(*graph.value(), seed, outputs);
+    REQUIRE(program.has_value());
+
+    return program.value();
+}
+
+/**
+ * Hash the bits of every output over a few chunks, any change in the evaluation changes the checksum.
+ */
+static uint64_t checksum(const DensityProgram& program, size_t output_count)
+{
+    static constexpr std::array<std::pair<int64_t, int64_t>, 4> chunks{{{0, 0}, {-1, -1}, {37, -12}, {-250, 1000}}};
+
+    std::string bytes;
+    DensityContext context;
+
+    for (auto [cx, cz] : chunks)
+    {
+        program.evaluate(DensityGrid::columns(cx, cz), context);
+
+        for (size_t output = 0; output < output_count; output++)
+        {
+            std::span<const float> values = context.output(output);
+            bytes.append((const char *)values.data(), values.size_bytes());
+        }
+    }
+
+    return hash_fnv64(bytes);
+}
+
+TEST_CASE("Density constant folding")
+{
+    static constexpr std::array<std::string_view, 2> outputs{"a", "b"};
+    std::shared_ptr<DensityProgram> program = compile(R"(
+nodes:
+  a: {type: add, args: [1, {type: mul, args: [2, 3]}, {type: clamp, input: 10, min: 0, max: 4}]}
+  b: {type: spline, input: 0.5, points: [[0, 0], [0.5, 2], [1, 3]], interpolation: linear}
+)",
+                                                      outputs);
+
+    CHECK(program->step_count() == 2);
+
+    DensityContext context;
+    program->evaluate(DensityGrid::columns(0, 0), context);
+    CHECK(context.output(0)[0] == 11.0f);
+    CHECK(context.output(1)[255] == 2.0f);
+}
+
+TEST_CASE("Density min and max")
+{
+    static constexpr std::array<std::string_view, 2> outputs{"a", "b"};
+    std::shared_ptr<DensityProgram> program = compile(R"(
+nodes:
+  a: {type: min, args: [3, x, 5, x]}
+  b: {type: max, args: [{type: mul, args: [x, -1]}, x]}
+)",
+                                                      outputs);
+
+    DensityContext context;
+    program->evaluate(DensityGrid::columns(-1, 0), context);
+    for (int64_t x = 0; x < 16; x++)
+    {
+        CHECK(context.output(0)[x] == std::min(3.0f, float(x - 16)));
+        CHECK(context.output(1)[x] == std::abs(float(x - 16)));
+    }
+}
+
+TEST_CASE("Density shared subexpressions")
+{
+    static constexpr std::array<std::string_view, 2> outputs{"a", "b"};
+    std::shared_ptr<DensityProgram> program = compile(R"(
+nodes:
+  a: {type: mul, args: [{type: noise, scale: 100}, 2]}
+  b: {type: mul, args: [2, {type: noise, scale: 100}]}
+)",
+                                                      outputs);
+
+    // The noise, the constant and the product are only evaluated once.
+    CHECK(program->step_count() == 3);
+}
+
+TEST_CASE("Density interpolation")
+{
+    static constexpr std::array<std::string_view, 2> outputs{"flat", "volume"};
+    std::shared_ptr<DensityProgram> program = compile(R"(
+nodes:
+  flat: {type: interpolate, width: 4, input: {type: add, args: [x, {type: mul, args: [z, 3]}]}}
+  volume: {type: interpolate, width: 4, height: 8, input: {type: add, args: [x, y, {type: cache2d, input: {type: add, args: [z, y]}}]}}
+)",
+                                                      outputs);
+
+    CHECK(program->is_2d(0));
+    CHECK(!program->is_2d(1));
+
+    // Linear functions are interpolated exactly.
+    DensityContext context;
+    const DensityGrid grid{.x = -16, .y = 3, .z = 32, .size_xz = 16, .size_y = 20};
+    program->evaluate(grid, context);
+
+    std::span<const float> flat = context.output(0);
+    std::span<const float> volume = context.output(1);
+    REQUIRE(flat.size() == 16 * 16);
+    REQUIRE(volume.size() == 16 * 16 * 20);
+
+    for (int64_t y = 0; y < grid.size_y; y++)
+        for (int64_t z = 0; z < 16; z++)
+            for (int64_t x = 0; x < 16; x++)
+            {
+                const float wx = float(grid.x + x);
+                const float wy = float(grid.y + y);
+                const float wz = float(grid.z + z);
+
+                CHECK(flat[x + z * 16] == wx + wz * 3.0f);
+                CHECK(volume[x + z * 16 + y * 16 * 16] == wx + wy + wz);
+            }
+}
+
+TEST_CASE("Density invalid graphs")
+{
+    CHECK(DensityGraph::parse("nodes: {a: {type: add, args: [b]}, b: {type: mul, args: [a]}}").has_error());
+    CHECK(DensityGraph::parse("nodes: {a: {type: unknown}}").has_error());
+    CHECK(DensityGraph::parse("nodes: {a: missing}").has_error());
+    CHECK(DensityGraph::parse("nodes: {a: {type: spline, input: x, points: [[0, 0], [1, 1]]}}").has_error());
+}
+
+TEST_CASE("Density overworld golden checksums")
+{
+    // Must run from the repository root. Update the checksums only when the terrain is meant to change.
+    Result<std::shared_ptr<DensityGraph>> graph = DensityGraph::load("assets/worldgen/overworld.yml");
+    REQUIRE(graph.has_value());
+
+    static constexpr std::array<std::string_view, 4> outputs{"height", "continentalness", "mountains", "forest"};
+
+    std::shared_ptr<DensityProgram> program = DensityProgram::compile(*graph.value(), 0, outputs).value();
+    CHECK(checksum(*program, outputs.size()) == 0xaac2291f6430e6b3);
+
+    program = DensityProgram::compile(*graph.value(), 1337, outputs).value();
+    CHECK(checksum(*program, outputs.size()) == 0x7ae3395bdeda3e75);
+}
@@ -0,0 +1,92 @@
+#include "World/EntityCodec.hpp"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SavedTestEntity : public Entity
+{
+    CLASS(SavedTestEntity, Entity);
+
+public:
+    int64_t value = 0;
+    std::string name;
+
+    void save(EntitySerializer& ser) const override
+    {
+        ser.set("value", value);
+        ser.set("name", name);
+    }
+};
+
+static std::shared_ptr<SavedTestEntity> make_entity(uint32_t id, glm::dvec3 position, int64_t value, std::string name)
+{
+    std::shared_ptr<SavedTestEntity> entity = std::make_shared<SavedTestEntity>();
+    entity->set_id(EntityId(id));
+    entity->set_position(position);
+    entity->value = value;
+    entity->name = std::move(name);
+    return entity;
+}
+
+TEST_CASE("EntityCodec round trip")
+{
+    const std::vector<std::shared_ptr<Entity>> entities{
+        make_entity(1, glm::dvec3(0.5, 64.0, -3.25), 3, "zombie"),
+        make_entity(70000, glm::dvec3(-15.5, 80.0, 15.75), -1, ""),
+        make_entity(42, glm::dvec3(), 0, std::string(300, 'x')),
+    };
+
+    BufferWriter writer;
+    REQUIRE(EntityCodec::encode(writer, entities).has_value());
+
+    std::vector<SavedEntity> saved;
+    BufferReader reader(writer.buffer().data(), writer.buffer().size());
+    REQUIRE(EntityCodec::decode(reader, saved).has_value());
+    CHECK(reader.eof());
+
+    REQUIRE(saved.size() == entities.size());
+    for (size_t i = 0; i < saved.size(); i++)
+    {
+        const SavedTestEntity& entity = static_cast<const SavedTestEntity&>(*entities[i]);
+        CHECK(saved[i].class_name == "SavedTestEntity");
+        CHECK(saved[i].id == entity.id());
+        CHECK(saved[i].data.get<glm::dvec3>("position").value() == entity.get_position());
+        CHECK(saved[i].data.get<int64_t>("value").value() == entity.value);
+        CHECK(saved[i].data.get<std::string>("name").value() == entity.name);
+    }
+}
+
+TEST_CASE("EntityCodec reads chunks saved without entities")
+{
+    std::vector<SavedEntity> saved;
+    BufferReader reader(nullptr, 0);
+    CHECK(EntityCodec::decode(reader, saved).has_value());
+    CHECK(saved.empty());
+}
+
+TEST_CASE("EntityCodec rejects corrupted data")
+{
+    BufferWriter writer;
+    REQUIRE(EntityCodec::encode(writer, std::vector<std::shared_ptr<Entity>>{make_entity(7, glm::dvec3(1.0, 2.0, 3.0), 5, "cow")}).has_value());
+    const std::vector<uint8_t> data(writer.buffer().begin(), writer.buffer().end());
+
+    // Truncated anywhere.
+    for (size_t size = 1; size < data.size(); size++)
+    {
+        std::vector<SavedEntity> saved;
+        BufferReader reader(data.data(), size);
+        CHECK(EntityCodec::decode(reader, saved).has_error());
+    }
+
+    // Written by a newer version.
+    std::vector<uint8_t> newer = data;
+    const uint32_t version = EntityCodec::version + 1;
+    std::memcpy(newer.data() + sizeof(uint32_t), &version, sizeof(uint32_t));
+    std::vector<SavedEntity> saved;
+    BufferReader reader(newer.data(), newer.size());
+    CHECK(EntityCodec::decode(reader, saved).has_error());
+}
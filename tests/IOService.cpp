@@ -0,0 +1,68 @@
+#include "Core/IOService.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <string>
+
+static std::vector<uint8_t> make_data(size_t size, uint8_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = uint8_t(i * 31 + seed);
+    return data;
+}
+
+static void check_io_service(bool allow_io_uring)
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / std::format("ft_minecraft_io_{}", allow_io_uring);
+    std::filesystem::remove_all(directory);
+
+    IOService io(allow_io_uring);
+    INFO(io.backend_name());
+
+    std::atomic<size_t> failures = 0;
+    for (size_t i = 0; i < 200; i++)
+    {
+        io.write_file((directory / std::format("{}/{}.dat", i % 7, i)).string(), make_data(1000 + i * 37, uint8_t(i)), [&failures](Result<void> result)
+                      {
+                          if (result.has_error())
+                              failures++; });
+    }
+
+    // Rewriting a file with less data truncates it, and requests for the same file keep their order.
+    const std::string path = (directory / "overwritten.dat").string();
+    io.write_file(path, make_data(100000, 1));
+    io.write_file(path, make_data(10, 2));
+
+    Result<std::vector<uint8_t>> small = io.read_file_wait(path);
+    REQUIRE(small.has_value());
+    CHECK(small.value() == make_data(10, 2));
+
+    io.flush();
+    CHECK(failures.load() == 0);
+
+    for (size_t i = 0; i < 200; i += 13)
+    {
+        Result<std::vector<uint8_t>> data = io.read_file_wait((directory / std::format("{}/{}.dat", i % 7, i)).string());
+        REQUIRE(data.has_value());
+        CHECK(data.value() == make_data(1000 + i * 37, uint8_t(i)));
+    }
+
+    CHECK(io.read_file_wait((directory / "missing.dat").string()).has_error());
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+
+    const IOService::Stats stats = io.stats();
+    CHECK(stats.writes == 202);
+    CHECK(stats.batches < stats.writes);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("IOService")
+{
+    check_io_service(false);
+    check_io_service(true);
+}
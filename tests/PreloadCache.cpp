@@ -0,0 +1,72 @@
+#include "World/PreloadCache.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <string>
+
+static PreLoadedChunk make_chunk(int64_t seed)
+{
+    PreLoadedChunk chunk;
+    for (size_t i = 0; i < 16 * 16; i++)
+    {
+        chunk.heights[i] = int64_t(i) * 3 - 200 + seed;
+        chunk.biomes[i] = Biome((i + seed) % 2);
+    }
+    return chunk;
+}
+
+static void check_chunk(const std::shared_ptr<PreLoadedChunk>& chunk, const PreLoadedChunk& expected)
+{
+    REQUIRE(chunk != nullptr);
+    for (size_t i = 0; i < 16 * 16; i++)
+    {
+        CHECK(chunk->heights[i] == expected.heights[i]);
+        CHECK(chunk->biomes[i] == expected.biomes[i]);
+    }
+}
+
+TEST_CASE("PreloadCache stores chunks on the disk")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_preload";
+    std::filesystem::remove_all(directory);
+    const std::string path = (directory / "").string();
+    const std::filesystem::path region = directory / "preload" / std::format("{:016x}", 42) / "0.0.dat";
+
+    {
+        PreloadCache cache;
+        cache.set_directory(path, 42);
+        cache.store(ChunkPos(1, 2), make_chunk(1));
+        cache.store(ChunkPos(-1, 5), make_chunk(2));
+        cache.store(ChunkPos(3, 3), make_chunk(3));
+    }
+
+    // A torn write: the heights of the slot do not match its checksum anymore. Slots are 772 bytes, after an 8 bytes
+    // header.
+    {
+        std::fstream file(region, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(8 + (3 + 3 * PreloadCache::region_size) * 772 + 100);
+        file.put(0x7f);
+    }
+
+    {
+        PreloadCache cache;
+        cache.set_directory(path, 42);
+        check_chunk(cache.load(ChunkPos(1, 2)), make_chunk(1));
+        check_chunk(cache.load(ChunkPos(-1, 5)), make_chunk(2));
+        CHECK(cache.load(ChunkPos(3, 3)) == nullptr);
+
+        // Never preloaded, next to a preloaded chunk and in a region without a file.
+        CHECK(cache.load(ChunkPos(2, 2)) == nullptr);
+        CHECK(cache.load(ChunkPos(100, 100)) == nullptr);
+
+        // Another generator does not reuse the heights.
+        cache.set_directory(path, 43);
+        CHECK(cache.load(ChunkPos(1, 2)) == nullptr);
+    }
+
+    std::filesystem::remove_all(directory);
+}
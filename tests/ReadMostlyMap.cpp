@@ -0,0 +1,109 @@
+#include "Core/Epoch.hpp"
+#include "Core/ReadMostlyMap.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ReadMostlyMap")
+{
+    ReadMostlyMap<int, std::shared_ptr<int>> map;
+
+    for (int i = 0; i < 1000; i++)
+        map.insert(i, std::make_shared<int>(i));
+    CHECK(map.size() == 1000);
+
+    for (int i = 0; i < 1000; i += 2)
+        CHECK(map.erase(i));
+    CHECK(!map.erase(0));
+    CHECK(map.size() == 500);
+
+    map.insert(1, std::make_shared<int>(-1));
+    CHECK(map.size() == 500);
+    CHECK(*map.find(1).value() == -1);
+
+    for (int i = 2; i < 1000; i++)
+    {
+        std::optional<std::shared_ptr<int>> value = map.find(i);
+        CHECK(value.has_value() == (i % 2 == 1));
+        if (value.has_value())
+            CHECK(*value.value() == i);
+    }
+
+    size_t count = 0;
+    map.for_each([&count](int, const std::shared_ptr<int>&)
+                 { count++; });
+    CHECK(count == 500);
+}
+
+TEST_CASE("Epoch keeps retired objects while pinned")
+{
+    Epoch::collect();
+    REQUIRE(Epoch::pending() == 0);
+
+    static std::atomic<int> deleted = 0;
+    deleted = 0;
+
+    {
+        Epoch::Guard guard;
+        Epoch::retire(new int(0), [](void *ptr)
+                      {
+                          delete static_cast<int *>(ptr);
+                          deleted++; });
+        Epoch::collect();
+        CHECK(deleted == 0);
+    }
+
+    Epoch::collect();
+    CHECK(deleted == 1);
+    CHECK(Epoch::pending() == 0);
+}
+
+TEST_CASE("ReadMostlyMap lookups while writing")
+{
+    static constexpr int key_count = 256;
+    static constexpr int write_count = 200000;
+
+    ReadMostlyMap<int, std::shared_ptr<int>> map;
+    std::atomic<bool> done = false;
+    std::atomic<int> bad_values = 0;
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+    {
+        readers.emplace_back([&, t]()
+                             {
+                                 std::minstd_rand random(t);
+                                 while (!done.load())
+                                 {
+                                     const int key = int(random() % key_count);
+                                     std::optional<std::shared_ptr<int>> value = map.find(key);
+                                     if (value.has_value() && *value.value() != key)
+                                         bad_values++;
+                                 } });
+    }
+
+    // Inserts, replacements and erases, the table grows and is rehashed.
+    std::minstd_rand random(42);
+    for (int i = 0; i < write_count; i++)
+    {
+        const int key = int(random() % key_count);
+        if (random() % 3 == 0)
+            map.erase(key);
+        else
+            map.insert(key, std::make_shared<int>(key));
+    }
+
+    done = true;
+    for (std::thread& reader : readers)
+        reader.join();
+
+    CHECK(bad_values == 0);
+
+    Epoch::collect();
+    CHECK(Epoch::pending() == 0);
+}
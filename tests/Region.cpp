@@ -0,0 +1,282 @@
+#include "World/Region.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+
+static RegionChunk make_chunk(size_t size, uint8_t seed)
+{
+    RegionChunk chunk;
+    chunk.compression = ChunkCompression::None;
+    chunk.data.resize(size);
+    for (size_t i = 0; i < size; i++)
+        chunk.data[i] = uint8_t(i * 31 + seed);
+    return chunk;
+}
+
+static void check_chunk(const RegionFile& file, ChunkPos pos, const RegionChunk& expected)
+{
+    Result<std::optional<RegionChunk>> chunk = file.read(pos);
+    REQUIRE(chunk.has_value());
+    REQUIRE(chunk.value().has_value());
+    CHECK(chunk.value()->compression == expected.compression);
+    CHECK(chunk.value()->data == expected.data);
+    CHECK(chunk.value()->generated == expected.generated);
+}
+
+TEST_CASE("RegionFile")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_region";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::string path = (directory / "r.-1.0.dat").string();
+
+    CHECK(RegionFile::region_of(ChunkPos(-1, 31)) == ChunkPos(-1, 0));
+    CHECK(RegionFile::region_of(ChunkPos(-33, 32)) == ChunkPos(-2, 1));
+    CHECK(RegionFile::open(path, false).has_error());
+
+    const RegionChunk a = make_chunk(100, 1);
+    const RegionChunk b = make_chunk(10000, 2);
+    const RegionChunk c = make_chunk(5000, 3);
+
+    {
+        std::shared_ptr<RegionFile> file = RegionFile::open(path, true).value();
+        CHECK(!file->contains(ChunkPos(-1, 0)));
+        CHECK(!file->read(ChunkPos(-1, 0)).value().has_value());
+
+        REQUIRE(file->write({{ChunkPos(-1, 0), &a}, {ChunkPos(-32, 31), &b}}).has_value());
+        check_chunk(*file, ChunkPos(-1, 0), a);
+        check_chunk(*file, ChunkPos(-32, 31), b);
+
+        // A smaller chunk goes to the sectors freed by the previous write of `b`, the file does not grow.
+        const size_t sectors = file->sector_count();
+        REQUIRE(file->write({{ChunkPos(-32, 31), &c}}).has_value());
+        REQUIRE(file->write({{ChunkPos(-32, 31), &b}}).has_value());
+        CHECK(file->sector_count() <= sectors + 2);
+        check_chunk(*file, ChunkPos(-32, 31), b);
+    }
+
+    {
+        std::shared_ptr<RegionFile> file = RegionFile::open(path, false).value();
+        check_chunk(*file, ChunkPos(-1, 0), a);
+        check_chunk(*file, ChunkPos(-32, 31), b);
+
+        REQUIRE(file->write({{ChunkPos(-1, 0), &c}}).has_value());
+    }
+
+    // Tear the latest header copy, the previous one is used instead.
+    {
+        std::fstream stream(path, std::ios::in | std::ios::out | std::ios::binary);
+        for (size_t copy = 0; copy < 2; copy++)
+        {
+            // The header with the highest generation points `(-1, 0)` to `c`, corrupt it wherever it is.
+            std::shared_ptr<RegionFile> file = RegionFile::open(path, false).value();
+            if (file->read(ChunkPos(-1, 0)).value()->data != c.data)
+                break;
+
+            stream.seekp(std::streamoff(copy * 3 * RegionFile::sector_size + 100));
+            stream.put('x');
+            stream.flush();
+        }
+    }
+
+    {
+        std::shared_ptr<RegionFile> file = RegionFile::open(path, false).value();
+        check_chunk(*file, ChunkPos(-1, 0), a);
+        check_chunk(*file, ChunkPos(-32, 31), b);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("RegionFile views")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_region_view";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::string path = (directory / "r.0.0.dat").string();
+
+    const RegionChunk a = make_chunk(10000, 1);
+    const RegionChunk b = make_chunk(9000, 2);
+    RegionChunk c = make_chunk(100, 3);
+    c.generated = true;
+
+    std::shared_ptr<RegionFile> file = RegionFile::open(path, true).value();
+    CHECK(!file->view(ChunkPos(0, 0)).value().has_value());
+    REQUIRE(file->write({{ChunkPos(0, 0), &a}}).has_value());
+
+    {
+        RegionChunkView view = file->view(ChunkPos(0, 0)).value().value();
+        CHECK(std::equal(view.data.begin(), view.data.end(), a.data.begin(), a.data.end()));
+        CHECK(!view.generated);
+
+        // The sectors of `a` are not reused while the view reads them, even when the file grows and is mapped again.
+        REQUIRE(file->write({{ChunkPos(0, 0), &c}}).has_value());
+        REQUIRE(file->write({{ChunkPos(1, 0), &b}}).has_value());
+        CHECK(std::equal(view.data.begin(), view.data.end(), a.data.begin(), a.data.end()));
+
+        RegionChunkView view_b = file->view(ChunkPos(1, 0)).value().value();
+        CHECK(std::equal(view_b.data.begin(), view_b.data.end(), b.data.begin(), b.data.end()));
+    }
+
+    // Once the views are gone the sectors are reused.
+    const size_t sectors = file->sector_count();
+    REQUIRE(file->write({{ChunkPos(2, 0), &b}}).has_value());
+    CHECK(file->sector_count() == sectors);
+    check_chunk(*file, ChunkPos(2, 0), b);
+
+    CHECK(file->view(ChunkPos(0, 0)).value()->generated);
+    check_chunk(*file, ChunkPos(0, 0), c);
+
+    file = nullptr;
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("RegionStore")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_region_store";
+    std::filesystem::remove_all(directory);
+
+    IOService io;
+    std::shared_ptr<RegionStore> store = std::make_shared<RegionStore>(io, (directory / "").string());
+
+    CHECK(!store->read_wait(ChunkPos(0, 0)).value().has_value());
+
+    for (int64_t i = 0; i < 100; i++)
+        store->write(ChunkPos(i - 50, i * 3), make_chunk(size_t(i * 97), uint8_t(i)));
+
+    // The latest write of a chunk wins, and reads see the writes queued before them.
+    store->write(ChunkPos(-50, 0), make_chunk(42, 42));
+    for (int64_t i = 1; i < 100; i++)
+    {
+        Result<std::optional<RegionChunk>> chunk = store->read_wait(ChunkPos(i - 50, i * 3));
+        REQUIRE(chunk.has_value());
+        REQUIRE(chunk.value().has_value());
+        CHECK(chunk.value()->data == make_chunk(size_t(i * 97), uint8_t(i)).data);
+    }
+    CHECK(store->read_wait(ChunkPos(-50, 0)).value()->data == make_chunk(42, 42).data);
+
+    RegionChunkView view = store->view_wait(ChunkPos(-49, 3)).value().value();
+    const RegionChunk expected = make_chunk(97, 1);
+    CHECK(std::equal(view.data.begin(), view.data.end(), expected.data.begin(), expected.data.end()));
+    CHECK(!store->view_wait(ChunkPos(1000, 1000)).value().has_value());
+
+    io.flush();
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("RegionStore keeps failed saves")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_region_retry";
+    std::filesystem::remove_all(directory);
+
+    // A file in place of the directory makes every write fail.
+    std::ofstream(directory).put('x');
+
+    IOService io;
+    std::shared_ptr<RegionStore> store = std::make_shared<RegionStore>(io, (directory / "").string());
+
+    store->write(ChunkPos(3, 4), make_chunk(100, 1));
+    store->write(ChunkPos(40, -2), make_chunk(5000, 2));
+    io.flush();
+    CHECK(store->failed_writes() == std::set<ChunkPos>{ChunkPos(3, 4), ChunkPos(40, -2)});
+
+    // Written with the next save once the error is gone, the newer save of a chunk still wins.
+    std::filesystem::remove(directory);
+    store->write(ChunkPos(40, -2), make_chunk(300, 3));
+    io.flush();
+    CHECK(store->failed_writes().empty());
+
+    CHECK(store->read_wait(ChunkPos(3, 4)).value()->data == make_chunk(100, 1).data);
+    CHECK(store->read_wait(ChunkPos(40, -2)).value()->data == make_chunk(300, 3).data);
+
+    io.flush();
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("RegionStore load benchmark" * doctest::skip())
+{
+    // Loads a 41x41 area like joining a world with a render distance of 20, the page cache is warm after the writes.
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ft_minecraft_region_bench";
+    std::filesystem::remove_all(directory);
+
+    static constexpr int64_t radius = 20;
+    const size_t blocks_size = sizeof(BlockState) * Chunk::block_count;
+    const ChunkCodec *codec = ChunkCodec::get(save_compression);
+
+    IOService io;
+    std::shared_ptr<RegionStore> store = std::make_shared<RegionStore>(io, (directory / "").string());
+
+    for (int64_t x = -radius; x <= radius; x++)
+    {
+        for (int64_t z = -radius; z <= radius; z++)
+        {
+            // Layers of stone, dirt and air around a height changing with the position.
+            std::vector<uint16_t> blocks(Chunk::block_count, 0);
+            for (int64_t bx = 0; bx < Chunk::width; bx++)
+            {
+                for (int64_t bz = 0; bz < Chunk::width; bz++)
+                {
+                    const int64_t height = 64 + int64_t(8.0 * std::sin(double(x * Chunk::width + bx) * 0.05) * std::cos(double(z * Chunk::width + bz) * 0.05));
+                    for (int64_t y = 0; y < height; y++)
+                        blocks[Chunk::linearize(bx, y, bz)] = y < height - 4 ? 1 : 2;
+                }
+            }
+
+            RegionChunk chunk;
+            chunk.compression = save_compression;
+            REQUIRE(codec->encode(std::span((const uint8_t *)blocks.data(), blocks_size), chunk.data).has_value());
+            store->write(ChunkPos(x, z), std::move(chunk));
+        }
+    }
+    io.flush();
+
+    const size_t count = size_t(radius * 2 + 1) * size_t(radius * 2 + 1);
+    std::vector<uint8_t> blocks(blocks_size);
+
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int64_t x = -radius; x <= radius; x++)
+        {
+            for (int64_t z = -radius; z <= radius; z++)
+            {
+                RegionChunk chunk = store->read_wait(ChunkPos(x, z)).value().value();
+                std::vector<uint8_t> data;
+                REQUIRE(codec->decode(chunk.data, data).has_value());
+                std::memcpy(blocks.data(), data.data(), blocks_size);
+            }
+        }
+        const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        info("read + copy: {:.1f} chunks/s", double(count) / time.count());
+    }
+
+    {
+        store->prefetch(ChunkPos(-radius, -radius), ChunkPos(radius, radius));
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> data;
+        for (int64_t x = -radius; x <= radius; x++)
+        {
+            for (int64_t z = -radius; z <= radius; z++)
+            {
+                RegionChunkView chunk = store->view_wait(ChunkPos(x, z)).value().value();
+                data.clear();
+                REQUIRE(codec->decode(chunk.data, data).has_value());
+                std::memcpy(blocks.data(), data.data(), blocks_size);
+            }
+        }
+        const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        info("mmap + reused buffer: {:.1f} chunks/s", double(count) / time.count());
+    }
+
+    store = nullptr;
+    std::filesystem::remove_all(directory);
+}
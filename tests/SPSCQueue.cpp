@@ -0,0 +1,65 @@
+#include "Core/SPSCQueue.hpp"
+
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <thread>
+
+TEST_CASE("SPSCQueue is bounded")
+{
+    SPSCQueue<std::unique_ptr<int>> queue(4);
+    CHECK(queue.capacity() == 4);
+
+    for (int i = 0; i < 4; i++)
+        CHECK(queue.try_push(std::make_unique<int>(i)));
+
+    std::unique_ptr<int> extra = std::make_unique<int>(4);
+    CHECK(!queue.try_push(std::move(extra)));
+    CHECK(extra != nullptr);
+    CHECK(queue.size() == 4);
+
+    std::unique_ptr<int> item;
+    for (int i = 0; i < 4; i++)
+    {
+        REQUIRE(queue.try_pop(item));
+        CHECK(*item == i);
+    }
+
+    CHECK(!queue.try_pop(item));
+    CHECK(queue.size() == 0);
+}
+
+TEST_CASE("SPSCQueue keeps order across threads")
+{
+    static constexpr size_t item_count = 200000;
+
+    // A small queue so both threads keep hitting the full and empty cases.
+    SPSCQueue<size_t> queue(16);
+
+    std::thread producer([&queue]()
+                         {
+                             for (size_t i = 0; i < item_count; i++)
+                             {
+                                 size_t item = i;
+                                 while (!queue.try_push(std::move(item)))
+                                     std::this_thread::yield();
+                             } });
+
+    size_t expected = 0;
+    while (expected < item_count)
+    {
+        size_t item;
+        if (!queue.try_pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (item != expected)
+            break;
+        expected++;
+    }
+
+    producer.join();
+    CHECK(expected == item_count);
+}
@@ -0,0 +1,198 @@
+#include "World/TagCodec.hpp"
+#include "Core/Logger.hpp"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+
+static Variant random_value(std::mt19937& random)
+{
+    switch (random() % 6)
+    {
+    case 0:
+        return Variant(nullptr);
+    case 1:
+        return Variant(bool(random() % 2));
+    case 2:
+        return Variant(double(int32_t(random())) / 7.0);
+    case 3:
+        return Variant(std::string(random() % 13, char('a' + random() % 26)));
+    case 4:
+        return Variant(glm::dvec3(random() % 100, -double(random() % 100), 0.5));
+    default:
+        // Large and negative integers too, for the zigzag varints.
+        return Variant(int64_t(random() % 2 ? int64_t(random()) << (random() % 32) : -int64_t(random() % 16)));
+    }
+}
+
+/**
+ * Tags of a chunk with `block_count` tagged blocks: a few names, and columns of constant values, of integers or of
+ * mixed types.
+ */
+static std::map<int64_t, BlockTags> random_tags(std::mt19937& random, size_t block_count)
+{
+    const std::array<const char *, 4> names{"water", "level", "owner", ""};
+    const uint32_t kind = random() % 3;
+
+    std::map<int64_t, BlockTags> tags;
+    for (size_t i = 0; i < block_count; i++)
+    {
+        const int64_t index = random() % Chunk::block_count;
+        const char *name = names[random() % names.size()];
+
+        Variant value;
+        if (kind == 0)
+            value = Variant(int64_t(0));
+        else if (kind == 1)
+            value = Variant(int64_t(random() % 8));
+        else
+            value = random_value(random);
+
+        tags[index].tags[name] = value;
+    }
+    return tags;
+}
+
+/**
+ * Compares the serialized variants, `==` does not support every type.
+ */
+static std::vector<uint8_t> bytes_of(const Variant& value)
+{
+    BufferWriter writer;
+    CHECK(!writer.write_variant(value).has_error());
+    return writer.release();
+}
+
+static void check_equal(const std::map<int64_t, BlockTags>& a, const std::map<int64_t, BlockTags>& b)
+{
+    REQUIRE(a.size() == b.size());
+    for (const auto& [index, block_tags] : a)
+    {
+        REQUIRE(b.contains(index));
+        const BlockTags& other = b.at(index);
+        REQUIRE(block_tags.tags.size() == other.tags.size());
+        for (const auto& [name, value] : block_tags.tags)
+        {
+            REQUIRE(other.tags.contains(name));
+            CHECK(bytes_of(other.tags.at(name)) == bytes_of(value));
+        }
+    }
+}
+
+static std::map<int64_t, BlockTags> round_trip(const std::map<int64_t, BlockTags>& tags)
+{
+    BufferWriter writer;
+    TagCodec::encode(writer, tags);
+
+    std::map<int64_t, BlockTags> decoded;
+    BufferReader reader(writer.buffer().data(), writer.buffer().size());
+    CHECK(!TagCodec::decode(reader, decoded).has_error());
+    return decoded;
+}
+
+TEST_CASE("TagCodec round trip")
+{
+    std::mt19937 random(1234);
+
+    check_equal(round_trip({}), {});
+
+    std::map<int64_t, BlockTags> edges;
+    edges[0].tags["water"] = Variant(int64_t(0));
+    edges[Chunk::block_count - 1].tags["water"] = Variant(int64_t(0));
+    edges[Chunk::block_count - 1].tags["level"] = Variant(INT64_MIN);
+    edges[1].tags["level"] = Variant(INT64_MAX);
+    check_equal(round_trip(edges), edges);
+
+    for (int i = 0; i < 500; i++)
+    {
+        const std::map<int64_t, BlockTags> tags = random_tags(random, random() % 3000);
+        check_equal(round_trip(tags), tags);
+    }
+}
+
+TEST_CASE("TagCodec reads the map of variants saved before")
+{
+    std::mt19937 random(42);
+
+    for (int i = 0; i < 50; i++)
+    {
+        const std::map<int64_t, BlockTags> tags = random_tags(random, random() % 300);
+
+        std::map<int64_t, std::map<std::string, Variant>> map;
+        for (const auto& [index, block_tags] : tags)
+            for (const auto& [name, value] : block_tags.tags)
+                map[index][name] = value;
+
+        BufferWriter writer;
+        CHECK(!writer.write_variant(Variant(map)).has_error());
+
+        std::map<int64_t, BlockTags> decoded;
+        BufferReader reader(writer.buffer().data(), writer.buffer().size());
+        CHECK(!TagCodec::decode(reader, decoded).has_error());
+        check_equal(decoded, tags);
+    }
+}
+
+TEST_CASE("TagCodec rejects newer versions")
+{
+    BufferWriter writer;
+    TagCodec::encode(writer, {});
+
+    std::vector<uint8_t> data = writer.release();
+    const uint32_t version = TagCodec::version + 1;
+    std::memcpy(data.data() + sizeof(uint32_t), &version, sizeof(uint32_t));
+
+    std::map<int64_t, BlockTags> decoded;
+    BufferReader reader(data.data(), data.size());
+    CHECK(TagCodec::decode(reader, decoded).has_error());
+}
+
+TEST_CASE("TagCodec benchmark" * doctest::skip())
+{
+    // A chunk of an ocean: every block between the ground and the sea level is water.
+    std::map<int64_t, BlockTags> tags;
+    std::map<int64_t, std::map<std::string, Variant>> map;
+    for (int64_t x = 0; x < Chunk::width; x++)
+    {
+        for (int64_t z = 0; z < Chunk::width; z++)
+        {
+            for (int64_t y = 40; y < 64; y++)
+            {
+                tags[Chunk::linearize(x, y, z)].tags["water"] = Variant(int64_t(0));
+                map[Chunk::linearize(x, y, z)]["water"] = Variant(int64_t(0));
+            }
+        }
+    }
+
+    BufferWriter legacy;
+    REQUIRE(legacy.write_variant(Variant(map)).has_value());
+
+    BufferWriter columnar;
+    TagCodec::encode(columnar, tags);
+
+    const int iterations = 100;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        std::map<int64_t, BlockTags> decoded;
+        BufferReader reader(legacy.buffer().data(), legacy.buffer().size());
+        REQUIRE(TagCodec::decode(reader, decoded).has_value());
+    }
+    const auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        std::map<int64_t, BlockTags> decoded;
+        BufferReader reader(columnar.buffer().data(), columnar.buffer().size());
+        REQUIRE(TagCodec::decode(reader, decoded).has_value());
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const std::chrono::duration<double, std::micro> legacy_time = (middle - start) / iterations;
+    const std::chrono::duration<double, std::micro> columnar_time = (end - middle) / iterations;
+    info("{} water blocks: map {} bytes {:.0f} us, columns {} bytes {:.0f} us", tags.size(), legacy.buffer().size(), legacy_time.count(), columnar.buffer().size(), columnar_time.count());
+}
@@ -0,0 +1,349 @@
+#include "Core/Logger.hpp"
+#include "Core/ThreadPool.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+TEST_CASE("ThreadPool runs every task once")
+{
+    static constexpr size_t task_count = 10000;
+
+    std::vector<std::atomic<int>> runs(task_count * 2);
+
+    {
+        ThreadPool pool(4);
+
+        // Half of the tasks are started from the workers, to go through their deques and be stolen.
+        for (size_t i = 0; i < task_count; i++)
+            pool.async([&pool, &runs, i]()
+                       {
+                           runs[i].fetch_add(1);
+                           pool.async([&runs, i]()
+                                      { runs[task_count + i].fetch_add(1); }); });
+
+        // The destructor waits for every task.
+    }
+
+    for (const std::atomic<int>& count : runs)
+        CHECK(count.load() == 1);
+}
+
+TEST_CASE("Task")
+{
+    std::shared_ptr<int> value = std::make_shared<int>(0);
+
+    Task task([value]()
+              { (*value)++; });
+    CHECK(value.use_count() == 2);
+
+    Task moved = std::move(task);
+    CHECK(!task);
+    REQUIRE(moved);
+    moved();
+    CHECK(*value == 1);
+
+    moved = Task();
+    CHECK(value.use_count() == 1);
+
+    // Captures up to the inline size fit.
+    std::array<char, Task::inline_size> bytes{};
+    Task large([bytes]()
+               { (void)bytes; });
+    CHECK(large);
+}
+
+TEST_CASE("ThreadPool deque")
+{
+    WorkStealingDeque<int> deque(2);
+
+    for (int i = 0; i < 100; i++)
+        deque.push(i);
+
+    int item;
+    REQUIRE(deque.steal(item));
+    CHECK(item == 0);
+    REQUIRE(deque.pop(item));
+    CHECK(item == 99);
+
+    size_t count = 0;
+    while (deque.pop(item))
+        count++;
+    CHECK(count == 98);
+    CHECK(deque.empty());
+}
+
+TEST_CASE("ThreadPool priorities")
+{
+    std::mutex mutex;
+    std::vector<std::string> order;
+    const auto record = [&](std::string name)
+    {
+        return [&mutex, &order, name]()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(name);
+        };
+    };
+
+    {
+        ThreadPool pool(1);
+
+        // Block the only worker until every task is queued.
+        std::promise<void> started;
+        std::promise<void> gate;
+        std::shared_future<void> gate_future = gate.get_future().share();
+        pool.async([&started, gate_future]()
+                   {
+                       started.set_value();
+                       gate_future.wait(); },
+                   TaskPriority::Interactive);
+        started.get_future().wait();
+
+        pool.async(record("housekeeping"), TaskPriority::Housekeeping);
+        pool.async(record("far"), TaskPriority::NearGeneration, 100);
+        pool.async(record("near"), TaskPriority::NearGeneration, 1);
+        for (size_t i = 0; i < 64; i++)
+            pool.async(record("edit"), TaskPriority::Interactive);
+
+        gate.set_value();
+    }
+
+    REQUIRE(order.size() == 67);
+
+    // Edits go first, except at most one less important task per `starvation_interval` jobs whatever the phase of the
+    // rotation.
+    size_t others = 0;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        if (order[i] != "edit")
+            others++;
+        CHECK(others <= i / ThreadPool::starvation_interval + 1);
+    }
+
+    const auto position = [&](std::string_view name)
+    { return std::find(order.begin(), order.end(), name) - order.begin(); };
+
+    CHECK(position("near") < position("far"));
+
+    // Less important tasks are not starved by a flood of more important ones.
+    CHECK(position("housekeeping") < 64);
+}
+
+TEST_CASE("ThreadPool task handles")
+{
+    ThreadPool pool(2);
+
+    TaskHandle<int> answer = pool.async([]()
+                                        { return 21; });
+    TaskHandle<int> doubled = answer.then([](int value)
+                                          { return value * 2; });
+    CHECK(doubled.get() == 42);
+    CHECK(answer.is_done());
+
+    // Cancelled before starting: the task and its continuation never run.
+    std::promise<void> started;
+    std::promise<void> gate;
+    std::shared_future<void> gate_future = gate.get_future().share();
+    TaskHandle<void> blockers[2] = {
+        pool.async([gate_future]()
+                   { gate_future.wait(); }),
+        pool.async([gate_future]()
+                   { gate_future.wait(); }),
+    };
+
+    std::atomic<bool> ran = false;
+    TaskHandle<void> pending = pool.async([&ran]()
+                                          { ran = true; });
+    TaskHandle<void> continuation = pending.then([&ran]()
+                                                 { ran = true; });
+    CHECK(pending.cancel());
+    CHECK(pending.is_done());
+    continuation.wait();
+    CHECK(continuation.is_cancelled());
+
+    // Running tasks see the cancellation at their safe points.
+    TaskHandle<bool> running = pool.async([&started](const CancellationToken& token)
+                                          {
+                                              started.set_value();
+                                              while (!token.is_cancelled())
+                                                  std::this_thread::yield();
+                                              return true; });
+
+    gate.set_value();
+    for (TaskHandle<void>& blocker : blockers)
+        blocker.wait();
+
+    started.get_future().wait();
+    CHECK(!running.cancel());
+    CHECK(running.get() == true);
+    CHECK(!ran.load());
+}
+
+/**
+ * The previous pool: a single vector behind a mutex, shared by every submitter and worker.
+ */
+class MutexThreadPool
+{
+public:
+    MutexThreadPool(size_t num_threads)
+    {
+        for (size_t i = 0; i < num_threads; i++)
+            m_threads.emplace_back(&MutexThreadPool::thread_worker, this);
+    }
+
+    ~MutexThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_queue_mutex);
+            m_stop = true;
+        }
+
+        m_cv.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    void async(std::function<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_queue_mutex);
+            m_tasks.push_back(task);
+        }
+
+        m_cv.notify_one();
+    }
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_queue_mutex;
+    std::vector<std::function<void()>> m_tasks;
+    std::condition_variable m_cv;
+    bool m_stop = false;
+
+    void thread_worker()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_queue_mutex);
+                m_cv.wait(lock, [this]
+                          { return !m_tasks.empty() || m_stop; });
+
+                if (m_stop && m_tasks.empty())
+                    return;
+
+                task = m_tasks[m_tasks.size() - 1];
+                m_tasks.pop_back();
+            }
+
+            task();
+        }
+    }
+};
+
+/**
+ * Small tasks started from outside the pool and from the tasks themselves, like generation jobs starting the next
+ * stage of their chunk.
+ */
+template <typename Pool>
+static double run_contention_benchmark(size_t threads, size_t roots, size_t children)
+{
+    std::atomic<size_t> done = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    {
+        Pool pool(threads);
+
+        for (size_t i = 0; i < roots; i++)
+            pool.async([&pool, &done, children]()
+                       {
+                           for (size_t k = 0; k < children; k++)
+                               pool.async([&done]()
+                                          { done.fetch_add(1, std::memory_order_relaxed); });
+                           done.fetch_add(1, std::memory_order_relaxed); });
+    }
+
+    CHECK(done.load() == roots * (children + 1));
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+TEST_CASE("ThreadPool contention benchmark" * doctest::skip())
+{
+    // Run with `--no-skip -tc="ThreadPool contention benchmark"`.
+    const size_t threads = std::max<size_t>(std::thread::hardware_concurrency() - 1, 1);
+    static constexpr size_t roots = 20000;
+    static constexpr size_t children = 16;
+
+    const double mutex_ms = run_contention_benchmark<MutexThreadPool>(threads, roots, children);
+    const double stealing_ms = run_contention_benchmark<ThreadPool>(threads, roots, children);
+
+    info("{} threads, {} tasks: mutex pool {:.1f} ms, work-stealing pool {:.1f} ms", threads, roots * (children + 1), mutex_ms, stealing_ms);
+}
+
+TEST_CASE("ThreadPool submission benchmark" * doctest::skip())
+{
+    // Run with `--no-skip -tc="ThreadPool submission benchmark"`.
+    static constexpr size_t count = 1000000;
+
+    // Same captures as the chunk tasks: the owner, a chunk and its position.
+    std::shared_ptr<int> chunk = std::make_shared<int>(0);
+    int64_t x = 1;
+    int64_t z = 2;
+    std::atomic<int64_t> sum = 0;
+
+    const auto time = [](auto&& body)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / count;
+    };
+
+    const double function_ns = time([&]()
+                                    {
+                                        for (size_t i = 0; i < count; i++)
+                                        {
+                                            std::function<void()> function = [&sum, chunk, x, z]()
+                                            { sum.fetch_add(x + z + *chunk, std::memory_order_relaxed); };
+                                            function();
+                                        } });
+    const double task_ns = time([&]()
+                                {
+                                    for (size_t i = 0; i < count; i++)
+                                    {
+                                        Task task = [&sum, chunk, x, z]()
+                                        { sum.fetch_add(x + z + *chunk, std::memory_order_relaxed); };
+                                        task();
+                                    } });
+
+    const size_t threads = std::max<size_t>(std::thread::hardware_concurrency() - 1, 1);
+    const auto submit = [&](auto&& start)
+    {
+        return time([&]()
+                    {
+                        ThreadPool pool(threads);
+                        for (size_t i = 0; i < count; i++)
+                            start(pool, [&sum, chunk, x, z]()
+                                  { sum.fetch_add(x + z + *chunk, std::memory_order_relaxed); }); });
+    };
+
+    const double run_ns = submit([](ThreadPool& pool, auto&& function)
+                                 { pool.run(std::move(function)); });
+    const double async_ns = submit([](ThreadPool& pool, auto&& function)
+                                   { pool.async(std::move(function)); });
+
+    CHECK(sum.load() == int64_t(count * 4 * 3));
+
+    info("std::function {:.1f} ns, Task {:.1f} ns", function_ns, task_ns);
+    info("{} threads: run {:.1f} ns per task, async {:.1f} ns per task", threads, run_ns, async_ns);
+}
@@ -0,0 +1,154 @@
+#include "Core/Logger.hpp"
+#include "Core/ZLib.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+/**
+ * Allocations with `new` of the whole test binary, to check that the vectors are reused. zlib allocates with `malloc`,
+ * only when a stream of the thread is created.
+ */
+static std::atomic<size_t> allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+/**
+ * Bytes compressing like the blocks of a chunk: long runs of a few values with some noise.
+ */
+static std::vector<uint8_t> make_data(size_t size, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = random() % 16 == 0 ? uint8_t(random()) : uint8_t(i / 512);
+    return data;
+}
+
+TEST_CASE("ZLib round trip")
+{
+    for (size_t size : {size_t(0), size_t(1), size_t(4095), size_t(4096), size_t(100000), size_t(131072)})
+    {
+        const std::vector<uint8_t> data = make_data(size, (uint32_t)size);
+
+        for (int level : {-1, 1, 6, 9})
+        {
+            std::vector<uint8_t> compressed{1, 2, 3};
+            REQUIRE(ZLib::deflate(std::as_bytes(std::span(data)), compressed, level).has_value());
+            CHECK(compressed[0] == 1);
+
+            const std::span<const uint8_t> stream = std::span(compressed).subspan(3);
+
+            // Without hint, with a hint too small and with the exact size.
+            for (size_t hint : {size_t(0), size / 3, size})
+            {
+                std::vector<uint8_t> decompressed{4};
+                REQUIRE(ZLib::inflate(std::as_bytes(stream), decompressed, hint).has_value());
+                REQUIRE(decompressed.size() == size + 1);
+                CHECK(decompressed[0] == 4);
+                CHECK(std::equal(data.begin(), data.end(), decompressed.begin() + 1));
+            }
+        }
+    }
+}
+
+TEST_CASE("ZLib rejects truncated and oversized data")
+{
+    const std::vector<uint8_t> data = make_data(50000, 7);
+
+    std::vector<uint8_t> compressed;
+    REQUIRE(ZLib::deflate(std::as_bytes(std::span(data)), compressed).has_value());
+
+    std::vector<uint8_t> decompressed;
+    CHECK(ZLib::inflate(std::as_bytes(std::span(compressed).first(compressed.size() / 2)), decompressed).has_error());
+    CHECK(decompressed.empty());
+
+    CHECK(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed, 0, data.size() - 1).has_error());
+    CHECK(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed, 0, data.size()).has_value());
+    CHECK(decompressed == data);
+
+    // The stream of the thread is reset after a failure.
+    compressed[compressed.size() / 2] ^= 0xff;
+    decompressed.clear();
+    CHECK(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed).has_error());
+    compressed[compressed.size() / 2] ^= 0xff;
+    CHECK(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed).has_value());
+    CHECK(decompressed == data);
+}
+
+TEST_CASE("ZLib does not allocate once warm")
+{
+    const std::vector<uint8_t> data = make_data(131072, 3);
+
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+
+    // The first calls create the streams of the thread and grow the vectors.
+    for (int i = 0; i < 2; i++)
+    {
+        compressed.clear();
+        decompressed.clear();
+        REQUIRE(ZLib::deflate(std::as_bytes(std::span(data)), compressed, 6).has_value());
+        REQUIRE(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed).has_value());
+    }
+
+    const size_t before = allocations.load();
+    for (int i = 0; i < 10; i++)
+    {
+        compressed.clear();
+        decompressed.clear();
+        REQUIRE(ZLib::deflate(std::as_bytes(std::span(data)), compressed, 6).has_value());
+        REQUIRE(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed).has_value());
+    }
+    CHECK(allocations.load() == before);
+    CHECK(decompressed == data);
+}
+
+TEST_CASE("ZLib benchmark" * doctest::skip())
+{
+    const std::vector<uint8_t> data = make_data(131072, 5);
+    const int iterations = 500;
+
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+    const size_t before = allocations.load();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        compressed.clear();
+        REQUIRE(ZLib::deflate(std::as_bytes(std::span(data)), compressed, 6).has_value());
+    }
+    const auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        decompressed.clear();
+        REQUIRE(ZLib::inflate(std::as_bytes(std::span(compressed)), decompressed).has_value());
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const std::chrono::duration<double, std::micro> deflate_time = (middle - start) / iterations;
+    const std::chrono::duration<double, std::micro> inflate_time = (end - middle) / iterations;
+    info("deflate {:.1f} us, inflate {:.1f} us, {:.2f} allocations per call", deflate_time.count(), inflate_time.count(), double(allocations.load() - before) / (2 * iterations));
+}